@@ -0,0 +1,159 @@
+#include "bot.h"
+#include <limits.h>
+
+// Column of fish i after k more frames - same stepping and wrapping as the move kernels
+// span: number of columns a fish cycles through (cols - FISH_WIDTH)
+static int predict_pos(const FishPool* pool, int i, int k, int span) {
+    int fps = pool->framesPerStep[i] > 0 ? pool->framesPerStep[i] : 1;
+    int first = fps - pool->frameCounter[i];   // frames until the next step
+    if (first < 1) first = 1;
+    if (k < first) return pool->pos[i];
+
+    int steps = 1 + (k - first) / fps;
+    int p = pool->pos[i];
+    if (pool->dir[i] > 0) {
+        // Right: 0 .. span-1, then back to 0
+        if (p > span - 1) p = span - 1;
+        return (p + steps) % span;
+    }
+    // Left: span .. 1, then back to span
+    if (p < 1) p = 1;
+    if (p > span) p = span;
+    return 1 + ((p - 1 - steps) % span + span) % span;
+}
+
+// Key that moves the hook one column toward [lo, hi]
+static int steer(int hook_x, int lo, int hi) {
+    if (hook_x < lo) return 'd';
+    if (hook_x > hi) return 'a';
+    return GAME_INPUT_NONE;
+}
+
+// Hook geometry for the frame being planned
+typedef struct {
+    int max_depth;
+    int depth;
+    int lowering;
+    int top;            // tip row at depth 0
+    int hook_x;
+    int x_min, x_max;   // hook columns the boat can reach
+    int span;           // columns a fish cycles through
+    int spare;          // 1 if this frame's key is spent on the drop
+} HookPlan;
+
+// Frames until the tip is at depth d, on the way down and on the way back up
+// Returns: how many of ks[0..1] were filled, earliest first
+static int frames_to_depth(const HookPlan* h, int d, int ks[2]) {
+    int nk = 0;
+    if (h->lowering >= 0) {
+        if (d > h->depth) ks[nk++] = d - h->depth;
+        if (d < h->max_depth) ks[nk++] = (h->max_depth - h->depth) + (h->max_depth - d);
+    } else if (d < h->depth) {
+        ks[nk++] = h->depth - d;
+    }
+    return nk;
+}
+
+// Lower bound on the frames until the tip is anywhere in depths [d_lo, d_hi]
+static int earliest_frames(const HookPlan* h, int d_lo, int d_hi) {
+    if (h->lowering >= 0) {
+        if (d_hi > h->depth) return (d_lo > h->depth ? d_lo : h->depth + 1) - h->depth;
+        return (h->max_depth - h->depth) + (h->max_depth - d_hi);
+    }
+    return d_lo < h->depth ? h->depth - (d_hi < h->depth ? d_hi : h->depth - 1) : INT_MAX;
+}
+
+// Hook columns that hit fish i k frames from now; 0 if the boat cannot get there at all
+static int hit_columns(const HookPlan* h, const FishPool* pool, int i, int k, int* lo, int* hi) {
+    int p = predict_pos(pool, i, k, h->span);
+    *lo = p > h->x_min ? p : h->x_min;
+    *hi = p + FISH_WIDTH - 1 < h->x_max ? p + FISH_WIDTH - 1 : h->x_max;
+    return *lo <= *hi;
+}
+
+// Columns the boat still has to move to put the hook in [lo, hi]
+static int distance(int hook_x, int lo, int hi) {
+    return hook_x < lo ? lo - hook_x : (hook_x > hi ? hook_x - hi : 0);
+}
+
+/**
+ * Key for the next frame: 'h' to drop, 'a'/'d' to line the hook up, or none
+ * An intercept is reachable when the boat can cover the distance to the
+ * fish's predicted columns in the frames before the hook gets there
+ * (dropping costs the first frame's key). The earliest reachable one wins;
+ * if nothing is reachable from an idle hook the boat moves toward the
+ * fish it misses by the fewest columns and the hook stays up.
+ * A fish that cannot wrap around before the hook arrives moves at most
+ * one column per frame, so distant ones are skipped without predicting.
+ */
+int bot_input(const GameState* state) {
+    const FishPool* pool = &state->fish;
+    HookPlan h;
+    h.max_depth = state->max_hook_depth;
+    h.depth = state->hook_depth;
+    h.lowering = state->hook_lowering;
+    h.top = game_hook_y(state) - h.depth;
+    h.hook_x = game_hook_x(state);
+    h.x_min = BOAT_WIDTH / 2;                           // boat against the left wall
+    h.x_max = state->cols - (BOAT_WIDTH - 1) + BOAT_WIDTH / 2;
+    h.span = state->cols - FISH_WIDTH;
+    h.spare = h.lowering == 0 ? 1 : 0;
+
+    if (h.max_depth <= 0 || h.span <= 0) return GAME_INPUT_NONE;
+
+    // Earliest reachable catch
+    int best_k = INT_MAX, best_lo = 0, best_hi = 0;
+    for (int i = 0; i < pool->used; i++) {
+        if (!pool->alive[i]) continue;
+
+        // Depths at which the tip is inside this fish's rows
+        int d_lo = pool->row[i] - h.top;
+        int d_hi = d_lo + FISH_LINES - 1;
+        if (d_lo < 1) d_lo = 1;
+        if (d_hi > h.max_depth) d_hi = h.max_depth;
+        if (d_lo > d_hi || earliest_frames(&h, d_lo, d_hi) >= best_k) continue;
+
+        int p = pool->pos[i];
+        for (int d = d_lo; d <= d_hi; d++) {
+            int ks[2];
+            int nk = frames_to_depth(&h, d, ks);
+            for (int j = 0; j < nk && ks[j] < best_k; j++) {
+                int k = ks[j];
+                int wraps = pool->dir[i] > 0 ? p + k >= h.span - 1 : p - k <= 1;
+                int reach = 2 * k - h.spare;        // fish drift plus boat moves
+                if (!wraps && (h.hook_x < p - reach || h.hook_x > p + FISH_WIDTH - 1 + reach)) continue;
+
+                int lo, hi;
+                if (hit_columns(&h, pool, i, k, &lo, &hi) && distance(h.hook_x, lo, hi) <= k - h.spare) {
+                    best_k = k;
+                    best_lo = lo;
+                    best_hi = hi;
+                }
+            }
+        }
+    }
+    if (best_k != INT_MAX) {
+        return h.lowering == 0 ? 'h' : steer(h.hook_x, best_lo, best_hi);
+    }
+    if (h.lowering != 0) return GAME_INPUT_NONE;
+
+    // Nothing reachable: move toward the fish missed by the fewest columns
+    int near_excess = INT_MAX, near_lo = 0, near_hi = 0;
+    for (int i = 0; i < pool->used; i++) {
+        if (!pool->alive[i]) continue;
+        int d = pool->row[i] - h.top;
+        if (d < 1) d = 1;
+        if (d > h.max_depth) continue;
+
+        int ks[2];
+        int lo, hi;
+        if (frames_to_depth(&h, d, ks) == 0 || !hit_columns(&h, pool, i, ks[0], &lo, &hi)) continue;
+        int excess = distance(h.hook_x, lo, hi) - (ks[0] - h.spare);
+        if (excess < near_excess) {
+            near_excess = excess;
+            near_lo = lo;
+            near_hi = hi;
+        }
+    }
+    return near_excess != INT_MAX ? steer(h.hook_x, near_lo, near_hi) : GAME_INPUT_NONE;
+}
@@ -0,0 +1,18 @@
+#ifndef BOT_H
+#define BOT_H
+
+#include "game.h"
+
+/**
+ * Autoplayer - picks the key for the next game_step() from the game state
+ * It predicts where every fish will be when the hook tip passes its rows
+ * (one row per frame down to max_hook_depth and back up) and steers the
+ * boat so the hook meets the earliest fish it can still reach.
+ * Stateless: it re-plans from scratch every frame, so it can take over
+ * any game at any moment.
+ */
+
+// Function prototypes
+int bot_input(const GameState* state);
+
+#endif
@@ -5,8 +5,25 @@
 #include<stdlib.h>
 #include<time.h>
 #include<signal.h>
+#include<limits.h>
+#include<stdint.h>
+#include<sys/ioctl.h>
 #include "highscore.h"
+#include "leaderboard.h"
 #include "statistics.h"
+#include "stats_logger.h"
+#include "stats_query.h"
+#include "score_tree.h"
+#include "game.h"
+#include "fish_kernels.h"
+#include "scheduler.h"
+#include "scenery.h"
+#include "render_bench.h"
+#include "eventloop.h"
+#include "replay.h"
+#include "simulate.h"
+#include "bot.h"
+#include "profiler.h"
 
 // ANSI color codes for terminal output
 #define RED    "\033[31m"
@@ -15,25 +32,41 @@
 #define BLUE   "\033[34m"
 #define RESET  "\033[0m"
 
-// Signal flags - MUST be volatile sig_atomic_t for signal safety
-volatile sig_atomic_t pause_request = 0;  // Set when Ctrl+Z is pressed
-volatile sig_atomic_t quit_request = 0;   // Set when Ctrl+C is pressed
+// Render rate cap - independent of the simulation tick
+#define RENDER_FPS 60
+#define INPUT_QUEUE_SIZE 16
 
 // Animation state for moss (seaweed)
-static time_t last_moss_update = 0;
+static long long last_moss_update = -1;
 static int moss_reversed = 0;
 static int wave_offset = 0;
 
-// Game state variables
-int score = 0;
-int lives = 3;
-int fish_caught_total = 0;
-int hooks_missed_total = 0;
-int paused = 0;  // Regular int, not volatile - only modified in main loop
-int time_limit = 30;
-time_t start_time;
-time_t pause_start = 0;
-time_t total_pause_time = 0;
+// Cached background layers (castle, waves, moss)
+static Scenery scenery;
+
+// Frame profiler: overlay shown ('o' during a game), dump file of --profile
+static int show_profile = 0;
+static const char* profile_path = NULL;
+
+// ASCII art castle
+static const char* castle[] = {
+    "               T~~",
+     "               |",
+      "              /^\\",
+       "             /   \\",
+    " _   _   _  /     \\  _   _   _", 
+    "[ ]_[ ]_[ ]/ _   _ \\[ ]_[ ]_[ ]",
+    "|_=__-_ =_|_[ ]_[ ]_|_=-___-__|", 
+    " | _- =  | =_ = _    |= _=   |",
+    " |= -[]  |- = _ =    |_-=_[] |", 
+    " | =_    |= - ___    | =_ =  |",
+    " |=  []- |-  /| |\\   |=_ =[] |",
+    " |- =_   |=|       | |- = -  |",
+    " |_______|__|_|_|_|__|_______|",
+};
+#define CASTLE_LINES ((int)(sizeof(castle) / sizeof(castle[0])))
+
+// Player shown in the HUD and saved with the results
 char player_name[20] = "Player";
 
 // Global color pair IDs for ncurses
@@ -44,178 +77,100 @@ int COLOR_BLUE_PAIR = 4;
 int COLOR_MAGENTA_PAIR = 5;
 int COLOR_CYAN_PAIR = 6;
 
-/**
- * Calculate remaining game time accounting for pauses
- * Returns: seconds remaining (0 if time is up)
- */
-int get_remaining_time(){
-    time_t current = time(NULL);
-    int elapsed = (int)difftime(current, start_time) - total_pause_time;
-
-    // If currently paused, don't count current pause duration yet
-    if(paused && pause_start > 0){
-        elapsed -= (int)difftime(current, pause_start);
-    }
-    int remaining = time_limit - elapsed;
-    return remaining > 0 ? remaining : 0;
-}
-
-/**
- * Signal handler for SIGTSTP (Ctrl+Z)
- * IMPORTANT: We intercept Ctrl+Z to pause game instead of suspending process
- * This prevents "suspended jobs" issues in the terminal
- */
-void handle_sigtstp(int sig) {
-    pause_request = 1;  // Just set flag, return immediately
-    // Note: By handling this signal, we prevent default suspend behavior
-}
-
-/**
- * Signal handler for SIGINT (Ctrl+C)
- * IMPORTANT: Signal handlers must be minimal - only set flags!
- */
-void handle_sigint(int sig) {
-    quit_request = 1;  // Just set flag, return immediately
-}
-
 /**
  * Toggle game pause state
- * Handles pause timer tracking and screen refresh
+ * The scheduler stops the game clock, so pauses are accounted to the millisecond
  */
-void toggle_pause(){
-    time_t current = time(NULL);
-    
-    if(paused){
+void toggle_pause(FrameScheduler* sched, long long now){
+    if(sched->paused){
         // Resuming from pause
-        if(pause_start > 0){
-            total_pause_time += (int)difftime(current, pause_start);
-            pause_start = 0;
-        }
-        paused = 0;
+        sched_resume(sched, now);
         
         // Restore ncurses screen state after resume
         refresh();
         clear();
     } else {
         // Entering pause state
-        pause_start = current;
-        paused = 1;
+        sched_pause(sched, now);
     }
 }
 
 /**
- * Fish structure - represents a single fish in the pond
+ * Build the static scenery layer: castle in the bottom-right corner
+ * Done once per game - the castle never changes, so it is never recomputed
  */
-typedef struct {
-    int pos;            // Horizontal position
-    int row;            // Vertical position (row)
-    int dir;            // Direction: -1 (left) or 1 (right)
-    int width;          // Width of fish ASCII art
-    int framesPerStep;  // Speed control - frames before moving
-    int frameCounter;   // Current frame count
-} Fish;
+static void build_scenery(int cols, int lines) {
+    int castle_width = 0;
+    for (int i = 0; i < CASTLE_LINES; i++) {
+        int len = strlen(castle[i]);
+        if (len > castle_width) castle_width = len;
+    }
+
+    int start_col = cols - castle_width - 1;
+    if (start_col < 0) start_col = 0;
+    int start_row = lines - CASTLE_LINES - 1;
+    if (start_row < 0) start_row = 0;
+
+    for (int i = 0; i < CASTLE_LINES; i++) {
+        scenery_put_static(&scenery, start_row + i, start_col, castle[i], COLOR_PAIR(COLOR_BLUE_PAIR));
+    }
+    scenery_put_static(&scenery, (2 * start_row) + 1, start_col + 12, player_name, COLOR_PAIR(COLOR_BLUE_PAIR));
+    last_moss_update = -1;  // compose the first animation frame right away
+}
 
 /**
  * Draw animated border with waves, moss, and castle
- * Creates the game environment visualization
+ * Waves and moss change once per second; only then is a new frame composed,
+ * and only the background cells that actually changed are repainted.
+ * Returns: number of background cells painted (sprites on them need redrawing)
  */
-void draw_border() {
+int draw_border(long long now_ns) {
     // Wave pattern for water surface
     const char* wave = "~~~~    ";
 
     // Animate moss (seaweed) by toggling pattern every second
-    time_t current_time = time(NULL);
+    long long current_time = now_ns / NS_PER_SEC;
     if (current_time != last_moss_update) {
         moss_reversed = !moss_reversed;
         wave_offset = (wave_offset + 1) % 8;
         last_moss_update = current_time;
-    }
 
-    // Two alternating moss patterns for animation effect
-    const char* moss_normal[] = {"(", " )", "(", " )", "("};
-    const char* moss_reverse[] = {" )", "(", " )", "(", " )"};
-    const char** moss = moss_reversed ? moss_reverse : moss_normal;
-    
-    // Draw moss at various positions along the bottom
-    int moss_len = 5;
-    int start_rowm = LINES - moss_len - 1;
-    if (start_rowm < 0) start_rowm = 0;
-    
-    attron(COLOR_PAIR(COLOR_GREEN_PAIR));
-    // Clear old moss positions
-    for(int i = 0; i < moss_len; i++){
-        mvaddstr(start_rowm + i, 5, "  ");
-        mvaddstr(start_rowm + i, 10, "  ");
-        mvaddstr(start_rowm + i, 15, "  ");
-        mvaddstr(start_rowm + i, 20, "  ");
-        mvaddstr(start_rowm + i, COLS / 2, "  ");
-        mvaddstr(start_rowm + i, COLS / 2 + 10, "  ");
-        mvaddstr(start_rowm + i, COLS / 2 + 15, "  ");
-        mvaddstr(start_rowm + i, COLS / 2 + 20, "  ");
-        mvaddstr(start_rowm + i, COLS / 2 + 40, "  ");
-        mvaddstr(start_rowm + i, COLS / 2 + 45, "  ");
-    }
-    
-    // Draw new moss positions
-    for(int i = 0; i < moss_len; i++){
-        mvaddstr(start_rowm + i, 5, moss[i]);
-        mvaddstr(start_rowm + i, 10, moss[i]);
-        mvaddstr(start_rowm + i, 15, moss[i]);
-        mvaddstr(start_rowm + i, 20, moss[i]);
-        mvaddstr(start_rowm + i, COLS / 2, moss[i]);
-        mvaddstr(start_rowm + i, COLS / 2 + 10, moss[i]);
-        mvaddstr(start_rowm + i, COLS / 2 + 15, moss[i]);
-        mvaddstr(start_rowm + i, COLS / 2 + 20, moss[i]);
-        mvaddstr(start_rowm + i, COLS / 2 + 40, moss[i]);
-        mvaddstr(start_rowm + i, COLS / 2 + 45, moss[i]);
-    }
-    attroff(COLOR_PAIR(COLOR_GREEN_PAIR));
-    
-    // ASCII art castle
-    const char* castle[] = {
-        "               T~~",
-         "               |",
-          "              /^\\",
-           "             /   \\",
-        " _   _   _  /     \\  _   _   _", 
-        "[ ]_[ ]_[ ]/ _   _ \\[ ]_[ ]_[ ]",
-        "|_=__-_ =_|_[ ]_[ ]_|_=-___-__|", 
-        " | _- =  | =_ = _    |= _=   |",
-        " |= -[]  |- = _ =    |_-=_[] |", 
-        " | =_    |= - ___    | =_ =  |",
-        " |=  []- |-  /| |\\   |=_ =[] |",
-        " |- =_   |=|       | |- = -  |",
-        " |_______|__|_|_|_|__|_______|",
-    };
-    int castle_len = sizeof(castle)/sizeof(castle[0]);
-    int castle_width = 0;
-    for (int i = 0; i < castle_len; i++) {
-        int len = strlen(castle[i]);
-        if (len > castle_width) castle_width = len;
-    }
+        // Two alternating moss patterns for animation effect
+        const char* moss_normal[] = {"(", " )", "(", " )", "("};
+        const char* moss_reverse[] = {" )", "(", " )", "(", " )"};
+        const char** moss = moss_reversed ? moss_reverse : moss_normal;
+        int moss_cols[] = {5, 10, 15, 20, COLS / 2, COLS / 2 + 10, COLS / 2 + 15,
+                           COLS / 2 + 20, COLS / 2 + 40, COLS / 2 + 45};
 
-    // Draw animated wave pattern at water surface
-    attron(COLOR_PAIR(COLOR_CYAN_PAIR));
-    int wave_len = strlen(wave);
-    for (int i = 0; i < COLS - 1; i++) {
-        mvaddch(LINES / 4, i, '~');
-        mvaddch(LINES / 4 + 1, i, wave[(i + wave_offset) % wave_len]);
-        mvaddch(LINES / 4 + 2, i, wave[(i + wave_offset + 2) % wave_len]);
-    }
-    attroff(COLOR_PAIR(COLOR_CYAN_PAIR));
+        scenery_begin_frame(&scenery);
 
-    // Draw castle in bottom-right corner
-    attron(COLOR_PAIR(COLOR_BLUE_PAIR));
-    int start_col = COLS - castle_width - 1;
-    if (start_col < 0) start_col = 0;
-    int start_row = LINES - castle_len - 1;
-    if (start_row < 0) start_row = 0;
-    
-    for(int i = 0; i < castle_len; i++){
-        mvaddstr(start_row + i, start_col, castle[i]);
+        // Moss at various positions along the bottom
+        int moss_len = 5;
+        int start_rowm = LINES - moss_len - 1;
+        if (start_rowm < 0) start_rowm = 0;
+        for (int i = 0; i < moss_len; i++) {
+            for (int j = 0; j < (int)(sizeof(moss_cols) / sizeof(moss_cols[0])); j++) {
+                scenery_put_anim(&scenery, start_rowm + i, moss_cols[j], moss[i], COLOR_PAIR(COLOR_GREEN_PAIR));
+            }
+        }
+
+        // Animated wave pattern at water surface
+        int wave_len = strlen(wave);
+        char row[3][COLS + 1];
+        for (int i = 0; i < COLS - 1; i++) {
+            row[0][i] = '~';
+            row[1][i] = wave[(i + wave_offset) % wave_len];
+            row[2][i] = wave[(i + wave_offset + 2) % wave_len];
+        }
+        for (int r = 0; r < 3; r++) {
+            row[r][COLS > 0 ? COLS - 1 : 0] = '\0';
+            scenery_put_anim(&scenery, LINES / 4 + r, 0, row[r], COLOR_PAIR(COLOR_CYAN_PAIR));
+        }
+
+        scenery_commit_frame(&scenery);
     }
-    mvaddstr((2 * start_row) + 1, start_col + 12, player_name);
-    attroff(COLOR_PAIR(COLOR_BLUE_PAIR));
+
+    return scenery_paint(&scenery);
 }
 
 /**
@@ -225,18 +180,20 @@ void draw_border() {
 static void erase_boat(int boat_x) {
     int water_y = LINES / 4;
     int boat_y = water_y - 2;
-    int max_w = 14;
-    
-    // Bounds checking
-    if (boat_x < 0) boat_x = 0;
-    if (boat_x + max_w >= COLS) max_w = COLS - boat_x;
     
-    if (max_w > 0 && boat_y >= 0) {
-        for (int i = 0; i < 2; i++) {
-            for (int j = 0; j < max_w && (boat_x + j) < COLS; j++) {
-                mvaddch(boat_y + i, boat_x + j, ' ');
-            }
-        }
+    for (int i = 0; i < 2; i++) {
+        scenery_restore(&scenery, boat_y + i, boat_x, 14);
+    }
+}
+
+/**
+ * Put the background back over the part of the fishing line that is gone
+ * line_x/depth: where the line was drawn, new_depth: what stays drawn (-1 = nothing)
+ */
+static void erase_hook(int line_x, int depth, int new_depth) {
+    int line_start_y = LINES / 4 + 1;
+    for (int d = new_depth + 1; d <= depth; d++) {
+        scenery_restore(&scenery, line_start_y + d, line_x, 1);
     }
 }
 
@@ -244,8 +201,10 @@ static void erase_boat(int boat_x) {
  * Draw boat and fishing hook
  * boat_x: horizontal position of boat
  * hook_depth: how deep the hook is lowered
+ * drawn_x/drawn_depth: where the line was drawn last time, updated here
+ * Only the part of the line that moved away is erased - not the whole column
  */
-static void draw_boat_and_hook(int boat_x, int hook_depth) {
+static void draw_boat_and_hook(int boat_x, int hook_depth, int* drawn_x, int* drawn_depth) {
     // Boat ASCII art
     const char *boat_top = "    __/\\__   ";
     const char *boat_hull = "___/______\\__";
@@ -266,14 +225,15 @@ static void draw_boat_and_hook(int boat_x, int hook_depth) {
     int line_x = boat_x + bw / 2;
     int line_start_y = water_y + 1;
     int line_end_y = line_start_y + hook_depth;
+
+    // Erase what is left of the old line
+    if (*drawn_x >= 0) {
+        erase_hook(*drawn_x, *drawn_depth, *drawn_x == line_x ? hook_depth : -1);
+    }
     
     // Draw fishing line and hook
     attron(COLOR_PAIR(COLOR_MAGENTA_PAIR));
     if (line_x >= 0 && line_x < COLS) {
-        // Clear entire vertical line first
-        for (int y = line_start_y; y < LINES; y++) {
-            mvaddch(y, line_x, ' ');
-        }
         // Draw fishing line
         for (int y = line_start_y; y < line_end_y && y < LINES; y++) {
             mvaddch(y, line_x, '|');
@@ -282,43 +242,35 @@ static void draw_boat_and_hook(int boat_x, int hook_depth) {
         if (line_end_y < LINES) mvaddch(line_end_y, line_x, 'J');
     }
     attroff(COLOR_PAIR(COLOR_MAGENTA_PAIR));
+    *drawn_x = line_x;
+    *drawn_depth = hook_depth;
 }
 
 /**
- * Draw a fish at its current position
+ * Draw a fish at the given position
  * Uses appropriate left or right facing ASCII art based on direction
  */
-void draw_fish(Fish* fish, const char** left_fish, const char** right_fish, int lines) {
-    attron(COLOR_PAIR(COLOR_CYAN_PAIR));
-    const char** art = (fish->dir == -1) ? left_fish : right_fish;
+void draw_fish(int pos, int row, int dir, const char** left_fish, const char** right_fish, int lines) {
+    const char** art = (dir == -1) ? left_fish : right_fish;
+    int avail = COLS - pos;
+    if (avail <= 0) return;
     
     for (int i = 0; i < lines; i++) {
         const char* s = art[i];
         int len = (int)strlen(s);
-        int avail = COLS - fish->pos;
-        if (avail > 0) {
-            if (len > avail) len = avail;
-            mvaddnstr(fish->row + i, fish->pos, s, len);
-        }
+        if (len > avail) len = avail;
+        mvaddnstr(row + i, pos, s, len);
     }
-    attroff(COLOR_PAIR(COLOR_CYAN_PAIR));
 }
 
 /**
- * Erase fish from screen at current position
+ * Erase a fish drawn at the given position
  * Used before moving fish to new position
  */
-void erase_fish(Fish* fish, int lines) {
-    static const char blanks[] = "                                                                ";
-    int erase_len = fish->width;
-    if (erase_len > (int)sizeof(blanks) - 1) erase_len = (int)sizeof(blanks) - 1;
-    
+void erase_fish(int pos, int row, int lines) {
+    // Copy the background back so moss and castle are not punched out
     for (int i = 0; i < lines; i++) {
-        int avail = COLS - fish->pos;
-        int len = erase_len;
-        if (avail <= 0) continue;
-        if (len > avail) len = avail;
-        mvaddnstr(fish->row + i, fish->pos, blanks, len);
+        scenery_restore(&scenery, row + i, pos, FISH_WIDTH);
     }
 }
 
@@ -409,357 +361,1200 @@ void cleanup_terminal() {
 }
 
 /**
- * Main game function
+ * Scripted input used by headless runs: drop the hook whenever it is idle
  */
-int main(){
-    while(1){
-        srand(time(NULL));
-        
-        // Get player name and show menu
-        get_player_name();
-        show_main_menu();
+static int headless_input(const GameState* game){
+    return game->hook_lowering == 0 ? 'h' : GAME_INPUT_NONE;
+}
 
-        // Register cleanup function to run on exit
-        atexit(cleanup_terminal);
+// Settings shared by the terminal-less modes
+typedef struct {
+    long frames;        // game_step() calls to simulate
+    int cols;           // pond size
+    int lines;
+    int fish;           // population
+    int schooling;      // 1 = fish flock
+    int bot;            // 1 = the autoplayer plays instead of headless_input()
+    unsigned long long seed;    // seed of the first game; game n uses seed + n
+} SimOptions;
 
-        // Initialize ncurses
-        initscr();
-        cbreak();
-        noecho();
-        curs_set(0);
-        timeout(0);
-        keypad(stdscr, TRUE);  // Enable special keys
-
-        // Initialize color pairs
-        start_color();
-        use_default_colors();
-        init_pair(COLOR_RED_PAIR, COLOR_RED, -1);
-        init_pair(COLOR_GREEN_PAIR, COLOR_GREEN, -1);
-        init_pair(COLOR_YELLOW_PAIR, COLOR_YELLOW, -1);
-        init_pair(COLOR_BLUE_PAIR, COLOR_BLUE, -1);
-        init_pair(COLOR_MAGENTA_PAIR, COLOR_MAGENTA, -1);
-        init_pair(COLOR_CYAN_PAIR, COLOR_CYAN, -1);
-
-        // Set up signal handlers using sigaction (more portable than signal())
-        struct sigaction sa_tstp, sa_int;
-        
-        sa_tstp.sa_handler = handle_sigtstp;
-        sigemptyset(&sa_tstp.sa_mask);
-        sa_tstp.sa_flags = 0;
-        sigaction(SIGTSTP, &sa_tstp, NULL);
-        
-        sa_int.sa_handler = handle_sigint;
-        sigemptyset(&sa_int.sa_mask);
-        sa_int.sa_flags = 0;
-        sigaction(SIGINT, &sa_int, NULL);
+// Key for the next frame of a terminal-less run
+static int sim_input(const SimOptions* opt, const GameState* game){
+    return opt->bot ? bot_input(game) : headless_input(game);
+}
 
-        start_time = time(NULL);
+// Seed for a game nobody asked to reproduce
+static unsigned long long fresh_seed(void){
+    return (unsigned long long)time(NULL) ^ ((unsigned long long)getpid() << 32) ^
+           (unsigned long long)sched_clock_ns();
+}
 
-        // Fish ASCII art (left and right facing)
-        const char* left_fish[] = {" /,", "<')=<", " \\`"};
-        const char* right_fish[] = {" ,'", "=>('>", " '/"};
-        
-        int fish_lines = 3;
-        int fish_width = 5;
-        
-        // Initialize fish array
-        Fish fishes[10];
-        int pond_top = LINES / 4 + 3;
-        int pond_bottom = LINES - 1;
-        int water_span = (pond_bottom - pond_top - fish_lines);
-        if (water_span < 3) water_span = 3;
-        
-        // Divide pond into three depth zones
-        int band = water_span / 3;
-        int top_start = pond_top;
-        int top_end = pond_top + band;
-        int mid_start = pond_top + band;
-        int mid_end = pond_top + 2 * band;
-        int bot_start = pond_top + 2 * band;
-        int bot_end = pond_bottom - fish_lines;
-        
-        // Ensure valid ranges
-        if (top_end <= top_start) top_end = top_start + 1;
-        if (mid_end <= mid_start) mid_end = mid_start + 1;
-        if (bot_end <= bot_start) bot_end = bot_start + 1;
-
-        // Spawn fish at random positions and depths
-        for (int i = 0; i < 10; i++) {
-            fishes[i].pos = (COLS > fish_width) ? rand() % (COLS - fish_width) : 0;
-            
-            // Distribute fish across depth zones
-            if (i < 4) {
-                // Middle depth
-                int span = mid_end - mid_start;
-                fishes[i].row = mid_start + (span > 0 ? rand() % span : 0);
-            } else if (i < 6) {
-                // Deep
-                int span = bot_end - bot_start;
-                fishes[i].row = bot_start + (span > 0 ? rand() % span : 0);
-            } else {
-                // Shallow
-                int span = top_end - top_start;
-                fishes[i].row = top_start + (span > 0 ? rand() % span : 0);
+// Create a game for a terminal-less run; prints the reason on failure
+static int sim_game_init(GameState* game, const SimOptions* opt, int fish){
+    if (game_init(game, opt->cols, opt->lines, fish, opt->seed) == -1) {
+        fprintf(stderr, "Out of memory for %d fish\n", fish);
+        return -1;
+    }
+    if (game_set_schooling(game, opt->schooling) == -1) {
+        fprintf(stderr, "Out of memory for the schooling grid\n");
+        game_free(game);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Run games back to back without a terminal
+ * Prints throughput and score summary to stdout
+ */
+static int run_headless(const SimOptions* opt){
+    GameState game;
+    long frames = opt->frames;
+    long games = 0;
+    long total_score = 0;
+    long total_caught = 0;
+    long total_missed = 0;
+
+    if (sim_game_init(&game, opt, opt->fish) == -1) {
+        return 1;
+    }
+    long long t0 = sched_clock_ns();
+    for (long f = 0; f < frames; f++) {
+        if (game_step(&game, sim_input(opt, &game)) & GAME_EVENT_OVER) {
+            games++;
+            total_score += game.score;
+            total_caught += game.fish_caught_total;
+            total_missed += game.hooks_missed_total;
+            game_reset(&game, opt->seed + games);
+        }
+    }
+    double seconds = (sched_clock_ns() - t0) / 1e9;
+    printf("Headless run: %dx%d pond, %d fish, %s kernels%s%s, seed %llu\n", opt->cols, opt->lines,
+           game.fish.capacity, game.kernels->name, game.schooling ? ", schooling" : "",
+           opt->bot ? ", bot" : "", opt->seed);
+    printf("  frames simulated : %ld\n", frames);
+    printf("  games finished   : %ld\n", games);
+    printf("  wall time        : %.3f s\n", seconds);
+    printf("  frames/sec       : %.0f\n", seconds > 0 ? frames / seconds : 0.0);
+    printf("  ns/frame         : %.1f\n", frames > 0 ? seconds * 1e9 / frames : 0.0);
+    printf("  ns/fish/frame    : %.2f\n", frames > 0 ? seconds * 1e9 / frames / game.fish.capacity : 0.0);
+    if (games > 0) {
+        printf("  avg score        : %.2f\n", (double)total_score / games);
+        printf("  avg caught       : %.2f\n", (double)total_caught / games);
+        printf("  avg missed       : %.2f\n", (double)total_missed / games);
+    }
+    game_free(&game);
+    return 0;
+}
+
+#define SCALE_MIN_FISH 1000
+#define SCALE_MAX_NS (NS_PER_SEC / 4)   // time budget per population size
+
+/**
+ * Measure how the cost of one tick grows with the fish count
+ * Populations double from SCALE_MIN_FISH up to opt->fish; each runs for
+ * opt->frames ticks or a quarter second, whichever comes first.
+ */
+static int run_scaling(const SimOptions* opt){
+    int sizes[32];
+    int count = 0;
+    for (int n = opt->fish; count < 32; n /= 2) {
+        sizes[count++] = n;
+        if (n / 2 < SCALE_MIN_FISH) break;
+    }
+
+    printf("Tick cost by fish count: %dx%d pond, %s kernels, schooling %s\n", opt->cols, opt->lines,
+           fish_kernels_get()->name, opt->schooling ? "on" : "off");
+    printf("  %8s %10s %12s %14s\n", "fish", "ticks", "ns/tick", "ns/fish/tick");
+
+    double prev_ns = 0;
+    int prev_fish = 0;
+    for (int k = count - 1; k >= 0; k--) {
+        GameState game;
+        if (sim_game_init(&game, opt, sizes[k]) == -1) {
+            return 1;
+        }
+        long ticks = 0;
+        long long t0 = sched_clock_ns();
+        long long spent = 0;
+        while (ticks < opt->frames && spent < SCALE_MAX_NS) {
+            if (game_step(&game, sim_input(opt, &game)) & GAME_EVENT_OVER) {
+                game_reset(&game, game.seed + 1);
             }
-            
-            fishes[i].dir = (rand() % 2) * 2 - 1;  // -1 or 1
-            fishes[i].width = fish_width;
-            fishes[i].framesPerStep = 1 + rand() % 6;  // Random speed
-            fishes[i].frameCounter = 0;
-        }
-
-        // Game state variables
-        int speed = 4;
-        int boat_x = COLS / 4;
-        int hook_depth = 0;
-        int hook_lowering = 0;  // 0=idle, 1=lowering, -1=raising
-        int max_hook_depth = (LINES - (LINES/4) - 4);
-        if (max_hook_depth < 0) max_hook_depth = 0;
-        
-        static int prev_boat_x = -1;
-        int hook_miss_penalized = 0;
-        int fish_caught_this_attempt = 0;
-        int game_over = 0;
-        int quit_confirmation_mode = 0;  // Track if waiting for quit confirmation
-
-        // Main game loop
-        while(!game_over){
-            draw_border();
-
-            // Handle quit request (Ctrl+C pressed)
-            if (quit_request && !quit_confirmation_mode) {
-                if (!paused) {
-                    toggle_pause();  // Pause game while confirming
-                }
-                quit_confirmation_mode = 1;
-                attron(COLOR_PAIR(COLOR_RED_PAIR));
-                mvprintw(LINES / 2, (COLS - 60) / 2, "Are you sure you want to quit? (y/n)");
-                attroff(COLOR_PAIR(COLOR_RED));
-                refresh();
+            if (++ticks % 16 == 0) spent = sched_clock_ns() - t0;
+        }
+        spent = sched_clock_ns() - t0;
+
+        double ns = (double)spent / ticks;
+        printf("  %8d %10ld %12.0f %14.2f", sizes[k], ticks, ns, ns / sizes[k]);
+        if (prev_fish > 0) {
+            printf("   x%.2f fish -> x%.2f time", (double)sizes[k] / prev_fish, ns / prev_ns);
+        }
+        printf("\n");
+        prev_ns = ns;
+        prev_fish = sizes[k];
+        game_free(&game);
+    }
+    return 0;
+}
+
+/**
+ * Monte Carlo mode: play 'games' games at every speed level on a thread pool
+ * and print the score, catch and lives-lost distributions per level
+ */
+static int run_simulate(const SimOptions* opt, long games, int threads, int log_games, int fsync_ms){
+    SimConfig cfg = { games, threads, opt->cols, opt->lines, opt->fish, opt->schooling, opt->bot,
+                      opt->seed, MIN_SPEED, MAX_SPEED, log_games };
+    if (log_games && stats_logger_start(fsync_ms) == -1) {
+        return 1;
+    }
+    SimResult* res = malloc(sizeof(SimResult));
+    if (res == NULL || simulate_run(&cfg, res) == -1) {
+        fprintf(stderr, "Simulation failed: out of memory or threads\n");
+        free(res);
+        return 1;
+    }
+    simulate_print(&cfg, res);
+    free(res);
+    if (log_games) {
+        StatsLoggerCounters c;
+        long long t0 = sched_clock_ns();
+        stats_logger_stop();
+        stats_logger_counters(&c);
+        printf("\nLogged %lld of %lld games to %s in %lld commits, %lld syncs (%.1f ms to drain at exit)\n",
+               c.logged, c.pushed, STATS_FILE, c.commits, c.syncs, (sched_clock_ns() - t0) / 1e6);
+        if (c.failed > 0) return 1;
+    }
+    return 0;
+}
+
+/**
+ * Where a score stands among every game saved, overall and at its speed
+ */
+static void print_game_rank(int score, int speed){
+    Leaderboard lb;
+    if (leaderboard_open(&lb, HIGHSCORE_FILE) == -1) {
+        return;
+    }
+    int board = leaderboard_board_of(speed);
+    printf(GREEN "Rank #%ld of %ld games" RESET, leaderboard_rank(&lb, 0, score), leaderboard_games(&lb, 0));
+    if (board != 0) {
+        printf(GREEN ", #%ld of %ld at speed %d" RESET, leaderboard_rank(&lb, board, score),
+               leaderboard_games(&lb, board), speed);
+    }
+    printf("\n");
+    leaderboard_close(&lb);
+}
+
+/**
+ * Share of all logged games at the same speed that this score beat
+ * logged: 1 if this game is in the stats log - opening the trees catches
+ * them up with the log, so it is then counted too and is left out here
+ */
+static void print_percentile(int score, int speed, int logged){
+    ScoreTree tree;
+    if (score_tree_open(&tree, STATS_FILE) == -1) {
+        return;
+    }
+    int board = score_tree_board_of(speed);
+    long long others = score_tree_count(&tree, board) - (logged ? 1 : 0);
+    if (others > 0) {
+        printf(GREEN "You beat %.0f%% of the %lld other games played at %s%d\n" RESET,
+               100.0 * score_tree_below(&tree, board, score) / others, others,
+               board ? "speed " : "any speed, ", board ? board : speed);
+    }
+    score_tree_close(&tree);
+}
+
+/**
+ * Score distribution of every logged game, per speed level
+ */
+static int run_percentiles(void){
+    static const double quantiles[] = { 0.10, 0.25, 0.50, 0.75, 0.90, 0.99 };
+    ScoreTree tree;
+    if (score_tree_open(&tree, STATS_FILE) == -1) {
+        fprintf(stderr, "Cannot open the score trees of %s\n", STATS_FILE);
+        return 1;
+    }
+    printf("Scores of logged games (%s%s)\n", STATS_FILE, SCORE_TREE_SUFFIX);
+    printf("  %-6s %10s %6s %6s %6s %6s %6s %6s\n", "speed", "games", "p10", "p25", "p50", "p75", "p90", "p99");
+    for (int board = 0; board < SCORE_TREE_BOARDS; board++) {
+        long long games = score_tree_count(&tree, board);
+        if (games == 0) continue;
+        if (board == 0) printf("  %-6s %10lld", "all", games);
+        else printf("  %-6d %10lld", board, games);
+        for (int q = 0; q < (int)(sizeof(quantiles) / sizeof(quantiles[0])); q++) {
+            printf(" %6d", score_tree_quantile(&tree, board, quantiles[q]));
+        }
+        printf("\n");
+    }
+    score_tree_close(&tree);
+    return 0;
+}
+
+/**
+ * Aggregate the stats log by player, day or speed on all cores
+ */
+static int run_query(const StatsQuery* q){
+    StatsQueryResult res;
+    if (stats_query_run(STATS_FILE, q, &res) == -1) {
+        perror("Error querying stats log");
+        return 1;
+    }
+    stats_query_print(q, &res);
+    stats_query_free(&res);
+    return 0;
+}
+
+/**
+ * Parse a YYYY-MM-DD day (local time) into its first or last second
+ * Returns: 0 on success, -1 if it is not a date
+ */
+static int parse_day(const char* text, int end_of_day, time_t* out){
+    struct tm tm_info;
+    memset(&tm_info, 0, sizeof(tm_info));
+    if (sscanf(text, "%d-%d-%d", &tm_info.tm_year, &tm_info.tm_mon, &tm_info.tm_mday) != 3) {
+        return -1;
+    }
+    tm_info.tm_year -= 1900;
+    tm_info.tm_mon -= 1;
+    tm_info.tm_isdst = -1;
+    if (end_of_day) {
+        tm_info.tm_hour = 23;
+        tm_info.tm_min = 59;
+        tm_info.tm_sec = 59;
+    }
+    *out = mktime(&tm_info);
+    return *out == (time_t)-1 ? -1 : 0;
+}
+
+/**
+ * Leaderboard queries from the command line
+ * board: 0 = every game, 1..6 = one speed level
+ * rank_score: print the rank of this score (INT_MIN = skip)
+ * player: print this player's best game (NULL = skip)
+ */
+static int run_leaderboard(int board, int top, int per_player, int rank_score, const char* player){
+    Leaderboard lb;
+    if (board < 0 || board >= LEADERBOARD_BOARDS) {
+        fprintf(stderr, "Invalid board: %d (0 = all games, 1..%d = speed)\n", board, LEADERBOARD_SPEEDS);
+        return 1;
+    }
+    if (leaderboard_open(&lb, HIGHSCORE_FILE) == -1) {
+        fprintf(stderr, "Cannot read the leaderboard\n");
+        return 1;
+    }
+    long games = leaderboard_games(&lb, board);
+    if (board == 0) {
+        printf("Leaderboard: all speeds, %ld games\n", games);
+    } else {
+        printf("Leaderboard: speed %d, %ld games\n", board, games);
+    }
+
+    if (rank_score != INT_MIN) {
+        printf("  score %d ranks #%ld of %ld\n", rank_score, leaderboard_rank(&lb, board, rank_score), games);
+    }
+    if (player != NULL) {
+        HighScore best;
+        if (leaderboard_player_best(&lb, board, player, &best)) {
+            printf("  %s: best %d at speed %d, rank #%ld\n", best.name, best.score, best.speed_level,
+                   leaderboard_rank(&lb, board, best.score));
+        } else {
+            printf("  %s has no games on this board\n", player);
+        }
+    }
+    if (top > 0) {
+        HighScore* entries = malloc((top < LEADERBOARD_MAX_TOP ? top : LEADERBOARD_MAX_TOP) * sizeof(HighScore));
+        int n = entries ? leaderboard_top(&lb, board, per_player, entries, top) : 0;
+        printf("  %-5s %-20s %7s %5s  %s\n", "rank", "name", "score", "speed", "date");
+        for (int i = 0; i < n; i++) {
+            char date_str[20];
+            struct tm* tm_info = localtime(&entries[i].date);
+            strftime(date_str, sizeof(date_str), "%Y-%m-%d", tm_info);
+            printf("  %-5ld %-20s %7d %5d  %s\n", leaderboard_rank(&lb, board, entries[i].score),
+                   entries[i].name, entries[i].score, entries[i].speed_level, date_str);
+        }
+        free(entries);
+    }
+    leaderboard_close(&lb);
+    return 0;
+}
+
+/**
+ * Print command line usage
+ */
+static void print_usage(const char* prog){
+    printf("Usage: %s [options]\n", prog);
+    printf("  --headless         Simulate games without a terminal\n");
+    printf("  --frames N         Frames to simulate in headless mode (default 1000000)\n");
+    printf("  --size COLSxLINES  Pond size for headless mode (default 80x24)\n");
+    printf("  --fish N           Number of fish in the pond (default %d, max %d)\n", DEFAULT_FISH, MAX_FISH);
+    printf("  --kernel NAME      Fish update kernels: avx2, sse2, scalar or auto (default)\n");
+    printf("  --school           Fish swim in schools (alignment, cohesion, separation)\n");
+    printf("  --bot              The autoplayer plays (interactive, headless and --simulate)\n");
+    printf("  --scale            Headless: report tick cost for fish counts doubling up to --fish\n");
+    printf("  --seed N           Start from a fixed random seed (headless: game n uses N+n)\n");
+    printf("  --simulate N       Play N games at every speed level on all cores, print distributions\n");
+    printf("  --threads N        Worker threads for --simulate or --query (default one per CPU)\n");
+    printf("  --log-games        With --simulate: log every game to %s (background writer)\n", STATS_FILE);
+    printf("  --fsync-ms N       With --log-games: flush the log to disk at least every N ms\n");
+    printf("  --record FILE      Record the seed, pond size and every key of each game\n");
+    printf("  --replay FILE      Re-run a recording as fast as possible, no terminal\n");
+    printf("  --realtime         With --replay: play it back on screen at normal speed\n");
+    printf("  --seek FRAME       With --replay: jump to FRAME via the nearest keyframe\n");
+    printf("  --marks            With --replay: list the keyframes, catches and misses\n");
+    printf("  --leaderboard      Print the full ranking of every saved game and exit\n");
+    printf("  --board N          With --leaderboard: 0 = all games (default), 1..%d = one speed\n", LEADERBOARD_SPEEDS);
+    printf("  --top K            With --leaderboard: list the best K (default 10, max %d);\n", LEADERBOARD_MAX_TOP);
+    printf("                     with --history: show K games\n");
+    printf("  --games            With --leaderboard: list games, not each player's best\n");
+    printf("  --rank SCORE       With --leaderboard: rank a score would have\n");
+    printf("  --player NAME      With --leaderboard: a player's best game and its rank;\n");
+    printf("                     with --history or --query: only that player's games\n");
+    printf("  --history          Print the latest logged games and exit\n");
+    printf("  --from YYYY-MM-DD  With --history or --query: games from that day on\n");
+    printf("  --to YYYY-MM-DD    With --history or --query: games up to that day\n");
+    printf("  --compact-stats D  Compact the stats log's days older than D days and exit\n");
+    printf("  --percentiles      Print score percentiles of all logged games per speed and exit\n");
+    printf("  --query GROUP      Aggregate logged games by player, day, speed or all and exit;\n");
+    printf("                     takes --player, --from, --to, --speed and --threads\n");
+    printf("  --speed N          With --query: only games at speed level N\n");
+    printf("  --rebuild-stats    Rebuild the score trees and player index from %s and exit\n", STATS_FILE);
+    printf("  --migrate          Convert %s and %s from older formats and exit\n", STATS_FILE, HIGHSCORE_FILE);
+    printf("  --render-bench N   Render N frames for render_bench (run inside its pty)\n");
+    printf("  --profile FILE     Time every phase of each frame, write them to FILE after each game\n");
+    printf("                     (folded stacks, for flame graphs); 'o' shows the averages live\n");
+    printf("  --help             Show this message\n");
+}
+
+// Last values shown in the status line - a field is redrawn only when it changes
+typedef struct {
+    int valid;
+    int lives;
+    int speed;
+    int score;
+    long tenths;
+} HudCache;
+
+// What is currently on screen, so the next render only touches what moved
+typedef struct {
+    int* fish_pos;              // where each fish was last drawn
+    int* fish_row;
+    int fish_count;
+    int fish_capacity;
+    int boat_x;
+    int hook_x;
+    int hook_depth;
+    HudCache hud;
+} ScreenCache;
+
+#define HUD_KEYS "a:left d:right h:hook s:slower f:faster | "
+
+/**
+ * Allocate the cache for up to 'capacity' fish
+ * Returns: 0 on success, -1 if out of memory
+ */
+static int screen_cache_init(ScreenCache* cache, int capacity){
+    memset(cache, 0, sizeof(ScreenCache));
+    cache->fish_pos = malloc(capacity * sizeof(int));
+    cache->fish_row = malloc(capacity * sizeof(int));
+    cache->fish_capacity = capacity;
+    return (cache->fish_pos && cache->fish_row) ? 0 : -1;
+}
+
+static void screen_cache_free(ScreenCache* cache){
+    free(cache->fish_pos);
+    free(cache->fish_row);
+    memset(cache, 0, sizeof(ScreenCache));
+}
+
+/**
+ * Forget everything on screen (after clear()) so the next render repaints it all
+ */
+static void screen_cache_reset(ScreenCache* cache){
+    cache->fish_count = 0;
+    cache->boat_x = -1;
+    cache->hook_x = -1;
+    cache->hook_depth = -1;
+    cache->hud.valid = 0;
+    scenery_invalidate(&scenery);
+}
+
+/**
+ * Print one status field at a fixed column, clipped to the screen width
+ */
+static void hud_field(int row, int col, int width, const char* text){
+    if (col >= COLS - 1) return;
+    int avail = COLS - 1 - col;
+    mvprintw(row, col, "%-*.*s", width < avail ? width : avail, avail, text);
+}
+
+/**
+ * Draw the status lines at the top of the screen
+ * Each field sits at a fixed column and is rewritten only when its value changed
+ */
+static void draw_hud(const GameState* game, HudCache* hud){
+    long tenths = game_remaining_ms(game) / 100;
+    int col = 2 + (int)strlen(HUD_KEYS);
+    char field[48];
+
+    attron(COLOR_PAIR(COLOR_GREEN));
+    if (!hud->valid) {
+        hud_field(0, 2, 0, HUD_KEYS);
+    }
+    if (!hud->valid || hud->lives != game->lives) {
+        int stars = game->lives > 0 ? 2 * game->lives : 0;
+        snprintf(field, sizeof(field), "Lives: %-*.*s| ", 2 * DEFAULT_LIVES, stars, "* * * * * * ");
+        hud_field(0, col, 0, field);
+    }
+    col += 7 + 2 * DEFAULT_LIVES + 2;
+    if (!hud->valid || hud->speed != game->speed) {
+        snprintf(field, sizeof(field), "Speed: %d (%dx points)", game->speed, game_points_per_fish(game->speed));
+        hud_field(0, col, 21, field);
+        hud_field(0, col + 21, 0, "| ");
+    }
+    col += 23;
+    if (!hud->valid || hud->score != game->score) {
+        snprintf(field, sizeof(field), "score:%-4d| ", game->score);
+        hud_field(0, col, 0, field);
+    }
+    col += 12;
+    if (!hud->valid || hud->tenths != tenths) {
+        snprintf(field, sizeof(field), "time:%4.1fs", tenths / 10.0);
+        hud_field(0, col, 0, field);
+    }
+    attroff(COLOR_PAIR(COLOR_GREEN));
+
+    if (!hud->valid) {
+        attron(COLOR_PAIR(COLOR_BLUE));
+        mvprintw(1, 2, "Player: %s | Press Ctrl+C to quit, Ctrl+Z to pause", player_name);
+        attroff(COLOR_PAIR(COLOR_BLUE));
+    }
+
+    hud->valid = 1;
+    hud->lives = game->lives;
+    hud->speed = game->speed;
+    hud->score = game->score;
+    hud->tenths = tenths;
+}
+
+#define PROFILE_WIDTH 34
+#define PROFILE_ROW 3
+
+/**
+ * Draw the frame profiler box in the top right corner
+ * Average and worst time of each phase over the last PROF_WINDOW frames;
+ * a phase's average counts only the frames it ran in.
+ */
+static void draw_profile_overlay(void){
+    int col = COLS - PROFILE_WIDTH - 1;
+    if (col < 0 || LINES < PROFILE_ROW + PROF_PHASES + 4) return;
+
+    ProfSummary sum;
+    prof_summary(&sum);
+
+    attron(COLOR_PAIR(COLOR_YELLOW_PAIR));
+    mvprintw(PROFILE_ROW, col, "%-*s", PROFILE_WIDTH, " Frame profile (last 120)");
+    mvprintw(PROFILE_ROW + 1, col, " %-10s %9s %9s   ", "phase", "avg us", "max us");
+    for (int p = 0; p < PROF_PHASES; p++) {
+        mvprintw(PROFILE_ROW + 2 + p, col, " %-10s %9.1f %9.1f   ",
+                 prof_phase_name((ProfPhase)p), sum.avg_us[p], sum.max_us[p]);
+    }
+    mvprintw(PROFILE_ROW + 2 + PROF_PHASES, col, " %-10s %9.1f %9.1f   ",
+             "frame", sum.frame_avg_us, sum.frame_max_us);
+    char line[PROFILE_WIDTH];
+    snprintf(line, sizeof(line), "%ld frames measured", prof_frames());
+    mvprintw(PROFILE_ROW + 3 + PROF_PHASES, col, " %-*s", PROFILE_WIDTH - 1, line);
+    attroff(COLOR_PAIR(COLOR_YELLOW_PAIR));
+}
+
+/**
+ * Draw all sprites and the HUD, then push the frame to the terminal
+ * Sprites are erased where the cache says they were, so only what moved changes
+ */
+static void render_frame(const GameState* game, ScreenCache* cache){
+    // Fish ASCII art (left and right facing)
+    const char* left_fish[] = {" /,", "<')=<", " \\`"};
+    const char* right_fish[] = {" ,'", "=>('>", " '/"};
+    long long t = prof_begin();
+
+    // Erase boat at old position if it moved
+    if (cache->boat_x >= 0 && cache->boat_x != game->boat_x) {
+        erase_boat(cache->boat_x);
+    }
+    cache->boat_x = game->boat_x;
+
+    // Erase fish where they were last drawn, then draw them at their new spots
+    for (int i = 0; i < cache->fish_count; i++) {
+        erase_fish(cache->fish_pos[i], cache->fish_row[i], FISH_LINES);
+    }
+
+    const FishPool* pool = &game->fish;
+    int drawn = 0;
+    attron(COLOR_PAIR(COLOR_CYAN_PAIR));
+    for (int i = 0; i < pool->used && drawn < cache->fish_capacity; i++) {
+        if (!pool->alive[i]) continue;
+        draw_fish(pool->pos[i], pool->row[i], pool->dir[i], left_fish, right_fish, FISH_LINES);
+        cache->fish_pos[drawn] = pool->pos[i];
+        cache->fish_row[drawn] = pool->row[i];
+        drawn++;
+    }
+    attroff(COLOR_PAIR(COLOR_CYAN_PAIR));
+    cache->fish_count = drawn;
+
+    draw_boat_and_hook(game->boat_x, game->hook_depth, &cache->hook_x, &cache->hook_depth);
+    draw_hud(game, &cache->hud);
+    prof_end(PROF_SPRITES, t);
+
+    if (show_profile) draw_profile_overlay();
+    t = prof_begin();
+    refresh();
+    prof_end(PROF_REFRESH, t);
+}
+
+/**
+ * Show the "game paused" banner
+ */
+static void show_pause_message(void){
+    attron(COLOR_PAIR(COLOR_YELLOW_PAIR));
+    mvprintw((LINES / 2) + 1, (COLS - 40) / 2, "*** GAME PAUSED ***");
+    mvprintw((LINES / 2) + 2, (COLS - 40) / 2, "Press 'p' or Ctrl+Z to resume");
+    attroff(COLOR_PAIR(COLOR_YELLOW_PAIR));
+}
+
+/**
+ * Follow a terminal resize: resize ncurses and rebuild the scenery layers
+ * The pond keeps the size the game started with
+ */
+static void handle_resize(void){
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+        resizeterm(ws.ws_row, ws.ws_col);
+    }
+    scenery_free(&scenery);
+    if (scenery_init(&scenery, COLS, LINES) == 0) {
+        build_scenery(COLS, LINES);
+    }
+    clear();
+}
+
+/**
+ * Play one interactive game on the ncurses screen
+ * The simulation runs on fixed ticks (speed * 10 ms) from the scheduler;
+ * drawing happens at most RENDER_FPS times per second and never slows the game.
+ * Between frames the loop sleeps in poll() until a key, the frame timer or a
+ * signal arrives - a paused game has no timer armed and uses no CPU at all.
+ * rec: if not NULL, every key passed to game_step() is recorded
+ * replay: if not NULL, keys come from the recording instead of the player
+ * autoplay: 1 = bot_input() plays whenever the player has not pressed a key
+ * Returns when the game is over or the player quits
+ */
+static void play_game(GameState* game, FrameScheduler* sched, Recording* rec, Replay* replay,
+                      int autoplay){
+    EventLoop ev;
+    ScreenCache cache;
+    int quit_confirmation_mode = 0;  // Track if waiting for quit confirmation
+    int dirty = 1;                   // simulation changed since last render
+    int wake = 0;                    // events that ended the previous wait
+
+    // Keys wait here until the next tick consumes them (one key per tick)
+    int input_queue[INPUT_QUEUE_SIZE];
+    int input_head = 0, input_count = 0;
+
+    if (screen_cache_init(&cache, game->fish.capacity) == -1) {
+        screen_cache_free(&cache);
+        return;
+    }
+    if (events_open(&ev) == -1) {
+        screen_cache_free(&cache);
+        return;
+    }
+    sched_init(sched, sched_clock_ns(), game_tick_ms(game) * NS_PER_MS, NS_PER_SEC / RENDER_FPS);
+    build_scenery(COLS, LINES);
+    screen_cache_reset(&cache);
+
+    // Main game loop
+    while(!game->game_over){
+        long long now = sched_clock_ns();  // the only clock read this frame
+        prof_frame_begin(now);
+
+        if (wake & EV_HANGUP) {
+            break;
+        }
+        if (wake & EV_SIGWINCH) {
+            handle_resize();
+            screen_cache_reset(&cache);
+            dirty = 1;
+            if (sched->paused) show_pause_message();
+        }
+
+        // Handle quit request (Ctrl+C pressed)
+        if ((wake & EV_SIGINT) && !quit_confirmation_mode) {
+            if (!sched->paused) {
+                toggle_pause(sched, now);  // Pause game while confirming
+            }
+            quit_confirmation_mode = 1;
+            attron(COLOR_PAIR(COLOR_RED_PAIR));
+            mvprintw(LINES / 2, (COLS - 60) / 2, "Are you sure you want to quit? (y/n)");
+            attroff(COLOR_PAIR(COLOR_RED));
+        }
+
+        // Handle pause request (Ctrl+Z pressed)
+        if (wake & EV_SIGTSTP) {
+            toggle_pause(sched, now);
+            if (sched->paused) {
+                show_pause_message();
+            } else {
+                screen_cache_reset(&cache);
+                dirty = 1;
             }
+        }
 
-            int ch = getch();
-            
-            // Handle quit confirmation
-            if (quit_confirmation_mode && ch != ERR) {
+        // Read every key that arrived
+        long long t = prof_begin();
+        int ch;
+        while ((ch = getch()) != ERR) {
+            if (quit_confirmation_mode) {
                 if (ch == 'y' || ch == 'Y') {
-                    game_over = 1;
                     clear();
                     endwin();
-                    break;
+                    events_close(&ev);
+                    screen_cache_free(&cache);
+                    return;
                 } else if (ch == 'n' || ch == 'N') {
-                    toggle_pause();  // Unpause game
-                    quit_request = 0;
+                    toggle_pause(sched, now);  // Unpause game
                     quit_confirmation_mode = 0;
                     move(LINES / 2, 0);
                     clrtoeol();
                     clear();
+                    screen_cache_reset(&cache);
+                    dirty = 1;
                 }
+            } else if (sched->paused) {
+                // Only the resume key works while paused
+                if (ch == 'p' || ch == 'P') {
+                    toggle_pause(sched, now);
+                    clear();
+                    screen_cache_reset(&cache);  // screen was cleared, nothing left to erase
+                    dirty = 1;
+                }
+            } else if (ch == 'q' || ch == 'Q') {
+                clear();
+                endwin();
+                events_close(&ev);
+                screen_cache_free(&cache);
+                return;  // Direct quit with 'q'
+            } else if (ch == 'o' || ch == 'O') {
+                // The overlay needs samples; without --profile they are only taken while it shows
+                show_profile = !show_profile;
+                if (show_profile && !prof_on) {
+                    prof_enable(1);
+                } else if (!show_profile && profile_path == NULL) {
+                    prof_enable(0);
+                }
+                clear();
+                screen_cache_reset(&cache);
+                dirty = 1;
+            } else if (replay == NULL && input_count < INPUT_QUEUE_SIZE) {
+                input_queue[(input_head + input_count) % INPUT_QUEUE_SIZE] = ch;
+                input_count++;
             }
+        }
+        prof_end(PROF_INPUT, t);
 
-            // Show help text when not in confirmation mode
-            if (!quit_confirmation_mode) {
-                attron(COLOR_PAIR(COLOR_BLUE));
-                mvprintw(1, 2, "Player: %s | Press Ctrl+C to quit, Ctrl+Z to pause", player_name);
-                attroff(COLOR_PAIR(COLOR_BLUE));
-            }
+        if (sched->paused) {
+            // Nothing moves: no timer, sleep until a key or a signal
+            refresh();
+            prof_frame_end();
+            events_disarm(&ev);
+            wake = events_wait(&ev);
+            continue;
+        }
 
-            // Handle pause request (Ctrl+Z pressed)
-            if (pause_request) {
-                toggle_pause();
-                pause_request = 0;
-                
-                if (paused) {
-                    // Show pause message
-                    attron(COLOR_PAIR(COLOR_YELLOW_PAIR));
-                    mvprintw((LINES / 2) + 1, (COLS - 40) / 2, "*** GAME PAUSED ***");
-                    mvprintw((LINES / 2) + 2, (COLS - 40) / 2, "Press 'p' or Ctrl+Z to resume");
-                    attroff(COLOR_PAIR(COLOR_YELLOW_PAIR));
-                    refresh();
-                }
-            }
+        t = prof_begin();
+        if (draw_border(now) > 0) {
+            dirty = 1;  // scenery may have been painted over sprites
+        }
+        prof_end(PROF_BORDER, t);
 
-            // If paused, only handle resume command
-            if (paused) {
-                // Allow both 'p' and Ctrl+Z to resume
-                if (ch == 'p' || ch == 'P' || pause_request) {
-                    if (pause_request) pause_request = 0;
-                    toggle_pause();
-                    // Clear pause message area
-                    for (int i = 0; i < 4; i++) {
-                        move(LINES / 2 + i, 0);
-                        clrtoeol();
-                    }
-                    clear();
-                }
-                refresh();
-                usleep(50000);
-                continue;
+        // Run every simulation tick that is due
+        sched_advance(sched, now);
+        while (sched_take_tick(sched)) {
+            int key = GAME_INPUT_NONE;
+            if (replay != NULL) {
+                key = replay_key(replay, game->frame);
+            } else if (input_count > 0) {
+                key = input_queue[input_head];
+                input_head = (input_head + 1) % INPUT_QUEUE_SIZE;
+                input_count--;
+            } else if (autoplay) {
+                key = bot_input(game);
+            }
+            if (rec != NULL) {
+                recording_frame(rec, game);
+                recording_key(rec, game->frame, key);
             }
-            
-            // Erase boat at old position if it moved
-            if (prev_boat_x >= 0 && prev_boat_x != boat_x) {
-                erase_boat(prev_boat_x);
+            int events = game_step(game, key);
+            if (rec != NULL) {
+                recording_mark(rec, game, events);
             }
-            prev_boat_x = boat_x;
-            
-            // Draw all fish
-            for (int i = 0; i < 10; i++) {
-                draw_fish(&fishes[i], left_fish, right_fish, fish_lines);
+            sched_set_tick(sched, game_tick_ms(game) * NS_PER_MS);
+            dirty = 1;
+            if ((events & GAME_EVENT_OVER) || (replay != NULL && replay_finished(replay, game->frame))) {
+                events_close(&ev);
+                screen_cache_free(&cache);
+                return;
             }
+        }
 
-            // Draw boat and hook
-            draw_boat_and_hook(boat_x, hook_depth);
-            refresh();
-            usleep(speed * 10000);
+        // Redraw sprites and HUD only when something changed and the render slot is open
+        if (dirty && sched_render_due(sched, now)) {
+            render_frame(game, &cache);
+            dirty = 0;
+        }
 
-            // Erase fish before moving them
-            for (int i = 0; i < 10; i++) {
-                erase_fish(&fishes[i], fish_lines);
-            }
+        // Wake up when the next tick (or the pending render) is due
+        long long wait_ns = sched_next_tick_in(sched);
+        if (dirty && sched->next_render_ns - now < wait_ns) {
+            wait_ns = sched->next_render_ns - now;
+        }
+        prof_frame_end();
+        events_arm(&ev, now + wait_ns);
+        wake = events_wait(&ev);
+    }
+    events_close(&ev);
+    screen_cache_free(&cache);
+}
 
-            // Update fish positions
-            for (int i = 0; i < 10; i++) {
-                fishes[i].frameCounter++;
-                if (fishes[i].frameCounter >= fishes[i].framesPerStep) {
-                    fishes[i].frameCounter = 0;
-                    fishes[i].pos += fishes[i].dir;
-                    
-                    // Wrap around screen edges
-                    if (fishes[i].dir == 1 && fishes[i].pos + fishes[i].width >= COLS) {
-                        fishes[i].pos = 0;
-                    } else if (fishes[i].dir == -1 && fishes[i].pos <= 0) {
-                        int max_start = (COLS > fishes[i].width) ? (COLS - fishes[i].width) : 0;
-                        fishes[i].pos = max_start;
-                    }
-                }
-            }
+/**
+ * Start ncurses mode and set up the color pairs
+ */
+static void init_curses(void){
+    initscr();
+    cbreak();
+    noecho();
+    curs_set(0);
+    timeout(0);
+    keypad(stdscr, TRUE);  // Enable special keys
 
-            // Reset attempt tracking when hook returns to top
-            if (hook_lowering == 1 && hook_depth == 0) {
-                hook_miss_penalized = 0;
-                fish_caught_this_attempt = 0;
-            }
+    // Initialize color pairs
+    start_color();
+    use_default_colors();
+    init_pair(COLOR_RED_PAIR, COLOR_RED, -1);
+    init_pair(COLOR_GREEN_PAIR, COLOR_GREEN, -1);
+    init_pair(COLOR_YELLOW_PAIR, COLOR_YELLOW, -1);
+    init_pair(COLOR_BLUE_PAIR, COLOR_BLUE, -1);
+    init_pair(COLOR_MAGENTA_PAIR, COLOR_MAGENTA, -1);
+    init_pair(COLOR_CYAN_PAIR, COLOR_CYAN, -1);
+}
+
+/**
+ * Render benchmark client (started by render_bench inside a pty)
+ * Runs the real draw path one frame at a time with scripted input and a
+ * simulated clock. Each frame waits for a go byte on BENCH_SYNC_FD and ends
+ * with BENCH_FRAME_MARK on the terminal, so the parent can split bytes per frame.
+ */
+static int run_render_bench(long frames, int fish){
+    const char* script = RENDER_BENCH_SCRIPT;
+    int script_len = strlen(script);
+    int mark_len = strlen(BENCH_FRAME_MARK);
+    GameState game;
+    ScreenCache cache;
+    char go;
+
+    init_curses();
+    if (game_init(&game, COLS, LINES, fish, RENDER_BENCH_SEED) == -1 ||
+        screen_cache_init(&cache, game.fish.capacity) == -1 ||
+        scenery_init(&scenery, COLS, LINES) == -1) {
+        endwin();
+        return 1;
+    }
+    build_scenery(COLS, LINES);
+    screen_cache_reset(&cache);
+    refresh();  // initscr output is not part of any frame
+    if (write(STDOUT_FILENO, BENCH_FRAME_MARK, mark_len) != mark_len) frames = 0;
+
+    long long now = 0;
+    for (long f = 0; f < frames; f++) {
+        if (read(BENCH_SYNC_FD, &go, 1) != 1) break;
+
+        if (game_step(&game, script[f % script_len]) & GAME_EVENT_OVER) {
+            game_reset(&game, game.seed + 1);
+        }
+        now += game_tick_ms(&game) * NS_PER_MS;
+        draw_border(now);
+        render_frame(&game, &cache);
+
+        if (write(STDOUT_FILENO, BENCH_FRAME_MARK, mark_len) != mark_len) break;
+    }
+
+    scenery_free(&scenery);
+    screen_cache_free(&cache);
+    game_free(&game);
+    endwin();
+    return 0;
+}
+
+// List the keyframes and the catches/misses indexed in a recording
+static void print_replay_index(const char* path, const Replay* rp){
+    printf("Recording %s: %dx%d pond, %d fish, format v%d\n", path, rp->header.cols,
+           rp->header.lines, rp->header.fish, rp->header.version);
+    printf("  keyframes        : %d (every %d frames)\n", rp->keyframe_count,
+           rp->header.keyframe_interval);
+    for (int i = 0; i < rp->mark_count; i++) {
+        const ReplayMark* m = &rp->marks[i];
+        printf("  frame %-8lld %-6s score %d\n", (long long)m->frame,
+               (m->events & GAME_EVENT_CATCH) ? "catch" : "miss", m->score);
+    }
+}
+
+/**
+ * Re-run a recorded game
+ * realtime: 0 = as fast as possible without a terminal, 1 = on screen at game speed
+ * seek: frame to jump to first (-1 = start); without realtime, stop there
+ * Prints the final result and a state hash, so two builds can be compared
+ */
+static int run_replay(const char* path, int realtime, long seek, int list_marks){
+    Replay rp;
+    GameState game;
+    long long t0, elapsed;
 
-            // Update hook position
-            if (hook_lowering == 1 && hook_depth < max_hook_depth) {
-                hook_depth++;  // Lower hook
-            } else if (hook_lowering == -1 && hook_depth > 0) {
-                hook_depth--;  // Raise hook
+    if (replay_load(&rp, path) == -1) {
+        return 1;
+    }
+    if (list_marks) {
+        print_replay_index(path, &rp);
+        replay_free(&rp);
+        return 0;
+    }
+    if (replay_new_game(&rp, &game) == -1) {
+        fprintf(stderr, "Out of memory for %d fish\n", rp.header.fish);
+        replay_free(&rp);
+        return 1;
+    }
+
+    if (seek >= 0) {
+        t0 = sched_clock_ns();
+        if (replay_seek(&rp, &game, seek) == -1) {
+            fprintf(stderr, "%s: could not load the keyframe for frame %ld\n", path, seek);
+            game_free(&game);
+            replay_free(&rp);
+            return 1;
+        }
+        printf("Seek to frame %ld: %.2f ms (%ld frames simulated after the keyframe)\n",
+               game.frame, (sched_clock_ns() - t0) / 1e6, rp.seek_simulated);
+    }
+
+    t0 = sched_clock_ns();
+    if (realtime) {
+        FrameScheduler sched;
+        atexit(cleanup_terminal);
+        init_curses();
+        if (COLS < game.cols || LINES < game.lines || scenery_init(&scenery, COLS, LINES) == -1) {
+            endwin();
+            fprintf(stderr, "Recording needs a %dx%d terminal (this one is %dx%d)\n",
+                    game.cols, game.lines, COLS, LINES);
+            game_free(&game);
+            replay_free(&rp);
+            return 1;
+        }
+        play_game(&game, &sched, NULL, &rp, 0);
+        scenery_free(&scenery);
+        endwin();
+    } else if (seek < 0) {
+        while (!replay_finished(&rp, game.frame)) {
+            if (game_step(&game, replay_key(&rp, game.frame)) & GAME_EVENT_OVER) break;
+        }
+    }
+    elapsed = sched_clock_ns() - t0;
+
+    printf("Replay of %s: %dx%d pond, %d fish%s, seed %llu\n", path, game.cols, game.lines,
+           game.fish.capacity, game.schooling ? ", schooling" : "", game.seed);
+    printf("  frames           : %ld\n", game.frame);
+    printf("  score            : %d\n", game.score);
+    printf("  fish caught      : %d\n", game.fish_caught_total);
+    printf("  hooks missed     : %d\n", game.hooks_missed_total);
+    printf("  lives / speed    : %d / %d\n", game.lives, game.speed);
+    printf("  state hash       : %016llx\n", game_hash(&game));
+    if (!realtime && seek < 0) {
+        printf("  ns/frame         : %.1f\n", game.frame > 0 ? (double)elapsed / game.frame : 0.0);
+    }
+    int diverged = (seek < 0 || realtime) && game.game_over && !replay_finished(&rp, game.frame);
+    if (diverged) {
+        printf("  WARNING: the game ended before the recording did - replay diverged\n");
+    }
+    game_free(&game);
+    replay_free(&rp);
+    return diverged ? 2 : 0;
+}
+
+/**
+ * Main game function
+ */
+int main(int argc, char* argv[]){
+    int headless = 0;
+    int scaling = 0;
+    long bench_frames = 0;
+    int seeded = 0;
+    int realtime = 0;
+    int list_marks = 0;
+    long seek = -1;
+    long sim_games = 0;
+    int leaderboard = 0;
+    int percentiles = 0;
+    int query = 0;
+    StatsQuery stats_query = { (time_t)INT64_MIN, (time_t)INT64_MAX, NULL, 0, STATS_GROUP_NONE, 0, 0 };
+    int rebuild_stats = 0;
+    int migrate = 0;
+    int history = 0;
+    int compact_days = -1;
+    time_t history_from = (time_t)INT64_MIN;
+    time_t history_to = (time_t)INT64_MAX;
+    int lb_board = 0;
+    int lb_top = 10;
+    int lb_per_player = 1;
+    int lb_rank = INT_MIN;
+    const char* lb_player = NULL;
+    int sim_threads = 0;
+    int log_games = 0;
+    int fsync_ms = 0;
+    const char* record_path = NULL;
+    const char* replay_path = NULL;
+    SimOptions sim = { 1000000, 80, 24, DEFAULT_FISH, 0, 0, 0 };
+
+    // Parse command line options
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = 1;
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            sim.frames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--fish") == 0 && i + 1 < argc) {
+            sim.fish = atoi(argv[++i]);
+            if (sim.fish < 1 || sim.fish > MAX_FISH) {
+                fprintf(stderr, "Invalid fish count: %s (1..%d)\n", argv[i], MAX_FISH);
+                return 1;
             }
-            
-            // Auto-raise when hook reaches bottom
-            if (hook_depth >= max_hook_depth && hook_lowering == 1) {
-                hook_lowering = -1;
+        } else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+            if (fish_kernels_use(argv[++i]) == -1) {
+                fprintf(stderr, "Kernel not available on this CPU: %s (avx2, sse2, scalar, auto)\n", argv[i]);
+                return 1;
             }
-            
-            // Penalize for missing fish when hook returns to top
-            if (hook_depth <= 0 && hook_lowering == -1) {
-                hook_lowering = 0;
-                if (!fish_caught_this_attempt && !hook_miss_penalized) {
-                    lives--;
-                    hooks_missed_total++;
-                    hook_miss_penalized = 1;
-                    if (lives <= 0) {
-                        game_over = 1;
-                        break;
-                    }
-                }
+        } else if (strcmp(argv[i], "--school") == 0) {
+            sim.schooling = 1;
+        } else if (strcmp(argv[i], "--bot") == 0) {
+            sim.bot = 1;
+        } else if (strcmp(argv[i], "--scale") == 0) {
+            scaling = 1;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            sim.seed = strtoull(argv[++i], NULL, 10);
+            seeded = 1;
+        } else if (strcmp(argv[i], "--simulate") == 0 && i + 1 < argc) {
+            sim_games = atol(argv[++i]);
+            if (sim_games < 1) {
+                fprintf(stderr, "Invalid game count: %s\n", argv[i]);
+                return 1;
             }
-
-            // Check for fish collision with hook
-            int water_y = LINES / 4;
-            int hook_x = boat_x + (int)strlen("___/______\\__") / 2;
-            int hook_y = water_y + 1 + hook_depth;
-            
-            for (int i = 0; i < 10; i++) {
-                // Check if hook is at fish depth
-                if (hook_depth > 0 && hook_y >= fishes[i].row && hook_y < fishes[i].row + fish_lines) {
-                    // Check if hook is touching fish horizontally
-                    if (hook_x >= fishes[i].pos && hook_x < fishes[i].pos + fishes[i].width) {
-                        // Caught a fish!
-                        int points = (3 - speed) + 1;  // Faster speed = more points
-                        score += points;
-                        fish_caught_total++;
-                        
-                        // Respawn fish at random position
-                        fishes[i].pos = rand() % (COLS - fishes[i].width);
-                        int span = (mid_end - top_start);
-                        fishes[i].row = top_start + (span > 0 ? rand() % span : 0);
-                        fishes[i].dir = (rand() % 2) * 2 - 1;
-                        
-                        fish_caught_this_attempt = 1;
-                        hook_lowering = -1;  // Auto-raise hook
-                        break;
-                    }
-                }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            sim_threads = atoi(argv[++i]);
+            if (sim_threads < 0 || sim_threads > SIM_MAX_THREADS) {
+                fprintf(stderr, "Invalid thread count: %s (0..%d, 0 = one per CPU)\n", argv[i], SIM_MAX_THREADS);
+                return 1;
             }
-
-            // Check time limit
-            int time_left = get_remaining_time();
-            if(time_left <= 0 && !paused){
-                game_over = 1;
-                break;
+        } else if (strcmp(argv[i], "--log-games") == 0) {
+            log_games = 1;
+        } else if (strcmp(argv[i], "--fsync-ms") == 0 && i + 1 < argc) {
+            fsync_ms = atoi(argv[++i]);
+            if (fsync_ms < 0) {
+                fprintf(stderr, "Invalid fsync interval: %s\n", argv[i]);
+                return 1;
             }
-            
-
-            // Display game status
-            char lives_display[20];
-            strcpy(lives_display,"Lives: ");
-            for (int i = 0; i < lives; i++) {
-                strcat(lives_display,"* ");
+        } else if (strcmp(argv[i], "--history") == 0) {
+            history = 1;
+        } else if ((strcmp(argv[i], "--from") == 0 || strcmp(argv[i], "--to") == 0) && i + 1 < argc) {
+            int to = strcmp(argv[i], "--to") == 0;
+            if (parse_day(argv[++i], to, to ? &history_to : &history_from) == -1) {
+                fprintf(stderr, "Invalid date: %s (expected YYYY-MM-DD)\n", argv[i]);
+                return 1;
             }
-
-            char speed_display[35];
-            attron(COLOR_PAIR(COLOR_GREEN));
-            sprintf(speed_display, "Speed: %d (%dx points)", speed, (3 - speed) + 1);
-            
-            if(paused){
-                mvprintw(0, 2, "[PAUSED] | %s | %s | score:%d | time:%2ds   ", 
-                        lives_display, speed_display, score, time_left);
-            }else{
-                mvprintw(0, 2, "a:left d:right h:hook s:slower f:faster | %s | %s | score:%d | time:%2ds   ", 
-                        lives_display, speed_display, score, time_left);
+        } else if (strcmp(argv[i], "--compact-stats") == 0 && i + 1 < argc) {
+            compact_days = atoi(argv[++i]);
+            if (compact_days < 0) {
+                fprintf(stderr, "Invalid day count: %s\n", argv[i]);
+                return 1;
             }
-            attroff(COLOR_PAIR(COLOR_GREEN));
-            // Handle player input (only when not paused)
-            if(!paused && !quit_confirmation_mode){
-                if(ch != ERR){
-                    if(ch =='q' || ch =='Q'){
-                        clear();
-                        endwin();
-                        break;  // Direct quit with 'q'
-                    }else if (ch == 'a' || ch == 'A') {
-                        // Move boat left
-                        if (boat_x > 0) boat_x--;
-                    }else if (ch == 'd' || ch == 'D') {
-                        // Move boat right
-                        if (boat_x < COLS - 12) boat_x++;
-                    }else if (ch == 'h' || ch == 'H') {
-                        // Drop hook (only if not already lowering)
-                        if (hook_lowering == 0) hook_lowering = 1;
-                    }else if(ch == ' '){
-                        // Easter egg: space reverses all fish
-                        for (int i = 0; i < 10; i++) {
-                            fishes[i].dir = -fishes[i].dir;
-                        }
-                    }else if(ch == 's' || ch == 'S'){
-                        // Decrease speed (slower game, fewer points)
-                        if(speed < 6){
-                            speed += 1;
-                        }
-                    }else if(ch == 'f' || ch == 'F'){
-                        // Increase speed (faster game, more points)
-                        if(speed > 1){
-                            speed -= 1;
-                        }
-                    }
+        } else if (strcmp(argv[i], "--rebuild-stats") == 0) {
+            rebuild_stats = 1;
+        } else if (strcmp(argv[i], "--migrate") == 0) {
+            migrate = 1;
+        } else if (strcmp(argv[i], "--percentiles") == 0) {
+            percentiles = 1;
+        } else if (strcmp(argv[i], "--query") == 0 && i + 1 < argc) {
+            static const char* groups[] = { "all", "player", "day", "speed" };
+            query = 0;
+            for (int g = 0; g < 4 && query == 0; g++) {
+                if (strcmp(argv[i + 1], groups[g]) == 0) {
+                    stats_query.group = (StatsGroupBy)g;
+                    query = 1;
                 }
             }
+            if (!query) {
+                fprintf(stderr, "Invalid grouping: %s (player, day, speed or all)\n", argv[i + 1]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            stats_query.speed = atoi(argv[++i]);
+            if (stats_query.speed < MIN_SPEED || stats_query.speed > MAX_SPEED) {
+                fprintf(stderr, "Invalid speed level: %s (%d..%d)\n", argv[i], MIN_SPEED, MAX_SPEED);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--leaderboard") == 0) {
+            leaderboard = 1;
+        } else if (strcmp(argv[i], "--board") == 0 && i + 1 < argc) {
+            lb_board = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc) {
+            lb_top = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--games") == 0) {
+            lb_per_player = 0;
+        } else if (strcmp(argv[i], "--rank") == 0 && i + 1 < argc) {
+            lb_rank = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--player") == 0 && i + 1 < argc) {
+            lb_player = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--realtime") == 0) {
+            realtime = 1;
+        } else if (strcmp(argv[i], "--seek") == 0 && i + 1 < argc) {
+            seek = atol(argv[++i]);
+            if (seek < 0) seek = 0;
+        } else if (strcmp(argv[i], "--marks") == 0) {
+            list_marks = 1;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile_path = argv[++i];
+        } else if (strcmp(argv[i], "--render-bench") == 0 && i + 1 < argc) {
+            bench_frames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%dx%d", &sim.cols, &sim.lines) != 2 ||
+                sim.cols < 20 || sim.lines < 10) {
+                fprintf(stderr, "Invalid size: %s (expected COLSxLINES, min 20x10)\n", argv[i]);
+                return 1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? 0 : 1;
+        }
+    }
+
+    if (bench_frames > 0) {
+        return run_render_bench(bench_frames, sim.fish);
+    }
+    if (rebuild_stats) {
+        return rebuild_stats_indexes() == 0 ? 0 : 1;
+    }
+    if (migrate) {
+        long games = migrate_stats();
+        if (games == -1 || highscore_compact(HIGHSCORE_FILE) == -1) {
+            perror("Error converting data files");
+            return 1;
+        }
+        printf("%s and %s are in the current format (%ld logged games)\n", STATS_FILE, HIGHSCORE_FILE, games);
+        return 0;
+    }
+    if (compact_days >= 0) {
+        int compacted = compact_stats(compact_days);
+        if (compacted == -1) {
+            perror("Error compacting stats log");
+            return 1;
         }
+        printf("Compacted %d day(s) of %s\n", compacted, STATS_FILE);
+        return 0;
+    }
+    if (history) {
+        display_game_history_range(history_from, history_to, lb_player, lb_top);
+        return 0;
+    }
+    if (percentiles) {
+        return run_percentiles();
+    }
+    if (query) {
+        stats_query.from = history_from;
+        stats_query.to = history_to;
+        stats_query.player = lb_player;
+        stats_query.threads = sim_threads;
+        return run_query(&stats_query);
+    }
+    if (leaderboard) {
+        return run_leaderboard(lb_board, lb_top, lb_per_player, lb_rank, lb_player);
+    }
+    if (replay_path != NULL) {
+        return run_replay(replay_path, realtime, seek, list_marks);
+    }
+    if (!seeded) {
+        sim.seed = fresh_seed();
+    }
+    if (sim_games > 0) {
+        return run_simulate(&sim, sim_games, sim_threads, log_games, fsync_ms);
+    }
+    if (headless) {
+        return scaling ? run_scaling(&sim) : run_headless(&sim);
+    }
+
+    while(1){
+        // Get player name and show menu
+        get_player_name();
+        show_main_menu();
+
+        // Register cleanup function to run on exit
+        atexit(cleanup_terminal);
+
+        init_curses();
+
+        // All per-game state lives here, fresh for every game
+        GameState game;
+        FrameScheduler sched;
+        Recording rec;
+        Recording* recording = NULL;
+        unsigned long long seed = seeded ? sim.seed : fresh_seed();
+        if (game_init(&game, COLS, LINES, sim.fish, seed) == -1 ||
+            game_set_schooling(&game, sim.schooling) == -1 ||
+            scenery_init(&scenery, COLS, LINES) == -1) {
+            endwin();
+            fprintf(stderr, "Out of memory for the pond\n");
+            return 1;
+        }
+
+        if (record_path != NULL && recording_start(&rec, &game, record_path) == 0) {
+            recording = &rec;
+        }
+
+        if (profile_path != NULL) {
+            prof_enable(1);
+        }
+        play_game(&game, &sched, recording, NULL, sim.bot);
+        long long active_ms = sched_active_ms(&sched, sched_clock_ns());
+        scenery_free(&scenery);
         
         // Game ended - cleanup ncurses
         endwin();
+
+        // The ring holds the last frames of every game so far
+        if (profile_path != NULL) {
+            int frames = prof_dump(profile_path);
+            if (frames == -1) {
+                perror("Error writing frame profile");
+            } else {
+                printf("Frame profile: %d frames written to %s\n", frames, profile_path);
+            }
+        }
+        
+        if (recording != NULL) {
+            if (recording_save(recording, game.frame) == 0) {
+                printf("Game recorded to %s (seed %llu)\n", record_path, game.seed);
+            }
+            recording_free(recording);
+        }
         
         // Restore terminal to normal state
         signal(SIGINT, SIG_DFL);
@@ -770,15 +1565,17 @@ int main(){
         
         // Save game statistics to file
         GameStats stats;
+        memset(&stats, 0, sizeof(stats));
         stats.timestamp = time(NULL);
         strncpy(stats.player_name, player_name, sizeof(stats.player_name) - 1);
-        stats.final_score = score;
-        stats.fish_caught = fish_caught_total;
-        stats.hooks_missed = hooks_missed_total;
-        stats.speed_level = speed;
-        stats.lives_remaining = lives;
-        stats.game_duration = (int)difftime(time(NULL), start_time) - total_pause_time;
-        log_game_stats(&stats);
+        stats.final_score = game.score;
+        stats.fish_caught = game.fish_caught_total;
+        stats.hooks_missed = game.hooks_missed_total;
+        stats.speed_level = game.speed;
+        stats.lives_remaining = game.lives;
+        stats.game_duration = (int)(active_ms / 1000);
+        int logged = log_game_stats(&stats) == 0;
+        game_free(&game);
         
         // Display final statistics
         printf("\n\n");
@@ -786,24 +1583,30 @@ int main(){
         printf(cyan "║           GAME OVER - FINAL RESULTS            ║\n" RESET);
         printf(cyan "╠════════════════════════════════════════════════╣\n" RESET);
         printf(cyan "║ Player: %-38s ║\n" RESET, player_name);
-        printf(cyan "║ Final Score: %-33d ║\n" RESET, score);
-        printf(cyan "║ Fish Caught: %-33d ║\n" RESET, fish_caught_total);
-        printf(cyan "║ Hooks Missed: %-32d ║\n"RESET, hooks_missed_total);
-        printf(cyan "║ Lives Remaining: %-29d ║\n" RESET, lives);
-        printf(cyan "║ Final Speed Level: %-27d ║\n" RESET, speed);
+        printf(cyan "║ Final Score: %-33d ║\n" RESET, game.score);
+        printf(cyan "║ Fish Caught: %-33d ║\n" RESET, game.fish_caught_total);
+        printf(cyan "║ Hooks Missed: %-32d ║\n"RESET, game.hooks_missed_total);
+        printf(cyan "║ Lives Remaining: %-29d ║\n" RESET, game.lives);
+        printf(cyan "║ Final Speed Level: %-27d ║\n" RESET, game.speed);
         printf(cyan "╚════════════════════════════════════════════════╝\n" RESET);
         
-        // Check and save high score
-        if (is_highscore(score)) {
+        // Check and save high score (the file is read once; every game is saved for the leaderboard)
+        HighScoreTable table;
+        highscore_table_load(&table, HIGHSCORE_FILE);
+        int top_rank = highscore_table_insert(&table, player_name, game.score, game.speed);
+        int saved = highscore_table_save(&table) == 0;
+        if (top_rank >= 0) {
             printf(GREEN "\n🎉 CONGRATULATIONS! You achieved a HIGH SCORE! 🎉\n" RESET);
-            if (add_highscore(player_name, score, speed) == 0) {
+            if (saved) {
                 printf(GREEN "Your score has been saved to the high score table!\n" RESET);
             }
         }
         
-        display_highscores();
+        highscore_table_display(&table);
+        print_game_rank(game.score, game.speed);
+        print_percentile(game.score, game.speed, logged);
         
     }
     
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,115 @@
+#include "codec.h"
+#include <string.h>
+
+static uint32_t crc_table[256];
+
+// Filled once before main(), so readers on any thread find it ready
+__attribute__((constructor))
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[i] = c;
+    }
+}
+
+uint32_t codec_crc32(const void* data, size_t size) {
+    return codec_crc32_extend(0, data, size);
+}
+
+// CRC-32 of the bytes 'crc' was computed over followed by data[0..size)
+// (start from 0), for data that is written a piece at a time
+uint32_t codec_crc32_extend(uint32_t crc, const void* data, size_t size) {
+    const unsigned char* p = data;
+    uint32_t c = crc ^ 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        c = crc_table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+// Append one unsigned varint; returns the byte after it
+unsigned char* codec_put_varint(unsigned char* p, uint64_t v) {
+    while (v >= 0x80) {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char)v;
+    return p;
+}
+
+unsigned char* codec_put_svarint(unsigned char* p, int64_t v) {
+    return codec_put_varint(p, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+// Decode one varint; returns the byte after it, or NULL if it runs past 'end'
+const unsigned char* codec_get_varint(const unsigned char* p, const unsigned char* end, uint64_t* v) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        unsigned char byte = *p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *v = value;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+const unsigned char* codec_get_svarint(const unsigned char* p, const unsigned char* end, int64_t* v) {
+    uint64_t u;
+    p = codec_get_varint(p, end, &u);
+    if (p != NULL) *v = (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+    return p;
+}
+
+/**
+ * Frame a payload already written at block + CODEC_BLOCK_HEAD
+ * Returns: bytes of the whole block
+ */
+size_t codec_block_finish(unsigned char* block, size_t payload_size, uint32_t count) {
+    CodecBlockHead head;
+    uint32_t size = (uint32_t)payload_size;
+    head.magic = CODEC_BLOCK_MAGIC;
+    head.size = size;
+    head.count = count;
+    head.crc = codec_crc32(block + CODEC_BLOCK_HEAD, payload_size);
+    memcpy(block, &head, sizeof(head));
+    memcpy(block + CODEC_BLOCK_HEAD + payload_size, &size, CODEC_BLOCK_TAIL);
+    return CODEC_BLOCK_HEAD + payload_size + CODEC_BLOCK_TAIL;
+}
+
+/**
+ * Check the block at the start of 'avail' bytes
+ * Returns: bytes of the whole block (payload at block + CODEC_BLOCK_HEAD),
+ * or -1 if it is cut short, damaged or not a block
+ */
+long codec_block_check(const unsigned char* block, size_t avail, uint32_t* count) {
+    CodecBlockHead head;
+    uint32_t tail;
+    if (avail < CODEC_BLOCK_HEAD + CODEC_BLOCK_TAIL) return -1;
+    memcpy(&head, block, sizeof(head));
+    if (head.magic != CODEC_BLOCK_MAGIC || head.size > avail - CODEC_BLOCK_HEAD - CODEC_BLOCK_TAIL) {
+        return -1;
+    }
+    memcpy(&tail, block + CODEC_BLOCK_HEAD + head.size, CODEC_BLOCK_TAIL);
+    if (tail != head.size || codec_crc32(block + CODEC_BLOCK_HEAD, head.size) != head.crc) {
+        return -1;
+    }
+    *count = head.count;
+    return (long)(CODEC_BLOCK_HEAD + head.size + CODEC_BLOCK_TAIL);
+}
+
+/**
+ * Where does the block that ends at data + end start?
+ * Returns: its offset in 'data', or -1 if the trailing size does not fit
+ */
+long codec_block_start(const unsigned char* data, size_t end) {
+    uint32_t size;
+    if (end < CODEC_BLOCK_HEAD + CODEC_BLOCK_TAIL) return -1;
+    memcpy(&size, data + end - CODEC_BLOCK_TAIL, CODEC_BLOCK_TAIL);
+    if (size > end - CODEC_BLOCK_HEAD - CODEC_BLOCK_TAIL) return -1;
+    return (long)(end - CODEC_BLOCK_TAIL - size - CODEC_BLOCK_HEAD);
+}
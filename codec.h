@@ -0,0 +1,39 @@
+#ifndef CODEC_H
+#define CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CODEC_BLOCK_MAGIC 0x4b4c4243u       // "CBLK" in the first four bytes
+#define CODEC_BLOCK_HEAD 16                 // magic, payload size, record count, CRC-32
+#define CODEC_BLOCK_TAIL 4                  // payload size again
+#define CODEC_VARINT_MAX 10                 // longest encoding of a 64-bit value
+
+/**
+ * Compact on-disk encoding shared by the stats log and the high scores
+ *   varint    7 bits per byte, low bits first, high bit = more follows
+ *   svarint   zigzag (0, -1, 1, -2 ...) then varint, for signed values
+ *   block     CODEC_BLOCK_HEAD, payload, CODEC_BLOCK_TAIL
+ * A block is checked as a whole (magic, both sizes, CRC of the payload)
+ * before any record in it is decoded. The trailing size lets a reader
+ * step backwards from the end of a block to its start.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t size;              // payload bytes
+    uint32_t count;             // records in the payload
+    uint32_t crc;               // CRC-32 (IEEE) of the payload
+} CodecBlockHead;
+
+// Function prototypes
+uint32_t codec_crc32(const void* data, size_t size);
+uint32_t codec_crc32_extend(uint32_t crc, const void* data, size_t size);
+unsigned char* codec_put_varint(unsigned char* p, uint64_t v);
+unsigned char* codec_put_svarint(unsigned char* p, int64_t v);
+const unsigned char* codec_get_varint(const unsigned char* p, const unsigned char* end, uint64_t* v);
+const unsigned char* codec_get_svarint(const unsigned char* p, const unsigned char* end, int64_t* v);
+size_t codec_block_finish(unsigned char* block, size_t payload_size, uint32_t count);
+long codec_block_check(const unsigned char* block, size_t avail, uint32_t* count);
+long codec_block_start(const unsigned char* data, size_t end);
+
+#endif
@@ -0,0 +1,99 @@
+#include "eventloop.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+
+// Block the game signals and create the timer and signal descriptors
+// System calls used: sigprocmask(), signalfd(), timerfd_create()
+int events_open(EventLoop* ev) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTSTP);
+    sigaddset(&mask, SIGWINCH);
+
+    if (sigprocmask(SIG_BLOCK, &mask, &ev->old_mask) == -1) {
+        perror("sigprocmask");
+        return -1;
+    }
+
+    ev->signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    ev->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (ev->signal_fd == -1 || ev->timer_fd == -1) {
+        perror("Error creating event descriptors");
+        events_close(ev);
+        return -1;
+    }
+    return 0;
+}
+
+// Close the descriptors and restore the previous signal mask
+void events_close(EventLoop* ev) {
+    if (ev->signal_fd >= 0) close(ev->signal_fd);
+    if (ev->timer_fd >= 0) close(ev->timer_fd);
+    ev->signal_fd = -1;
+    ev->timer_fd = -1;
+    sigprocmask(SIG_SETMASK, &ev->old_mask, NULL);
+}
+
+// Wake up at an absolute CLOCK_MONOTONIC time
+// System calls used: timerfd_settime()
+int events_arm(EventLoop* ev, long long deadline_ns) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (deadline_ns <= 0) deadline_ns = 1;  // zero would disarm the timer
+    its.it_value.tv_sec = deadline_ns / 1000000000LL;
+    its.it_value.tv_nsec = deadline_ns % 1000000000LL;
+    return timerfd_settime(ev->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+// No timed wake-up (paused game) - only input and signals wake the loop
+int events_disarm(EventLoop* ev) {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    return timerfd_settime(ev->timer_fd, 0, &its, NULL);
+}
+
+/**
+ * Sleep until input, the timer deadline or a signal
+ * System calls used: poll(), read()
+ * Returns: bitmask of EV_* flags (0 if interrupted)
+ */
+int events_wait(EventLoop* ev) {
+    struct pollfd fds[3] = {
+        { STDIN_FILENO, POLLIN, 0 },
+        { ev->timer_fd, POLLIN, 0 },
+        { ev->signal_fd, POLLIN, 0 },
+    };
+    int events = 0;
+
+    if (poll(fds, 3, -1) == -1) {
+        return errno == EINTR ? 0 : EV_HANGUP;
+    }
+
+    if (fds[0].revents & POLLIN) {
+        events |= EV_INPUT;
+    } else if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+        events |= EV_HANGUP;
+    }
+    if (fds[1].revents & POLLIN) {
+        uint64_t expirations;
+        if (read(ev->timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+            events |= EV_TIMER;
+        }
+    }
+    if (fds[2].revents & POLLIN) {
+        struct signalfd_siginfo info;
+        while (read(ev->signal_fd, &info, sizeof(info)) == sizeof(info)) {
+            if (info.ssi_signo == SIGINT) events |= EV_SIGINT;
+            else if (info.ssi_signo == SIGTSTP) events |= EV_SIGTSTP;
+            else if (info.ssi_signo == SIGWINCH) events |= EV_SIGWINCH;
+        }
+    }
+    return events;
+}
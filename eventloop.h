@@ -0,0 +1,32 @@
+#ifndef EVENTLOOP_H
+#define EVENTLOOP_H
+
+#include <signal.h>
+
+// Event bits returned by events_wait()
+#define EV_INPUT    0x01    // stdin is readable
+#define EV_TIMER    0x02    // frame deadline reached
+#define EV_SIGINT   0x04    // Ctrl+C
+#define EV_SIGTSTP  0x08    // Ctrl+Z
+#define EV_SIGWINCH 0x10    // terminal resized
+#define EV_HANGUP   0x20    // terminal went away
+
+/**
+ * Event-driven wait on stdin, a timerfd frame deadline and a signalfd
+ * SIGINT/SIGTSTP/SIGWINCH are blocked while the loop is open and arrive
+ * as events instead of running handlers, so nothing has to poll for flags.
+ */
+typedef struct {
+    int timer_fd;
+    int signal_fd;
+    sigset_t old_mask;      // signal mask restored by events_close()
+} EventLoop;
+
+// Function prototypes
+int events_open(EventLoop* ev);
+void events_close(EventLoop* ev);
+int events_arm(EventLoop* ev, long long deadline_ns);
+int events_disarm(EventLoop* ev);
+int events_wait(EventLoop* ev);
+
+#endif
@@ -0,0 +1,209 @@
+#include "fish_kernels.h"
+#include "game.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_KERNELS 1
+#endif
+
+// Scalar reference version - the SIMD versions must match it exactly
+static void move_scalar(int* pos, const int* dir, const int* fps, int* counter,
+                        int n, int right_edge, int max_start) {
+    for (int i = 0; i < n; i++) {
+        int c = counter[i] + 1;
+        int step = c >= fps[i];
+        counter[i] = step ? 0 : c;
+
+        int p = pos[i] + (step ? dir[i] : 0);
+        if (step && dir[i] == 1 && p >= right_edge) p = 0;
+        else if (step && dir[i] == -1 && p <= 0) p = max_start;
+        pos[i] = p;
+    }
+}
+
+static int find_hit_scalar(const int* pos, const int* row, const unsigned char* alive,
+                           int n, int hook_x, int hook_y) {
+    for (int i = 0; i < n; i++) {
+        if (alive[i] &&
+            (unsigned)(hook_y - row[i]) < FISH_LINES &&
+            (unsigned)(hook_x - pos[i]) < FISH_WIDTH) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// First live fish among the lanes set in 'mask' (lane 0 = index 'base')
+static int first_alive(unsigned mask, const unsigned char* alive, int base) {
+    while (mask) {
+        int lane = __builtin_ctz(mask);
+        if (alive[base + lane]) return base + lane;
+        mask &= mask - 1;
+    }
+    return -1;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+// SSE2: 4 fish per step; no blend instruction, so selects are and/andnot/or
+__attribute__((target("sse2")))
+static void move_sse2(int* pos, const int* dir, const int* fps, int* counter,
+                      int n, int right_edge, int max_start) {
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i minus_one = _mm_set1_epi32(-1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i edge = _mm_set1_epi32(right_edge);
+    const __m128i restart = _mm_set1_epi32(max_start);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i c = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(counter + i)), one);
+        __m128i d = _mm_loadu_si128((const __m128i*)(dir + i));
+        __m128i p = _mm_loadu_si128((const __m128i*)(pos + i));
+
+        // hold = c < frames_per_step, i.e. this fish does not move yet
+        __m128i hold = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i*)(fps + i)), c);
+        _mm_storeu_si128((__m128i*)(counter + i), _mm_and_si128(hold, c));
+        p = _mm_add_epi32(p, _mm_andnot_si128(hold, d));
+
+        // p >= right_edge is !(right_edge > p); p <= 0 is !(p > 0)
+        __m128i right = _mm_andnot_si128(hold, _mm_cmpeq_epi32(d, one));
+        __m128i left = _mm_andnot_si128(hold, _mm_cmpeq_epi32(d, minus_one));
+        __m128i wrap_r = _mm_andnot_si128(_mm_cmpgt_epi32(edge, p), right);
+        __m128i wrap_l = _mm_andnot_si128(_mm_cmpgt_epi32(p, zero), left);
+
+        p = _mm_andnot_si128(wrap_r, p);
+        p = _mm_or_si128(_mm_andnot_si128(wrap_l, p), _mm_and_si128(wrap_l, restart));
+        _mm_storeu_si128((__m128i*)(pos + i), p);
+    }
+    move_scalar(pos + i, dir + i, fps + i, counter + i, n - i, right_edge, max_start);
+}
+
+__attribute__((target("sse2")))
+static int find_hit_sse2(const int* pos, const int* row, const unsigned char* alive,
+                         int n, int hook_x, int hook_y) {
+    // row in (hook_y - FISH_LINES, hook_y] and pos in (hook_x - FISH_WIDTH, hook_x]
+    const __m128i row_lo = _mm_set1_epi32(hook_y - FISH_LINES);
+    const __m128i row_hi = _mm_set1_epi32(hook_y);
+    const __m128i pos_lo = _mm_set1_epi32(hook_x - FISH_WIDTH);
+    const __m128i pos_hi = _mm_set1_epi32(hook_x);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m128i r = _mm_loadu_si128((const __m128i*)(row + i));
+        __m128i p = _mm_loadu_si128((const __m128i*)(pos + i));
+        __m128i in_row = _mm_andnot_si128(_mm_cmpgt_epi32(r, row_hi), _mm_cmpgt_epi32(r, row_lo));
+        __m128i in_col = _mm_andnot_si128(_mm_cmpgt_epi32(p, pos_hi), _mm_cmpgt_epi32(p, pos_lo));
+        unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(in_row, in_col)));
+        if (mask) {
+            int hit = first_alive(mask, alive, i);
+            if (hit >= 0) return hit;
+        }
+    }
+    int hit = find_hit_scalar(pos + i, row + i, alive + i, n - i, hook_x, hook_y);
+    return hit >= 0 ? i + hit : -1;
+}
+
+// AVX2: 8 fish per step with blends
+__attribute__((target("avx2")))
+static void move_avx2(int* pos, const int* dir, const int* fps, int* counter,
+                      int n, int right_edge, int max_start) {
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i minus_one = _mm256_set1_epi32(-1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i edge = _mm256_set1_epi32(right_edge);
+    const __m256i restart = _mm256_set1_epi32(max_start);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i c = _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(counter + i)), one);
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dir + i));
+        __m256i p = _mm256_loadu_si256((const __m256i*)(pos + i));
+
+        __m256i hold = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)(fps + i)), c);
+        _mm256_storeu_si256((__m256i*)(counter + i), _mm256_and_si256(hold, c));
+        p = _mm256_add_epi32(p, _mm256_andnot_si256(hold, d));
+
+        __m256i right = _mm256_andnot_si256(hold, _mm256_cmpeq_epi32(d, one));
+        __m256i left = _mm256_andnot_si256(hold, _mm256_cmpeq_epi32(d, minus_one));
+        __m256i wrap_r = _mm256_andnot_si256(_mm256_cmpgt_epi32(edge, p), right);
+        __m256i wrap_l = _mm256_andnot_si256(_mm256_cmpgt_epi32(p, zero), left);
+
+        p = _mm256_blendv_epi8(p, zero, wrap_r);
+        p = _mm256_blendv_epi8(p, restart, wrap_l);
+        _mm256_storeu_si256((__m256i*)(pos + i), p);
+    }
+    move_scalar(pos + i, dir + i, fps + i, counter + i, n - i, right_edge, max_start);
+}
+
+__attribute__((target("avx2")))
+static int find_hit_avx2(const int* pos, const int* row, const unsigned char* alive,
+                         int n, int hook_x, int hook_y) {
+    const __m256i row_lo = _mm256_set1_epi32(hook_y - FISH_LINES);
+    const __m256i row_hi = _mm256_set1_epi32(hook_y);
+    const __m256i pos_lo = _mm256_set1_epi32(hook_x - FISH_WIDTH);
+    const __m256i pos_hi = _mm256_set1_epi32(hook_x);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i r = _mm256_loadu_si256((const __m256i*)(row + i));
+        __m256i p = _mm256_loadu_si256((const __m256i*)(pos + i));
+        __m256i in_row = _mm256_andnot_si256(_mm256_cmpgt_epi32(r, row_hi), _mm256_cmpgt_epi32(r, row_lo));
+        __m256i in_col = _mm256_andnot_si256(_mm256_cmpgt_epi32(p, pos_hi), _mm256_cmpgt_epi32(p, pos_lo));
+        unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(in_row, in_col)));
+        if (mask) {
+            int hit = first_alive(mask, alive, i);
+            if (hit >= 0) return hit;
+        }
+    }
+    int hit = find_hit_scalar(pos + i, row + i, alive + i, n - i, hook_x, hook_y);
+    return hit >= 0 ? i + hit : -1;
+}
+
+#endif
+
+static const FishKernels kernels[] = {
+#ifdef HAVE_X86_KERNELS
+    { "avx2", move_avx2, find_hit_avx2 },
+    { "sse2", move_sse2, find_hit_sse2 },
+#endif
+    { "scalar", move_scalar, find_hit_scalar },
+};
+#define KERNEL_COUNT (int)(sizeof(kernels) / sizeof(kernels[0]))
+
+static const FishKernels* active = NULL;
+
+static int cpu_supports(const FishKernels* k) {
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (strcmp(k->name, "avx2") == 0) return __builtin_cpu_supports("avx2");
+    if (strcmp(k->name, "sse2") == 0) return __builtin_cpu_supports("sse2");
+#endif
+    return strcmp(k->name, "scalar") == 0;
+}
+
+// Kernels in use - the widest the CPU supports unless fish_kernels_use() chose
+const FishKernels* fish_kernels_get(void) {
+    const FishKernels* k = __atomic_load_n(&active, __ATOMIC_ACQUIRE);
+    if (k == NULL) {
+        fish_kernels_use("auto");
+        k = __atomic_load_n(&active, __ATOMIC_ACQUIRE);
+    }
+    return k;
+}
+
+/**
+ * Force a kernel set by name: "avx2", "sse2", "scalar" or "auto"
+ * Returns: 0 on success, -1 if unknown or not supported by this CPU
+ */
+int fish_kernels_use(const char* name) {
+    int is_auto = strcmp(name, "auto") == 0;
+    for (int i = 0; i < KERNEL_COUNT; i++) {
+        if ((is_auto || strcmp(name, kernels[i].name) == 0) && cpu_supports(&kernels[i])) {
+            __atomic_store_n(&active, &kernels[i], __ATOMIC_RELEASE);
+            return 0;
+        }
+    }
+    return -1;
+}
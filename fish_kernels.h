@@ -0,0 +1,28 @@
+#ifndef FISH_KERNELS_H
+#define FISH_KERNELS_H
+
+/**
+ * Per-frame passes over the fish arrays, in scalar and SIMD versions
+ * Every version gives the same results as the scalar one, bit for bit;
+ * the widest one the CPU supports is picked at run time.
+ */
+typedef struct {
+    const char* name;
+
+    // Step every fish whose frame counter is due and wrap at the edges:
+    // moving right past right_edge restarts at 0, moving left onto 0
+    // restarts at max_start
+    void (*move)(int* pos, const int* dir, const int* frames_per_step,
+                 int* frame_counter, int n, int right_edge, int max_start);
+
+    // Index of the first live fish whose sprite covers (hook_x, hook_y),
+    // or -1 if the hook hits nothing
+    int (*find_hit)(const int* pos, const int* row, const unsigned char* alive,
+                    int n, int hook_x, int hook_y);
+} FishKernels;
+
+// Function prototypes
+const FishKernels* fish_kernels_get(void);
+int fish_kernels_use(const char* name);
+
+#endif
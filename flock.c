@@ -0,0 +1,166 @@
+#include "flock.h"
+#include "game.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Steering weights - separation wins over alignment, alignment over cohesion
+#define ALIGN_WEIGHT 2
+#define COHESION_WEIGHT 1
+#define SEPARATION_WEIGHT 3
+
+// 3x3 neighbourhood, own cell first
+static const int cell_dx[9] = { 0, -1, 0, 1, -1, 1, -1, 0, 1 };
+static const int cell_dy[9] = { 0, -1, -1, -1, 0, 0, 1, 1, 1 };
+
+static int sign(int v) {
+    return (v > 0) - (v < 0);
+}
+
+static int clamp(int v, int lo, int hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Allocate the grid for a cols x lines pond and up to 'capacity' fish
+// Returns: 0 on success, -1 if out of memory
+int flock_init(Flock* f, int cols, int lines, int capacity) {
+    memset(f, 0, sizeof(Flock));
+    f->cols = cols;
+    f->lines = lines;
+    f->grid_cols = cols / FLOCK_RADIUS_X + 1;
+    f->grid_rows = lines / FLOCK_RADIUS_Y + 1;
+    f->capacity = capacity;
+    f->cell_start = malloc((FLOCK_BANDS * f->grid_cols * f->grid_rows + 1) * sizeof(int));
+    f->order = malloc(capacity * sizeof(int));
+    f->cell_of = malloc(capacity * sizeof(int));
+    f->new_dir = malloc(capacity * sizeof(int));
+    f->new_row = malloc(capacity * sizeof(int));
+    f->new_fps = malloc(capacity * sizeof(int));
+    if (!f->cell_start || !f->order || !f->cell_of || !f->new_dir || !f->new_row || !f->new_fps) {
+        flock_free(f);
+        return -1;
+    }
+    return 0;
+}
+
+void flock_free(Flock* f) {
+    free(f->cell_start);
+    free(f->order);
+    free(f->cell_of);
+    free(f->new_dir);
+    free(f->new_row);
+    free(f->new_fps);
+    memset(f, 0, sizeof(Flock));
+}
+
+// Depth band holding 'row' (rows outside every band go to the nearest one)
+static int band_of(int row, const int band_edges[FLOCK_BANDS + 1]) {
+    int b = 0;
+    while (b < FLOCK_BANDS - 1 && row >= band_edges[b + 1]) b++;
+    return b;
+}
+
+// Counting sort of the live fish into grid cells, one grid per depth band
+static void build_grid(Flock* f, const int* pos, const int* row, const unsigned char* alive, int n,
+                       const int band_edges[FLOCK_BANDS + 1]) {
+    int cells = FLOCK_BANDS * f->grid_cols * f->grid_rows;
+    memset(f->cell_start, 0, (cells + 1) * sizeof(int));
+
+    for (int i = 0; i < n; i++) {
+        if (!alive[i]) {
+            f->cell_of[i] = -1;
+            continue;
+        }
+        int gx = clamp(pos[i] / FLOCK_RADIUS_X, 0, f->grid_cols - 1);
+        int gy = clamp(row[i] / FLOCK_RADIUS_Y, 0, f->grid_rows - 1);
+        int band = band_of(row[i], band_edges);
+        f->cell_of[i] = (band * f->grid_rows + gy) * f->grid_cols + gx;
+        f->cell_start[f->cell_of[i]]++;
+    }
+
+    // Running totals give the end of each cell; filling backwards moves them to the start
+    for (int c = 1; c < cells; c++) {
+        f->cell_start[c] += f->cell_start[c - 1];
+    }
+    f->cell_start[cells] = f->cell_start[cells - 1];
+    for (int i = n - 1; i >= 0; i--) {
+        if (f->cell_of[i] >= 0) {
+            f->order[--f->cell_start[f->cell_of[i]]] = i;
+        }
+    }
+}
+
+/**
+ * Steer every live fish by the neighbours in its depth band
+ * - alignment:  turn to the heading most neighbours swim in, match their speed
+ * - cohesion:   drift toward the neighbours' centre
+ * - separation: move away from fish whose sprite overlaps this one
+ * Heading can change every tick; row and speed only change on the tick
+ * the fish takes a step, so schools do not jitter between rows.
+ * All decisions read the positions from the start of the tick.
+ */
+void flock_steer(Flock* f, int* pos, int* row, int* dir, int* fps,
+                 const int* counter, const unsigned char* alive, int n,
+                 const int band_edges[FLOCK_BANDS + 1]) {
+    if (n > f->capacity) n = f->capacity;
+    build_grid(f, pos, row, alive, n, band_edges);
+    int band_cells = f->grid_cols * f->grid_rows;
+
+    for (int i = 0; i < n; i++) {
+        f->new_dir[i] = dir[i];
+        f->new_row[i] = row[i];
+        f->new_fps[i] = fps[i];
+        if (f->cell_of[i] < 0) continue;
+
+        int b = band_of(row[i], band_edges);
+        int band_lo = band_edges[b];
+        int band_hi = band_edges[b + 1] > band_lo ? band_edges[b + 1] : band_lo + 1;
+        int own = f->cell_of[i] - b * band_cells;
+        int gx = own % f->grid_cols;
+        int gy = own / f->grid_cols;
+
+        // Own cell first: in a crowded pond it fills the neighbour quota on its own
+        int seen = 0, align = 0, sum_dx = 0, sum_dy = 0, sum_fps = 0;
+        int sep_x = 0, sep_y = 0;
+        for (int k = 0; k < 9 && seen < FLOCK_MAX_NEIGHBORS; k++) {
+            int x = gx + cell_dx[k];
+            int y = gy + cell_dy[k];
+            if (x < 0 || x >= f->grid_cols || y < 0 || y >= f->grid_rows) continue;
+
+            int c = b * band_cells + y * f->grid_cols + x;
+            for (int e = f->cell_start[c]; e < f->cell_start[c + 1] && seen < FLOCK_MAX_NEIGHBORS; e++) {
+                int j = f->order[e];
+                int dx = pos[j] - pos[i];
+                int dy = row[j] - row[i];
+                if (j == i) continue;
+                if (abs(dx) > FLOCK_RADIUS_X || abs(dy) > FLOCK_RADIUS_Y) continue;
+
+                seen++;
+                align += dir[j];
+                sum_dx += dx;
+                sum_dy += dy;
+                sum_fps += fps[j];
+                if (abs(dx) < FISH_WIDTH && abs(dy) < FISH_LINES) {
+                    // Stacked fish split by index so the pair does not move together
+                    sep_x -= dx ? sign(dx) : (j < i ? -1 : 1);
+                    sep_y -= dy ? sign(dy) : (j < i ? -1 : 1);
+                }
+            }
+        }
+        if (seen == 0) continue;
+
+        int heading = ALIGN_WEIGHT * align + COHESION_WEIGHT * sign(sum_dx) + SEPARATION_WEIGHT * sep_x;
+        if (heading != 0) f->new_dir[i] = sign(heading);
+
+        if (counter[i] + 1 >= fps[i]) {
+            int climb = sign(COHESION_WEIGHT * sign(sum_dy) + SEPARATION_WEIGHT * sep_y);
+            f->new_row[i] = clamp(row[i] + climb, band_lo, band_hi - 1);
+
+            int mean_fps = (sum_fps + seen / 2) / seen;
+            f->new_fps[i] = fps[i] + sign(mean_fps - fps[i]);
+        }
+    }
+
+    memcpy(dir, f->new_dir, n * sizeof(int));
+    memcpy(row, f->new_row, n * sizeof(int));
+    memcpy(fps, f->new_fps, n * sizeof(int));
+}
@@ -0,0 +1,34 @@
+#ifndef FLOCK_H
+#define FLOCK_H
+
+#define FLOCK_BANDS 3           // shallow, middle, deep
+#define FLOCK_RADIUS_X 8        // columns a fish can see
+#define FLOCK_RADIUS_Y 2        // rows a fish can see
+#define FLOCK_MAX_NEIGHBORS 12  // nearest-in-scan-order fish that count
+
+/**
+ * Schooling fish - alignment, cohesion and separation inside a depth band
+ * A uniform grid of FLOCK_RADIUS_X x FLOCK_RADIUS_Y cells is rebuilt
+ * every tick with a counting sort, so each fish only looks at the 3x3
+ * cells around it and a tick stays O(fish) instead of O(fish^2).
+ */
+typedef struct {
+    int cols, lines;            // pond size the grid covers
+    int grid_cols, grid_rows;
+    int capacity;               // fish the scratch arrays can hold
+    int* cell_start;            // per cell: first entry in 'order' (+1 sentinel)
+    int* order;                 // fish indices sorted by cell
+    int* cell_of;               // per fish: grid cell (-1 = not in the pond)
+    int* new_dir;               // steering results, applied after the scan
+    int* new_row;
+    int* new_fps;
+} Flock;
+
+// Function prototypes
+int flock_init(Flock* f, int cols, int lines, int capacity);
+void flock_free(Flock* f);
+void flock_steer(Flock* f, int* pos, int* row, int* dir, int* frames_per_step,
+                 const int* frame_counter, const unsigned char* alive, int n,
+                 const int band_edges[FLOCK_BANDS + 1]);
+
+#endif
@@ -0,0 +1,563 @@
+#include "game.h"
+#include "fish_kernels.h"
+#include "flock.h"
+#include "profiler.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Per-game random numbers (xorshift64*): the same seed always gives the same game
+static int game_rand(GameState* state) {
+    unsigned long long x = state->rng;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    state->rng = x;
+    return (int)((x * 0x2545F4914F6CDD1DULL) >> 33);  // 31 bits, like rand()
+}
+
+// Pick a random row inside [start, end)
+static int random_row(GameState* state, int start, int end) {
+    int span = end - start;
+    return start + (span > 0 ? game_rand(state) % span : 0);
+}
+
+// Allocate the fish arrays
+static int pool_alloc(FishPool* pool, int capacity) {
+    memset(pool, 0, sizeof(FishPool));
+    pool->capacity = capacity;
+    pool->pos = malloc(capacity * sizeof(int));
+    pool->row = malloc(capacity * sizeof(int));
+    pool->dir = malloc(capacity * sizeof(int));
+    pool->framesPerStep = malloc(capacity * sizeof(int));
+    pool->frameCounter = malloc(capacity * sizeof(int));
+    pool->alive = malloc(capacity);
+    pool->free_slots = malloc(capacity * sizeof(int));
+    if (!pool->pos || !pool->row || !pool->dir || !pool->framesPerStep ||
+        !pool->frameCounter || !pool->alive || !pool->free_slots) {
+        return -1;
+    }
+    return 0;
+}
+
+static void pool_free(FishPool* pool) {
+    free(pool->pos);
+    free(pool->row);
+    free(pool->dir);
+    free(pool->framesPerStep);
+    free(pool->frameCounter);
+    free(pool->alive);
+    free(pool->free_slots);
+    memset(pool, 0, sizeof(FishPool));
+}
+
+// Take a slot for a new fish: reuse a released one, else the next fresh one
+// Returns: slot index, or -1 if the pool is full
+static int pool_take(FishPool* pool) {
+    int slot;
+    if (pool->free_count > 0) {
+        slot = pool->free_slots[--pool->free_count];
+    } else if (pool->used < pool->capacity) {
+        slot = pool->used++;
+    } else {
+        return -1;
+    }
+    pool->alive[slot] = 1;
+    pool->count++;
+    return slot;
+}
+
+// Give a slot back to the free list
+static void pool_release(FishPool* pool, int slot) {
+    pool->alive[slot] = 0;
+    pool->free_slots[pool->free_count++] = slot;
+    pool->count--;
+}
+
+// Put a new fish somewhere in rows [row_start, row_end)
+static int spawn_fish(GameState* state, int row_start, int row_end) {
+    FishPool* pool = &state->fish;
+    int slot = pool_take(pool);
+    if (slot < 0) return -1;
+
+    pool->pos[slot] = (state->cols > FISH_WIDTH) ? game_rand(state) % (state->cols - FISH_WIDTH) : 0;
+    pool->row[slot] = random_row(state, row_start, row_end);
+    pool->dir[slot] = (game_rand(state) % 2) * 2 - 1;  // -1 or 1
+    pool->framesPerStep[slot] = 1 + game_rand(state) % SLOWEST_FISH;  // Random speed
+    pool->frameCounter[slot] = 0;
+    return slot;
+}
+
+/**
+ * Create a game for a pond of the given terminal size
+ * fish_count: population, 1..MAX_FISH
+ * seed: everything random in the game follows from it
+ * Returns: 0 on success, -1 if out of memory
+ */
+int game_init(GameState* state, int cols, int lines, int fish_count, unsigned long long seed) {
+    memset(state, 0, sizeof(GameState));
+    if (fish_count < 1) fish_count = 1;
+    if (fish_count > MAX_FISH) fish_count = MAX_FISH;
+
+    if (pool_alloc(&state->fish, fish_count) == -1) {
+        pool_free(&state->fish);
+        return -1;
+    }
+    state->cols = cols;
+    state->lines = lines;
+    state->fish_wanted = fish_count;
+    state->kernels = fish_kernels_get();
+
+    // Divide pond into three depth zones
+    int pond_top = lines / 4 + 3;
+    int pond_bottom = lines - 1;
+    int water_span = (pond_bottom - pond_top - FISH_LINES);
+    if (water_span < 3) water_span = 3;
+
+    int band = water_span / 3;
+    state->top_start = pond_top;
+    state->top_end = pond_top + band;
+    state->mid_start = pond_top + band;
+    state->mid_end = pond_top + 2 * band;
+    state->bot_start = pond_top + 2 * band;
+    state->bot_end = pond_bottom - FISH_LINES;
+
+    // Ensure valid ranges
+    if (state->top_end <= state->top_start) state->top_end = state->top_start + 1;
+    if (state->mid_end <= state->mid_start) state->mid_end = state->mid_start + 1;
+    if (state->bot_end <= state->bot_start) state->bot_end = state->bot_start + 1;
+
+    state->max_hook_depth = (lines - (lines / 4) - 4);
+    if (state->max_hook_depth < 0) state->max_hook_depth = 0;
+
+    game_reset(state, seed);
+    return 0;
+}
+
+// Start a new game in the same pond, reusing the fish arrays
+void game_reset(GameState* state, unsigned long long seed) {
+    FishPool* pool = &state->fish;
+    state->seed = seed;
+    // splitmix64 step so nearby seeds give unrelated games (and never a zero state)
+    unsigned long long z = seed + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    state->rng = (z ^ (z >> 31)) | 1;
+
+    pool->used = 0;
+    pool->count = 0;
+    pool->free_count = 0;
+
+    // Spawn fish across depth zones: 4 in 10 middle, 2 deep, 4 shallow
+    for (int i = 0; i < state->fish_wanted; i++) {
+        if (i % 10 < 4) {
+            spawn_fish(state, state->mid_start, state->mid_end);
+        } else if (i % 10 < 6) {
+            spawn_fish(state, state->bot_start, state->bot_end);
+        } else {
+            spawn_fish(state, state->top_start, state->top_end);
+        }
+    }
+
+    state->boat_x = state->cols / 4;
+    state->hook_depth = 0;
+    state->hook_lowering = 0;
+    state->hook_miss_penalized = 0;
+    state->fish_caught_this_attempt = 0;
+
+    state->speed = DEFAULT_SPEED;
+    state->score = 0;
+    state->lives = DEFAULT_LIVES;
+    state->fish_caught_total = 0;
+    state->hooks_missed_total = 0;
+
+    state->time_limit = DEFAULT_TIME_LIMIT;
+    state->elapsed_ms = 0;
+    state->frame = 0;
+    state->game_over = 0;
+}
+
+void game_free(GameState* state) {
+    pool_free(&state->fish);
+    flock_free(&state->flock);
+}
+
+/**
+ * Turn schooling on or off; the neighbour grid is allocated on first use
+ * Returns: 0 on success, -1 if out of memory
+ */
+int game_set_schooling(GameState* state, int on) {
+    if (on && state->flock.capacity == 0 &&
+        flock_init(&state->flock, state->cols, state->lines, state->fish.capacity) == -1) {
+        return -1;
+    }
+    state->schooling = on;
+    return 0;
+}
+
+/**
+ * Fingerprint of everything the simulation depends on (FNV-1a)
+ * Two runs that agree frame by frame end with the same hash
+ */
+unsigned long long game_hash(const GameState* state) {
+    unsigned long long h = 0xCBF29CE484222325ULL;
+    const FishPool* pool = &state->fish;
+    int scalars[] = {
+        state->boat_x, state->hook_depth, state->hook_lowering, state->speed, state->score,
+        state->lives, state->fish_caught_total, state->hooks_missed_total, (int)state->frame,
+    };
+    for (size_t i = 0; i < sizeof(scalars) / sizeof(scalars[0]); i++) {
+        h = (h ^ (unsigned)scalars[i]) * 0x100000001B3ULL;
+    }
+    for (int i = 0; i < pool->used; i++) {
+        if (!pool->alive[i]) continue;
+        h = (h ^ (unsigned)pool->pos[i]) * 0x100000001B3ULL;
+        h = (h ^ (unsigned)pool->row[i]) * 0x100000001B3ULL;
+        h = (h ^ (unsigned)pool->dir[i]) * 0x100000001B3ULL;
+        h = (h ^ (unsigned)pool->framesPerStep[i]) * 0x100000001B3ULL;
+    }
+    return h;
+}
+
+// Fixed part of a snapshot; the fish arrays follow it
+typedef struct {
+    int32_t used, count, free_count;
+    int32_t boat_x, hook_depth, hook_lowering, hook_miss_penalized, fish_caught_this_attempt;
+    int32_t speed, score, lives, fish_caught_total, hooks_missed_total;
+    int32_t time_limit, game_over, schooling;
+    int64_t elapsed_ms, frame;
+    uint64_t seed, rng;
+} SnapshotHead;
+
+static unsigned char* put_bytes(unsigned char* out, const void* src, size_t n) {
+    memcpy(out, src, n);
+    return out + n;
+}
+
+/**
+ * Serialize the full game state (fish, boat, hook, score, lives, clock, rng)
+ * buf: destination, or NULL to ask for the size
+ * Returns: bytes needed; nothing is written if cap is too small
+ */
+size_t game_snapshot(const GameState* state, unsigned char* buf, size_t cap) {
+    const FishPool* pool = &state->fish;
+    size_t need = sizeof(SnapshotHead) + (size_t)pool->used * (5 * sizeof(int) + 1) +
+                  (size_t)pool->free_count * sizeof(int);
+    if (buf == NULL || cap < need) return need;
+
+    SnapshotHead head = {
+        pool->used, pool->count, pool->free_count,
+        state->boat_x, state->hook_depth, state->hook_lowering, state->hook_miss_penalized,
+        state->fish_caught_this_attempt,
+        state->speed, state->score, state->lives, state->fish_caught_total, state->hooks_missed_total,
+        state->time_limit, state->game_over, state->schooling,
+        state->elapsed_ms, state->frame,
+        state->seed, state->rng,
+    };
+    size_t n = (size_t)pool->used;
+    unsigned char* out = put_bytes(buf, &head, sizeof(head));
+    out = put_bytes(out, pool->pos, n * sizeof(int));
+    out = put_bytes(out, pool->row, n * sizeof(int));
+    out = put_bytes(out, pool->dir, n * sizeof(int));
+    out = put_bytes(out, pool->framesPerStep, n * sizeof(int));
+    out = put_bytes(out, pool->frameCounter, n * sizeof(int));
+    out = put_bytes(out, pool->alive, n);
+    put_bytes(out, pool->free_slots, (size_t)pool->free_count * sizeof(int));
+    return need;
+}
+
+// Largest snapshot game_snapshot() can make of this game (every slot used, every one free)
+size_t game_snapshot_max(const GameState* state) {
+    return sizeof(SnapshotHead) + (size_t)state->fish.capacity * (6 * sizeof(int) + 1);
+}
+
+// Element i of an int array stored in a snapshot
+static int snapshot_int(const unsigned char* array, size_t i) {
+    int v;
+    memcpy(&v, array + i * sizeof(int), sizeof(int));
+    return v;
+}
+
+/**
+ * Check that a snapshot describes a game this one could have reached:
+ * values in the ranges game_step() keeps them in, and a fish pool whose
+ * free list holds each dead slot below 'used' exactly once
+ * Returns: 1 if it is safe to load, 0 otherwise
+ */
+static int snapshot_valid(const GameState* state, const SnapshotHead* head, const unsigned char* fish) {
+    int boat_max = state->cols - 12 > state->cols / 4 ? state->cols - 12 : state->cols / 4;
+    int max_start = (state->cols > FISH_WIDTH) ? (state->cols - FISH_WIDTH) : 0;
+    if (head->boat_x < 0 || head->boat_x > boat_max ||
+        head->hook_depth < 0 || head->hook_depth > state->max_hook_depth ||
+        head->hook_lowering < -1 || head->hook_lowering > 1 ||
+        head->speed < MIN_SPEED || head->speed > MAX_SPEED ||
+        head->lives < 0 || head->lives > DEFAULT_LIVES ||
+        head->fish_caught_total < 0 || head->hooks_missed_total < 0 ||
+        head->time_limit < 1 || head->elapsed_ms < 0 || head->frame < 0 ||
+        (head->hook_miss_penalized & ~1) || (head->fish_caught_this_attempt & ~1) ||
+        (head->game_over & ~1) || (head->schooling & ~1) ||
+        head->count != head->used - head->free_count) {
+        return 0;
+    }
+
+    size_t n = (size_t)head->used;
+    const unsigned char* pos = fish;
+    const unsigned char* row = pos + n * sizeof(int);
+    const unsigned char* dir = row + n * sizeof(int);
+    const unsigned char* fps = dir + n * sizeof(int);
+    const unsigned char* counter = fps + n * sizeof(int);
+    const unsigned char* alive = counter + n * sizeof(int);
+    const unsigned char* free_slots = alive + n;
+
+    int live = 0;
+    for (size_t i = 0; i < n; i++) {
+        int p = snapshot_int(pos, i), r = snapshot_int(row, i), d = snapshot_int(dir, i);
+        int f = snapshot_int(fps, i), c = snapshot_int(counter, i);
+        if (alive[i] > 1 || p < 0 || p > max_start || r < state->top_start || r >= state->bot_end ||
+            (d != 1 && d != -1) || f < 1 || f > SLOWEST_FISH || c < 0 || c >= f) {
+            return 0;
+        }
+        live += alive[i];
+    }
+    if (live != head->count) return 0;
+
+    // Each free slot must be dead and listed once: mark them off in a scratch copy of 'alive'
+    unsigned char* seen = malloc(n + 1);
+    if (seen == NULL) return 0;
+    memcpy(seen, alive, n);
+    int ok = 1;
+    for (int i = 0; i < head->free_count && ok; i++) {
+        int slot = snapshot_int(free_slots, (size_t)i);
+        ok = slot >= 0 && slot < head->used && seen[slot] == 0;
+        if (ok) seen[slot] = 1;
+    }
+    free(seen);
+    return ok;
+}
+
+/**
+ * Load a snapshot into a game created with the same pond and population
+ * The snapshot is checked in full first; a damaged one leaves the game untouched.
+ * Returns: 0 on success, -1 if the snapshot does not fit this game
+ */
+int game_restore(GameState* state, const unsigned char* buf, size_t len) {
+    FishPool* pool = &state->fish;
+    SnapshotHead head;
+    if (len < sizeof(head)) return -1;
+    memcpy(&head, buf, sizeof(head));
+    if (head.used < 0 || head.used > pool->capacity ||
+        head.free_count < 0 || head.free_count > head.used ||
+        len != sizeof(head) + (size_t)head.used * (5 * sizeof(int) + 1) +
+               (size_t)head.free_count * sizeof(int) ||
+        !snapshot_valid(state, &head, buf + sizeof(head))) {
+        return -1;
+    }
+    if (head.schooling && game_set_schooling(state, 1) == -1) return -1;
+    if (!head.schooling) state->schooling = 0;
+
+    size_t n = (size_t)head.used;
+    const unsigned char* in = buf + sizeof(head);
+    memcpy(pool->pos, in, n * sizeof(int));                     in += n * sizeof(int);
+    memcpy(pool->row, in, n * sizeof(int));                     in += n * sizeof(int);
+    memcpy(pool->dir, in, n * sizeof(int));                     in += n * sizeof(int);
+    memcpy(pool->framesPerStep, in, n * sizeof(int));           in += n * sizeof(int);
+    memcpy(pool->frameCounter, in, n * sizeof(int));            in += n * sizeof(int);
+    memcpy(pool->alive, in, n);                                 in += n;
+    memcpy(pool->free_slots, in, (size_t)head.free_count * sizeof(int));
+    pool->used = head.used;
+    pool->count = head.count;
+    pool->free_count = head.free_count;
+
+    state->boat_x = head.boat_x;
+    state->hook_depth = head.hook_depth;
+    state->hook_lowering = head.hook_lowering;
+    state->hook_miss_penalized = head.hook_miss_penalized;
+    state->fish_caught_this_attempt = head.fish_caught_this_attempt;
+    state->speed = head.speed;
+    state->score = head.score;
+    state->lives = head.lives;
+    state->fish_caught_total = head.fish_caught_total;
+    state->hooks_missed_total = head.hooks_missed_total;
+    state->time_limit = head.time_limit;
+    state->game_over = head.game_over;
+    state->elapsed_ms = (long)head.elapsed_ms;
+    state->frame = (long)head.frame;
+    state->seed = head.seed;
+    state->rng = head.rng;
+    return 0;
+}
+
+// Points awarded per fish - faster speed = more points
+int game_points_per_fish(int speed) {
+    return (3 - speed) + 1;
+}
+
+// Column of the hook (center of boat)
+int game_hook_x(const GameState* state) {
+    return state->boat_x + BOAT_WIDTH / 2;
+}
+
+// Row of the hook tip
+int game_hook_y(const GameState* state) {
+    return state->lines / 4 + 1 + state->hook_depth;
+}
+
+// Milliseconds of play left on the simulated clock
+long game_remaining_ms(const GameState* state) {
+    long remaining_ms = (long)state->time_limit * 1000 - state->elapsed_ms;
+    return remaining_ms > 0 ? remaining_ms : 0;
+}
+
+// Seconds of play left on the simulated clock (rounded up)
+int game_remaining_time(const GameState* state) {
+    return (int)((game_remaining_ms(state) + 999) / 1000);
+}
+
+// Length of one simulation tick at the current speed
+int game_tick_ms(const GameState* state) {
+    return state->speed * MS_PER_SPEED_LEVEL;
+}
+
+// Apply one player key to the game
+static void apply_input(GameState* state, int input) {
+    if (input == 'a' || input == 'A') {
+        // Move boat left
+        if (state->boat_x > 0) state->boat_x--;
+    } else if (input == 'd' || input == 'D') {
+        // Move boat right
+        if (state->boat_x < state->cols - 12) state->boat_x++;
+    } else if (input == 'h' || input == 'H') {
+        // Drop hook (only if not already lowering)
+        if (state->hook_lowering == 0) state->hook_lowering = 1;
+    } else if (input == ' ') {
+        // Easter egg: space reverses all fish
+        int* dir = state->fish.dir;
+        for (int i = 0; i < state->fish.used; i++) {
+            dir[i] = -dir[i];
+        }
+    } else if (input == 's' || input == 'S') {
+        // Decrease speed (slower game, fewer points)
+        if (state->speed < MAX_SPEED) state->speed++;
+    } else if (input == 'f' || input == 'F') {
+        // Increase speed (faster game, more points)
+        if (state->speed > MIN_SPEED) state->speed--;
+    }
+}
+
+// Move every fish one frame, wrapping around screen edges
+// Runs over every handed-out slot; a free slot is only ever moved, never drawn or hit
+static void move_fish(GameState* state) {
+    FishPool* pool = &state->fish;
+    int right_edge = state->cols - FISH_WIDTH;
+    int max_start = (state->cols > FISH_WIDTH) ? (state->cols - FISH_WIDTH) : 0;
+
+    state->kernels->move(pool->pos, pool->dir, pool->framesPerStep, pool->frameCounter,
+                         pool->used, right_edge, max_start);
+}
+
+// Lower/raise the hook and charge a life for an empty return
+// Returns: GAME_EVENT_MISS if a life was lost, 0 otherwise
+static int update_hook(GameState* state) {
+    // Reset attempt tracking when hook leaves the top
+    if (state->hook_lowering == 1 && state->hook_depth == 0) {
+        state->hook_miss_penalized = 0;
+        state->fish_caught_this_attempt = 0;
+    }
+
+    if (state->hook_lowering == 1 && state->hook_depth < state->max_hook_depth) {
+        state->hook_depth++;
+    } else if (state->hook_lowering == -1 && state->hook_depth > 0) {
+        state->hook_depth--;
+    }
+
+    // Auto-raise when hook reaches bottom
+    if (state->hook_depth >= state->max_hook_depth && state->hook_lowering == 1) {
+        state->hook_lowering = -1;
+    }
+
+    // Penalize for missing fish when hook returns to top
+    if (state->hook_depth <= 0 && state->hook_lowering == -1) {
+        state->hook_lowering = 0;
+        if (!state->fish_caught_this_attempt && !state->hook_miss_penalized) {
+            state->lives--;
+            state->hooks_missed_total++;
+            state->hook_miss_penalized = 1;
+            return GAME_EVENT_MISS;
+        }
+    }
+    return 0;
+}
+
+// Test the hook against every fish; first hit is caught and respawned
+// Returns: GAME_EVENT_CATCH on a catch, 0 otherwise
+static int check_catch(GameState* state) {
+    if (state->hook_depth <= 0) return 0;
+
+    FishPool* pool = &state->fish;
+    int i = state->kernels->find_hit(pool->pos, pool->row, pool->alive, pool->used,
+                                     game_hook_x(state), game_hook_y(state));
+    if (i >= 0) {
+        state->score += game_points_per_fish(state->speed);
+        state->fish_caught_total++;
+
+        // The caught fish leaves; a new one takes its slot in the upper half of the pond
+        pool_release(pool, i);
+        spawn_fish(state, state->top_start, state->mid_end);
+
+        state->fish_caught_this_attempt = 1;
+        state->hook_lowering = -1;  // Auto-raise hook
+        return GAME_EVENT_CATCH;
+    }
+    return 0;
+}
+
+/**
+ * Advance the game by one frame
+ * input: key pressed this frame, or GAME_INPUT_NONE
+ * Returns: bitmask of GAME_EVENT_* flags
+ *
+ * The key is applied first, then the fish move, the hook moves and the
+ * catch is checked. The original loop applied a key after that frame's
+ * movement, so here a key lands one frame sooner (a drop starts, and a
+ * boat move lines the hook up, on the frame the key is given to).
+ * Recordings, the bot's predictions and the benchmarks are all built on
+ * this order; changing it means bumping REPLAY_VERSION.
+ */
+int game_step(GameState* state, int input) {
+    if (state->game_over) return GAME_EVENT_OVER;
+
+    int events = 0;
+    int tick_ms = game_tick_ms(state);  // speed keys take effect next tick
+    state->frame++;
+    if (input != GAME_INPUT_NONE) apply_input(state, input);
+
+    long long t = prof_begin();
+    if (state->schooling) {
+        FishPool* pool = &state->fish;
+        int band_edges[FLOCK_BANDS + 1] = {
+            state->top_start, state->mid_start, state->bot_start, state->bot_end
+        };
+        flock_steer(&state->flock, pool->pos, pool->row, pool->dir, pool->framesPerStep,
+                    pool->frameCounter, pool->alive, pool->used, band_edges);
+    }
+    move_fish(state);
+    prof_end(PROF_FISH, t);
+
+    events |= update_hook(state);
+    if (state->lives <= 0) {
+        state->game_over = 1;
+        return events | GAME_EVENT_OVER;
+    }
+
+    t = prof_begin();
+    events |= check_catch(state);
+    prof_end(PROF_COLLISION, t);
+
+    // One frame lasts speed * 10 ms of game time
+    state->elapsed_ms += tick_ms;
+    if (state->elapsed_ms >= (long)state->time_limit * 1000) {
+        state->game_over = 1;
+        events |= GAME_EVENT_OVER;
+    }
+    return events;
+}
@@ -0,0 +1,109 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stddef.h>
+#include "fish_kernels.h"
+#include "flock.h"
+
+#define DEFAULT_FISH 10
+#define MAX_FISH 100000
+#define FISH_LINES 3
+#define FISH_WIDTH 5
+#define SLOWEST_FISH 6          // frames per step of the slowest fish
+#define BOAT_WIDTH 13           // strlen("___/______\\__")
+#define DEFAULT_LIVES 3
+#define DEFAULT_SPEED 4
+#define DEFAULT_TIME_LIMIT 30   // seconds
+#define MIN_SPEED 1
+#define MAX_SPEED 6
+#define MS_PER_SPEED_LEVEL 10   // one frame lasts speed * 10 ms
+
+#define GAME_INPUT_NONE -1      // no key this frame (same value as ncurses ERR)
+
+// Event bits returned by game_step()
+#define GAME_EVENT_CATCH 0x01
+#define GAME_EVENT_MISS  0x02
+#define GAME_EVENT_OVER  0x04
+
+/**
+ * Fish pool - every fish in the pond, stored as structure-of-arrays
+ * Capacity is fixed when the game is created. Slots [0, used) have been
+ * handed out; a caught fish returns its slot to the free list and the
+ * next spawn reuses it, so per-frame passes stay dense linear loops.
+ */
+typedef struct {
+    int capacity;           // slots allocated
+    int used;               // slots ever handed out (high-water mark)
+    int count;              // live fish
+    int* pos;               // Horizontal position
+    int* row;               // Vertical position (row)
+    int* dir;               // Direction: -1 (left) or 1 (right)
+    int* framesPerStep;     // Speed control - frames before moving
+    int* frameCounter;      // Current frame count
+    unsigned char* alive;   // 1 if the slot holds a fish
+    int* free_slots;        // stack of released slots
+    int free_count;
+} FishPool;
+
+/**
+ * Complete state of one game - no globals, no ncurses
+ * Several games can run side by side (headless, tests, simulations)
+ */
+typedef struct {
+    // Pond geometry (terminal size the game was started with)
+    int cols;
+    int lines;
+    int top_start, top_end;     // Shallow depth zone
+    int mid_start, mid_end;     // Middle depth zone
+    int bot_start, bot_end;     // Deep depth zone
+
+    FishPool fish;
+    int fish_wanted;            // population restored by game_reset()
+    const FishKernels* kernels; // move/collision passes picked for this CPU
+    int schooling;              // 1 = fish steer by their neighbours (flock)
+    Flock flock;
+
+    // Boat and hook
+    int boat_x;
+    int hook_depth;
+    int hook_lowering;          // 0=idle, 1=lowering, -1=raising
+    int max_hook_depth;
+    int hook_miss_penalized;
+    int fish_caught_this_attempt;
+
+    // Scoring
+    int speed;
+    int score;
+    int lives;
+    int fish_caught_total;
+    int hooks_missed_total;
+
+    // Random numbers
+    unsigned long long seed;    // seed this game was started with
+    unsigned long long rng;     // generator state
+
+    // Simulated game clock
+    int time_limit;             // seconds
+    long elapsed_ms;            // play time simulated so far
+    long frame;                 // number of game_step() calls
+    int game_over;
+} GameState;
+
+// Function prototypes
+int game_init(GameState* state, int cols, int lines, int fish_count, unsigned long long seed);
+void game_reset(GameState* state, unsigned long long seed);
+void game_free(GameState* state);
+int game_set_schooling(GameState* state, int on);
+int game_step(GameState* state, int input);
+int game_points_per_fish(int speed);
+int game_hook_x(const GameState* state);
+int game_hook_y(const GameState* state);
+long game_remaining_ms(const GameState* state);
+int game_remaining_time(const GameState* state);
+int game_tick_ms(const GameState* state);
+unsigned long long game_hash(const GameState* state);
+size_t game_snapshot(const GameState* state, unsigned char* buf, size_t cap);
+size_t game_snapshot_max(const GameState* state);
+int game_restore(GameState* state, const unsigned char* buf, size_t len);
+
+#endif
@@ -1,148 +1,596 @@
 #include "highscore.h"
+#include "leaderboard.h"
+#include "codec.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/stat.h>
+#include <sys/file.h>
 
 #define BLUE    "\033[34m"
 #define RESET   "\033[0m"
 
 
-// Load high scores from file
-// System calls used: open(), read(), close(), stat()
-int load_highscores(HighScore scores[], int max_scores) {
-    int fd;
-    struct stat file_stat;
-    
-    // Check if file exists using stat()
-    if (stat(HIGHSCORE_FILE, &file_stat) == -1) {
-        // File doesn't exist, return 0 scores
-        return 0;
-    }
-    
-    // Open file for reading
-    fd = open(HIGHSCORE_FILE, O_RDONLY);
+// Longest encoded record: name length and characters, score, speed, date, id
+#define RECORD_MAX (1 + MAX_NAME_LENGTH + 5 + 5 + 2 * CODEC_VARINT_MAX)
+// Largest snapshot; also holds a bare array of MAX_HIGHSCORES from before headers
+#define SNAPSHOT_BYTES (sizeof(HighScoreFileHeader) + CODEC_BLOCK_HEAD + MAX_HIGHSCORES * RECORD_MAX + CODEC_BLOCK_TAIL)
+
+// splitmix64 finaliser: spreads a counter over all 64 bits, one to one
+static uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * A new game id
+ * The process draws a random base once (pid and the wall clock in
+ * nanoseconds); ids are the base plus a counter, mixed. Ids of one
+ * process never repeat, and two processes collide with odds of about
+ * one in 2^63 per pair of games.
+ * System calls used: getpid(), clock_gettime()
+ */
+uint64_t highscore_new_id(void) {
+    static uint64_t base;
+    static uint64_t next;
+    if (base == 0) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        base = mix64(((uint64_t)getpid() << 32) ^ (uint64_t)ts.tv_sec * 1000000000ULL ^ (uint64_t)ts.tv_nsec) | 1;
+    }
+    uint64_t seq = __atomic_fetch_add(&next, 1, __ATOMIC_RELAXED);
+    return mix64(base + seq) & ~HIGHSCORE_LEGACY_ID;
+}
+
+// Id of a game saved before ids: FNV-1a of its name, score, speed and date
+// The same record always gets the same id, so folding an old journal
+// twice still finds its games already there
+uint64_t highscore_legacy_id(const HighScore* s) {
+    int64_t fields[3] = { s->score, s->speed_level, (int64_t)s->date };
+    const unsigned char* p = (const unsigned char*)fields;
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < MAX_NAME_LENGTH && s->name[i]; i++) {
+        h = (h ^ (unsigned char)s->name[i]) * 1099511628211ULL;
+    }
+    for (size_t i = 0; i < sizeof(fields); i++) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    return h | HIGHSCORE_LEGACY_ID;
+}
+
+// Convert a record from before game ids
+void highscore_from_v1(HighScore* out, const HighScoreV1* in) {
+    memset(out, 0, sizeof(HighScore));
+    memcpy(out->name, in->name, MAX_NAME_LENGTH);
+    out->name[MAX_NAME_LENGTH - 1] = '\0';
+    out->score = in->score;
+    out->speed_level = in->speed_level;
+    out->date = in->date;
+    out->id = highscore_legacy_id(out);
+}
+
+// Encode one score after the one dated *prev
+static unsigned char* put_score(unsigned char* p, const HighScore* s, int64_t* prev) {
+    size_t len = strnlen(s->name, MAX_NAME_LENGTH);
+    *p++ = (unsigned char)(len | HIGHSCORE_ID_FLAG);
+    memcpy(p, s->name, len);
+    p += len;
+    p = codec_put_svarint(p, s->score);
+    p = codec_put_svarint(p, s->speed_level);
+    p = codec_put_svarint(p, (int64_t)s->date - *prev);
+    p = codec_put_varint(p, s->id);
+    *prev = s->date;
+    return p;
+}
+
+static const unsigned char* get_score(const unsigned char* p, const unsigned char* end, HighScore* s, int64_t* prev) {
+    int64_t score, speed, delta;
+    memset(s, 0, sizeof(HighScore));
+    if (p >= end) return NULL;
+    int has_id = (*p & HIGHSCORE_ID_FLAG) != 0;
+    size_t len = *p++ & ~HIGHSCORE_ID_FLAG;
+    if (len > MAX_NAME_LENGTH || (size_t)(end - p) < len) return NULL;
+    memcpy(s->name, p, len);
+    p += len;
+    if ((p = codec_get_svarint(p, end, &score)) == NULL ||
+        (p = codec_get_svarint(p, end, &speed)) == NULL ||
+        (p = codec_get_svarint(p, end, &delta)) == NULL) {
+        return NULL;
+    }
+    s->score = (int)score;
+    s->speed_level = (int)speed;
+    *prev += delta;
+    s->date = (time_t)*prev;
+    if (has_id) {
+        if ((p = codec_get_varint(p, end, &s->id)) == NULL) return NULL;
+    } else {
+        s->id = highscore_legacy_id(s);
+    }
+    return p;
+}
+
+// Encode 'count' scores as one block (room for RECORD_MAX each)
+// Returns: bytes of the block
+static size_t encode_scores(unsigned char* block, const HighScore scores[], int count) {
+    unsigned char* p = block + CODEC_BLOCK_HEAD;
+    int64_t prev = 0;
+    for (int i = 0; i < count; i++) {
+        p = put_score(p, &scores[i], &prev);
+    }
+    return codec_block_finish(block, (size_t)(p - block - CODEC_BLOCK_HEAD), (uint32_t)count);
+}
+
+/**
+ * Check the block at the start of 'avail' bytes and decode up to 'max'
+ * of its scores
+ * Returns: bytes of the block, or -1 if it is damaged; *count = scores
+ */
+static long decode_scores(const unsigned char* block, size_t avail, HighScore scores[], int max, int* count) {
+    uint32_t n;
+    long size = codec_block_check(block, avail, &n);
+    if (size == -1) return -1;
+    const unsigned char* p = block + CODEC_BLOCK_HEAD;
+    const unsigned char* end = block + size - CODEC_BLOCK_TAIL;
+    int64_t prev = 0;
+    HighScore s;
+    *count = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if ((p = get_score(p, end, &s, &prev)) == NULL) return -1;
+        if (*count < max) scores[(*count)++] = s;
+    }
+    return p == end ? size : -1;
+}
+
+// Read up to max_scores records from 'path' with a single read()
+// A file from before headers is a bare array of records
+// System calls used: open(), read(), close()
+static int read_scores(const char* path, HighScore scores[], int max_scores) {
+    unsigned char data[SNAPSHOT_BYTES];
+    HighScoreFileHeader header;
+
+    int fd = open(path, O_RDONLY);
     if (fd == -1) {
-        perror("Error opening highscore file");
-        return 0;
-    }
-    
-    // Read high scores
-    int count = 0;
-    ssize_t bytes_read;
-    
-    while (count < max_scores) {
-        bytes_read = read(fd, &scores[count], sizeof(HighScore));
-        if (bytes_read == 0) {
-            break; // End of file
+        if (errno != ENOENT) {
+            perror("Error opening highscore file");
         }
-        if (bytes_read == -1) {
+        return 0; // No file yet means no scores
+    }
+
+    size_t done = 0;
+    while (done < sizeof(data)) {
+        ssize_t n = read(fd, data + done, sizeof(data) - done);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1) {
             perror("Error reading highscore file");
-            close(fd);
-            return count;
-        }
-        if (bytes_read == sizeof(HighScore)) {
-            count++;
+            break;
         }
+        if (n == 0) break; // End of file
+        done += n;
     }
-    
     close(fd);
-    return count;
+
+    memcpy(&header, data, done < sizeof(header) ? done : sizeof(header));
+    if (done >= sizeof(header) && header.magic == HIGHSCORE_MAGIC) {
+        int count = 0;
+        if (header.version != HIGHSCORE_VERSION ||
+            decode_scores(data + sizeof(header), done - sizeof(header), scores, max_scores, &count) == -1) {
+            fprintf(stderr, "Highscore file is damaged; starting from an empty table\n");
+            return 0;
+        }
+        return count;
+    }
+
+    // Whole records only; a cut-off last record is ignored
+    size_t want = done / sizeof(HighScoreV1);
+    if (want > (size_t)max_scores) want = max_scores;
+    for (size_t i = 0; i < want; i++) {
+        HighScoreV1 old;
+        memcpy(&old, data + i * sizeof(old), sizeof(old));
+        highscore_from_v1(&scores[i], &old);
+    }
+    return (int)want;
 }
 
-// Save high scores to file
-// System calls used: open(), write(), close()
-int save_highscores(HighScore scores[], int count) {
-    int fd;
-    
-    // Open file for writing (create if doesn't exist, truncate if exists)
-    fd = open(HIGHSCORE_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+// Replace 'path' with the given records: one write() to a temporary file,
+// then rename() over the old one, so the table on disk is never half written
+// System calls used: open(), write(), fsync(), close(), rename(), unlink()
+static int write_scores(const char* path, const HighScore scores[], int count) {
+    char tmp_path[256];
+    unsigned char data[SNAPSHOT_BYTES];
+    HighScoreFileHeader header = { HIGHSCORE_MAGIC, HIGHSCORE_VERSION };
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", path, (int)getpid());
+
+    memcpy(data, &header, sizeof(header));
+    size_t bytes = sizeof(header) + encode_scores(data + sizeof(header), scores, count);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
     if (fd == -1) {
         perror("Error opening highscore file for writing");
         return -1;
     }
-    
-    // Write all scores
-    for (int i = 0; i < count; i++) {
-        ssize_t bytes_written = write(fd, &scores[i], sizeof(HighScore));
-        if (bytes_written != sizeof(HighScore)) {
+
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t n = write(fd, data + done, bytes - done);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) {
             perror("Error writing highscore");
             close(fd);
+            unlink(tmp_path);
             return -1;
         }
+        done += n;
+    }
+
+    // Data must be on disk before the new name points at it
+    if (fsync(fd) == -1 || close(fd) == -1) {
+        perror("Error writing highscore");
+        unlink(tmp_path);
+        return -1;
+    }
+    if (rename(tmp_path, path) == -1) {
+        perror("Error replacing highscore file");
+        unlink(tmp_path);
+        return -1;
     }
-    
-    close(fd);
     return 0;
 }
 
-// Add a new high score
-int add_highscore(const char* name, int score, int speed_level) {
-    HighScore scores[MAX_HIGHSCORES];
-    int count = load_highscores(scores, MAX_HIGHSCORES);
-    
-    // Create new score entry
-    HighScore new_score;
-    strncpy(new_score.name, name, MAX_NAME_LENGTH - 1);
-    new_score.name[MAX_NAME_LENGTH - 1] = '\0';
-    new_score.score = score;
-    new_score.speed_level = speed_level;
-    new_score.date = time(NULL);
-    
-    // Find insertion position
+// Journal kept next to the snapshot file ("highscores.dat.journal")
+static void journal_path(const char* path, char* buf, size_t size) {
+    snprintf(buf, size, "%s%s", path, HIGHSCORE_JOURNAL_SUFFIX);
+}
+
+// Put one score into a ranked list of 'count' scores (ties go after older ones)
+// A game already in the list (same id) is skipped, so a journal folded
+// twice after a crash does not show the same game twice
+// Returns: the new count
+static int merge_score(HighScore scores[], int count, const HighScore* entry) {
     int insert_pos = count;
     for (int i = 0; i < count; i++) {
-        if (score > scores[i].score) {
+        if (scores[i].id == entry->id) {
+            return count;
+        }
+        if (insert_pos == count && entry->score > scores[i].score) {
             insert_pos = i;
-            break;
         }
     }
-    
-    // If not in top 10, don't add
     if (insert_pos >= MAX_HIGHSCORES) {
-        return 0;
-    }
-    
-    // Shift scores down
-    for (int i = MAX_HIGHSCORES - 1; i > insert_pos; i--) {
-        if (i - 1 < count) {
-            scores[i] = scores[i - 1];
-        }
+        return count;
     }
-    
-    // Insert new score
-    scores[insert_pos] = new_score;
-    
-    // Update count
     if (count < MAX_HIGHSCORES) {
         count++;
     }
-    
-    // Save updated scores
-    return save_highscores(scores, count);
+    for (int i = count - 1; i > insert_pos; i--) {
+        scores[i] = scores[i - 1];
+    }
+    scores[insert_pos] = *entry;
+    return count;
 }
 
-// Check if score qualifies as high score
-int is_highscore(int score) {
+// Is an open journal from before blocks (a bare array of records)?
+// System calls used: pread()
+static int journal_is_legacy(int fd) {
+    uint32_t magic;
+    ssize_t n;
+    do {
+        n = pread(fd, &magic, sizeof(magic), 0);
+    } while (n == -1 && errno == EINTR);
+    return n == (ssize_t)sizeof(magic) && magic != CODEC_BLOCK_MAGIC;
+}
+
+/**
+ * Every record of an open journal, in the order they were appended
+ * A block that fails its check (a save cut short by a crash) is skipped
+ * up to the next block's magic. A journal from before blocks is read as
+ * a bare array of records.
+ * Returns: malloc'd array (free() it) or NULL on error; *count = records
+ * System calls used: fstat(), pread()
+ */
+HighScore* highscore_read_journal(int fd, int* count) {
+    struct stat file_stat;
+    *count = 0;
+    if (fstat(fd, &file_stat) == -1) return NULL;
+
+    size_t bytes = (size_t)file_stat.st_size;
+    unsigned char* data = malloc(bytes > 0 ? bytes : 1);
+    if (data == NULL) return NULL;
+    size_t done = 0;
+    while (done < bytes) {
+        ssize_t n = pread(fd, data + done, bytes - done, (off_t)done);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+
+    if (journal_is_legacy(fd)) {
+        int n = (int)(done / sizeof(HighScoreV1));
+        HighScore* records = malloc((n > 0 ? n : 1) * sizeof(HighScore));
+        if (records != NULL) {
+            for (int i = 0; i < n; i++) {
+                HighScoreV1 old;
+                memcpy(&old, data + i * sizeof(old), sizeof(old));
+                highscore_from_v1(&records[i], &old);
+            }
+            *count = n;
+        }
+        free(data);
+        return records;
+    }
+
+    // A record takes at least 4 bytes, so this is enough for all of them
+    HighScore* records = malloc((done / 4 + 1) * sizeof(HighScore));
+    if (records == NULL) {
+        free(data);
+        return NULL;
+    }
+    size_t off = 0;
+    while (off < done) {
+        int n;
+        long size = decode_scores(data + off, done - off, records + *count, (int)((done - off) / 4), &n);
+        if (size == -1) {
+            uint32_t magic;
+            do {
+                off++;
+                if (off + sizeof(magic) <= done) memcpy(&magic, data + off, sizeof(magic));
+            } while (off + sizeof(magic) <= done && magic != CODEC_BLOCK_MAGIC);
+            if (off + sizeof(magic) > done) break;
+            continue;
+        }
+        *count += n;
+        off += (size_t)size;
+    }
+    free(data);
+    return records;
+}
+
+// Merge every record of an open journal into the ranked list
+// System calls used: fstat(), pread()
+static int merge_journal(int fd, HighScore scores[], int count) {
+    int journal_count;
+    HighScore* journal = highscore_read_journal(fd, &journal_count);
+    if (journal == NULL) {
+        perror("Error reading highscore journal");
+        return count;
+    }
+    for (int i = 0; i < journal_count; i++) {
+        count = merge_score(scores, count, &journal[i]);
+    }
+    free(journal);
+    return count;
+}
+
+/**
+ * Fold the journal into the snapshot and the leaderboard, then empty it
+ * Takes the journal's exclusive lock, so no append or load runs meanwhile.
+ * wait: 0 = give up at once if another process holds the lock (it is
+ *       appending, loading or folding itself; the next save tries again)
+ * replace: if not NULL, these 'count' scores become the snapshot instead
+ *          of snapshot + journal (the journal still goes to the leaderboard)
+ * Returns: 0 on success (or skipped), -1 on error (the journal is kept)
+ * System calls used: open(), flock(), ftruncate(), close()
+ */
+static int fold_journal(const char* path, int wait, const HighScore* replace, int count) {
+    char jpath[256];
     HighScore scores[MAX_HIGHSCORES];
-    int count = load_highscores(scores, MAX_HIGHSCORES);
-    
-    if (count < MAX_HIGHSCORES) {
+    journal_path(path, jpath, sizeof(jpath));
+
+    int fd = open(jpath, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        perror("Error opening highscore journal");
+        return -1;
+    }
+    if (flock(fd, LOCK_EX | (wait ? 0 : LOCK_NB)) == -1) {
+        close(fd);
+        return (!wait && errno == EWOULDBLOCK) ? 0 : -1;
+    }
+
+    // The journal's games always reach the leaderboard, even when the snapshot is replaced
+    int journal_count;
+    HighScore* journal = highscore_read_journal(fd, &journal_count);
+    int result = journal != NULL ? leaderboard_add_run(path, journal, journal_count) : -1;
+    if (replace != NULL) {
+        if (count > MAX_HIGHSCORES) count = MAX_HIGHSCORES;
+        memcpy(scores, replace, count * sizeof(HighScore));
+    } else {
+        count = read_scores(path, scores, MAX_HIGHSCORES);
+        for (int i = 0; i < journal_count; i++) {
+            count = merge_score(scores, count, &journal[i]);
+        }
+    }
+    free(journal);
+
+    // Leaderboard and snapshot first: a crash before the truncate only
+    // leaves records that both recognise as already folded
+    if (result == 0) {
+        result = write_scores(path, scores, count);
+    }
+    if (result == 0 && ftruncate(fd, 0) == -1) {
+        perror("Error truncating highscore journal");
+        result = -1;
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+    return result;
+}
+
+/**
+ * Load the table at 'path': the snapshot plus every score still in the
+ * journal (missing files = empty table)
+ * Both are read under the journal's shared lock so a fold cannot swap
+ * the snapshot between the two reads.
+ * Returns: number of scores loaded
+ * System calls used: open(), flock(), close()
+ */
+int highscore_table_load(HighScoreTable* table, const char* path) {
+    char jpath[256];
+    journal_path(path, jpath, sizeof(jpath));
+    table->path = path;
+    table->pending_count = 0;
+
+    int fd = open(jpath, O_RDONLY);
+    if (fd != -1 && flock(fd, LOCK_SH) == -1) {
+        close(fd);
+        fd = -1;
+    }
+    table->count = read_scores(path, table->scores, MAX_HIGHSCORES);
+    if (fd != -1) {
+        table->count = merge_journal(fd, table->scores, table->count);
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+    return table->count;
+}
+
+// Check if score qualifies as high score
+int highscore_table_qualifies(const HighScoreTable* table, int score) {
+    if (table->count < MAX_HIGHSCORES) {
         return 1; // Less than 10 scores, any score qualifies
     }
-    
+
     // Check if better than lowest high score
-    return score > scores[count - 1].score;
+    return score > table->scores[table->count - 1].score;
 }
 
-// Display high scores (for terminal output after game)
-#include <string.h>
+// Insert a score in rank order (in memory; highscore_table_save() stores it)
+// Every game is saved - the leaderboard ranks all of them - even if it
+// does not make the top 10. Once MAX_HIGHSCORES games wait to be saved
+// they are saved first, to make room.
+// Returns: its rank in the top 10 (0 = best), -1 if it did not make it,
+//          -2 if waiting games could not be saved (this one is not inserted)
+int highscore_table_insert(HighScoreTable* table, const char* name, int score, int speed_level) {
+    HighScore entry;
+    if (table->pending_count >= MAX_HIGHSCORES && highscore_table_save(table) == -1) {
+        return -2;
+    }
+
+    memset(&entry, 0, sizeof(HighScore));
+    strncpy(entry.name, name, MAX_NAME_LENGTH - 1);
+    entry.score = score;
+    entry.speed_level = speed_level;
+    entry.date = time(NULL);
+    entry.id = highscore_new_id();
+
+    table->count = merge_score(table->scores, table->count, &entry);
+    int rank = -1;
+    for (int i = 0; i < table->count; i++) {
+        if (table->scores[i].id == entry.id) {
+            rank = i;
+            break;
+        }
+    }
+    table->pending[table->pending_count++] = entry;
+    return rank;
+}
+
+/**
+ * Store the scores inserted since the table was loaded
+ * They are appended to the journal as one block in one write() under a
+ * shared lock: any number of players can append at once, and nobody
+ * rewrites the whole file. Once the journal holds HIGHSCORE_FOLD_BYTES
+ * the saver folds it into the snapshot, unless another process is busy
+ * with it; at HIGHSCORE_FOLD_LIMIT bytes it waits for its turn. A
+ * journal from before blocks is folded first, so the two never mix.
+ * Returns: 0 on success, -1 on error
+ * System calls used: open(), flock(), pread(), write(), fstat(), close()
+ */
+int highscore_table_save(HighScoreTable* table) {
+    char jpath[256];
+    unsigned char block[CODEC_BLOCK_HEAD + MAX_HIGHSCORES * RECORD_MAX + CODEC_BLOCK_TAIL];
+    struct stat file_stat;
+    if (table->pending_count == 0) return 0;
+    journal_path(table->path, jpath, sizeof(jpath));
+
+    int fd = open(jpath, O_RDONLY);
+    if (fd != -1) {
+        int legacy = journal_is_legacy(fd);
+        close(fd);
+        if (legacy && fold_journal(table->path, 1, NULL, 0) == -1) return -1;
+    }
+
+    fd = open(jpath, O_WRONLY | O_APPEND | O_CREAT, 0644);
+    if (fd == -1) {
+        perror("Error opening highscore journal");
+        return -1;
+    }
+    if (flock(fd, LOCK_SH) == -1) {
+        perror("Error locking highscore journal");
+        close(fd);
+        return -1;
+    }
+
+    // One O_APPEND write: blocks from different players never interleave
+    size_t bytes = encode_scores(block, table->pending, table->pending_count);
+    ssize_t n;
+    do {
+        n = write(fd, block, bytes);
+    } while (n == -1 && errno == EINTR);
+    long size = fstat(fd, &file_stat) == 0 ? (long)file_stat.st_size : 0;
+    flock(fd, LOCK_UN);
+    close(fd);
+    if (n != (ssize_t)bytes) {
+        perror("Error writing highscore journal");
+        return -1;
+    }
+    table->pending_count = 0;
+
+    // Past the hard limit, wait for the lock so busy readers cannot put the fold off forever
+    if (size >= HIGHSCORE_FOLD_BYTES) {
+        return fold_journal(table->path, size >= HIGHSCORE_FOLD_LIMIT, NULL, 0);
+    }
+    return 0;
+}
+
+// Fold the journal into the snapshot now, waiting for other processes
+int highscore_compact(const char* path) {
+    return fold_journal(path, 1, NULL, 0);
+}
+
+// Load high scores from file
+int load_highscores(HighScore scores[], int max_scores) {
+    HighScoreTable table;
+    int count = highscore_table_load(&table, HIGHSCORE_FILE);
+    if (count > max_scores) count = max_scores;
+    memcpy(scores, table.scores, count * sizeof(HighScore));
+    return count;
+}
+
+// Save high scores to file (replaces the snapshot and empties the journal)
+int save_highscores(HighScore scores[], int count) {
+    return fold_journal(HIGHSCORE_FILE, 1, scores, count);
+}
+
+// Add a new high score (every score goes to the leaderboard)
+int add_highscore(const char* name, int score, int speed_level) {
+    HighScoreTable table;
+    highscore_table_load(&table, HIGHSCORE_FILE);
+    highscore_table_insert(&table, name, score, speed_level);
+    return highscore_table_save(&table);
+}
+
+// Check if score qualifies as high score
+int is_highscore(int score) {
+    HighScoreTable table;
+    highscore_table_load(&table, HIGHSCORE_FILE);
+    return highscore_table_qualifies(&table, score);
+}
 
 // Display high scores (for terminal output after game)
 void display_highscores() {
-    HighScore scores[MAX_HIGHSCORES];
-    int count = load_highscores(scores, MAX_HIGHSCORES);
+    HighScoreTable table;
+    highscore_table_load(&table, HIGHSCORE_FILE);
+    highscore_table_display(&table);
+}
+
+// Display a loaded table, one line per player (their best score)
+void highscore_table_display(const HighScoreTable* table) {
+    const HighScore* scores = table->scores;
+    int count = table->count;
 
     char printed_names[MAX_HIGHSCORES][32];  // store unique names
     int printed_count = 0;
@@ -1,20 +1,76 @@
 #ifndef HIGHSCORE_H
 #define HIGHSCORE_H
 
+#include <stdint.h>
 #include <time.h>
 
 #define MAX_HIGHSCORES 10
 #define MAX_NAME_LENGTH 20
 #define HIGHSCORE_FILE "highscores.dat"
+#define HIGHSCORE_JOURNAL_SUFFIX ".journal"    // new scores are appended here
+#define HIGHSCORE_FOLD_BYTES 2048               // journal size that triggers a fold
+#define HIGHSCORE_FOLD_LIMIT 8192               // ... that makes the saver wait to fold
+#define HIGHSCORE_MAGIC 0x02534889u             // "\x89HS\x02": no name starts with it
+#define HIGHSCORE_VERSION 2                     // 1: a bare HighScore array, no header
+#define HIGHSCORE_ID_FLAG 0x80                  // name length byte: a game id follows the date
 
+#define HIGHSCORE_LEGACY_ID (1ULL << 63)          // set in ids derived from a record's values
+
+// One saved game
+// id tells games apart: two games with the same name, score, speed and
+// second are still two games. Games saved before ids existed get one
+// derived from those values (HIGHSCORE_LEGACY_ID set).
 typedef struct {
     char name[MAX_NAME_LENGTH];
     int score;
     int speed_level;
     time_t date;
+    uint64_t id;
 } HighScore;
 
+// Record of the files from before game ids (bare arrays, leaderboard v1)
+typedef struct {
+    char name[MAX_NAME_LENGTH];
+    int score;
+    int speed_level;
+    time_t date;
+} HighScoreV1;
+
+// The high scores loaded into memory - read once, queried and updated in
+// memory; saving appends only the new scores to the journal
+//   highscores.dat          HighScoreFileHeader + one codec block holding
+//                           the sorted top-N snapshot, replaced by rename()
+//   highscores.dat.journal  one codec block per save since the last fold
+// A record is the name (length byte + characters), then score, speed and
+// date (as a delta from the record before) as zigzag varints, then the
+// game id as a varint; HIGHSCORE_ID_FLAG in the length byte says the id is
+// there (records from before ids end after the date). Files from before
+// blocks are still read and are rewritten by the next fold.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} HighScoreFileHeader;
+
+typedef struct {
+    const char* path;
+    HighScore scores[MAX_HIGHSCORES];   // best first (snapshot + journal)
+    int count;
+    HighScore pending[MAX_HIGHSCORES];  // inserted since load, not yet saved
+    int pending_count;
+} HighScoreTable;
+
 // Function prototypes
+int highscore_table_load(HighScoreTable* table, const char* path);
+int highscore_table_qualifies(const HighScoreTable* table, int score);
+int highscore_table_insert(HighScoreTable* table, const char* name, int score, int speed_level);
+int highscore_table_save(HighScoreTable* table);
+void highscore_table_display(const HighScoreTable* table);
+int highscore_compact(const char* path);
+HighScore* highscore_read_journal(int fd, int* count);
+uint64_t highscore_new_id(void);
+uint64_t highscore_legacy_id(const HighScore* s);
+void highscore_from_v1(HighScore* out, const HighScoreV1* in);
+
 int load_highscores(HighScore scores[], int max_scores);
 int save_highscores(HighScore scores[], int count);
 int add_highscore(const char* name, int score, int speed_level);
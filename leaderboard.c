@@ -0,0 +1,804 @@
+#include "leaderboard.h"
+#include "codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+
+#define WRITE_BUFFER (64 * 1024)
+
+// Ranking order: higher score first, then the older game; name, speed and
+// game id make it total, so the same game stored twice sorts next to itself
+static int rank_cmp(const HighScore* a, const HighScore* b) {
+    if (a->score != b->score) return a->score > b->score ? -1 : 1;
+    if (a->date != b->date) return a->date < b->date ? -1 : 1;
+    int c = strncmp(a->name, b->name, MAX_NAME_LENGTH);
+    if (c != 0) return c;
+    if (a->speed_level != b->speed_level) return a->speed_level < b->speed_level ? -1 : 1;
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+// Player order: by name, each player's best game first
+static int name_cmp(const HighScore* a, const HighScore* b) {
+    int c = strncmp(a->name, b->name, MAX_NAME_LENGTH);
+    return c != 0 ? c : rank_cmp(a, b);
+}
+
+static int rank_qsort(const void* a, const void* b) {
+    return rank_cmp(a, b);
+}
+
+static int name_qsort(const void* a, const void* b) {
+    return name_cmp(a, b);
+}
+
+// Two copies of one game; games that only look alike have different ids
+static int same_game(const HighScore* a, const HighScore* b) {
+    return a->id == b->id;
+}
+
+static int same_player(const HighScore* a, const HighScore* b) {
+    return strncmp(a->name, b->name, MAX_NAME_LENGTH) == 0;
+}
+
+// Board of a speed level; games at an unknown speed are only on board 0
+int leaderboard_board_of(int speed_level) {
+    return (speed_level >= 1 && speed_level <= LEADERBOARD_SPEEDS) ? speed_level : 0;
+}
+
+static int on_board(const HighScore* r, int board) {
+    return board == 0 || leaderboard_board_of(r->speed_level) == board;
+}
+
+// ---- Searching a run ----
+
+static const HighScore* section(const LeaderboardRun* run, uint64_t off) {
+    return (const HighScore*)(run->map + off);
+}
+
+// Games in a[0..n) (best first) that scored more than 'score'
+static long count_above(const HighScore* a, long n, int score) {
+    long lo = 0, hi = n;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (a[mid].score > score) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// First index in a[0..n) that does not sort before 'key'
+static long lower_bound(const HighScore* a, long n, const HighScore* key,
+                        int (*cmp)(const HighScore*, const HighScore*)) {
+    long lo = 0, hi = n;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (cmp(&a[mid], key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static int run_has_game(const LeaderboardRun* run, const HighScore* rec) {
+    const LeaderboardSection* s = &run->head->boards[0];
+    const HighScore* a = section(run, s->ranked_off);
+    long i = lower_bound(a, (long)s->ranked_count, rec, rank_cmp);
+    return i < (long)s->ranked_count && same_game(&a[i], rec);
+}
+
+// ---- Files ----
+
+static void file_name(char* buf, size_t size, const char* path, const char* suffix, unsigned long long seq) {
+    if (seq) snprintf(buf, size, "%s%s%llu", path, suffix, seq);
+    else snprintf(buf, size, "%s%s", path, suffix);
+}
+
+// Write everything or fail
+// System calls used: write()
+static int write_all(int fd, const void* buf, size_t len) {
+    const unsigned char* p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Sequence numbers of the live runs, oldest first
+// A manifest from before its CRC (LEADERBOARD_MAGIC, count) is still read
+// Returns: the number of runs (0 if there is no manifest yet), -1 on error
+// System calls used: open(), read(), close()
+static int read_manifest(const char* path, uint64_t seqs[LEADERBOARD_MAX_RUNS]) {
+    char name[256];
+    uint32_t head[3];
+    file_name(name, sizeof(name), path, LEADERBOARD_RUNS_SUFFIX, 0);
+
+    int fd = open(name, O_RDONLY);
+    if (fd == -1) return errno == ENOENT ? 0 : -1;
+    int count = -1;
+    size_t head_size = 0;
+    if (read(fd, head, 2 * sizeof(uint32_t)) == (ssize_t)(2 * sizeof(uint32_t))) {
+        if (head[0] == LEADERBOARD_MAGIC) {
+            head_size = 2 * sizeof(uint32_t);
+        } else if (head[0] == LEADERBOARD_RUNS_MAGIC &&
+                   read(fd, &head[2], sizeof(uint32_t)) == (ssize_t)sizeof(uint32_t)) {
+            head_size = sizeof(head);
+        }
+    }
+    if (head_size > 0 && head[1] <= LEADERBOARD_MAX_RUNS) {
+        ssize_t bytes = (ssize_t)(head[1] * sizeof(uint64_t));
+        if (read(fd, seqs, bytes) == bytes &&
+            (head_size != sizeof(head) || codec_crc32(seqs, (size_t)bytes) == head[2])) {
+            count = (int)head[1];
+        }
+    }
+    close(fd);
+    return count;
+}
+
+// Replace the manifest (temporary file + rename)
+// System calls used: open(), write(), fsync(), close(), rename()
+static int write_manifest(const char* path, const uint64_t* seqs, int count) {
+    char name[256], tmp[280];
+    uint32_t head[3] = { LEADERBOARD_RUNS_MAGIC, (uint32_t)count, codec_crc32(seqs, count * sizeof(uint64_t)) };
+    file_name(name, sizeof(name), path, LEADERBOARD_RUNS_SUFFIX, 0);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) return -1;
+    int ok = write_all(fd, head, sizeof(head)) == 0 &&
+             write_all(fd, seqs, count * sizeof(uint64_t)) == 0 && fsync(fd) == 0;
+    if (close(fd) == -1) ok = 0;
+    if (!ok || rename(tmp, name) == -1) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+// Do the sections of a run of 'size' bytes with records of 'record' bytes lie inside it?
+static int sections_fit(const LeaderboardRunHeader* head, size_t size, size_t record) {
+    for (int b = 0; b < LEADERBOARD_BOARDS; b++) {
+        const LeaderboardSection* s = &head->boards[b];
+        uint64_t limit = size / record;
+        if (s->ranked_count > limit || s->players_count > limit ||
+            s->ranked_off + s->ranked_count * record > size ||
+            s->leaders_off + s->players_count * record > size ||
+            s->players_off + s->players_count * record > size) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Header of the runs from before CRCs (versions 1 and 2)
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seq;
+    LeaderboardSection boards[LEADERBOARD_BOARDS];
+} LeaderboardRunHeaderV2;
+
+// Copy a run of an older version into memory in the current layout
+// A v1 run (records without ids) never holds two records with equal
+// values, so the id tie-break leaves every section in order
+// Returns: 0 on success, -1 if out of memory, -2 if the run is damaged
+static int convert_old_run(LeaderboardRun* run, const unsigned char* old, size_t old_size) {
+    LeaderboardRunHeaderV2 old_head;
+    LeaderboardRunHeader head;
+    if (old_size < sizeof(old_head)) return -2;
+    memcpy(&old_head, old, sizeof(old_head));
+    size_t record = old_head.version == 1 ? sizeof(HighScoreV1) : sizeof(HighScore);
+    memset(&head, 0, sizeof(head));
+    head.magic = LEADERBOARD_MAGIC;
+    head.version = LEADERBOARD_VERSION;
+    head.seq = old_head.seq;
+    head.record_size = sizeof(HighScore);
+    memcpy(head.boards, old_head.boards, sizeof(head.boards));
+    if (!sections_fit(&head, old_size, record)) return -2;
+
+    size_t records = 0;
+    for (int b = 0; b < LEADERBOARD_BOARDS; b++) {
+        records += head.boards[b].ranked_count + 2 * head.boards[b].players_count;
+    }
+    unsigned char* map = malloc(sizeof(head) + records * sizeof(HighScore));
+    if (map == NULL) return -1;
+
+    uint64_t off = sizeof(head);
+    for (int b = 0; b < LEADERBOARD_BOARDS; b++) {
+        LeaderboardSection* s = &head.boards[b];
+        uint64_t* offs[3] = { &s->ranked_off, &s->leaders_off, &s->players_off };
+        uint64_t counts[3] = { s->ranked_count, s->players_count, s->players_count };
+        for (int k = 0; k < 3; k++) {
+            for (uint64_t i = 0; i < counts[k]; i++) {
+                HighScore* out = (HighScore*)(map + off + i * sizeof(HighScore));
+                if (old_head.version == 1) {
+                    HighScoreV1 r;
+                    memcpy(&r, old + *offs[k] + i * record, sizeof(r));
+                    highscore_from_v1(out, &r);
+                } else {
+                    memcpy(out, old + *offs[k] + i * record, sizeof(HighScore));
+                }
+            }
+            *offs[k] = off;
+            off += counts[k] * sizeof(HighScore);
+        }
+    }
+    memcpy(map, &head, sizeof(head));
+    run->map = map;
+    run->size = (size_t)off;
+    run->head = (const LeaderboardRunHeader*)map;
+    run->converted = 1;
+    return 0;
+}
+
+// CRC of a run header, taken with its head_crc field zero
+static uint32_t header_crc(const LeaderboardRunHeader* head) {
+    LeaderboardRunHeader copy = *head;
+    copy.head_crc = 0;
+    return codec_crc32(&copy, sizeof(copy));
+}
+
+// Do the records of a mapped run still match the CRC they were written with?
+static int run_data_ok(const LeaderboardRun* run) {
+    if (run->converted) return 1;   // checked as well as its format allows
+    return codec_crc32(run->map + sizeof(LeaderboardRunHeader), run->size - sizeof(LeaderboardRunHeader)) ==
+           run->head->data_crc;
+}
+
+// Map one run read-only and check its header and that every section lies inside the file
+// Returns: 0 on success, -1 on an I/O error, -2 if the run is missing or damaged
+// System calls used: open(), fstat(), mmap(), munmap(), close()
+static int map_run(LeaderboardRun* run, const char* path, uint64_t seq) {
+    char name[256];
+    struct stat st;
+    file_name(name, sizeof(name), path, ".run", (unsigned long long)seq);
+    memset(run, 0, sizeof(LeaderboardRun));
+
+    int fd = open(name, O_RDONLY);
+    if (fd == -1) return errno == ENOENT ? -2 : -1;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(LeaderboardRunHeaderV2)) {
+        close(fd);
+        return -2;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    run->map = map;
+    run->size = (size_t)st.st_size;
+    run->head = map;
+
+    if (run->head->magic == LEADERBOARD_MAGIC && (run->head->version == 1 || run->head->version == 2)) {
+        int result = convert_old_run(run, map, (size_t)st.st_size);
+        munmap(map, (size_t)st.st_size);
+        return result;
+    }
+    if (run->size < sizeof(LeaderboardRunHeader) || run->head->magic != LEADERBOARD_MAGIC ||
+        run->head->version != LEADERBOARD_VERSION || run->head->record_size != sizeof(HighScore) ||
+        run->head->head_crc != header_crc(run->head) ||
+        !sections_fit(run->head, run->size, sizeof(HighScore))) {
+        munmap(run->map, run->size);
+        memset(run, 0, sizeof(LeaderboardRun));
+        return -2;
+    }
+    return 0;
+}
+
+/**
+ * Take a damaged run out of the leaderboard: the file is renamed to
+ * <run>.bad for inspection and the manifest no longer lists it. Its games
+ * are no longer ranked, but every later fold works again. Reported once,
+ * since the run is gone from the manifest afterwards.
+ * Returns: 0 on success, -1 if the manifest could not be rewritten
+ * System calls used: rename()
+ */
+static int drop_run(const char* path, uint64_t* seqs, int* n, int r) {
+    char name[256], bad[280];
+    file_name(name, sizeof(name), path, ".run", (unsigned long long)seqs[r]);
+    snprintf(bad, sizeof(bad), "%s.bad", name);
+    if (rename(name, bad) == -1 && errno != ENOENT) return -1;
+
+    memmove(&seqs[r], &seqs[r + 1], (size_t)(*n - r - 1) * sizeof(uint64_t));
+    if (write_manifest(path, seqs, *n - 1) == -1) return -1;
+    (*n)--;
+    fprintf(stderr, "Leaderboard run %s is damaged: moved to %s, its games are no longer ranked\n",
+            name, bad);
+    return 0;
+}
+
+static void unmap_run(LeaderboardRun* run) {
+    if (run->converted) free(run->map);
+    else if (run->map != NULL) munmap(run->map, run->size);
+    memset(run, 0, sizeof(LeaderboardRun));
+}
+
+static long run_games(const LeaderboardRun* run) {
+    return (long)run->head->boards[0].ranked_count;
+}
+
+// ---- Writing a run ----
+
+typedef struct {
+    int fd;
+    unsigned char* buf;
+    size_t len;
+    uint64_t off;               // file offset of the next record
+    uint32_t crc;               // of the records written so far
+    int failed;
+} RunWriter;
+
+static void writer_flush(RunWriter* w) {
+    if (!w->failed && w->len > 0 && write_all(w->fd, w->buf, w->len) == -1) w->failed = 1;
+    w->len = 0;
+}
+
+static void writer_put(RunWriter* w, const void* data, size_t size) {
+    if (w->len + size > WRITE_BUFFER) writer_flush(w);
+    memcpy(w->buf + w->len, data, size);
+    w->len += size;
+    w->off += size;
+}
+
+// Write one record with its padding zeroed, so the file (and its CRC)
+// holds nothing but the record's values
+static void writer_put_record(RunWriter* w, const HighScore* r) {
+    HighScore clean;
+    memset(&clean, 0, sizeof(clean));
+    memcpy(clean.name, r->name, MAX_NAME_LENGTH);
+    clean.score = r->score;
+    clean.speed_level = r->speed_level;
+    clean.date = r->date;
+    clean.id = r->id;
+    writer_put(w, &clean, sizeof(clean));
+    w->crc = codec_crc32_extend(w->crc, &clean, sizeof(clean));
+}
+
+// One input of a merge: per board, a best-first list and a by-name list
+typedef struct {
+    const HighScore* ranked[LEADERBOARD_BOARDS];
+    long ranked_n[LEADERBOARD_BOARDS];
+    const HighScore* players[LEADERBOARD_BOARDS];
+    long players_n[LEADERBOARD_BOARDS];
+} RunSource;
+
+static void source_of_run(RunSource* src, const LeaderboardRun* run) {
+    for (int b = 0; b < LEADERBOARD_BOARDS; b++) {
+        const LeaderboardSection* s = &run->head->boards[b];
+        src->ranked[b] = section(run, s->ranked_off);
+        src->ranked_n[b] = (long)s->ranked_count;
+        src->players[b] = section(run, s->players_off);
+        src->players_n[b] = (long)s->players_count;
+    }
+}
+
+/**
+ * k-way merge of sorted lists; a record that matches the previous one
+ * written (same(), e.g. the same game or the same player) is skipped
+ * collect: if not NULL, also receives every record written
+ * Returns: the number of records written
+ */
+static long merge_lists(RunWriter* w, const HighScore* const* lists, const long* counts, int k,
+                        int (*cmp)(const HighScore*, const HighScore*),
+                        int (*same)(const HighScore*, const HighScore*), HighScore* collect) {
+    long pos[LEADERBOARD_MAX_RUNS + 1] = { 0 };
+    const HighScore* last = NULL;
+    long written = 0;
+
+    for (;;) {
+        int best = -1;
+        for (int i = 0; i < k; i++) {
+            if (pos[i] < counts[i] &&
+                (best < 0 || cmp(&lists[i][pos[i]], &lists[best][pos[best]]) < 0)) {
+                best = i;
+            }
+        }
+        if (best < 0) break;
+        const HighScore* r = &lists[best][pos[best]++];
+        if (last != NULL && same(last, r)) continue;
+        writer_put_record(w, r);
+        if (collect != NULL) collect[written] = *r;
+        last = r;
+        written++;
+    }
+    return written;
+}
+
+// Merge the sources into run file 'seq' (written to a temporary name, then renamed)
+// System calls used: open(), write(), pwrite(), fsync(), close(), rename(), unlink()
+static int write_run(const char* path, uint64_t seq, const RunSource* src, int k) {
+    char name[256], tmp[280];
+    LeaderboardRunHeader head;
+    const HighScore* lists[LEADERBOARD_MAX_RUNS + 1];
+    long counts[LEADERBOARD_MAX_RUNS + 1];
+    RunWriter w = { -1, NULL, 0, 0, 0, 0 };
+
+    file_name(name, sizeof(name), path, ".run", (unsigned long long)seq);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", name);
+    memset(&head, 0, sizeof(head));
+    head.magic = LEADERBOARD_MAGIC;
+    head.version = LEADERBOARD_VERSION;
+    head.seq = seq;
+    head.record_size = sizeof(HighScore);
+
+    w.buf = malloc(WRITE_BUFFER);
+    w.fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (w.buf == NULL || w.fd == -1) {
+        free(w.buf);
+        if (w.fd != -1) close(w.fd);
+        return -1;
+    }
+    writer_put(&w, &head, sizeof(head));   // placeholder, rewritten at the end
+
+    for (int b = 0; b < LEADERBOARD_BOARDS && !w.failed; b++) {
+        LeaderboardSection* s = &head.boards[b];
+
+        for (int i = 0; i < k; i++) {
+            lists[i] = src[i].ranked[b];
+            counts[i] = src[i].ranked_n[b];
+        }
+        s->ranked_off = w.off;
+        s->ranked_count = (uint64_t)merge_lists(&w, lists, counts, k, rank_cmp, same_game, NULL);
+
+        // Each player's best: the first record per name in name order
+        long total = 0;
+        for (int i = 0; i < k; i++) {
+            lists[i] = src[i].players[b];
+            counts[i] = src[i].players_n[b];
+            total += counts[i];
+        }
+        HighScore* bests = malloc((total > 0 ? total : 1) * sizeof(HighScore));
+        if (bests == NULL) {
+            w.failed = 1;
+            break;
+        }
+        s->players_off = w.off;
+        s->players_count = (uint64_t)merge_lists(&w, lists, counts, k, name_cmp, same_player, bests);
+
+        qsort(bests, s->players_count, sizeof(HighScore), rank_qsort);
+        s->leaders_off = w.off;
+        for (uint64_t i = 0; i < s->players_count; i++) {
+            writer_put_record(&w, &bests[i]);
+        }
+        free(bests);
+    }
+    writer_flush(&w);
+    free(w.buf);
+    head.data_crc = w.crc;
+    head.head_crc = header_crc(&head);
+
+    int ok = !w.failed && pwrite(w.fd, &head, sizeof(head), 0) == (ssize_t)sizeof(head) && fsync(w.fd) == 0;
+    if (close(w.fd) == -1) ok = 0;
+    if (!ok || rename(tmp, name) == -1) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Add a batch of games as a new run, merging it with every newer run that
+ * is no more than twice its size (run sizes then at least double from
+ * newest to oldest). Call with the high score journal locked exclusively.
+ * Games already in a run are skipped, so folding the same journal twice
+ * (after a crash between the fold and the truncate) changes nothing.
+ * A run that is damaged (bad header, or records that fail their CRC when
+ * it is due to be merged) is moved aside with drop_run() and the fold
+ * goes on without it, so one bad file cannot keep the journal growing.
+ * Returns: 0 on success, -1 on error
+ * System calls used: unlink()
+ */
+int leaderboard_add_run(const char* path, const HighScore* records, int count) {
+    uint64_t seqs[LEADERBOARD_MAX_RUNS];
+    LeaderboardRun runs[LEADERBOARD_MAX_RUNS];
+    RunSource src[LEADERBOARD_MAX_RUNS + 1];
+    HighScore* fresh = NULL;
+    HighScore* by_name = NULL;
+    int result = -1;
+
+    int n = read_manifest(path, seqs);
+    if (n < 0) return -1;
+    int mapped = 0;
+    while (mapped < n) {
+        int status = map_run(&runs[mapped], path, seqs[mapped]);
+        if (status == -1 || (status == -2 && drop_run(path, seqs, &n, mapped) == -1)) goto done;
+        if (status == 0) mapped++;
+    }
+
+    fresh = malloc((count > 0 ? count : 1) * sizeof(HighScore));
+    by_name = malloc((count > 0 ? count : 1) * sizeof(HighScore));
+    if (fresh == NULL || by_name == NULL) goto done;
+    int fresh_n = 0;
+    for (int i = 0; i < count; i++) {
+        int known = 0;
+        for (int r = 0; r < n && !known; r++) {
+            known = run_has_game(&runs[r], &records[i]);
+        }
+        if (!known) fresh[fresh_n++] = records[i];
+    }
+    if (fresh_n == 0) {
+        result = 0;
+        goto done;
+    }
+
+    // The batch as a source: stable-sorted once, then split per board
+    // (board 0 holds everything, so its slices cover the whole arrays)
+    qsort(fresh, fresh_n, sizeof(HighScore), rank_qsort);
+    memcpy(by_name, fresh, fresh_n * sizeof(HighScore));
+    qsort(by_name, fresh_n, sizeof(HighScore), name_qsort);
+    HighScore* per_board = malloc((size_t)fresh_n * 2 * LEADERBOARD_BOARDS * sizeof(HighScore));
+    if (per_board == NULL) goto done;
+    RunSource* batch = &src[0];
+    for (int b = 0; b < LEADERBOARD_BOARDS; b++) {
+        HighScore* ranked = per_board + (size_t)fresh_n * 2 * b;
+        HighScore* players = ranked + fresh_n;
+        long rn = 0, pn = 0;
+        for (int i = 0; i < fresh_n; i++) {
+            if (on_board(&fresh[i], b)) ranked[rn++] = fresh[i];
+            if (on_board(&by_name[i], b)) players[pn++] = by_name[i];
+        }
+        batch->ranked[b] = ranked;
+        batch->ranked_n[b] = rn;
+        batch->players[b] = players;
+        batch->players_n[b] = pn;
+    }
+
+    // Newest runs that are not at least twice as big as what is being written join it;
+    // all of them if one is still in the old format, so it is rewritten
+    long size = fresh_n;
+    int first = n;
+    while (first > 0 && run_games(&runs[first - 1]) <= 2 * size) {
+        first--;
+        size += run_games(&runs[first]);
+    }
+    for (int r = 0; r < first; r++) {
+        if (runs[r].converted) {
+            first = 0;
+            break;
+        }
+    }
+    if (first == LEADERBOARD_MAX_RUNS) first--;
+    for (int r = first; r < n; r++) {
+        if (!run_data_ok(&runs[r])) {
+            // Damaged records are not carried into a new run: drop it and plan the merge again
+            free(per_board);
+            free(fresh);
+            free(by_name);
+            unmap_run(&runs[r]);
+            int dropped = drop_run(path, seqs, &n, r);
+            for (int k = 0; k < mapped; k++) {
+                if (k != r) unmap_run(&runs[k]);
+            }
+            return dropped == -1 ? -1 : leaderboard_add_run(path, records, count);
+        }
+        source_of_run(&src[1 + r - first], &runs[r]);
+    }
+
+    uint64_t seq = (n > 0 ? seqs[n - 1] : 0) + 1;
+    if (write_run(path, seq, src, 1 + n - first) == 0) {
+        uint64_t old[LEADERBOARD_MAX_RUNS];
+        memcpy(old, seqs, sizeof(seqs));
+        seqs[first] = seq;
+        if (write_manifest(path, seqs, first + 1) == 0) {
+            // Readers that still have the merged runs mapped keep their copy
+            for (int r = first; r < n; r++) {
+                char name[256];
+                file_name(name, sizeof(name), path, ".run", (unsigned long long)old[r]);
+                unlink(name);
+            }
+            result = 0;
+        }
+    }
+    free(per_board);
+
+done:
+    for (int r = 0; r < mapped; r++) unmap_run(&runs[r]);
+    free(fresh);
+    free(by_name);
+    return result;
+}
+
+// ---- Queries ----
+
+/**
+ * Open a consistent view: the live runs plus the journal records not
+ * folded yet, read under the journal's shared lock so no fold runs meanwhile
+ * Each game is counted once, even if a crashed fold left it in both
+ * Returns: 0 on success, -1 on error
+ * System calls used: open(), flock(), fstat(), pread(), close()
+ */
+int leaderboard_open(Leaderboard* lb, const char* path) {
+    char jpath[256];
+    uint64_t seqs[LEADERBOARD_MAX_RUNS];
+    memset(lb, 0, sizeof(Leaderboard));
+    file_name(jpath, sizeof(jpath), path, HIGHSCORE_JOURNAL_SUFFIX, 0);
+
+    int fd = open(jpath, O_RDONLY);
+    if (fd != -1 && flock(fd, LOCK_SH) == -1) {
+        close(fd);
+        fd = -1;
+    }
+
+    int result = -1;
+    int n = read_manifest(path, seqs);
+    if (n < 0) goto done;
+    // A damaged run is skipped here; the next fold moves it aside and reports it
+    for (int r = 0; r < n; r++) {
+        int status = map_run(&lb->runs[lb->run_count], path, seqs[r]);
+        if (status == -1) goto done;
+        if (status == 0) lb->run_count++;
+    }
+
+    if (fd != -1) {
+        lb->recent = highscore_read_journal(fd, &lb->recent_count);
+        if (lb->recent == NULL) goto done;
+        qsort(lb->recent, lb->recent_count, sizeof(HighScore), rank_qsort);
+
+        // A fold cut short before its truncate leaves games that a run already has
+        int kept = 0;
+        for (int i = 0; i < lb->recent_count; i++) {
+            const HighScore* r = &lb->recent[i];
+            int known = kept > 0 && same_game(&lb->recent[kept - 1], r);
+            for (int k = 0; k < lb->run_count && !known; k++) {
+                known = run_has_game(&lb->runs[k], r);
+            }
+            if (!known) lb->recent[kept++] = *r;
+        }
+        lb->recent_count = kept;
+    }
+    result = 0;
+
+done:
+    if (fd != -1) {
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+    if (result == -1) leaderboard_close(lb);
+    return result;
+}
+
+void leaderboard_close(Leaderboard* lb) {
+    for (int r = 0; r < lb->run_count; r++) unmap_run(&lb->runs[r]);
+    free(lb->recent);
+    memset(lb, 0, sizeof(Leaderboard));
+}
+
+// Games on a board
+long leaderboard_games(const Leaderboard* lb, int board) {
+    if (board < 0 || board >= LEADERBOARD_BOARDS) return 0;
+    long games = 0;
+    for (int r = 0; r < lb->run_count; r++) {
+        games += (long)lb->runs[r].head->boards[board].ranked_count;
+    }
+    for (int i = 0; i < lb->recent_count; i++) {
+        games += on_board(&lb->recent[i], board);
+    }
+    return games;
+}
+
+// Rank a score would have on a board: 1 + games with a higher score
+// O(log n) per run, plus the short unfolded journal
+long leaderboard_rank(const Leaderboard* lb, int board, int score) {
+    if (board < 0 || board >= LEADERBOARD_BOARDS) return 1;
+    long above = 0;
+    for (int r = 0; r < lb->run_count; r++) {
+        const LeaderboardSection* s = &lb->runs[r].head->boards[board];
+        above += count_above(section(&lb->runs[r], s->ranked_off), (long)s->ranked_count, score);
+    }
+    for (int i = 0; i < lb->recent_count && lb->recent[i].score > score; i++) {
+        above += on_board(&lb->recent[i], board);
+    }
+    return above + 1;
+}
+
+// FNV-1a of a player name, for the seen-names set of leaderboard_top()
+static unsigned name_hash(const char* name) {
+    unsigned h = 2166136261u;
+    for (int i = 0; i < MAX_NAME_LENGTH && name[i]; i++) {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return h;
+}
+
+/**
+ * Best k games on a board, or with per_player each player's best game
+ * Merges the heads of the runs' lists, so it reads O(k * runs) records;
+ * a player's best can appear once per run, later copies are skipped.
+ * Returns: number of entries in out (at most k, at most LEADERBOARD_MAX_TOP)
+ */
+int leaderboard_top(const Leaderboard* lb, int board, int per_player, HighScore* out, int k) {
+    const HighScore* lists[LEADERBOARD_MAX_RUNS + 1];
+    long counts[LEADERBOARD_MAX_RUNS + 1];
+    long pos[LEADERBOARD_MAX_RUNS + 1] = { 0 };
+    int seen[4 * LEADERBOARD_MAX_TOP];      // indices into out, -1 = empty
+    int seen_mask = 4 * LEADERBOARD_MAX_TOP - 1;
+
+    if (board < 0 || board >= LEADERBOARD_BOARDS || k <= 0) return 0;
+    if (k > LEADERBOARD_MAX_TOP) k = LEADERBOARD_MAX_TOP;
+    memset(seen, -1, sizeof(seen));
+
+    int lists_n = 0;
+    for (int r = 0; r < lb->run_count; r++) {
+        const LeaderboardSection* s = &lb->runs[r].head->boards[board];
+        lists[lists_n] = section(&lb->runs[r], per_player ? s->leaders_off : s->ranked_off);
+        counts[lists_n++] = (long)(per_player ? s->players_count : s->ranked_count);
+    }
+    HighScore* recent = malloc((lb->recent_count > 0 ? lb->recent_count : 1) * sizeof(HighScore));
+    if (recent == NULL) return 0;
+    long recent_n = 0;
+    for (int i = 0; i < lb->recent_count; i++) {
+        if (on_board(&lb->recent[i], board)) recent[recent_n++] = lb->recent[i];
+    }
+    lists[lists_n] = recent;
+    counts[lists_n++] = recent_n;
+
+    int found = 0;
+    while (found < k) {
+        int best = -1;
+        for (int i = 0; i < lists_n; i++) {
+            if (pos[i] < counts[i] &&
+                (best < 0 || rank_cmp(&lists[i][pos[i]], &lists[best][pos[best]]) < 0)) {
+                best = i;
+            }
+        }
+        if (best < 0) break;
+        const HighScore* r = &lists[best][pos[best]++];
+
+        if (per_player) {
+            unsigned slot = name_hash(r->name) & seen_mask;
+            int dup = 0;
+            while (seen[slot] >= 0 && !dup) {
+                dup = same_player(&out[seen[slot]], r);
+                slot = (slot + 1) & seen_mask;
+            }
+            if (dup) continue;
+            seen[slot] = found;
+        } else if (found > 0 && same_game(&out[found - 1], r)) {
+            continue;
+        }
+        out[found++] = *r;
+    }
+    free(recent);
+    return found;
+}
+
+// A player's best game on a board: one binary search per run
+// Returns: 1 and fills 'out' if the player has a game there, 0 if not
+int leaderboard_player_best(const Leaderboard* lb, int board, const char* name, HighScore* out) {
+    HighScore key;
+    int found = 0;
+    if (board < 0 || board >= LEADERBOARD_BOARDS) return 0;
+    memset(&key, 0, sizeof(key));
+    strncpy(key.name, name, MAX_NAME_LENGTH - 1);
+    key.score = 0x7fffffff;     // sorts before every real game of that name
+
+    for (int r = 0; r < lb->run_count; r++) {
+        const LeaderboardSection* s = &lb->runs[r].head->boards[board];
+        const HighScore* players = section(&lb->runs[r], s->players_off);
+        long i = lower_bound(players, (long)s->players_count, &key, name_cmp);
+        if (i < (long)s->players_count && same_player(&players[i], &key) &&
+            (!found || rank_cmp(&players[i], out) < 0)) {
+            *out = players[i];
+            found = 1;
+        }
+    }
+    for (int i = 0; i < lb->recent_count; i++) {
+        const HighScore* r = &lb->recent[i];
+        if (on_board(r, board) && same_player(r, &key) && (!found || rank_cmp(r, out) < 0)) {
+            *out = *r;
+            found = 1;
+        }
+    }
+    return found;
+}
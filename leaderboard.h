@@ -0,0 +1,86 @@
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "highscore.h"
+
+#define LEADERBOARD_MAGIC 0x424c4743u       // "CGLB" in the first four bytes
+#define LEADERBOARD_VERSION 3              // 1: no game ids, 2: no CRCs; both still read
+#define LEADERBOARD_RUNS_MAGIC 0x4d4c4743u  // "CGLM": manifest with a CRC
+#define LEADERBOARD_SPEEDS 6                // boards 1..6 = speed level (MIN_SPEED..MAX_SPEED)
+#define LEADERBOARD_BOARDS (LEADERBOARD_SPEEDS + 1)     // board 0 = every game
+#define LEADERBOARD_MAX_RUNS 64
+#define LEADERBOARD_RUNS_SUFFIX ".runs"     // manifest: which run files are live
+#define LEADERBOARD_MAX_TOP 1000            // longest list leaderboard_top() returns
+
+/**
+ * Full ranking of every game ever saved, next to the high score files
+ *   highscores.dat.runs      manifest: LEADERBOARD_RUNS_MAGIC, run count,
+ *                            CRC-32 of the sequence numbers, then the
+ *                            sequence numbers of the live runs
+ *   highscores.dat.run<N>    immutable sorted run (below)
+ * Each fold of the high score journal becomes a new run; runs of similar
+ * size are merged right away (each run at least twice the size of the
+ * next newer one), so there are O(log n) runs and every game is rewritten
+ * O(log n) times over its life. A query binary-searches each run and
+ * adds the journal records not folded yet.
+ *
+ * Run file: LeaderboardRunHeader, then per board three HighScore arrays
+ *   ranked    every game, best first (score desc, then oldest first;
+ *             name, speed and game id break the remaining ties)
+ *   leaders   each player's best game in this run, best first
+ *   players   the same bests sorted by name
+ * Records stay fixed-size HighScores (padding zeroed) rather than varint
+ * blocks: queries binary-search them in the mapped file without decoding.
+ * The header records their size, so a build with another layout (e.g. a
+ * 32-bit time_t) rejects the run instead of misreading it; the magic does
+ * the same for the other byte order. The header's CRC is checked when a
+ * run is mapped, and the records' CRC when the run is merged (read whole).
+ */
+typedef struct {
+    uint64_t ranked_off;
+    uint64_t ranked_count;
+    uint64_t leaders_off;
+    uint64_t players_off;
+    uint64_t players_count;     // also the length of leaders
+} LeaderboardSection;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t seq;
+    uint32_t record_size;       // sizeof(HighScore) of the writer
+    uint32_t head_crc;          // CRC-32 of this header with head_crc = 0
+    uint32_t data_crc;          // CRC-32 of every record after the header
+    uint32_t unused;            // zero
+    LeaderboardSection boards[LEADERBOARD_BOARDS];
+} LeaderboardRunHeader;
+
+// One run mapped into memory (an older run is converted into a malloc'd copy)
+typedef struct {
+    unsigned char* map;
+    size_t size;
+    const LeaderboardRunHeader* head;
+    int converted;              // map is malloc'd, not mmap'd
+} LeaderboardRun;
+
+// A consistent view of the leaderboard (runs + unfolded journal)
+typedef struct {
+    LeaderboardRun runs[LEADERBOARD_MAX_RUNS];
+    int run_count;
+    HighScore* recent;          // journal records, best first
+    int recent_count;
+} Leaderboard;
+
+// Function prototypes
+int leaderboard_open(Leaderboard* lb, const char* path);
+void leaderboard_close(Leaderboard* lb);
+long leaderboard_games(const Leaderboard* lb, int board);
+long leaderboard_rank(const Leaderboard* lb, int board, int score);
+int leaderboard_top(const Leaderboard* lb, int board, int per_player, HighScore* out, int k);
+int leaderboard_player_best(const Leaderboard* lb, int board, const char* name, HighScore* out);
+int leaderboard_add_run(const char* path, const HighScore* records, int count);
+int leaderboard_board_of(int speed_level);
+
+#endif
@@ -0,0 +1,444 @@
+#include "highscore.h"
+#include "statistics.h"
+#include "game.h"
+#include "fish_kernels.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+
+#define DEFAULT_REPS 200
+#define DEFAULT_WARMUP 20
+#define DEFAULT_THRESHOLD 15.0      // % slower median that counts as a regression
+#define TARGET_REP_NS 50000LL       // a repetition runs the operation this long (at least once)
+#define MAX_INNER 100000
+#define MAX_RESULTS 64
+#define RENDER_FRAMES 500           // frames per size for the rendered-frame benchmark
+
+// Microbenchmarks of the data files, the fish pass and one rendered frame
+// Every benchmark runs at a few data sizes: warmup repetitions first, then
+// 'reps' timed repetitions of 'inner' calls each (enough calls to last
+// TARGET_REP_NS); the median, p99, mean and minimum of the time per call
+// are printed as JSON, one result per line. --compare reads such a file
+// and flags every benchmark whose median got slower than the threshold.
+
+typedef struct {
+    char name[32];
+    char param[32];             // data size, e.g. "games=10000"
+    long reps;
+    long inner;                 // calls per timed repetition
+    double median_ns;
+    double p99_ns;
+    double mean_ns;
+    double min_ns;
+} BenchResult;
+
+typedef struct {
+    long reps;
+    long warmup;
+    int quick;
+    double threshold;
+    const char* out_path;
+    const char* baseline;
+    char game[PATH_MAX];        // catch_and_go, for the rendered frame
+    char render_bench[PATH_MAX];
+} BenchConfig;
+
+typedef void (*BenchOp)(long i);
+
+static BenchResult results[MAX_RESULTS];
+static int result_count = 0;
+
+// State the operations work on
+static HighScore scores[MAX_HIGHSCORES];
+static GameStats history[MAX_LOG_ENTRIES];
+static GameStats bench_game;
+static int* fish_pos;
+static int* fish_dir;
+static int* fish_row;
+static int* fish_fps;
+static int* fish_counter;
+static unsigned char* fish_alive;
+static int fish_count;
+
+static int cmp_double(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Time one operation: calibrate the calls per repetition, warm up, then
+ * record 'reps' repetitions and keep their time per call
+ */
+static void run_bench(const BenchConfig* cfg, const char* name, const char* param, BenchOp op) {
+    if (result_count == MAX_RESULTS) return;
+    long long t0 = sched_clock_ns();
+    op(0);
+    long long once = sched_clock_ns() - t0;
+    long inner = once > 0 ? (long)(TARGET_REP_NS / once) : MAX_INNER;
+    if (inner < 1) inner = 1;
+    if (inner > MAX_INNER) inner = MAX_INNER;
+
+    long i = 1;
+    for (long w = 0; w < cfg->warmup * inner; w++) op(i++);
+    double* samples = malloc((size_t)cfg->reps * sizeof(double));
+    if (samples == NULL) return;
+    double total = 0;
+    for (long r = 0; r < cfg->reps; r++) {
+        t0 = sched_clock_ns();
+        for (long k = 0; k < inner; k++) op(i++);
+        samples[r] = (double)(sched_clock_ns() - t0) / inner;
+        total += samples[r];
+    }
+    qsort(samples, (size_t)cfg->reps, sizeof(double), cmp_double);
+
+    BenchResult* res = &results[result_count++];
+    snprintf(res->name, sizeof(res->name), "%s", name);
+    snprintf(res->param, sizeof(res->param), "%s", param);
+    res->reps = cfg->reps;
+    res->inner = inner;
+    res->median_ns = samples[(cfg->reps - 1) * 50 / 100];
+    res->p99_ns = samples[(cfg->reps - 1) * 99 / 100];
+    res->mean_ns = total / cfg->reps;
+    res->min_ns = samples[0];
+    free(samples);
+    fprintf(stderr, "  %-20s %-14s median %12.1f ns  p99 %12.1f ns\n", name, param, res->median_ns, res->p99_ns);
+}
+
+// Remove the data files of the previous size (the bench runs in its own directory)
+// System calls used: opendir(), readdir(), unlink()
+static void clear_data(void) {
+    DIR* dir = opendir(".");
+    struct dirent* e;
+    if (dir == NULL) return;
+    while ((e = readdir(dir)) != NULL) {
+        if (strncmp(e->d_name, HIGHSCORE_FILE, strlen(HIGHSCORE_FILE)) == 0 ||
+            strncmp(e->d_name, STATS_FILE, strlen(STATS_FILE)) == 0) {
+            unlink(e->d_name);
+        }
+    }
+    closedir(dir);
+}
+
+static void fill_game(GameStats* g, long i) {
+    memset(g, 0, sizeof(GameStats));
+    g->timestamp = time(NULL);
+    snprintf(g->player_name, sizeof(g->player_name), "player%ld", i % 100);
+    g->final_score = (int)((i * 7919) % 400) - 50;
+    g->fish_caught = (int)(i % 40);
+    g->hooks_missed = (int)(i % 7);
+    g->speed_level = MIN_SPEED + (int)(i % (MAX_SPEED - MIN_SPEED + 1));
+    g->lives_remaining = (int)(i % 4);
+    g->game_duration = 20 + (int)(i % 100);
+}
+
+// --- operations ---
+
+static void op_load_highscores(long i) {
+    (void)i;
+    load_highscores(scores, MAX_HIGHSCORES);
+}
+
+static void op_add_highscore(long i) {
+    add_highscore("bench", (int)((i * 7919) % 400), MIN_SPEED + (int)(i % 6));
+}
+
+static void op_is_highscore(long i) {
+    is_highscore((int)((i * 7919) % 400));
+}
+
+static void op_log_game_stats(long i) {
+    fill_game(&bench_game, i);
+    log_game_stats(&bench_game);
+}
+
+static void op_load_game_history(long i) {
+    (void)i;
+    load_game_history(history, MAX_LOG_ENTRIES);
+}
+
+static void op_display_player_stats(long i) {
+    char name[20];
+    snprintf(name, sizeof(name), "player%ld", i % 100);
+    display_player_stats(name);
+}
+
+// One frame of the fish pass: move every due fish, then test the hook
+static void op_fish_pass(long i) {
+    const FishKernels* k = fish_kernels_get();
+    k->move(fish_pos, fish_dir, fish_fps, fish_counter, fish_count, 79, 74);
+    k->find_hit(fish_pos, fish_row, fish_alive, fish_count, (int)(i % 80), 3 + (int)(i % 18));
+}
+
+// --- suites ---
+
+static void bench_highscores(const BenchConfig* cfg) {
+    static const long full[] = { 100, 1000, 10000 };
+    int sizes = cfg->quick ? 2 : 3;
+    for (int s = 0; s < sizes; s++) {
+        char param[32];
+        clear_data();
+        for (long i = 0; i < full[s]; i++) {
+            add_highscore("seed", (int)((i * 7919) % 400), MIN_SPEED + (int)(i % 6));
+        }
+        snprintf(param, sizeof(param), "games=%ld", full[s]);
+        run_bench(cfg, "load_highscores", param, op_load_highscores);
+        run_bench(cfg, "is_highscore", param, op_is_highscore);
+        run_bench(cfg, "add_highscore", param, op_add_highscore);
+    }
+}
+
+static void bench_stats(const BenchConfig* cfg) {
+    static const long full[] = { 1000, 10000, 100000 };
+    int sizes = cfg->quick ? 2 : 3;
+    GameStats* batch = malloc(4096 * sizeof(GameStats));
+    if (batch == NULL) return;
+    for (int s = 0; s < sizes; s++) {
+        char param[32];
+        clear_data();
+        for (long done = 0; done < full[s]; ) {
+            int n = full[s] - done < 4096 ? (int)(full[s] - done) : 4096;
+            for (int i = 0; i < n; i++) fill_game(&batch[i], done + i);
+            if (log_game_stats_batch(batch, n) != n) break;
+            done += n;
+        }
+        snprintf(param, sizeof(param), "games=%ld", full[s]);
+        run_bench(cfg, "load_game_history", param, op_load_game_history);
+
+        // the screen goes to /dev/null, flushed inside the timing
+        fflush(stdout);
+        int saved = dup(STDOUT_FILENO);
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (saved != -1 && null_fd != -1) {
+            dup2(null_fd, STDOUT_FILENO);
+            run_bench(cfg, "display_player_stats", param, op_display_player_stats);
+            fflush(stdout);
+            dup2(saved, STDOUT_FILENO);
+        }
+        if (null_fd != -1) close(null_fd);
+        if (saved != -1) close(saved);
+
+        run_bench(cfg, "log_game_stats", param, op_log_game_stats);
+    }
+    free(batch);
+}
+
+static void bench_fish(const BenchConfig* cfg) {
+    static const int full[] = { 16, 1024, 65536 };
+    int sizes = cfg->quick ? 2 : 3;
+    for (int s = 0; s < sizes; s++) {
+        int n = full[s];
+        char param[48];
+        fish_pos = malloc((size_t)n * sizeof(int));
+        fish_dir = malloc((size_t)n * sizeof(int));
+        fish_row = malloc((size_t)n * sizeof(int));
+        fish_fps = malloc((size_t)n * sizeof(int));
+        fish_counter = calloc((size_t)n, sizeof(int));
+        fish_alive = malloc((size_t)n);
+        if (fish_pos && fish_dir && fish_row && fish_fps && fish_counter && fish_alive) {
+            for (int i = 0; i < n; i++) {
+                fish_pos[i] = (i * 37) % 75;
+                fish_dir[i] = (i & 1) ? 1 : -1;
+                fish_row[i] = 3 + i % 18;
+                fish_fps[i] = 1 + i % 4;
+                fish_alive[i] = (i % 5) != 0;
+            }
+            fish_count = n;
+            snprintf(param, sizeof(param), "fish=%d/%s", n, fish_kernels_get()->name);
+            run_bench(cfg, "fish_pass", param, op_fish_pass);
+        }
+        free(fish_pos);
+        free(fish_dir);
+        free(fish_row);
+        free(fish_fps);
+        free(fish_counter);
+        free(fish_alive);
+    }
+}
+
+/**
+ * One full rendered frame: game step, border and render_frame() inside a
+ * pty, as measured by render_bench (its frame_us p50/p99/mean)
+ * System calls used: popen(), pclose() (fork/exec of render_bench)
+ */
+static void bench_render(const BenchConfig* cfg) {
+    static const char* full[] = { "80x24", "120x40", "200x60" };
+    int sizes = cfg->quick ? 1 : 3;
+    if (result_count + sizes > MAX_RESULTS) return;
+    for (int s = 0; s < sizes; s++) {
+        char cmd[2 * PATH_MAX + 128];
+        char line[512];
+        snprintf(cmd, sizeof(cmd), "'%s' --frames %d --sizes %s --game '%s' 2>/dev/null",
+                 cfg->render_bench, RENDER_FRAMES, full[s], cfg->game);
+        FILE* p = popen(cmd, "r");
+        if (p == NULL) break;
+        BenchResult res;
+        int found = 0;
+        memset(&res, 0, sizeof(res));
+        while (fgets(line, sizeof(line), p) != NULL) {
+            const char* m = strstr(line, "\"frame_us\": {");
+            double max_us;
+            if (m != NULL && sscanf(m, "\"frame_us\": {\"mean\": %lf, \"p50\": %lf, \"p99\": %lf, \"max\": %lf",
+                                    &res.mean_ns, &res.median_ns, &res.p99_ns, &max_us) == 4) {
+                found = 1;
+            }
+        }
+        if (pclose(p) != 0 || !found) {
+            fprintf(stderr, "  render_frame %-8s skipped (needs %s and a pty)\n", full[s], cfg->render_bench);
+            continue;
+        }
+        snprintf(res.name, sizeof(res.name), "render_frame");
+        snprintf(res.param, sizeof(res.param), "term=%s", full[s]);
+        res.reps = RENDER_FRAMES;
+        res.inner = 1;
+        res.median_ns *= 1000;
+        res.p99_ns *= 1000;
+        res.mean_ns *= 1000;
+        res.min_ns = res.median_ns;     // render_bench does not report a minimum
+        results[result_count++] = res;
+        fprintf(stderr, "  %-20s %-14s median %12.1f ns  p99 %12.1f ns\n", res.name, res.param, res.median_ns, res.p99_ns);
+    }
+}
+
+// --- output and comparison ---
+
+static void print_json(FILE* out, const BenchConfig* cfg) {
+    fprintf(out, "{\n  \"suite\": \"catch_and_go\",\n  \"reps\": %ld,\n  \"warmup\": %ld,\n  \"quick\": %s,\n  \"results\": [\n",
+            cfg->reps, cfg->warmup, cfg->quick ? "true" : "false");
+    for (int i = 0; i < result_count; i++) {
+        const BenchResult* r = &results[i];
+        fprintf(out, "    {\"name\": \"%s\", \"param\": \"%s\", \"reps\": %ld, \"inner\": %ld, "
+                     "\"median_ns\": %.1f, \"p99_ns\": %.1f, \"mean_ns\": %.1f, \"min_ns\": %.1f}%s\n",
+                r->name, r->param, r->reps, r->inner, r->median_ns, r->p99_ns, r->mean_ns, r->min_ns,
+                i + 1 < result_count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+/**
+ * Compare the medians with a baseline written by an earlier run
+ * Returns: number of regressions, or -1 if the baseline cannot be read
+ */
+static int compare_baseline(const BenchConfig* cfg) {
+    FILE* f = fopen(cfg->baseline, "r");
+    char line[512];
+    int regressions = 0;
+    if (f == NULL) {
+        perror("Error opening baseline");
+        return -1;
+    }
+    fprintf(stderr, "\nCompared with %s (regression: median more than %.0f%% slower)\n", cfg->baseline, cfg->threshold);
+    fprintf(stderr, "  %-20s %-14s %14s %14s %9s\n", "benchmark", "param", "baseline ns", "now ns", "change");
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char name[32], param[32];
+        double median;
+        const char* m = strstr(line, "{\"name\": \"");
+        if (m == NULL || sscanf(m, "{\"name\": \"%31[^\"]\", \"param\": \"%31[^\"]\"", name, param) != 2) continue;
+        const char* med = strstr(line, "\"median_ns\": ");
+        if (med == NULL || sscanf(med, "\"median_ns\": %lf", &median) != 1) continue;
+        for (int i = 0; i < result_count; i++) {
+            const BenchResult* r = &results[i];
+            if (strcmp(r->name, name) != 0 || strcmp(r->param, param) != 0) continue;
+            double change = median > 0 ? (r->median_ns - median) * 100.0 / median : 0.0;
+            int slower = change > cfg->threshold;
+            regressions += slower;
+            fprintf(stderr, "  %-20s %-14s %14.1f %14.1f %+8.1f%%%s\n", name, param, median, r->median_ns,
+                    change, slower ? "  REGRESSION" : "");
+        }
+    }
+    fclose(f);
+    fprintf(stderr, "%d regression(s)\n", regressions);
+    return regressions;
+}
+
+// Make a private directory for the data files and move into it
+// System calls used: mkdtemp(), chdir()
+static int enter_scratch(char* dir, size_t size) {
+    snprintf(dir, size, "/tmp/catch-bench-XXXXXX");
+    if (mkdtemp(dir) == NULL || chdir(dir) == -1) {
+        perror("Error creating bench directory");
+        return -1;
+    }
+    return 0;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--reps N] [--warmup N] [--quick] [--out FILE] [--compare BASELINE]\n"
+                    "          [--threshold PCT] [--game ./catch_and_go] [--render-bench ./render_bench]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig cfg;
+    const char* game = "./catch_and_go";
+    const char* render = "./render_bench";
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.reps = DEFAULT_REPS;
+    cfg.warmup = DEFAULT_WARMUP;
+    cfg.threshold = DEFAULT_THRESHOLD;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            cfg.reps = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            cfg.warmup = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            cfg.quick = 1;
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            cfg.out_path = argv[++i];
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            cfg.baseline = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            cfg.threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--game") == 0 && i + 1 < argc) {
+            game = argv[++i];
+        } else if (strcmp(argv[i], "--render-bench") == 0 && i + 1 < argc) {
+            render = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (cfg.reps < 1 || cfg.warmup < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (realpath(game, cfg.game) == NULL) snprintf(cfg.game, sizeof(cfg.game), "%s", game);
+    if (realpath(render, cfg.render_bench) == NULL) snprintf(cfg.render_bench, sizeof(cfg.render_bench), "%s", render);
+
+    // Output paths are relative to where we were started
+    FILE* out = stdout;
+    if (cfg.out_path != NULL && (out = fopen(cfg.out_path, "w")) == NULL) {
+        perror("Error opening output file");
+        return 1;
+    }
+    FILE* baseline = cfg.baseline != NULL ? fopen(cfg.baseline, "r") : NULL;
+    if (cfg.baseline != NULL && baseline == NULL) {
+        perror("Error opening baseline");
+        return 1;
+    }
+    char baseline_path[PATH_MAX];
+    if (baseline != NULL) {
+        fclose(baseline);
+        if (realpath(cfg.baseline, baseline_path) != NULL) cfg.baseline = baseline_path;
+    }
+
+    char scratch[64];
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) == NULL || enter_scratch(scratch, sizeof(scratch)) == -1) return 1;
+    fprintf(stderr, "Benchmarks in %s (%ld reps, %ld warmup)\n", scratch, cfg.reps, cfg.warmup);
+    bench_highscores(&cfg);
+    bench_stats(&cfg);
+    bench_fish(&cfg);
+    bench_render(&cfg);
+    clear_data();
+    if (chdir(cwd) == 0) rmdir(scratch);
+
+    print_json(out, &cfg);
+    if (out != stdout) fclose(out);
+    int regressions = cfg.baseline != NULL ? compare_baseline(&cfg) : 0;
+    return regressions != 0 ? 1 : 0;
+}
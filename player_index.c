@@ -0,0 +1,287 @@
+#include "player_index.h"
+#include "stats_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+
+static const int window_sizes[PLAYER_WINDOWS] = PLAYER_WINDOW_SIZES;
+
+static size_t file_size(uint32_t capacity) {
+    return sizeof(PlayerIndexHeader) + (size_t)capacity * sizeof(PlayerTotals);
+}
+
+// Zero-padded copy of a name, so keys compare with memcmp()
+static void make_key(char key[PLAYER_NAME_LEN], const char* name) {
+    memset(key, 0, PLAYER_NAME_LEN);
+    memcpy(key, name, strnlen(name, PLAYER_NAME_LEN));
+}
+
+// FNV-1a over the padded key
+static uint32_t hash_key(const char key[PLAYER_NAME_LEN]) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < PLAYER_NAME_LEN; i++) {
+        h = (h ^ (unsigned char)key[i]) * 16777619u;
+    }
+    return h;
+}
+
+// Slot holding 'key', or the empty slot where it would go
+static PlayerTotals* probe(const PlayerIndex* ix, const char key[PLAYER_NAME_LEN]) {
+    uint32_t mask = ix->head->capacity - 1;
+    uint32_t i = hash_key(key) & mask;
+    while (ix->slots[i].games != 0 && memcmp(ix->slots[i].name, key, PLAYER_NAME_LEN) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &ix->slots[i];
+}
+
+// Map the whole file as it is now (another process may have grown it)
+// System calls used: fstat(), mmap(), munmap()
+static int map_file(PlayerIndex* ix) {
+    struct stat st;
+    if (fstat(ix->fd, &st) == -1) return -1;
+    if (ix->head != NULL && (size_t)st.st_size == ix->map_size) return 0;
+    if (ix->head != NULL) munmap(ix->head, ix->map_size);
+    ix->head = NULL;
+    ix->slots = NULL;
+    ix->map_size = 0;
+    if ((size_t)st.st_size < file_size(PLAYER_INDEX_MIN_SLOTS)) return 0;   // new or cut short
+
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, ix->fd, 0);
+    if (map == MAP_FAILED) return -1;
+    ix->map_size = (size_t)st.st_size;
+    ix->head = map;
+    ix->slots = (PlayerTotals*)((unsigned char*)map + sizeof(PlayerIndexHeader));
+    return 0;
+}
+
+// Header agrees with the file it sits in
+static int valid(const PlayerIndex* ix) {
+    const PlayerIndexHeader* h = ix->head;
+    return h != NULL && h->magic == PLAYER_INDEX_MAGIC && h->version == PLAYER_INDEX_VERSION &&
+           h->capacity >= PLAYER_INDEX_MIN_SLOTS && (h->capacity & (h->capacity - 1)) == 0 &&
+           file_size(h->capacity) == ix->map_size && h->used < h->capacity;
+}
+
+// Resize the file to 'capacity' empty slots (call with the lock held)
+// The magic stays cleared until the caller has filled the table again
+// System calls used: ftruncate()
+static int reset_file(PlayerIndex* ix, uint32_t capacity) {
+    if (ix->head != NULL) ix->head->magic = 0;
+    if (ftruncate(ix->fd, (off_t)file_size(capacity)) == -1 || map_file(ix) == -1 || ix->head == NULL) {
+        return -1;
+    }
+    memset(ix->head, 0, ix->map_size);
+    ix->head->version = PLAYER_INDEX_VERSION;
+    ix->head->capacity = capacity;
+    return 0;
+}
+
+// Double the table and rehash every player into it (call with the lock held)
+static int grow(PlayerIndex* ix) {
+    uint32_t used = ix->head->used;
+    uint64_t records = ix->head->records;
+    PlayerTotals* players = malloc((size_t)used * sizeof(PlayerTotals));
+    if (players == NULL) return -1;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < ix->head->capacity && n < used; i++) {
+        if (ix->slots[i].games != 0) players[n++] = ix->slots[i];
+    }
+    if (reset_file(ix, ix->head->capacity * 2) == -1) {
+        free(players);
+        return -1;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        *probe(ix, players[i].name) = players[i];
+    }
+    free(players);
+    ix->head->used = n;
+    ix->head->records = records;
+    ix->head->magic = PLAYER_INDEX_MAGIC;
+    return 0;
+}
+
+// Add games to their player's totals, without touching 'records'
+// More than one game is a compacted summary: its counters are sums
+static int count_games(PlayerIndex* ix, const GameStats* game, int64_t games) {
+    char key[PLAYER_NAME_LEN];
+    make_key(key, game->player_name);
+    PlayerTotals* p = probe(ix, key);
+    if (p->games == 0) {
+        if ((ix->head->used + 1) * 4 > ix->head->capacity * 3) {
+            if (grow(ix) == -1) return -1;
+            p = probe(ix, key);
+        }
+        memcpy(p->name, key, PLAYER_NAME_LEN);
+        p->best_score = game->final_score;
+        ix->head->used++;
+    } else if (game->final_score > p->best_score) {
+        p->best_score = game->final_score;
+    }
+    p->games += games;
+    p->total_score += (int64_t)game->final_score * games;
+    p->caught += game->fish_caught;
+    p->missed += game->hooks_missed;
+    p->duration += game->game_duration;
+    for (int64_t i = 0; i < games && i < PLAYER_RECENT_GAMES; i++) {
+        player_recent_add(p, game->final_score);
+    }
+    return 0;
+}
+
+// Count the games of the log from 'records' on (call with the lock held)
+// If the log is shorter than that, or 'records' falls inside a compacted
+// day, everything is counted again from the start
+static int catch_up(PlayerIndex* ix, const char* log_path) {
+    StatsCursor cursor;
+    const GameStats* game;
+    if (stats_cursor_open(&cursor, log_path, 0) == -1) return -1;
+    int result = 0;
+    stats_cursor_seek(&cursor, ix->head->records);
+    if (ix->head->records > cursor.count || cursor.pos != ix->head->records) {
+        result = reset_file(ix, PLAYER_INDEX_MIN_SLOTS);
+        if (result == 0) ix->head->magic = PLAYER_INDEX_MAGIC;
+        stats_cursor_seek(&cursor, 0);
+    }
+    while (result == 0 && (game = stats_cursor_next(&cursor)) != NULL) {
+        if (count_games(ix, game, (int64_t)cursor.weight) == -1) {
+            result = -1;
+            break;
+        }
+        ix->head->records += cursor.weight;
+    }
+    if (ix->head->records != cursor.count) result = -1;
+    stats_cursor_close(&cursor);
+    return result;
+}
+
+/**
+ * Map the player index of a stats log, creating it on first use
+ * Games logged without reaching the index are counted now; an index
+ * that is damaged or ahead of the log is rebuilt from scratch. Compacted
+ * days rebuild exactly: their summaries keep sums and the score.
+ * The log is only scanned if its newest segment's header counts a
+ * different number of games than the index has, so a lookup costs a
+ * header read, not a directory listing.
+ * Returns: 0 on success, -1 on error
+ * System calls used: open(), flock(), fstat(), ftruncate(), mmap(), pread()
+ */
+int player_index_open(PlayerIndex* ix, const char* log_path) {
+    char path[256];
+    memset(ix, 0, sizeof(PlayerIndex));
+    snprintf(path, sizeof(path), "%s%s", log_path, PLAYER_INDEX_SUFFIX);
+
+    ix->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (ix->fd == -1) return -1;
+    if (player_index_lock(ix) == -1) {
+        player_index_close(ix);
+        return -1;
+    }
+    uint64_t games;
+    int result = 0;
+    if (!valid(ix)) {
+        result = player_index_rebuild(ix, log_path);
+    } else if (stats_log_position(log_path, &games) == -1 || games != ix->head->records) {
+        result = catch_up(ix, log_path);
+    }
+    player_index_unlock(ix);
+    if (result == -1) player_index_close(ix);
+    return result;
+}
+
+void player_index_close(PlayerIndex* ix) {
+    if (ix->head != NULL) munmap(ix->head, ix->map_size);
+    if (ix->fd != -1) close(ix->fd);
+    memset(ix, 0, sizeof(PlayerIndex));
+    ix->fd = -1;
+}
+
+// Updates from different processes take turns: hold this around
+// "append to the log, then player_index_add()", and around lookups
+// Picks up a table another process has grown meanwhile
+// System calls used: flock()
+int player_index_lock(PlayerIndex* ix) {
+    while (flock(ix->fd, LOCK_EX) == -1) {
+        if (errno != EINTR) return -1;
+    }
+    if (map_file(ix) == -1) {
+        player_index_unlock(ix);
+        return -1;
+    }
+    return 0;
+}
+
+void player_index_unlock(PlayerIndex* ix) {
+    flock(ix->fd, LOCK_UN);
+}
+
+// Count one newly logged game: one probe, plus a rehash now and then
+int player_index_add(PlayerIndex* ix, const GameStats* game) {
+    if (!valid(ix) || count_games(ix, game, 1) == -1) return -1;
+    ix->head->records++;
+    return 0;
+}
+
+// Totals of one player: one probe
+// Returns: 1 if found, 0 if the player has no games
+int player_index_find(const PlayerIndex* ix, const char* name, PlayerTotals* out) {
+    char key[PLAYER_NAME_LEN];
+    if (!valid(ix)) return 0;
+    make_key(key, name);
+    const PlayerTotals* p = probe(ix, key);
+    if (p->games == 0) return 0;
+    *out = *p;
+    return 1;
+}
+
+// Forget everything and count the whole log again (call with the lock held)
+int player_index_rebuild(PlayerIndex* ix, const char* log_path) {
+    if (reset_file(ix, PLAYER_INDEX_MIN_SLOTS) == -1) return -1;
+    ix->head->magic = PLAYER_INDEX_MAGIC;
+    if (catch_up(ix, log_path) == -1) {
+        ix->head->magic = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Add the newest score to a player's ring and moving windows: O(1)
+ * Each window gains the score and loses the one that has just left it;
+ * the streak grows if the score beats the short average before it.
+ */
+void player_recent_add(PlayerTotals* p, int score) {
+    double before = player_window_average(p, PLAYER_STREAK_WINDOW);
+    if (p->recent_count > 0 && score > before) {
+        if (++p->streak > p->best_streak) p->best_streak = p->streak;
+    } else {
+        p->streak = 0;
+    }
+    for (int w = 0; w < PLAYER_WINDOWS; w++) {
+        uint32_t size = (uint32_t)window_sizes[w];
+        if (p->recent_count >= size) {
+            p->window_sum[w] -= p->recent[(p->recent_next + PLAYER_RECENT_GAMES - size) % PLAYER_RECENT_GAMES];
+        }
+        p->window_sum[w] += score;
+    }
+    p->recent[p->recent_next] = score;
+    p->recent_next = (p->recent_next + 1) % PLAYER_RECENT_GAMES;
+    if (p->recent_count < PLAYER_RECENT_GAMES) p->recent_count++;
+}
+
+// Games a moving-average window spans when full
+int player_window_size(int window) {
+    return window_sizes[window];
+}
+
+// Average of a window's latest scores (fewer if the player has fewer games)
+double player_window_average(const PlayerTotals* p, int window) {
+    uint32_t n = p->recent_count < (uint32_t)window_sizes[window] ? p->recent_count : (uint32_t)window_sizes[window];
+    return n > 0 ? (double)p->window_sum[window] / n : 0.0;
+}
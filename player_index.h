@@ -0,0 +1,75 @@
+#ifndef PLAYER_INDEX_H
+#define PLAYER_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "statistics.h"
+
+#define PLAYER_INDEX_MAGIC 0x58444950u      // "PIDX" in the first four bytes
+#define PLAYER_INDEX_VERSION 2             // 1: totals only, no recent scores
+#define PLAYER_INDEX_SUFFIX ".players"      // sidecar of the stats log
+#define PLAYER_INDEX_MIN_SLOTS 1024         // power of two; doubles at 3/4 full
+#define PLAYER_NAME_LEN 20                  // same as GameStats.player_name
+#define PLAYER_RECENT_GAMES 100             // latest scores kept per player
+#define PLAYER_WINDOWS 3                    // moving averages over the latest...
+#define PLAYER_WINDOW_SIZES { 10, 50, 100 } // ... this many games (none above PLAYER_RECENT_GAMES)
+#define PLAYER_STREAK_WINDOW 0              // a streak game beats the average of this window
+
+/**
+ * Totals of every player in the stats log, one open-addressing hash table
+ * File layout: PlayerIndexHeader, then PlayerTotals[capacity]
+ * (a slot with games == 0 is empty). Looking a player up hashes the name
+ * and probes until the name or an empty slot. The file is mapped shared
+ * and updated in place under flock(); growing rehashes in place with the
+ * magic cleared, so a crash half-way is seen as "rebuild from the log".
+ *
+ * Each slot also keeps the player's latest PLAYER_RECENT_GAMES scores in
+ * a ring and the sum of each moving-average window, so a new game updates
+ * every window in O(1): add the score, subtract the one that falls out.
+ * A compacted summary adds its score once per game (at most a ring's
+ * worth): the order of games inside a compacted day is not kept.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t used;
+    uint64_t records;           // stats log games counted so far
+} PlayerIndexHeader;
+
+typedef struct {
+    char name[PLAYER_NAME_LEN]; // zero padded
+    int32_t best_score;
+    int64_t games;
+    int64_t total_score;
+    int64_t caught;
+    int64_t missed;
+    int64_t duration;           // seconds
+    int32_t recent[PLAYER_RECENT_GAMES];    // ring of the latest scores
+    uint32_t recent_next;       // ring slot of the next score
+    uint32_t recent_count;      // scores in the ring
+    int64_t window_sum[PLAYER_WINDOWS];     // sum of the latest scores of each window
+    int32_t streak;             // games in a row that beat the short average before them
+    int32_t best_streak;
+} PlayerTotals;
+
+typedef struct {
+    int fd;                     // also carries the flock() that orders updates
+    size_t map_size;
+    PlayerIndexHeader* head;
+    PlayerTotals* slots;
+} PlayerIndex;
+
+// Function prototypes
+int player_index_open(PlayerIndex* ix, const char* log_path);
+void player_index_close(PlayerIndex* ix);
+int player_index_lock(PlayerIndex* ix);
+void player_index_unlock(PlayerIndex* ix);
+int player_index_add(PlayerIndex* ix, const GameStats* game);
+int player_index_find(const PlayerIndex* ix, const char* name, PlayerTotals* out);
+int player_index_rebuild(PlayerIndex* ix, const char* log_path);
+void player_recent_add(PlayerTotals* p, int score);
+int player_window_size(int window);
+double player_window_average(const PlayerTotals* p, int window);
+
+#endif
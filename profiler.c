@@ -0,0 +1,127 @@
+#include "profiler.h"
+#include <stdio.h>
+#include <string.h>
+
+int prof_on = 0;
+
+static ProfSample ring[PROF_RING_FRAMES];
+static long frames;             // frames finished since the start (ring index = frames % size)
+static ProfSample current;      // frame being measured
+static int frame_open;
+
+// Stack of each phase in the dump, root first
+static const char* const phase_stacks[PROF_PHASES] = {
+    "frame;input",
+    "frame;tick;fish",
+    "frame;tick;collision",
+    "frame;border",
+    "frame;render;sprites",
+    "frame;render;refresh"
+};
+
+static const char* const phase_names[PROF_PHASES] = {
+    "input", "fish", "collision", "border", "sprites", "refresh"
+};
+
+// Turn sampling on or off; a frame in progress is dropped
+void prof_enable(int on) {
+    prof_on = on;
+    frame_open = 0;
+}
+
+// Start a new frame at the loop's clock reading
+void prof_frame_begin(long long now_ns) {
+    if (!prof_on) return;
+    memset(&current, 0, sizeof(current));
+    current.start_ns = now_ns;
+    frame_open = 1;
+}
+
+// Store the frame in the ring, overwriting the oldest one when it is full
+void prof_frame_end(void) {
+    if (!prof_on || !frame_open) return;
+    ring[frames & (PROF_RING_FRAMES - 1)] = current;
+    frames++;
+    frame_open = 0;
+}
+
+// Charge the time since begin_ns to 'phase' of the current frame
+void prof_add(ProfPhase phase, long long begin_ns) {
+    // begin_ns is 0 when profiling was switched on in the middle of the phase
+    if (!frame_open || begin_ns == 0) return;
+    long long ns = sched_clock_ns() - begin_ns;
+    long long sum = (long long)current.ns[phase] + ns;
+    current.ns[phase] = sum > UINT32_MAX ? UINT32_MAX : (uint32_t)sum;
+    current.ran |= 1u << phase;
+}
+
+/**
+ * Averages and maxima per phase over the last PROF_WINDOW frames
+ * A phase's average only counts the frames it ran in, so a render every
+ * few wake-ups still shows what one render costs.
+ */
+void prof_summary(ProfSummary* out) {
+    memset(out, 0, sizeof(*out));
+    long n = frames < PROF_WINDOW ? frames : PROF_WINDOW;
+    double total[PROF_PHASES] = {0};
+    double frame_total = 0;
+
+    for (long k = frames - n; k < frames; k++) {
+        const ProfSample* s = &ring[k & (PROF_RING_FRAMES - 1)];
+        double frame_us = 0;
+        for (int p = 0; p < PROF_PHASES; p++) {
+            if (!(s->ran & (1u << p))) continue;
+            double us = s->ns[p] / 1000.0;
+            out->runs[p]++;
+            total[p] += us;
+            if (us > out->max_us[p]) out->max_us[p] = us;
+            frame_us += us;
+        }
+        frame_total += frame_us;
+        if (frame_us > out->frame_max_us) out->frame_max_us = frame_us;
+    }
+
+    out->frames = (int)n;
+    for (int p = 0; p < PROF_PHASES; p++) {
+        if (out->runs[p] > 0) out->avg_us[p] = total[p] / out->runs[p];
+    }
+    if (n > 0) out->frame_avg_us = frame_total / n;
+}
+
+// Short name of a phase for the overlay
+const char* prof_phase_name(ProfPhase phase) {
+    return phase >= 0 && phase < PROF_PHASES ? phase_names[phase] : "?";
+}
+
+// Frames measured since the start (the ring keeps the last PROF_RING_FRAMES)
+long prof_frames(void) {
+    return frames;
+}
+
+/**
+ * Write the frames in the ring to 'path' in folded-stack format
+ * One line per phase that ran in a frame, oldest frame first:
+ *   frame;tick;fish 48213
+ * The count is nanoseconds, so flamegraph.pl --countname=ns (or any tool
+ * that reads folded stacks) adds the frames up into a flame graph, and the
+ * file order still shows how a stutter built up frame by frame.
+ * Returns: frames written, or -1 on error
+ * System calls used: open(), write(), close() (through stdio)
+ */
+int prof_dump(const char* path) {
+    FILE* fp = fopen(path, "w");
+    if (fp == NULL) return -1;
+
+    long n = frames < PROF_RING_FRAMES ? frames : PROF_RING_FRAMES;
+    for (long k = frames - n; k < frames; k++) {
+        const ProfSample* s = &ring[k & (PROF_RING_FRAMES - 1)];
+        for (int p = 0; p < PROF_PHASES; p++) {
+            if (s->ran & (1u << p)) {
+                fprintf(fp, "%s %u\n", phase_stacks[p], s->ns[p]);
+            }
+        }
+    }
+
+    if (fclose(fp) != 0) return -1;
+    return (int)n;
+}
@@ -0,0 +1,71 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include "scheduler.h"
+
+#define PROF_RING_FRAMES 16384      // frames kept for the dump (power of two)
+#define PROF_WINDOW 120             // frames behind the overlay's averages and maxima
+
+// Phases of one pass of the main loop
+typedef enum {
+    PROF_INPUT,                     // reading the keys that arrived
+    PROF_FISH,                      // moving (and steering) the fish, every tick
+    PROF_COLLISION,                 // hook against the fish, every tick
+    PROF_BORDER,                    // draw_border(): scenery animation
+    PROF_SPRITES,                   // fish, boat, hook and HUD
+    PROF_REFRESH,                   // refresh(): pushing the frame to the terminal
+    PROF_PHASES
+} ProfPhase;
+
+/**
+ * Time spent in each phase during one frame (one wake-up of the loop)
+ * Phases that run once per simulation tick add up over the frame's ticks.
+ */
+typedef struct {
+    long long start_ns;
+    uint32_t ns[PROF_PHASES];
+    uint32_t ran;                   // bit p set: phase p ran this frame
+} ProfSample;
+
+// Rolling view of the last PROF_WINDOW frames
+typedef struct {
+    int frames;
+    int runs[PROF_PHASES];          // frames in which the phase ran
+    double avg_us[PROF_PHASES];     // average over those frames
+    double max_us[PROF_PHASES];
+    double frame_avg_us;            // all phases of a frame together
+    double frame_max_us;
+} ProfSummary;
+
+/**
+ * Frame profiler for the main loop
+ * Every probe first tests prof_on, so while the profiler is off a probe is
+ * one well-predicted branch and no clock read. While it is on, each phase
+ * costs two CLOCK_MONOTONIC reads (vDSO, no system call) and the frame is
+ * stored in a fixed ring of PROF_RING_FRAMES samples - nothing is allocated
+ * and the oldest frames are overwritten.
+ */
+extern int prof_on;
+
+// Function prototypes
+void prof_enable(int on);
+void prof_frame_begin(long long now_ns);
+void prof_frame_end(void);
+void prof_add(ProfPhase phase, long long begin_ns);
+void prof_summary(ProfSummary* out);
+const char* prof_phase_name(ProfPhase phase);
+long prof_frames(void);
+int prof_dump(const char* path);
+
+// Start timing a phase: returns the clock reading, or 0 while profiling is off
+static inline long long prof_begin(void){
+    return prof_on ? sched_clock_ns() : 0;
+}
+
+// Charge the time since prof_begin() to 'phase'
+static inline void prof_end(ProfPhase phase, long long begin_ns){
+    if (prof_on) prof_add(phase, begin_ns);
+}
+
+#endif
@@ -0,0 +1,252 @@
+#include "render_bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define DEFAULT_FRAMES 2000
+#define DEFAULT_SIZES "80x24,120x40,200x60"
+#define MAX_SIZES 16
+#define READ_CHUNK 65536
+
+// Per-frame measurements for one terminal size
+typedef struct {
+    int cols;
+    int lines;
+    long count;
+    long* bytes;        // bytes written by refresh() (mark excluded)
+    long* escapes;      // ESC characters = escape sequences emitted
+    long* frame_ns;     // go byte sent -> frame mark received
+} FrameSamples;
+
+// Scanner that splits the pty stream at BENCH_FRAME_MARK
+typedef struct {
+    const char* mark;
+    int mark_len;
+    int matched;        // bytes of the mark matched so far
+    long bytes;
+    long escapes;
+} MarkScanner;
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Feed one byte; returns 1 when a complete frame mark was seen
+static int scan_byte(MarkScanner* sc, char c) {
+    if (c == sc->mark[sc->matched]) {
+        if (++sc->matched == sc->mark_len) {
+            sc->matched = 0;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Bytes held back as a possible mark turned out to be frame output
+    // (the mark starts with ESC and contains no other ESC until its end)
+    if (sc->matched > 0) {
+        sc->bytes += sc->matched;
+        sc->escapes++;
+        sc->matched = 0;
+        if (c == sc->mark[0]) {
+            sc->matched = 1;
+            return 0;
+        }
+    }
+    sc->bytes++;
+    if (c == '\033') sc->escapes++;
+    return 0;
+}
+
+// Read the pty until the next frame mark
+// pending/pending_len: bytes already read past the previous mark
+// Returns: 0 when a mark was found, -1 on EOF or error
+static int read_frame(int master, MarkScanner* sc, char* buf, int* pending_pos, int* pending_len) {
+    sc->bytes = 0;
+    sc->escapes = 0;
+    while (1) {
+        while (*pending_pos < *pending_len) {
+            if (scan_byte(sc, buf[(*pending_pos)++])) return 0;
+        }
+        struct pollfd pfd = { master, POLLIN, 0 };
+        if (poll(&pfd, 1, 5000) <= 0) return -1;
+        ssize_t n = read(master, buf, READ_CHUNK);
+        if (n <= 0) return -1;
+        *pending_pos = 0;
+        *pending_len = (int)n;
+    }
+}
+
+// Run the game in a pty of the given size and record every frame
+static int bench_size(const char* game, const char* term, long frames, FrameSamples* out) {
+    int sync[2];
+    int master;
+    struct winsize ws;
+    memset(&ws, 0, sizeof(ws));
+    ws.ws_row = out->lines;
+    ws.ws_col = out->cols;
+
+    if (pipe(sync) == -1) {
+        perror("pipe");
+        return -1;
+    }
+
+    pid_t pid = forkpty(&master, NULL, NULL, &ws);
+    if (pid == -1) {
+        perror("forkpty");
+        return -1;
+    }
+    if (pid == 0) {
+        char nframes[32];
+        snprintf(nframes, sizeof(nframes), "%ld", frames);
+        if (sync[0] != BENCH_SYNC_FD) {
+            dup2(sync[0], BENCH_SYNC_FD);
+            close(sync[0]);
+        }
+        if (sync[1] != BENCH_SYNC_FD) close(sync[1]);
+        setenv("TERM", term, 1);
+        execl(game, game, "--render-bench", nframes, (char*)NULL);
+        perror("exec");
+        _exit(127);
+    }
+    close(sync[0]);
+
+    char* buf = malloc(READ_CHUNK);
+    MarkScanner sc = { BENCH_FRAME_MARK, (int)strlen(BENCH_FRAME_MARK), 0, 0, 0 };
+    int pending_pos = 0, pending_len = 0;
+    int status = 0;
+
+    // Everything before the first mark is terminal setup, not a frame
+    if (read_frame(master, &sc, buf, &pending_pos, &pending_len) == -1) {
+        fprintf(stderr, "%dx%d: game did not start\n", out->cols, out->lines);
+        status = -1;
+    }
+
+    out->count = 0;
+    for (long f = 0; f < frames && status == 0; f++) {
+        long long t0 = now_ns();
+        if (write(sync[1], "g", 1) != 1 ||
+            read_frame(master, &sc, buf, &pending_pos, &pending_len) == -1) {
+            fprintf(stderr, "%dx%d: game stopped after %ld frames\n", out->cols, out->lines, f);
+            status = -1;
+            break;
+        }
+        out->frame_ns[f] = now_ns() - t0;
+        out->bytes[f] = sc.bytes;
+        out->escapes[f] = sc.escapes;
+        out->count++;
+    }
+
+    // Let the game shut down; drain the pty so endwin() never blocks
+    close(sync[1]);
+    while (read(master, buf, READ_CHUNK) > 0) {
+    }
+    close(master);
+    waitpid(pid, NULL, 0);
+    free(buf);
+    return status;
+}
+
+static int cmp_long(const void* a, const void* b) {
+    long x = *(const long*)a, y = *(const long*)b;
+    return (x > y) - (x < y);
+}
+
+// Print {"mean":..,"p50":..,"p99":..,"max":..,"total":..} for one metric
+static void print_stats(const char* name, long* v, long n, double scale) {
+    double total = 0;
+    for (long i = 0; i < n; i++) total += v[i];
+    qsort(v, n, sizeof(long), cmp_long);
+    printf("      \"%s\": {\"mean\": %.2f, \"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f, \"total\": %.0f}",
+           name,
+           n > 0 ? total / n / scale : 0.0,
+           n > 0 ? v[(n - 1) * 50 / 100] / scale : 0.0,
+           n > 0 ? v[(n - 1) * 99 / 100] / scale : 0.0,
+           n > 0 ? v[n - 1] / scale : 0.0,
+           total / scale);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--frames N] [--sizes 80x24,120x40] [--game ./catch_and_go] [--term xterm-256color]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    long frames = DEFAULT_FRAMES;
+    const char* sizes = DEFAULT_SIZES;
+    const char* game = "./catch_and_go";
+    const char* term = "xterm-256color";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            sizes = argv[++i];
+        } else if (strcmp(argv[i], "--game") == 0 && i + 1 < argc) {
+            game = argv[++i];
+        } else if (strcmp(argv[i], "--term") == 0 && i + 1 < argc) {
+            term = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (frames <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Parse "COLSxLINES,COLSxLINES,..."
+    FrameSamples runs[MAX_SIZES];
+    int nruns = 0;
+    const char* p = sizes;
+    while (*p && nruns < MAX_SIZES) {
+        int cols, lines, used;
+        if (sscanf(p, "%dx%d%n", &cols, &lines, &used) != 2 || cols < 20 || lines < 10) {
+            fprintf(stderr, "Invalid size list: %s\n", sizes);
+            return 1;
+        }
+        runs[nruns].cols = cols;
+        runs[nruns].lines = lines;
+        nruns++;
+        p += used;
+        if (*p == ',') p++;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    printf("{\n  \"frames\": %ld,\n  \"term\": \"%s\",\n  \"sizes\": [\n", frames, term);
+    for (int r = 0; r < nruns; r++) {
+        FrameSamples* run = &runs[r];
+        run->bytes = malloc(frames * sizeof(long));
+        run->escapes = malloc(frames * sizeof(long));
+        run->frame_ns = malloc(frames * sizeof(long));
+        if (!run->bytes || !run->escapes || !run->frame_ns) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+
+        int status = bench_size(game, term, frames, run);
+
+        printf("    {\n      \"cols\": %d,\n      \"lines\": %d,\n      \"frames\": %ld,\n      \"ok\": %s,\n",
+               run->cols, run->lines, run->count, status == 0 ? "true" : "false");
+        print_stats("bytes_per_frame", run->bytes, run->count, 1.0);
+        printf(",\n");
+        print_stats("escapes_per_frame", run->escapes, run->count, 1.0);
+        printf(",\n");
+        print_stats("frame_us", run->frame_ns, run->count, 1000.0);
+        printf("\n    }%s\n", r + 1 < nruns ? "," : "");
+
+        free(run->bytes);
+        free(run->escapes);
+        free(run->frame_ns);
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,14 @@
+#ifndef RENDER_BENCH_H
+#define RENDER_BENCH_H
+
+// Protocol between render_bench (parent) and catch_and_go --render-bench (child)
+// The child waits for one go byte on BENCH_SYNC_FD before each frame and, after
+// refresh(), writes BENCH_FRAME_MARK to the terminal. The mark is an APC string
+// (ignored by terminals) that the parent strips before counting.
+#define BENCH_SYNC_FD 3
+#define BENCH_FRAME_MARK "\033_catch-frame\033\\"
+
+#define RENDER_BENCH_SEED 462   // same fish for every run
+#define RENDER_BENCH_SCRIPT "dddddddddhddddddddaaaaaaaaaaaahaaaaaaaaadddfds dd h "
+
+#endif
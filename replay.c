@@ -0,0 +1,452 @@
+#include "replay.h"
+#include "codec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Make room for 'need' elements of 'size' bytes in a growable array
+static int grow(void** buf, int* cap, int need, size_t size) {
+    if (need <= *cap) return 0;
+    int n = *cap ? *cap * 2 : 16;
+    while (n < need) n *= 2;
+    void* p = realloc(*buf, (size_t)n * size);
+    if (!p) return -1;
+    *buf = p;
+    *cap = n;
+    return 0;
+}
+
+// Write everything or fail
+// System calls used: write()
+static int write_all(int fd, const void* buf, size_t len) {
+    const unsigned char* p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Read exactly 'len' bytes at 'offset'
+// System calls used: pread()
+static int read_at(int fd, void* buf, size_t len, uint64_t offset) {
+    unsigned char* p = buf;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, (off_t)offset);
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+// Append one unsigned varint (7 bits per byte, high bit = more follows)
+static int put_varint(Recording* rec, unsigned long v) {
+    if (rec->cap - rec->len < 10) {
+        size_t cap = rec->cap ? rec->cap * 2 : 256;
+        unsigned char* data = realloc(rec->data, cap);
+        if (!data) return -1;
+        rec->data = data;
+        rec->cap = cap;
+    }
+    do {
+        unsigned char b = v & 0x7F;
+        v >>= 7;
+        rec->data[rec->len++] = b | (v ? 0x80 : 0);
+    } while (v);
+    return 0;
+}
+
+// Decode one varint; returns -1 at a truncated or oversized value
+static int get_varint(Replay* rp, unsigned long* out) {
+    unsigned long v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (rp->off >= rp->len) return -1;
+        unsigned char b = rp->data[rp->off++];
+        v |= (unsigned long)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *out = v;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Start recording a game that game_init() has just created
+ * Keyframes are spaced so a seek never simulates more than about
+ * REPLAY_KEYFRAME_BUDGET fish-frames.
+ * System calls used: open(), write()
+ * Returns: 0 on success, -1 if the file cannot be created
+ */
+int recording_start(Recording* rec, const GameState* game, const char* path) {
+    memset(rec, 0, sizeof(Recording));
+    rec->header.magic = REPLAY_MAGIC;
+    rec->header.version = REPLAY_VERSION;
+    rec->header.flags = game->schooling ? REPLAY_FLAG_SCHOOLING : 0;
+    rec->header.seed = game->seed;
+    rec->header.cols = game->cols;
+    rec->header.lines = game->lines;
+    rec->header.fish = game->fish.capacity;
+
+    int cost = game->fish.capacity * (game->schooling ? REPLAY_SCHOOLING_COST : 1);
+    int interval = REPLAY_KEYFRAME_BUDGET / cost;
+    if (interval < REPLAY_MIN_INTERVAL) interval = REPLAY_MIN_INTERVAL;
+    if (interval > REPLAY_MAX_INTERVAL) interval = REPLAY_MAX_INTERVAL;
+    rec->header.keyframe_interval = interval;
+
+    rec->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (rec->fd == -1) {
+        perror("Error opening recording file for writing");
+        return -1;
+    }
+    if (write_all(rec->fd, &rec->header, sizeof(ReplayHeader)) == -1) {
+        perror("Error writing recording");
+        close(rec->fd);
+        rec->fd = -1;
+        return -1;
+    }
+    rec->file_off = sizeof(ReplayHeader);
+    return 0;
+}
+
+// Call before every game_step(): writes a keyframe when one is due
+// Returns: 0 on success, -1 on error (keyframes are switched off)
+int recording_frame(Recording* rec, const GameState* game) {
+    int interval = rec->header.keyframe_interval;
+    if (rec->fd == -1 || interval <= 0 || game->frame == 0 || game->frame % interval != 0) {
+        return 0;
+    }
+
+    size_t size = game_snapshot(game, NULL, 0);
+    if (size > rec->snap_cap) {
+        unsigned char* p = realloc(rec->snap, size);
+        if (!p) {
+            rec->header.keyframe_interval = 0;
+            return -1;
+        }
+        rec->snap = p;
+        rec->snap_cap = size;
+    }
+    game_snapshot(game, rec->snap, rec->snap_cap);
+
+    if (grow((void**)&rec->keyframes, &rec->keyframe_cap, rec->keyframe_count + 1,
+             sizeof(ReplayKeyframe)) == -1 ||
+        write_all(rec->fd, rec->snap, size) == -1) {
+        perror("Error writing keyframe");
+        rec->header.keyframe_interval = 0;
+        return -1;
+    }
+    ReplayKeyframe* kf = &rec->keyframes[rec->keyframe_count++];
+    kf->frame = game->frame;
+    kf->offset = rec->file_off;
+    kf->size = size;
+    kf->event_offset = rec->len;
+    kf->event_base = rec->last_frame;
+    kf->crc = codec_crc32(rec->snap, size);
+    kf->reserved = 0;
+    rec->file_off += size;
+    return 0;
+}
+
+// Remember the key passed to game_step() at 'frame'
+int recording_key(Recording* rec, long frame, int key) {
+    if (key <= 0) return 0;  // GAME_INPUT_NONE: nothing to replay
+    if (put_varint(rec, (unsigned long)(frame - rec->last_frame)) == -1 ||
+        put_varint(rec, (unsigned long)key) == -1) {
+        return -1;
+    }
+    rec->last_frame = frame;
+    return 0;
+}
+
+// Call after game_step(): indexes catches and misses so they can be jumped to
+int recording_mark(Recording* rec, const GameState* game, int events) {
+    events &= GAME_EVENT_CATCH | GAME_EVENT_MISS;
+    if (events == 0) return 0;
+    if (grow((void**)&rec->marks, &rec->mark_cap, rec->mark_count + 1, sizeof(ReplayMark)) == -1) {
+        return -1;
+    }
+    ReplayMark* m = &rec->marks[rec->mark_count++];
+    m->frame = game->frame;
+    m->events = events;
+    m->score = game->score;
+    return 0;
+}
+
+/**
+ * Finish the file: events, keyframe index, marks and trailer
+ * end_frame: state->frame when the game stopped (game over or quit)
+ * System calls used: write(), close()
+ * Returns: 0 on success, -1 on error
+ */
+int recording_save(Recording* rec, long end_frame) {
+    if (rec->fd == -1) return -1;
+    if (put_varint(rec, (unsigned long)(end_frame - rec->last_frame)) == -1 ||
+        put_varint(rec, 0) == -1) {
+        return -1;
+    }
+    rec->last_frame = end_frame;
+
+    ReplayTrailer trailer;
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.events_offset = rec->file_off;
+    trailer.events_len = rec->len;
+    trailer.index_offset = rec->file_off + rec->len;
+    trailer.keyframe_count = (uint32_t)rec->keyframe_count;
+    trailer.mark_count = (uint32_t)rec->mark_count;
+    trailer.magic = REPLAY_MAGIC;
+
+    int failed = write_all(rec->fd, rec->data, rec->len) == -1 ||
+                 write_all(rec->fd, rec->keyframes, rec->keyframe_count * sizeof(ReplayKeyframe)) == -1 ||
+                 write_all(rec->fd, rec->marks, rec->mark_count * sizeof(ReplayMark)) == -1 ||
+                 write_all(rec->fd, &trailer, sizeof(trailer)) == -1;
+    if (failed) {
+        perror("Error writing recording");
+    }
+    close(rec->fd);
+    rec->fd = -1;
+    return failed ? -1 : 0;
+}
+
+void recording_free(Recording* rec) {
+    if (rec->fd != -1) close(rec->fd);
+    free(rec->data);
+    free(rec->keyframes);
+    free(rec->marks);
+    free(rec->snap);
+    memset(rec, 0, sizeof(Recording));
+    rec->fd = -1;
+}
+
+// Decode the next event into next_frame/next_key
+static void replay_advance(Replay* rp) {
+    unsigned long delta, key;
+    if (get_varint(rp, &delta) == -1 || get_varint(rp, &key) == -1) {
+        rp->next_key = 0;  // damaged tail: stop where we are
+        return;
+    }
+    rp->next_frame += (long)delta;
+    rp->next_key = (int)key;
+}
+
+// Restart event decoding at a byte offset of the event block
+static void replay_rewind(Replay* rp, size_t off, long base) {
+    rp->off = off;
+    rp->next_frame = base;
+    replay_advance(rp);
+}
+
+// Read 'count' records of 'size' bytes at 'offset' into a new array
+static void* load_block(int fd, uint64_t offset, size_t count, size_t size) {
+    void* p = malloc(count * size + 1);
+    if (p && read_at(fd, p, count * size, offset) == -1) {
+        free(p);
+        p = NULL;
+    }
+    return p;
+}
+
+// Version 2 keyframe index entry (no CRC)
+typedef struct {
+    int64_t frame;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t event_offset;
+    int64_t event_base;
+} ReplayKeyframeV2;
+
+// Read a version 2 keyframe index into the current layout
+static ReplayKeyframe* load_old_keyframes(int fd, uint64_t offset, size_t count) {
+    ReplayKeyframeV2* old = load_block(fd, offset, count, sizeof(ReplayKeyframeV2));
+    ReplayKeyframe* kf = old ? malloc(count * sizeof(ReplayKeyframe) + 1) : NULL;
+    for (size_t i = 0; kf && i < count; i++) {
+        kf[i].frame = old[i].frame;
+        kf[i].offset = old[i].offset;
+        kf[i].size = old[i].size;
+        kf[i].event_offset = old[i].event_offset;
+        kf[i].event_base = old[i].event_base;
+        kf[i].crc = 0;
+        kf[i].reserved = 0;
+    }
+    free(old);
+    return kf;
+}
+
+// Every keyframe in frame order, its snapshot inside the snapshot area and its events inside the event block
+static int keyframes_valid(const ReplayKeyframe* kf, int count, const ReplayTrailer* t) {
+    for (int i = 0; i < count; i++) {
+        if (kf[i].frame < 1 || (i > 0 && kf[i].frame <= kf[i - 1].frame) ||
+            kf[i].offset < sizeof(ReplayHeader) || kf[i].offset > t->events_offset ||
+            kf[i].size > t->events_offset - kf[i].offset ||
+            kf[i].event_offset > t->events_len || kf[i].event_base > kf[i].frame) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Open a recording: the events and index are read into memory,
+ * snapshots are read only when replay_seek() needs one
+ * System calls used: open(), fstat(), pread(), close()
+ * Returns: 0 on success, -1 on error (message printed)
+ */
+int replay_load(Replay* rp, const char* path) {
+    struct stat st;
+    memset(rp, 0, sizeof(Replay));
+
+    rp->fd = open(path, O_RDONLY);
+    if (rp->fd == -1) {
+        perror("Error opening recording");
+        return -1;
+    }
+    if (fstat(rp->fd, &st) == -1 || st.st_size < (off_t)sizeof(ReplayHeader) ||
+        read_at(rp->fd, &rp->header, sizeof(ReplayHeader), 0) == -1) {
+        fprintf(stderr, "%s: not a recording\n", path);
+        replay_free(rp);
+        return -1;
+    }
+    uint64_t size = (uint64_t)st.st_size;
+
+    if (rp->header.magic != REPLAY_MAGIC || rp->header.version < 1 || rp->header.version > REPLAY_VERSION ||
+        rp->header.fish < 1 || rp->header.fish > MAX_FISH ||
+        rp->header.cols < 1 || rp->header.lines < 1) {
+        fprintf(stderr, "%s: unsupported recording format\n", path);
+        replay_free(rp);
+        return -1;
+    }
+
+    if (rp->header.version == 1) {
+        // Events only, right after the header
+        rp->len = size - sizeof(ReplayHeader);
+        rp->data = load_block(rp->fd, sizeof(ReplayHeader), rp->len, 1);
+    } else {
+        ReplayTrailer t;
+        size_t kf_size = rp->header.version == 2 ? sizeof(ReplayKeyframeV2) : sizeof(ReplayKeyframe);
+        if (size < sizeof(ReplayHeader) + sizeof(t) ||
+            read_at(rp->fd, &t, sizeof(t), size - sizeof(t)) == -1 || t.magic != REPLAY_MAGIC ||
+            t.events_offset + t.events_len > t.index_offset ||
+            t.index_offset + t.keyframe_count * kf_size +
+                t.mark_count * sizeof(ReplayMark) + sizeof(t) != size) {
+            fprintf(stderr, "%s: recording is incomplete (game not finished?)\n", path);
+            replay_free(rp);
+            return -1;
+        }
+        rp->len = t.events_len;
+        rp->data = load_block(rp->fd, t.events_offset, t.events_len, 1);
+        rp->keyframe_count = (int)t.keyframe_count;
+        rp->keyframes = rp->header.version == 2
+                        ? load_old_keyframes(rp->fd, t.index_offset, t.keyframe_count)
+                        : load_block(rp->fd, t.index_offset, t.keyframe_count, sizeof(ReplayKeyframe));
+        rp->mark_count = (int)t.mark_count;
+        rp->marks = load_block(rp->fd, t.index_offset + t.keyframe_count * kf_size,
+                               t.mark_count, sizeof(ReplayMark));
+        if (rp->keyframes && !keyframes_valid(rp->keyframes, rp->keyframe_count, &t)) {
+            fprintf(stderr, "%s: keyframe index is damaged\n", path);
+            replay_free(rp);
+            return -1;
+        }
+    }
+    if (!rp->data || (rp->header.version > 1 && (!rp->keyframes || !rp->marks))) {
+        fprintf(stderr, "%s: could not read recording\n", path);
+        replay_free(rp);
+        return -1;
+    }
+    replay_rewind(rp, 0, 0);
+    return 0;
+}
+
+// Create the recorded game: same pond, population, options and seed
+// Returns: 0 on success, -1 if out of memory
+int replay_new_game(const Replay* rp, GameState* game) {
+    if (game_init(game, rp->header.cols, rp->header.lines, rp->header.fish, rp->header.seed) == -1) {
+        return -1;
+    }
+    if (game_set_schooling(game, (rp->header.flags & REPLAY_FLAG_SCHOOLING) != 0) == -1) {
+        game_free(game);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Bring 'game' to the state it had at 'frame' (before that frame's step)
+ * Loads the last keyframe at or before 'frame' - unless the game is already
+ * between that keyframe and 'frame' - and simulates the rest with the
+ * recorded keys. Stops early if the recording ends first.
+ * Returns: 0 on success, -1 if a snapshot could not be read
+ */
+int replay_seek(Replay* rp, GameState* game, long frame) {
+    int lo = 0, hi = rp->keyframe_count - 1, best = -1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (rp->keyframes[mid].frame <= frame) {
+            best = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    long start = best >= 0 ? (long)rp->keyframes[best].frame : 0;
+
+    if (game->frame < start || game->frame > frame) {
+        if (best >= 0) {
+            const ReplayKeyframe* kf = &rp->keyframes[best];
+            if (kf->size > game_snapshot_max(game)) return -1;
+            if (kf->size > rp->snap_cap) {
+                unsigned char* p = realloc(rp->snap, kf->size);
+                if (!p) return -1;
+                rp->snap = p;
+                rp->snap_cap = kf->size;
+            }
+            if (read_at(rp->fd, rp->snap, kf->size, kf->offset) == -1 ||
+                (rp->header.version > 2 && codec_crc32(rp->snap, kf->size) != kf->crc) ||
+                game_restore(game, rp->snap, kf->size) == -1) {
+                return -1;
+            }
+            replay_rewind(rp, kf->event_offset, (long)kf->event_base);
+        } else {
+            game_reset(game, rp->header.seed);
+            replay_rewind(rp, 0, 0);
+        }
+    }
+
+    rp->seek_simulated = 0;
+    while (game->frame < frame && !game->game_over && !replay_finished(rp, game->frame)) {
+        game_step(game, replay_key(rp, game->frame));
+        rp->seek_simulated++;
+    }
+    return 0;
+}
+
+// Key for the game_step() call at 'frame' (frames must be asked in order)
+int replay_key(Replay* rp, long frame) {
+    if (rp->next_key == 0 || frame != rp->next_frame) {
+        return GAME_INPUT_NONE;
+    }
+    int key = rp->next_key;
+    replay_advance(rp);
+    return key;
+}
+
+// 1 once the recorded game has run all its frames
+int replay_finished(const Replay* rp, long frame) {
+    return rp->next_key == 0 && frame >= rp->next_frame;
+}
+
+void replay_free(Replay* rp) {
+    if (rp->fd != -1) close(rp->fd);
+    free(rp->data);
+    free(rp->keyframes);
+    free(rp->marks);
+    free(rp->snap);
+    memset(rp, 0, sizeof(Replay));
+    rp->fd = -1;
+}
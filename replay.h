@@ -0,0 +1,120 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "game.h"
+
+#define REPLAY_MAGIC 0x50524743u        // "CGRP" in the first four bytes
+#define REPLAY_VERSION 3                // 1 = events only, 2 = no keyframe CRCs; both still readable
+                                        // bump if game_step() order changes
+#define REPLAY_FLAG_SCHOOLING 0x0001
+#define REPLAY_KEYFRAME_BUDGET 262144   // fish x frames simulated at most per seek
+#define REPLAY_SCHOOLING_COST 64        // a schooling fish costs about this many plain ones
+#define REPLAY_MIN_INTERVAL 16
+#define REPLAY_MAX_INTERVAL 256
+
+/**
+ * Recording file layout (version 3)
+ *   ReplayHeader                    everything needed to recreate the game
+ *   snapshots...                    game_snapshot() every keyframe_interval frames
+ *   events                          varint frame delta, varint key ... then
+ *                                   varint frame delta, varint 0 (end of game)
+ *   ReplayKeyframe[keyframe_count]  where each snapshot and its events start
+ *   ReplayMark[mark_count]          frames with a catch or a miss
+ *   ReplayTrailer                   where the blocks above are
+ * Only frames with a key are stored; a key applies to the game_step()
+ * call made when state->frame equals the event frame, before that
+ * frame's fish and hook move (see game_step()). Version 1 files
+ * are a header followed by the events; version 2 keyframes have no CRC.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;             // REPLAY_FLAG_*
+    uint64_t seed;
+    int32_t cols;
+    int32_t lines;
+    int32_t fish;
+    int32_t keyframe_interval;  // frames between snapshots (0 = none)
+} ReplayHeader;
+
+typedef struct {
+    int64_t frame;              // state->frame of the snapshot
+    uint64_t offset;            // file offset of the snapshot
+    uint64_t size;
+    uint64_t event_offset;      // first event at or after 'frame' (in the event block)
+    int64_t event_base;         // frame that event's delta counts from
+    uint32_t crc;               // CRC-32 of the snapshot bytes
+    uint32_t reserved;
+} ReplayKeyframe;
+
+typedef struct {
+    int64_t frame;              // state->frame right after the catch or miss
+    int32_t events;             // GAME_EVENT_CATCH and/or GAME_EVENT_MISS
+    int32_t score;
+} ReplayMark;
+
+typedef struct {
+    uint64_t events_offset;
+    uint64_t events_len;
+    uint64_t index_offset;      // keyframes, then marks
+    uint32_t keyframe_count;
+    uint32_t mark_count;
+    uint32_t reserved;
+    uint32_t magic;             // REPLAY_MAGIC again, so a cut-off file is noticed
+} ReplayTrailer;
+
+// A game being recorded: snapshots go straight to the file, events and index stay in memory
+typedef struct {
+    ReplayHeader header;
+    int fd;
+    uint64_t file_off;          // bytes written so far
+    unsigned char* data;        // event stream
+    size_t len;
+    size_t cap;
+    long last_frame;            // frame of the previous event
+    ReplayKeyframe* keyframes;
+    int keyframe_count;
+    int keyframe_cap;
+    ReplayMark* marks;
+    int mark_count;
+    int mark_cap;
+    unsigned char* snap;        // snapshot scratch buffer
+    size_t snap_cap;
+} Recording;
+
+// A recording being played back
+typedef struct {
+    ReplayHeader header;
+    int fd;                     // kept open to read snapshots on demand
+    unsigned char* data;        // event stream
+    size_t len;
+    size_t off;                 // next undecoded byte
+    long next_frame;            // frame of the next event
+    int next_key;               // 0 = recording ends at next_frame
+    ReplayKeyframe* keyframes;
+    int keyframe_count;
+    ReplayMark* marks;
+    int mark_count;
+    unsigned char* snap;
+    size_t snap_cap;
+    long seek_simulated;        // frames the last replay_seek() had to simulate
+} Replay;
+
+// Function prototypes
+int recording_start(Recording* rec, const GameState* game, const char* path);
+int recording_frame(Recording* rec, const GameState* game);
+int recording_key(Recording* rec, long frame, int key);
+int recording_mark(Recording* rec, const GameState* game, int events);
+int recording_save(Recording* rec, long end_frame);
+void recording_free(Recording* rec);
+
+int replay_load(Replay* rp, const char* path);
+int replay_new_game(const Replay* rp, GameState* game);
+int replay_seek(Replay* rp, GameState* game, long frame);
+int replay_key(Replay* rp, long frame);
+int replay_finished(const Replay* rp, long frame);
+void replay_free(Replay* rp);
+
+#endif
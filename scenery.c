@@ -0,0 +1,124 @@
+#include "scenery.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BLANK ((chtype)' ')
+
+static void fill_blank(chtype* buf, int n) {
+    for (int i = 0; i < n; i++) buf[i] = BLANK;
+}
+
+// Allocate the layers for a cols x lines screen
+// Returns: 0 on success, -1 if out of memory
+int scenery_init(Scenery* sc, int cols, int lines) {
+    int n = cols * lines;
+    memset(sc, 0, sizeof(Scenery));
+    sc->cols = cols;
+    sc->lines = lines;
+    sc->base = malloc(n * sizeof(chtype));
+    sc->cells = malloc(n * sizeof(chtype));
+    sc->next = malloc(n * sizeof(chtype));
+    sc->dirty_lo = malloc(lines * sizeof(int));
+    sc->dirty_hi = malloc(lines * sizeof(int));
+    if (!sc->base || !sc->cells || !sc->next || !sc->dirty_lo || !sc->dirty_hi) {
+        scenery_free(sc);
+        return -1;
+    }
+    fill_blank(sc->base, n);
+    fill_blank(sc->cells, n);
+    for (int r = 0; r < lines; r++) {
+        sc->dirty_lo[r] = cols;
+        sc->dirty_hi[r] = -1;
+    }
+    sc->full_repaint = 1;
+    return 0;
+}
+
+void scenery_free(Scenery* sc) {
+    free(sc->base);
+    free(sc->cells);
+    free(sc->next);
+    free(sc->dirty_lo);
+    free(sc->dirty_hi);
+    memset(sc, 0, sizeof(Scenery));
+}
+
+// Clip-and-copy a string into a layer buffer
+// only_blank: write only where the static layer has nothing
+static void put_str(Scenery* sc, chtype* buf, int row, int col, const char* s, chtype attr, int only_blank) {
+    if (row < 0 || row >= sc->lines) return;
+    chtype* line = buf + row * sc->cols;
+    const chtype* base = sc->base + row * sc->cols;
+    for (int i = 0; s[i] != '\0'; i++) {
+        int x = col + i;
+        if (x < 0) continue;
+        if (x >= sc->cols) break;
+        if (only_blank && base[x] != BLANK) continue;
+        line[x] = (chtype)(unsigned char)s[i] | attr;
+    }
+}
+
+// Draw into the static layer (call before the first frame)
+void scenery_put_static(Scenery* sc, int row, int col, const char* s, chtype attr) {
+    put_str(sc, sc->base, row, col, s, attr, 0);
+}
+
+// Start composing a new animation frame on top of the static layer
+void scenery_begin_frame(Scenery* sc) {
+    memcpy(sc->next, sc->base, sc->cols * sc->lines * sizeof(chtype));
+}
+
+// Draw into the animation frame, behind anything in the static layer
+void scenery_put_anim(Scenery* sc, int row, int col, const char* s, chtype attr) {
+    put_str(sc, sc->next, row, col, s, attr, 1);
+}
+
+// Make the composed frame current and remember which cells changed
+void scenery_commit_frame(Scenery* sc) {
+    for (int r = 0; r < sc->lines; r++) {
+        chtype* cur = sc->cells + r * sc->cols;
+        const chtype* nxt = sc->next + r * sc->cols;
+        for (int c = 0; c < sc->cols; c++) {
+            if (cur[c] != nxt[c]) {
+                cur[c] = nxt[c];
+                if (c < sc->dirty_lo[r]) sc->dirty_lo[r] = c;
+                if (c > sc->dirty_hi[r]) sc->dirty_hi[r] = c;
+            }
+        }
+    }
+}
+
+// Screen contents were lost (clear()) - repaint everything next time
+void scenery_invalidate(Scenery* sc) {
+    sc->full_repaint = 1;
+}
+
+// Paint changed background cells into stdscr
+// Returns: number of cells painted
+int scenery_paint(Scenery* sc) {
+    int painted = 0;
+    for (int r = 0; r < sc->lines; r++) {
+        int lo = sc->full_repaint ? 0 : sc->dirty_lo[r];
+        int hi = sc->full_repaint ? sc->cols - 1 : sc->dirty_hi[r];
+        if (lo <= hi) {
+            mvaddchnstr(r, lo, sc->cells + r * sc->cols + lo, hi - lo + 1);
+            painted += hi - lo + 1;
+        }
+        sc->dirty_lo[r] = sc->cols;
+        sc->dirty_hi[r] = -1;
+    }
+    sc->full_repaint = 0;
+    return painted;
+}
+
+// Erase a sprite by copying the background back over it
+void scenery_restore(const Scenery* sc, int row, int col, int len) {
+    if (row < 0 || row >= sc->lines) return;
+    if (col < 0) {
+        len += col;
+        col = 0;
+    }
+    if (col + len > sc->cols) len = sc->cols - col;
+    if (len <= 0) return;
+    mvaddchnstr(row, col, sc->cells + row * sc->cols + col, len);
+}
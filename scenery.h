@@ -0,0 +1,36 @@
+#ifndef SCENERY_H
+#define SCENERY_H
+
+#include <curses.h>
+
+/**
+ * Background layer cache for the pond scenery
+ * - base:  static layer (castle), composed once per game
+ * - cells: what the background currently looks like (base + animation)
+ * - next:  animation frame being composed (waves, moss)
+ * Only cells that differ between frames are repainted, and sprites are
+ * erased by copying the background back instead of writing blanks.
+ */
+typedef struct {
+    int cols;
+    int lines;
+    chtype* base;
+    chtype* cells;
+    chtype* next;
+    int* dirty_lo;      // per row: first changed column (dirty_lo > dirty_hi = clean)
+    int* dirty_hi;      // per row: last changed column
+    int full_repaint;   // screen was cleared, repaint every cell
+} Scenery;
+
+// Function prototypes
+int scenery_init(Scenery* sc, int cols, int lines);
+void scenery_free(Scenery* sc);
+void scenery_put_static(Scenery* sc, int row, int col, const char* s, chtype attr);
+void scenery_begin_frame(Scenery* sc);
+void scenery_put_anim(Scenery* sc, int row, int col, const char* s, chtype attr);
+void scenery_commit_frame(Scenery* sc);
+void scenery_invalidate(Scenery* sc);
+int scenery_paint(Scenery* sc);
+void scenery_restore(const Scenery* sc, int row, int col, int len);
+
+#endif
@@ -0,0 +1,86 @@
+#include "scheduler.h"
+#include <time.h>
+
+// Read the monotonic clock in nanoseconds
+// System calls used: clock_gettime()
+long long sched_clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+}
+
+// Start scheduling at time 'now'
+void sched_init(FrameScheduler* sched, long long now, long long tick_ns, long long render_ns) {
+    sched->start_ns = now;
+    sched->last_ns = now;
+    sched->accumulator_ns = 0;
+    sched->tick_ns = tick_ns > 0 ? tick_ns : 1;
+    sched->render_ns = render_ns;
+    sched->next_render_ns = now;
+    sched->pause_start_ns = 0;
+    sched->total_pause_ns = 0;
+    sched->paused = 0;
+}
+
+// Change the simulation tick length (e.g. after a speed change)
+void sched_set_tick(FrameScheduler* sched, long long tick_ns) {
+    sched->tick_ns = tick_ns > 0 ? tick_ns : 1;
+}
+
+// Add the time passed since the previous frame to the accumulator
+void sched_advance(FrameScheduler* sched, long long now) {
+    if (sched->paused) return;
+
+    sched->accumulator_ns += now - sched->last_ns;
+    sched->last_ns = now;
+
+    // After a long stall, catch up a few ticks and drop the rest
+    long long max_backlog = MAX_TICKS_PER_FRAME * sched->tick_ns;
+    if (sched->accumulator_ns > max_backlog) {
+        sched->accumulator_ns = max_backlog;
+    }
+}
+
+// Consume one tick from the accumulator
+// Returns: 1 if a simulation tick should run now, 0 otherwise
+int sched_take_tick(FrameScheduler* sched) {
+    if (sched->paused || sched->accumulator_ns < sched->tick_ns) return 0;
+    sched->accumulator_ns -= sched->tick_ns;
+    return 1;
+}
+
+// Returns: 1 (and books the next slot) if enough time passed since the last render
+int sched_render_due(FrameScheduler* sched, long long now) {
+    if (now < sched->next_render_ns) return 0;
+    sched->next_render_ns = now + sched->render_ns;
+    return 1;
+}
+
+// Nanoseconds until the next tick is due (measured from the last frame)
+long long sched_next_tick_in(const FrameScheduler* sched) {
+    long long wait = sched->tick_ns - sched->accumulator_ns;
+    return wait > 0 ? wait : 0;
+}
+
+// Stop the game clock
+void sched_pause(FrameScheduler* sched, long long now) {
+    if (sched->paused) return;
+    sched->paused = 1;
+    sched->pause_start_ns = now;
+}
+
+// Restart the game clock; time spent paused is never simulated
+void sched_resume(FrameScheduler* sched, long long now) {
+    if (!sched->paused) return;
+    sched->total_pause_ns += now - sched->pause_start_ns;
+    sched->pause_start_ns = 0;
+    sched->last_ns = now;
+    sched->paused = 0;
+}
+
+// Milliseconds of unpaused play since sched_init()
+long long sched_active_ms(const FrameScheduler* sched, long long now) {
+    long long active = now - sched->start_ns - sched->total_pause_ns;
+    if (sched->paused) active -= now - sched->pause_start_ns;
+    return active / NS_PER_MS;
+}
@@ -0,0 +1,38 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#define NS_PER_MS 1000000LL
+#define NS_PER_SEC 1000000000LL
+#define MAX_TICKS_PER_FRAME 5   // drop backlog beyond this instead of spiralling
+
+/**
+ * Fixed-timestep frame scheduler on CLOCK_MONOTONIC
+ * The simulation advances in ticks of tick_ns no matter how long a frame
+ * takes to draw; rendering runs at its own (capped) rate.
+ * All functions take the frame's clock reading so the clock is read once per frame.
+ */
+typedef struct {
+    long long start_ns;         // when the game started
+    long long last_ns;          // clock reading of the previous frame
+    long long accumulator_ns;   // time not yet simulated
+    long long tick_ns;          // length of one simulation tick
+    long long render_ns;        // minimum time between two renders
+    long long next_render_ns;   // earliest time of the next render
+    long long pause_start_ns;   // when the current pause began
+    long long total_pause_ns;   // sum of all finished pauses
+    int paused;
+} FrameScheduler;
+
+// Function prototypes
+long long sched_clock_ns(void);
+void sched_init(FrameScheduler* sched, long long now, long long tick_ns, long long render_ns);
+void sched_set_tick(FrameScheduler* sched, long long tick_ns);
+void sched_advance(FrameScheduler* sched, long long now);
+int sched_take_tick(FrameScheduler* sched);
+int sched_render_due(FrameScheduler* sched, long long now);
+long long sched_next_tick_in(const FrameScheduler* sched);
+void sched_pause(FrameScheduler* sched, long long now);
+void sched_resume(FrameScheduler* sched, long long now);
+long long sched_active_ms(const FrameScheduler* sched, long long now);
+
+#endif
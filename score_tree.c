@@ -0,0 +1,209 @@
+#include "score_tree.h"
+#include "statistics.h"
+#include "stats_store.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+
+// Tree of a speed level; unknown speeds only count in tree 0
+int score_tree_board_of(int speed_level) {
+    return (speed_level >= 1 && speed_level <= SCORE_TREE_SPEEDS) ? speed_level : 0;
+}
+
+static int64_t* tree_of(const ScoreTree* t, int board) {
+    return t->trees + (size_t)board * (SCORE_TREE_SIZE + 1);
+}
+
+// Fenwick index (1-based) of a score's bucket
+static int bucket(int score) {
+    int i = score - SCORE_TREE_MIN + 1;
+    if (i < 1) i = 1;
+    if (i > SCORE_TREE_SIZE) i = SCORE_TREE_SIZE;
+    return i;
+}
+
+// Games in buckets 1..i
+static long long prefix(const int64_t* tree, int i) {
+    long long sum = 0;
+    for (; i > 0; i -= i & -i) sum += tree[i];
+    return sum;
+}
+
+static void tree_add(int64_t* tree, int i, int64_t games) {
+    for (; i <= SCORE_TREE_SIZE; i += i & -i) tree[i] += games;
+}
+
+// Count games with one score in its speed's tree and in the all-games tree
+static void count_games(ScoreTree* t, int speed_level, int score, int64_t games) {
+    int i = bucket(score);
+    tree_add(tree_of(t, 0), i, games);
+    int board = score_tree_board_of(speed_level);
+    if (board != 0) tree_add(tree_of(t, board), i, games);
+}
+
+// Forget every count
+static void clear(ScoreTree* t) {
+    memset(t->head, 0, t->map_size);
+    t->head->magic = SCORE_TREE_MAGIC;
+    t->head->version = SCORE_TREE_VERSION;
+    t->head->min_score = SCORE_TREE_MIN;
+    t->head->size = SCORE_TREE_SIZE;
+}
+
+// Count the games of the log from 'records' on (call with the lock held)
+// If the log is shorter than that, or 'records' falls inside a compacted
+// day, everything is counted again from the start
+static int catch_up(ScoreTree* t, const char* log_path) {
+    StatsCursor cursor;
+    const GameStats* game;
+    if (stats_cursor_open(&cursor, log_path, 0) == -1) return -1;
+
+    if (t->head->records > cursor.count) clear(t);
+    stats_cursor_seek(&cursor, t->head->records);
+    if (cursor.pos != t->head->records) {
+        clear(t);
+        stats_cursor_seek(&cursor, 0);
+    }
+    while ((game = stats_cursor_next(&cursor)) != NULL) {
+        count_games(t, game->speed_level, game->final_score, (int64_t)cursor.weight);
+        t->head->records += cursor.weight;
+    }
+    int result = t->head->records == cursor.count ? 0 : -1;
+    stats_cursor_close(&cursor);
+    return result;
+}
+
+/**
+ * Map the score trees of a stats log, creating them on first use
+ * Games logged without reaching the trees (an older build, or a crash
+ * between the append and the update) are counted now; if the log is
+ * shorter than the trees remember, they are rebuilt from scratch.
+ * A compacted day counts each summary's games at its score, which is
+ * exact: summaries group games by player, speed and score.
+ * As with the player index, the log is only scanned when its newest
+ * segment counts a different number of games than the trees.
+ * Returns: 0 on success, -1 on error
+ * System calls used: open(), flock(), fstat(), ftruncate(), mmap(), pread()
+ */
+int score_tree_open(ScoreTree* t, const char* log_path) {
+    char path[256];
+    struct stat st;
+    size_t size = sizeof(ScoreTreeHeader) + (size_t)SCORE_TREE_BOARDS * (SCORE_TREE_SIZE + 1) * sizeof(int64_t);
+    memset(t, 0, sizeof(ScoreTree));
+    t->fd = -1;
+    snprintf(path, sizeof(path), "%s%s", log_path, SCORE_TREE_SUFFIX);
+
+    t->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (t->fd == -1) return -1;
+    if (score_tree_lock(t) == -1 || fstat(t->fd, &st) == -1) {
+        score_tree_close(t);
+        return -1;
+    }
+    int fresh = (size_t)st.st_size != size;
+    if (fresh && ftruncate(t->fd, (off_t)size) == -1) {
+        score_tree_close(t);
+        return -1;
+    }
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, t->fd, 0);
+    if (map == MAP_FAILED) {
+        score_tree_close(t);
+        return -1;
+    }
+    t->map_size = size;
+    t->head = map;
+    t->trees = (int64_t*)((unsigned char*)map + sizeof(ScoreTreeHeader));
+
+    if (fresh || t->head->magic != SCORE_TREE_MAGIC || t->head->version != SCORE_TREE_VERSION ||
+        t->head->min_score != SCORE_TREE_MIN || t->head->size != SCORE_TREE_SIZE) {
+        clear(t);
+    }
+    uint64_t games;
+    int result = 0;
+    if (stats_log_position(log_path, &games) == -1 || games != t->head->records) {
+        result = catch_up(t, log_path);
+    }
+    score_tree_unlock(t);
+    if (result == -1) score_tree_close(t);
+    return result;
+}
+
+void score_tree_close(ScoreTree* t) {
+    if (t->head != NULL) munmap(t->head, t->map_size);
+    if (t->fd != -1) close(t->fd);
+    memset(t, 0, sizeof(ScoreTree));
+    t->fd = -1;
+}
+
+// Updates from different processes take turns: hold this around
+// "append to the log, then score_tree_add()"
+// System calls used: flock()
+int score_tree_lock(ScoreTree* t) {
+    while (flock(t->fd, LOCK_EX) == -1) {
+        if (errno != EINTR) return -1;
+    }
+    return 0;
+}
+
+void score_tree_unlock(ScoreTree* t) {
+    flock(t->fd, LOCK_UN);
+}
+
+// Count one newly logged game: O(log S)
+void score_tree_add(ScoreTree* t, int speed_level, int score) {
+    count_games(t, speed_level, score, 1);
+    t->head->records++;
+}
+
+// Forget everything and count the whole log again (call with the lock held)
+int score_tree_rebuild(ScoreTree* t, const char* log_path) {
+    clear(t);
+    return catch_up(t, log_path);
+}
+
+// Games on a board
+long long score_tree_count(const ScoreTree* t, int board) {
+    if (board < 0 || board >= SCORE_TREE_BOARDS) return 0;
+    return prefix(tree_of(t, board), SCORE_TREE_SIZE);
+}
+
+// Games on a board that scored less than 'score': O(log S)
+long long score_tree_below(const ScoreTree* t, int board, int score) {
+    if (board < 0 || board >= SCORE_TREE_BOARDS || score <= SCORE_TREE_MIN) return 0;
+    return prefix(tree_of(t, board), bucket(score) - 1);
+}
+
+// Games on a board that scored more than 'score': O(log S)
+long long score_tree_above(const ScoreTree* t, int board, int score) {
+    if (board < 0 || board >= SCORE_TREE_BOARDS || score >= SCORE_TREE_MIN + SCORE_TREE_SIZE - 1) return 0;
+    const int64_t* tree = tree_of(t, board);
+    return prefix(tree, SCORE_TREE_SIZE) - prefix(tree, bucket(score));
+}
+
+/**
+ * Lowest score reached by fraction q of the games on a board: O(log S)
+ * Binary lifting: walk down the Fenwick tree's implicit binary search
+ * Returns: the score, or SCORE_TREE_MIN if the board is empty
+ */
+int score_tree_quantile(const ScoreTree* t, int board, double q) {
+    if (board < 0 || board >= SCORE_TREE_BOARDS) return SCORE_TREE_MIN;
+    const int64_t* tree = tree_of(t, board);
+    long long total = prefix(tree, SCORE_TREE_SIZE);
+    if (total == 0) return SCORE_TREE_MIN;
+
+    long long want = (long long)(q * total + 0.999999);
+    if (want < 1) want = 1;
+    if (want > total) want = total;
+    int pos = 0;
+    for (int step = SCORE_TREE_SIZE; step > 0; step >>= 1) {
+        if (pos + step <= SCORE_TREE_SIZE && tree[pos + step] < want) {
+            pos += step;
+            want -= tree[pos];
+        }
+    }
+    return pos + SCORE_TREE_MIN;     // bucket pos + 1, as a score
+}
@@ -0,0 +1,50 @@
+#ifndef SCORE_TREE_H
+#define SCORE_TREE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SCORE_TREE_MAGIC 0x52544353u        // "SCTR" in the first four bytes
+#define SCORE_TREE_VERSION 1
+#define SCORE_TREE_SUFFIX ".scores"         // sidecar of the stats log
+#define SCORE_TREE_MIN -1024                // lowest score with its own bucket
+#define SCORE_TREE_SIZE 4096                // buckets; scores outside clamp to the ends
+#define SCORE_TREE_SPEEDS 6                 // trees 1..6 = speed level (MIN_SPEED..MAX_SPEED)
+#define SCORE_TREE_BOARDS (SCORE_TREE_SPEEDS + 1)   // tree 0 = every game
+
+/**
+ * Score frequencies of every logged game, one Fenwick tree per speed level
+ * File layout: ScoreTreeHeader, then int64_t[SCORE_TREE_BOARDS][SCORE_TREE_SIZE + 1]
+ * (index 0 of each tree unused). Adding a game touches O(log S) counters
+ * of two trees; a rank or percentile reads O(log S) counters.
+ * The file is mapped shared, so updates need no write() at all.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t min_score;
+    int32_t size;
+    uint64_t records;           // stats log games counted so far
+} ScoreTreeHeader;
+
+typedef struct {
+    int fd;                     // also carries the flock() that orders updates
+    size_t map_size;
+    ScoreTreeHeader* head;
+    int64_t* trees;
+} ScoreTree;
+
+// Function prototypes
+int score_tree_open(ScoreTree* t, const char* log_path);
+void score_tree_close(ScoreTree* t);
+int score_tree_lock(ScoreTree* t);
+void score_tree_unlock(ScoreTree* t);
+void score_tree_add(ScoreTree* t, int speed_level, int score);
+int score_tree_rebuild(ScoreTree* t, const char* log_path);
+long long score_tree_count(const ScoreTree* t, int board);
+long long score_tree_below(const ScoreTree* t, int board, int score);
+long long score_tree_above(const ScoreTree* t, int board, int score);
+int score_tree_quantile(const ScoreTree* t, int board, double q);
+int score_tree_board_of(int speed_level);
+
+#endif
@@ -0,0 +1,200 @@
+#include "simulate.h"
+#include "scheduler.h"
+#include "bot.h"
+#include "statistics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// Shared by the workers; the only thing they write is the game counter
+typedef struct {
+    const SimConfig* cfg;
+    long total;                 // games over all speed levels
+    long next;                  // next unclaimed game (atomic)
+} SimQueue;
+
+// One per thread, allocated separately so counters never share a cache line
+typedef struct {
+    SimQueue* queue;
+    SimResult result;
+    int failed;
+} SimWorker;
+
+// Same policies as the headless runner: the autoplayer, or drop the hook whenever it is idle
+static int sim_input(const SimConfig* cfg, const GameState* game) {
+    if (cfg->bot) return bot_input(game);
+    return game->hook_lowering == 0 ? 'h' : GAME_INPUT_NONE;
+}
+
+// Play one complete game and add it to the worker's distributions
+static void play_one(const SimConfig* cfg, GameState* game, SpeedStats* st) {
+    while (!(game_step(game, sim_input(cfg, game)) & GAME_EVENT_OVER)) {
+    }
+    int caught = game->fish_caught_total;
+    int lost = DEFAULT_LIVES - (game->lives > 0 ? game->lives : 0);
+    if (caught >= SIM_MAX_CAUGHT) caught = SIM_MAX_CAUGHT - 1;
+    if (lost > DEFAULT_LIVES) lost = DEFAULT_LIVES;
+
+    st->games++;
+    st->frames += game->frame;
+    st->caught_hist[caught]++;
+    st->lives_lost_hist[lost]++;
+    st->missed_total += game->hooks_missed_total;
+    st->score_total += game->score;
+    st->score_sq_total += (long long)game->score * game->score;
+
+    if (cfg->log_games) {
+        GameStats stats;
+        memset(&stats, 0, sizeof(stats));
+        stats.timestamp = time(NULL);
+        strcpy(stats.player_name, SIM_PLAYER);
+        stats.final_score = game->score;
+        stats.fish_caught = game->fish_caught_total;
+        stats.hooks_missed = game->hooks_missed_total;
+        stats.speed_level = game->speed;
+        stats.lives_remaining = game->lives > 0 ? game->lives : 0;
+        stats.game_duration = (int)(game->frame * game->speed * MS_PER_SPEED_LEVEL / 1000);
+        log_game_stats(&stats);
+    }
+}
+
+/**
+ * Worker thread: claims SIM_CHUNK games at a time until none are left
+ * Each game is fully determined by its index, so the totals do not
+ * depend on how many threads ran or which one played which game.
+ */
+static void* sim_worker(void* arg) {
+    SimWorker* w = arg;
+    const SimConfig* cfg = w->queue->cfg;
+    GameState game;
+
+    if (game_init(&game, cfg->cols, cfg->lines, cfg->fish, cfg->seed) == -1 ||
+        game_set_schooling(&game, cfg->schooling) == -1) {
+        w->failed = 1;
+        return NULL;
+    }
+    for (;;) {
+        long first = __atomic_fetch_add(&w->queue->next, SIM_CHUNK, __ATOMIC_RELAXED);
+        if (first >= w->queue->total) break;
+        long last = first + SIM_CHUNK;
+        if (last > w->queue->total) last = w->queue->total;
+
+        for (long g = first; g < last; g++) {
+            int speed = cfg->speed_min + (int)(g / cfg->games);
+            game_reset(&game, cfg->seed + (unsigned long long)g);
+            game.speed = speed;
+            play_one(cfg, &game, &w->result.speed[speed]);
+        }
+    }
+    game_free(&game);
+    return NULL;
+}
+
+static void merge(SpeedStats* into, const SpeedStats* from) {
+    into->games += from->games;
+    into->frames += from->frames;
+    for (int i = 0; i < SIM_MAX_CAUGHT; i++) into->caught_hist[i] += from->caught_hist[i];
+    for (int i = 0; i <= DEFAULT_LIVES; i++) into->lives_lost_hist[i] += from->lives_lost_hist[i];
+    into->missed_total += from->missed_total;
+    into->score_total += from->score_total;
+    into->score_sq_total += from->score_sq_total;
+}
+
+/**
+ * Run cfg->games games for every speed level on a pool of threads
+ * Returns: 0 on success, -1 if threads or memory ran out
+ */
+int simulate_run(const SimConfig* cfg, SimResult* out) {
+    int threads = cfg->threads;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if (threads > SIM_MAX_THREADS) threads = SIM_MAX_THREADS;
+
+    SimQueue queue = { cfg, cfg->games * (cfg->speed_max - cfg->speed_min + 1), 0 };
+    SimWorker* workers[SIM_MAX_THREADS];
+    pthread_t tids[SIM_MAX_THREADS];
+    int started = 0;
+    int failed = 0;
+
+    memset(out, 0, sizeof(SimResult));
+    long long t0 = sched_clock_ns();
+    for (int i = 0; i < threads; i++) {
+        workers[i] = calloc(1, sizeof(SimWorker));
+        if (workers[i] == NULL) {
+            failed = 1;
+            break;
+        }
+        workers[i]->queue = &queue;
+        if (pthread_create(&tids[i], NULL, sim_worker, workers[i]) != 0) {
+            free(workers[i]);
+            failed = 1;
+            break;
+        }
+        started++;
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+        failed |= workers[i]->failed;
+        for (int s = 0; s <= MAX_SPEED; s++) {
+            merge(&out->speed[s], &workers[i]->result.speed[s]);
+        }
+        free(workers[i]);
+    }
+    out->threads = started;
+    out->seconds = (sched_clock_ns() - t0) / 1e9;
+    return (failed || started == 0) ? -1 : 0;
+}
+
+// Smallest catch count reached by fraction q of the games
+static int caught_quantile(const SpeedStats* st, double q) {
+    long want = (long)ceil(q * st->games);
+    long seen = 0;
+    if (want < 1) want = 1;
+    for (int i = 0; i < SIM_MAX_CAUGHT; i++) {
+        seen += st->caught_hist[i];
+        if (seen >= want) return i;
+    }
+    return SIM_MAX_CAUGHT - 1;
+}
+
+// Score quantile: score is catches x points, so it follows the catch
+// distribution - mirrored when a fish is worth negative points
+static int score_quantile(const SpeedStats* st, int points, double q) {
+    return points * caught_quantile(st, points >= 0 ? q : 1.0 - q);
+}
+
+// Print the distributions, one row per speed level
+void simulate_print(const SimConfig* cfg, const SimResult* res) {
+    long total = 0;
+    for (int s = cfg->speed_min; s <= cfg->speed_max; s++) total += res->speed[s].games;
+
+    printf("Monte Carlo: %ld games per speed, %dx%d pond, %d fish%s%s, seed %llu\n",
+           cfg->games, cfg->cols, cfg->lines, cfg->fish, cfg->schooling ? ", schooling" : "",
+           cfg->bot ? ", bot" : "", cfg->seed);
+    printf("%d threads, %.2f s, %.0f games/s\n\n", res->threads, res->seconds,
+           res->seconds > 0 ? total / res->seconds : 0.0);
+    printf("speed pts/fish  score: mean  stddev  p10  p50  p90   caught  missed  lives lost 0/1/2/3 (%%)   frames\n");
+
+    for (int s = cfg->speed_min; s <= cfg->speed_max; s++) {
+        const SpeedStats* st = &res->speed[s];
+        if (st->games == 0) continue;
+        double n = (double)st->games;
+        double mean = st->score_total / n;
+        double var = st->score_sq_total / n - mean * mean;
+        int points = game_points_per_fish(s);
+        double caught = 0;
+        for (int i = 0; i < SIM_MAX_CAUGHT; i++) caught += (double)i * st->caught_hist[i];
+
+        printf("%5d %8d  %11.2f %7.2f %4d %4d %4d %8.2f %7.2f  ", s, points, mean,
+               var > 0 ? sqrt(var) : 0.0, score_quantile(st, points, 0.1),
+               score_quantile(st, points, 0.5), score_quantile(st, points, 0.9),
+               caught / n, st->missed_total / n);
+        for (int l = 0; l <= DEFAULT_LIVES; l++) {
+            printf("%s%.1f", l ? "/" : "", 100.0 * st->lives_lost_hist[l] / n);
+        }
+        printf("   %6.0f\n", st->frames / n);
+    }
+}
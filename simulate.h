@@ -0,0 +1,45 @@
+#ifndef SIMULATE_H
+#define SIMULATE_H
+
+#include "game.h"
+
+#define SIM_MAX_THREADS 256
+#define SIM_MAX_CAUGHT 256      // catches per game tracked exactly (more are clamped)
+#define SIM_CHUNK 32            // games a worker takes from the queue at a time
+#define SIM_PLAYER "sim"        // player name of logged games
+
+// What to simulate
+typedef struct {
+    long games;                 // games per speed level
+    int threads;                // worker threads (0 = one per CPU)
+    int cols, lines;            // pond size
+    int fish;
+    int schooling;
+    int bot;                    // 1 = bot_input() plays, 0 = drop the hook whenever idle
+    unsigned long long seed;    // game n of speed s uses seed + (s - speed_min) * games + n
+    int speed_min, speed_max;
+    int log_games;              // 1 = log every game as player SIM_PLAYER (needs the stats logger)
+} SimConfig;
+
+// Distributions for one speed level (merged over all threads)
+typedef struct {
+    long games;
+    long frames;
+    long caught_hist[SIM_MAX_CAUGHT];       // games by number of fish caught
+    long lives_lost_hist[DEFAULT_LIVES + 1];
+    long missed_total;
+    long long score_total;
+    long long score_sq_total;
+} SpeedStats;
+
+typedef struct {
+    SpeedStats speed[MAX_SPEED + 1];        // indexed by speed level
+    int threads;
+    double seconds;
+} SimResult;
+
+// Function prototypes
+int simulate_run(const SimConfig* cfg, SimResult* out);
+void simulate_print(const SimConfig* cfg, const SimResult* res);
+
+#endif
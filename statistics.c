@@ -1,6 +1,11 @@
 #include "statistics.h"
+#include "score_tree.h"
+#include "player_index.h"
+#include "stats_store.h"
+#include "stats_logger.h"
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -11,77 +16,165 @@
 #define blue  "\033[34m"
 
 
-// Log game statistics to file
-// System calls used: open(), write(), close(), lseek(), stat()
-int log_game_stats(GameStats* stats) {
-    int fd;
-    struct stat file_stat;
-    
-    // Open file for appending (create if doesn't exist)
-    fd = open(STATS_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd == -1) {
-        perror("Error opening stats file");
-        return -1;
+// Release the sidecars of the log; closing a descriptor drops its lock
+static void close_sidecars(ScoreTree* tree, int have_tree, PlayerIndex* index, int have_index) {
+    if (have_index) player_index_close(index);
+    if (have_tree) score_tree_close(tree);
+}
+
+// Log games, count their scores in the percentile trees and add them
+// to their players' totals - the group commit behind log_game_stats()
+// The append and both updates happen under the sidecars' locks (always
+// taken trees first, then the index, then the log's own lock), so they
+// commit together; a sidecar that cannot be opened does not stop the
+// games being logged, and it counts them the next time it is opened.
+// Games that start a new day also compact the old days, while all
+// three locks are still held
+// Returns: number of games logged (fewer than 'count' on error)
+// System calls used: open(), pread(), pwrite(), close(), flock()
+int log_game_stats_batch(const GameStats* games, int count) {
+    ScoreTree tree;
+    PlayerIndex index;
+    if (count <= 0) return 0;
+    int have_tree = score_tree_open(&tree, STATS_FILE) == 0;
+    if (have_tree && score_tree_lock(&tree) == -1) {
+        score_tree_close(&tree);
+        have_tree = 0;
+    }
+    int have_index = player_index_open(&index, STATS_FILE) == 0;
+    if (have_index && player_index_lock(&index) == -1) {
+        player_index_close(&index);
+        have_index = 0;
     }
     
-    // Get current file size using stat
-    if (fstat(fd, &file_stat) == -1) {
-        perror("Error getting file stats");
-        close(fd);
-        return -1;
+    int lock_fd = stats_store_lock(STATS_FILE);
+    if (lock_fd == -1) {
+        perror("Error locking stats log");
+        close_sidecars(&tree, have_tree, &index, have_index);
+        return 0;
     }
     
-    // Write stats to file
-    ssize_t bytes_written = write(fd, stats, sizeof(GameStats));
-    if (bytes_written != sizeof(GameStats)) {
+    // Append to today's segment (create it if the day is new)
+    int new_day;
+    int logged = stats_store_append(STATS_FILE, games, count, &new_day);
+    if (logged < count) {
         perror("Error writing stats");
-        close(fd);
-        return -1;
     }
     
-    close(fd);
-    return 0;
+    for (int i = 0; i < logged; i++) {
+        if (have_tree) {
+            score_tree_add(&tree, games[i].speed_level, games[i].final_score);
+        }
+        if (have_index) {
+            player_index_add(&index, &games[i]);
+        }
+    }
+    // Compacted days can only be counted as summaries, so compact only
+    // when both sidecars have counted every game
+    if (new_day && have_tree && have_index) {
+        stats_store_compact(STATS_FILE, STATS_STORE_KEEP_DAYS);
+    }
+    stats_store_unlock(lock_fd);
+    close_sidecars(&tree, have_tree, &index, have_index);
+    return logged;
+}
+
+// Log one game: handed to the background logger if one is running
+// (stats_logger_start()), else written before returning
+int log_game_stats(GameStats* stats) {
+    if (stats_logger_push(stats) == 0) {
+        return 0;
+    }
+    return log_game_stats_batch(stats, 1) == 1 ? 0 : -1;
+}
+
+// Compact the days of the stats log older than 'keep_days'
+// Returns: number of days compacted, or -1 on error
+int compact_stats(int keep_days) {
+    ScoreTree tree;
+    PlayerIndex index;
+    if (score_tree_open(&tree, STATS_FILE) == -1 || score_tree_lock(&tree) == -1) {
+        score_tree_close(&tree);
+        return -1;
+    }
+    if (player_index_open(&index, STATS_FILE) == -1 || player_index_lock(&index) == -1) {
+        player_index_close(&index);
+        score_tree_close(&tree);
+        return -1;
+    }
+    int result = -1;
+    int lock_fd = stats_store_lock(STATS_FILE);
+    if (lock_fd != -1) {
+        result = stats_store_compact(STATS_FILE, keep_days);
+        stats_store_unlock(lock_fd);
+    }
+    close_sidecars(&tree, 1, &index, 1);
+    return result;
+}
+
+// Rebuild the sidecars of the stats log from the log itself
+// For recovery after the log was edited, restored or copied without them
+int rebuild_stats_indexes(void) {
+    ScoreTree tree;
+    PlayerIndex index;
+    int result = 0;
+    if (score_tree_open(&tree, STATS_FILE) == -1 || score_tree_lock(&tree) == -1 ||
+        score_tree_rebuild(&tree, STATS_FILE) == -1) {
+        perror("Error rebuilding score trees");
+        result = -1;
+    }
+    score_tree_close(&tree);
+    if (player_index_open(&index, STATS_FILE) == -1 || player_index_lock(&index) == -1 ||
+        player_index_rebuild(&index, STATS_FILE) == -1) {
+        perror("Error rebuilding player index");
+        result = -1;
+    }
+    player_index_close(&index);
+    return result;
+}
+
+// Bring the stats log to the current format now rather than on next use
+// Returns: games in the log, or -1 on error
+long migrate_stats(void) {
+    int lock_fd = stats_store_lock(STATS_FILE);
+    if (lock_fd == -1) return -1;
+    stats_store_unlock(lock_fd);
+    return (long)stats_log_games(STATS_FILE);
 }
 
-// Load game history from file
-// System calls used: open(), read(), close()
+// Load the most recent games from file, oldest first
+// Compacted days have no single games left, so they are not returned
+// System calls used: open(), pread(), close()
 int load_game_history(GameStats history[], int max_entries) {
-    int fd;
-    
-    // Open file for reading
-    fd = open(STATS_FILE, O_RDONLY);
-    if (fd == -1) {
-        // File doesn't exist yet
+    StatsCursor cursor;
+    const GameStats* game;
+    if (max_entries <= 0 || stats_cursor_open(&cursor, STATS_FILE, 1) == -1) {
         return 0;
     }
-    
-    int count = 0;
-    ssize_t bytes_read;
-    
-    // Read all entries
-    while (count < max_entries) {
-        bytes_read = read(fd, &history[count], sizeof(GameStats));
-        if (bytes_read == 0) {
-            break; // End of file
-        }
-        if (bytes_read == -1) {
-            perror("Error reading stats file");
-            close(fd);
-            return count;
-        }
-        if (bytes_read == sizeof(GameStats)) {
-            count++;
-        }
+    int i = max_entries;
+    while (i > 0 && (game = stats_cursor_next(&cursor)) != NULL) {
+        if (!cursor.summary) history[--i] = *game;
     }
-    
-    close(fd);
-    return count;
+    stats_cursor_close(&cursor);
+    if (i > 0) {        // fewer games than asked for
+        memmove(history, history + i, (size_t)(max_entries - i) * sizeof(GameStats));
+    }
+    return max_entries - i;
 }
 
-// Display complete game history
-void display_game_history() {
-    GameStats history[MAX_LOG_ENTRIES];
-    int count = load_game_history(history, MAX_LOG_ENTRIES);
+// Display game history, newest first: the games that ended in
+// [from, to], of one player unless 'player' is NULL, at most 'max_rows'
+// Only the games shown are read, however long the log is, and days that
+// cannot hold any of them are skipped unread
+void display_game_history_range(time_t from, time_t to, const char* player, int max_rows) {
+    StatsCursor cursor;
+    const GameStats* game;
+    if (stats_cursor_open(&cursor, STATS_FILE, 1) == -1) {
+        perror("Error reading stats file");
+        return;
+    }
+    stats_cursor_filter(&cursor, from, to, player);
+    int shown = 0;
     
     printf("\n");
     printf(blue "╔═════════════════════════════════════════════════════════════════════╗\n" reset);
@@ -90,55 +183,90 @@ void display_game_history() {
     printf(blue "║ #  ║ Date         ║ Player       ║ Score ║ Catch ║ Miss  ║ Speed ║ L║\n" reset);
     printf(blue "╠════╬══════════════╬══════════════╬═══════╬═══════╬═══════╬═══════╬══╣\n" reset);
     
-    if (count == 0) {
-        printf(blue "║                    No game history available                         ║\n" reset);
-    } else {
-        // Display most recent games first
-        for (int i = count - 1; i >= 0 && i >= count - 20; i--) {
+    // Display most recent games first (compacted days have no single games)
+    while (shown < max_rows && (game = stats_cursor_next(&cursor)) != NULL) {
+        if (!cursor.summary) {
+            shown++;
             char date_str[12];
-            struct tm* tm_info = localtime(&history[i].timestamp);
+            struct tm* tm_info = localtime(&game->timestamp);
             strftime(date_str, sizeof(date_str), "%Y-%m-%d", tm_info);
             
             printf(blue "║ %-2d ║ %-12s ║ %-12s ║ %5d ║ %5d ║ %5d ║   %d   ║ %d║\n" reset,
-                   count - i,
+                   shown,
                    date_str,
-                   history[i].player_name,
-                   history[i].final_score,
-                   history[i].fish_caught,
-                   history[i].hooks_missed,
-                   history[i].speed_level,
-                   history[i].lives_remaining);
+                   game->player_name,
+                   game->final_score,
+                   game->fish_caught,
+                   game->hooks_missed,
+                   game->speed_level,
+                   game->lives_remaining);
         }
     }
+    uint64_t bad_blocks = cursor.bad_blocks;
+    stats_cursor_close(&cursor);
+    if (shown == 0) {
+        printf(blue "║                    No game history available                         ║\n" reset);
+    }
     
     printf(blue "╚════╩══════════════╩══════════════╩═══════╩═══════╩═══════╩═══════╩══╝\n" reset);
     printf(red "L = Lives Remaining\n" reset);
+    if (bad_blocks > 0) {
+        printf(red "%llu damaged block(s) of %s skipped (with the rest of their day)\n" reset,
+               (unsigned long long)bad_blocks, STATS_FILE);
+    }
+}
+
+// Display the last 20 games
+void display_game_history() {
+    display_game_history_range((time_t)INT64_MIN, (time_t)INT64_MAX, NULL, 20);
+}
+
+// Totals of one player by scanning the whole log (when the index is unusable)
+static void scan_player(const char* player_name, PlayerTotals* totals) {
+    StatsCursor cursor;
+    const GameStats* game;
+    memset(totals, 0, sizeof(PlayerTotals));
+    if (stats_cursor_open(&cursor, STATS_FILE, 0) == -1) {
+        perror("Error reading stats file");
+        return;
+    }
+    // Days without the player are skipped; a compacted summary counts
+    // all its games (its counters are already sums)
+    stats_cursor_filter(&cursor, (time_t)INT64_MIN, (time_t)INT64_MAX, player_name);
+    while ((game = stats_cursor_next(&cursor)) != NULL) {
+        if (totals->games == 0 || game->final_score > totals->best_score) {
+            totals->best_score = game->final_score;
+        }
+        totals->games += (int64_t)cursor.weight;
+        totals->total_score += (int64_t)game->final_score * (int64_t)cursor.weight;
+        totals->caught += game->fish_caught;
+        totals->missed += game->hooks_missed;
+        totals->duration += game->game_duration;
+        for (uint64_t i = 0; i < cursor.weight && i < PLAYER_RECENT_GAMES; i++) {
+            player_recent_add(totals, game->final_score);
+        }
+    }
+    stats_cursor_close(&cursor);
 }
 
 // Display statistics for specific player
+// One probe of the player index; a full scan of the log only if the
+// index cannot be opened
 void display_player_stats(const char* player_name) {
-    GameStats history[MAX_LOG_ENTRIES];
-    int count = load_game_history(history, MAX_LOG_ENTRIES);
-    
-    int total_games = 0;
-    int total_score = 0;
-    int total_caught = 0;
-    int total_missed = 0;
-    int best_score = 0;
-    
-    // Calculate player statistics
-    for (int i = 0; i < count; i++) {
-        if (strcmp(history[i].player_name, player_name) == 0) {
-            total_games++;
-            total_score += history[i].final_score;
-            total_caught += history[i].fish_caught;
-            total_missed += history[i].hooks_missed;
-            if (history[i].final_score > best_score) {
-                best_score = history[i].final_score;
-            }
-        }
+    PlayerIndex index;
+    PlayerTotals totals;
+    memset(&totals, 0, sizeof(totals));
+    if (player_index_open(&index, STATS_FILE) == 0 && player_index_lock(&index) == 0) {
+        player_index_find(&index, player_name, &totals);
+        player_index_close(&index);
+    } else {
+        player_index_close(&index);
+        scan_player(player_name, &totals);
     }
     
+    long long total_games = totals.games;
+    long long total_caught = totals.caught;
+    long long total_missed = totals.missed;
     if (total_games == 0) {
         printf(green "\nNo statistics found for player: %s\n" reset, player_name);
         return;
@@ -148,12 +276,26 @@ void display_player_stats(const char* player_name) {
     printf(green "╔════════════════════════════════════════════════╗\n" reset);
     printf(green "║         PLAYER STATISTICS: %-16s    ║\n" reset, player_name);
     printf(green "╠════════════════════════════════════════════════╣\n" reset);
-    printf(green "║ Total Games Played:        %4d                ║\n" reset, total_games);
-    printf(green "║ Best Score:                %4d                ║\n" reset, best_score);
-    printf(green "║ Average Score:             %4d                ║\n" reset, total_games > 0 ? total_score / total_games : 0);
-    printf(green "║ Total Fish Caught:         %4d                ║\n" reset, total_caught);
-    printf(green "║ Total Hooks Missed:        %4d                ║\n" reset, total_missed);
-    printf(green "║ Catch Rate:                %3d%%                ║\n" reset, 
+    printf(green "║ Total Games Played:        %4lld                ║\n" reset, total_games);
+    printf(green "║ Best Score:                %4d                ║\n" reset, totals.best_score);
+    printf(green "║ Average Score:             %4lld                ║\n" reset, totals.total_score / total_games);
+    printf(green "║ Total Fish Caught:         %4lld                ║\n" reset, total_caught);
+    printf(green "║ Total Hooks Missed:        %4lld                ║\n" reset, total_missed);
+    printf(green "║ Catch Rate:                %3lld%%                ║\n" reset, 
            (total_caught + total_missed) > 0 ? (total_caught * 100) / (total_caught + total_missed) : 0);
+    printf(green "║ Total Play Time:           %4lld s              ║\n" reset, (long long)totals.duration);
+
+    // Moving averages and streak, straight from the index's ring
+    printf(green "╠════════════════════════════════════════════════╣\n" reset);
+    for (int w = 0; w < PLAYER_WINDOWS; w++) {
+        char label[32];
+        snprintf(label, sizeof(label), "Average, Last %d Games:", player_window_size(w));
+        printf(green "║ %-27s%7.1f             ║\n" reset, label, player_window_average(&totals, w));
+    }
+    double trend = player_window_average(&totals, 0) - player_window_average(&totals, PLAYER_WINDOWS - 1);
+    printf(green "║ Trend (last %3d vs %3d):   %+7.1f %-4s        ║\n" reset,
+           player_window_size(0), player_window_size(PLAYER_WINDOWS - 1), trend,
+           trend > 0.05 ? "up" : trend < -0.05 ? "down" : "flat");
+    printf(green "║ Improving Streak:          %4d (best %4d)    ║\n" reset, totals.streak, totals.best_streak);
     printf(green "╚════════════════════════════════════════════════╝\n" reset);
 }
\ No newline at end of file
@@ -3,8 +3,8 @@
 
 #include <time.h>
 
-#define STATS_FILE "game_stats.log"
-#define MAX_LOG_ENTRIES 100
+#define STATS_FILE "game_stats.log"    // segments are game_stats.log.YYYYMMDD
+#define MAX_LOG_ENTRIES 100         // default size of a load_game_history() buffer
 
 typedef struct {
     time_t timestamp;
@@ -19,8 +19,13 @@ typedef struct {
 
 // Function prototypes
 int log_game_stats(GameStats* stats);
+int log_game_stats_batch(const GameStats* games, int count);
+int rebuild_stats_indexes(void);
+int compact_stats(int keep_days);
+long migrate_stats(void);
 int load_game_history(GameStats history[], int max_entries);
 void display_game_history();
+void display_game_history_range(time_t from, time_t to, const char* player, int max_rows);
 void display_player_stats(const char* player_name);
 
 #endif
@@ -0,0 +1,315 @@
+#include "stats_logger.h"
+#include "stats_store.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#define QUEUE_MASK (STATS_LOGGER_QUEUE - 1)
+
+// One queue slot: free for push number 'seq', or holding push number
+// seq - 1 until the writer takes it (bounded MPMC queue after D. Vyukov)
+typedef struct {
+    uint64_t seq;
+    GameStats game;
+} LoggerSlot;
+
+static struct {
+    uint64_t head __attribute__((aligned(64)));     // next push number
+    uint64_t tail __attribute__((aligned(64)));     // next game the writer takes (writer only)
+    int running __attribute__((aligned(64)));       // pushes are accepted
+    int pushers;                                    // pushes between the check and the publish
+    int sleeping;                                   // writer is (about to be) in poll()
+    int stopping;
+    volatile sig_atomic_t signal;                   // SIGINT/SIGTERM to die of once flushed
+    int fsync_ms;
+    int wake_fd;                                    // eventfd that wakes the writer
+    pthread_t thread;
+    pthread_mutex_t lock;                           // 'committed' and the flush waiters
+    pthread_cond_t done;
+    uint64_t committed;                             // pushes logged (or given up on)
+    StatsLoggerCounters counters;
+    struct sigaction old_int, old_term;
+    LoggerSlot slots[STATS_LOGGER_QUEUE];
+} logger = { .wake_fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER, .done = PTHREAD_COND_INITIALIZER };
+
+static GameStats batch[STATS_LOGGER_BATCH];        // writer thread only
+
+// System calls used: write()
+static void wake_writer(void) {
+    uint64_t one = 1;
+    ssize_t n = write(logger.wake_fd, &one, sizeof(one));
+    (void)n;    // the counter cannot overflow: the writer reads it on every wake-up
+}
+
+// Wake the writer only if it sleeps; the fence orders the caller's
+// publish before the check (the writer sets 'sleeping', then looks)
+static void nudge_writer(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&logger.sleeping, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&logger.sleeping, 0, __ATOMIC_SEQ_CST)) {
+        wake_writer();
+    }
+}
+
+// Flush what is queued, then die of the signal as if it had not been caught
+static void on_signal(int sig) {
+    logger.signal = sig;
+    wake_writer();
+}
+
+static int queue_ready(void) {
+    const LoggerSlot* slot = &logger.slots[logger.tail & QUEUE_MASK];
+    return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == logger.tail + 1;
+}
+
+// Take up to 'max' queued games, oldest first
+static int pop_games(GameStats* out, int max) {
+    int n = 0;
+    while (n < max && queue_ready()) {
+        LoggerSlot* slot = &logger.slots[logger.tail & QUEUE_MASK];
+        out[n++] = slot->game;
+        __atomic_store_n(&slot->seq, logger.tail + STATS_LOGGER_QUEUE, __ATOMIC_RELEASE);
+        logger.tail++;
+    }
+    return n;
+}
+
+static void publish_committed(uint64_t games) {
+    pthread_mutex_lock(&logger.lock);
+    logger.committed += games;
+    pthread_cond_broadcast(&logger.done);
+    pthread_mutex_unlock(&logger.lock);
+}
+
+// Stop accepting pushes and wait for the ones already past the check
+static void close_queue(void) {
+    __atomic_store_n(&logger.running, 0, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&logger.pushers, __ATOMIC_SEQ_CST) > 0) {
+        sched_yield();
+    }
+}
+
+/**
+ * Writer thread: group commit of everything queued, then sleep until a
+ * push, the next fsync, or stop. Games whose commit failed stay at the
+ * front of the batch and are retried; when stopping they are given up
+ * after STATS_LOGGER_STOP_TRIES attempts.
+ * System calls used: poll(), read(), fdatasync() (stats_store_sync())
+ */
+static void* writer_main(void* arg) {
+    (void)arg;
+    int pending = 0;
+    int failures = 0;
+    int dirty = 0;
+    long long last_sync = sched_clock_ns();
+
+    for (;;) {
+        int stopping = __atomic_load_n(&logger.stopping, __ATOMIC_ACQUIRE);
+        if (logger.signal != 0) {
+            // from now on log_game_stats() writes directly; pushes already
+            // past the check still land in the queue and are drained below
+            __atomic_store_n(&logger.running, 0, __ATOMIC_SEQ_CST);
+            stopping = 1;
+        }
+        pending += pop_games(batch + pending, STATS_LOGGER_BATCH - pending);
+
+        if (pending > 0) {
+            int logged = log_game_stats_batch(batch, pending);
+            logger.counters.commits++;
+            if (logged > 0) {
+                memmove(batch, batch + logged, (size_t)(pending - logged) * sizeof(GameStats));
+                pending -= logged;
+                logger.counters.logged += logged;
+                failures = 0;
+                dirty = 1;
+                publish_committed((uint64_t)logged);
+            }
+            if (pending > 0) {
+                if (++failures >= STATS_LOGGER_STOP_TRIES && stopping) {
+                    fprintf(stderr, "Stats logger: %d game(s) could not be written to %s\n", pending, STATS_FILE);
+                    logger.counters.failed += pending;
+                    publish_committed((uint64_t)pending);
+                    pending = 0;
+                } else {
+                    poll(NULL, 0, STATS_LOGGER_RETRY_MS);
+                }
+                continue;
+            }
+        }
+
+        long long now = sched_clock_ns();
+        long long sync_at = last_sync + (long long)logger.fsync_ms * 1000000LL;
+        if (dirty && logger.fsync_ms > 0 && (now >= sync_at || stopping)) {
+            stats_store_sync(STATS_FILE);
+            logger.counters.syncs++;
+            last_sync = now;
+            dirty = 0;
+        }
+        if (stopping) {
+            // done once no push is in flight (pushers publish, then leave)
+            if (__atomic_load_n(&logger.pushers, __ATOMIC_SEQ_CST) == 0 && !queue_ready()) break;
+            sched_yield();
+            continue;
+        }
+        if (queue_ready()) continue;
+
+        // Sleep until a push (which sees 'sleeping' after publishing),
+        // stop, a signal, or the next fsync
+        __atomic_store_n(&logger.sleeping, 1, __ATOMIC_SEQ_CST);
+        if (queue_ready() || logger.signal != 0) {
+            __atomic_store_n(&logger.sleeping, 0, __ATOMIC_SEQ_CST);
+            continue;
+        }
+        int timeout = -1;
+        if (dirty && logger.fsync_ms > 0) {
+            timeout = (int)((sync_at - now) / 1000000LL) + 1;
+        }
+        struct pollfd pfd = { logger.wake_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout) > 0) {
+            uint64_t wakes;
+            ssize_t n = read(logger.wake_fd, &wakes, sizeof(wakes));
+            (void)n;
+        }
+        __atomic_store_n(&logger.sleeping, 0, __ATOMIC_SEQ_CST);
+    }
+
+    if (logger.signal != 0) {
+        int sig = logger.signal;
+        sigaction(SIGINT, &logger.old_int, NULL);
+        sigaction(SIGTERM, &logger.old_term, NULL);
+        raise(sig);
+    }
+    return NULL;
+}
+
+/**
+ * Start the background writer; from now on log_game_stats() only queues
+ * SIGINT and SIGTERM are caught until stats_logger_stop(), so a run
+ * that is interrupted still writes every queued game before it dies.
+ * Returns: 0 on success (or already running), -1 on error
+ * System calls used: eventfd(), sigaction()
+ */
+int stats_logger_start(int fsync_ms) {
+    static int registered = 0;
+    if (__atomic_load_n(&logger.running, __ATOMIC_ACQUIRE)) return 0;
+
+    for (uint64_t i = 0; i < STATS_LOGGER_QUEUE; i++) {
+        logger.slots[i].seq = i;
+    }
+    logger.head = 0;
+    logger.tail = 0;
+    logger.committed = 0;
+    logger.stopping = 0;
+    logger.signal = 0;
+    logger.fsync_ms = fsync_ms > 0 ? fsync_ms : 0;
+    memset(&logger.counters, 0, sizeof(logger.counters));
+    logger.wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (logger.wake_fd == -1) {
+        perror("Error creating stats logger wake-up");
+        return -1;
+    }
+    if (pthread_create(&logger.thread, NULL, writer_main, NULL) != 0) {
+        perror("Error starting stats logger");
+        close(logger.wake_fd);
+        logger.wake_fd = -1;
+        return -1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, &logger.old_int);
+    sigaction(SIGTERM, &sa, &logger.old_term);
+    __atomic_store_n(&logger.running, 1, __ATOMIC_RELEASE);
+    if (!registered) {
+        atexit(stats_logger_stop);
+        registered = 1;
+    }
+    return 0;
+}
+
+/**
+ * Queue one game for the writer (any thread)
+ * Waits while the queue is full.
+ * Returns: 0 if queued, -1 if the logger is not running
+ */
+int stats_logger_push(const GameStats* game) {
+    __atomic_fetch_add(&logger.pushers, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&logger.running, __ATOMIC_SEQ_CST)) {
+        __atomic_fetch_sub(&logger.pushers, 1, __ATOMIC_SEQ_CST);
+        return -1;
+    }
+    uint64_t pos = __atomic_load_n(&logger.head, __ATOMIC_RELAXED);
+    for (;;) {
+        LoggerSlot* slot = &logger.slots[pos & QUEUE_MASK];
+        int64_t diff = (int64_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&logger.head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                slot->game = *game;
+                __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+                break;
+            }
+        } else if (diff < 0) {
+            // full: the writer is behind by a whole queue
+            nudge_writer();
+            sched_yield();
+            pos = __atomic_load_n(&logger.head, __ATOMIC_RELAXED);
+        } else {
+            pos = __atomic_load_n(&logger.head, __ATOMIC_RELAXED);
+        }
+    }
+    nudge_writer();
+    __atomic_fetch_sub(&logger.pushers, 1, __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+/**
+ * Wait until every game queued before the call is in the log
+ * Returns: 0 (also when the logger is not running)
+ */
+int stats_logger_flush(void) {
+    if (!__atomic_load_n(&logger.running, __ATOMIC_ACQUIRE)) return 0;
+    uint64_t target = __atomic_load_n(&logger.head, __ATOMIC_ACQUIRE);
+    nudge_writer();
+    pthread_mutex_lock(&logger.lock);
+    while (logger.committed < target) {
+        pthread_cond_wait(&logger.done, &logger.lock);
+    }
+    pthread_mutex_unlock(&logger.lock);
+    return 0;
+}
+
+/**
+ * Write every queued game, sync if fsync_ms was set, and end the writer
+ * Registered with atexit() by stats_logger_start(); safe to call twice.
+ * System calls used: sigaction(), close()
+ */
+void stats_logger_stop(void) {
+    if (!__atomic_load_n(&logger.running, __ATOMIC_ACQUIRE)) return;
+    close_queue();
+    __atomic_store_n(&logger.stopping, 1, __ATOMIC_RELEASE);
+    wake_writer();
+    pthread_join(logger.thread, NULL);
+    sigaction(SIGINT, &logger.old_int, NULL);
+    sigaction(SIGTERM, &logger.old_term, NULL);
+    close(logger.wake_fd);
+    logger.wake_fd = -1;
+}
+
+// What the logger has done since it was started
+void stats_logger_counters(StatsLoggerCounters* out) {
+    pthread_mutex_lock(&logger.lock);
+    *out = logger.counters;
+    out->pushed = (long long)__atomic_load_n(&logger.head, __ATOMIC_ACQUIRE);
+    pthread_mutex_unlock(&logger.lock);
+}
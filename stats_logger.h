@@ -0,0 +1,39 @@
+#ifndef STATS_LOGGER_H
+#define STATS_LOGGER_H
+
+#include "statistics.h"
+
+#define STATS_LOGGER_QUEUE 8192         // games waiting for the writer (power of two)
+#define STATS_LOGGER_BATCH 4096         // most games written by one group commit
+#define STATS_LOGGER_RETRY_MS 100       // wait before retrying a failed commit
+#define STATS_LOGGER_STOP_TRIES 3       // failed commits at exit before giving up
+
+/**
+ * Background writer for the stats log
+ * log_game_stats() pushes the game into a bounded lock-free queue (any
+ * number of threads may push) and returns. One writer thread drains
+ * the queue and logs everything it found with one log_game_stats_batch()
+ * call - one set of locks, one pwrite() per day - so under load the cost
+ * per game falls with the batch size. A full queue makes the pusher
+ * wait for room: no game is ever dropped. stats_logger_stop() (also run
+ * at exit) writes whatever is still queued before it returns.
+ *
+ * fsync_ms > 0 also flushes the log to disk at most that long after a
+ * game was written; 0 leaves it to the kernel, like a direct append.
+ */
+typedef struct {
+    long long pushed;           // games queued since start
+    long long logged;           // games written to the log
+    long long commits;          // log_game_stats_batch() calls
+    long long syncs;            // fdatasync() calls
+    long long failed;           // games given up on at stop
+} StatsLoggerCounters;
+
+// Function prototypes
+int stats_logger_start(int fsync_ms);
+int stats_logger_push(const GameStats* game);
+int stats_logger_flush(void);
+void stats_logger_stop(void);
+void stats_logger_counters(StatsLoggerCounters* out);
+
+#endif
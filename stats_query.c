@@ -0,0 +1,478 @@
+#include "stats_query.h"
+#include "stats_store.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define NAME_LEN 20
+#define QUERY_TRIES 3           // scans restarted when a day is sealed or compacted under them
+
+static const double percentiles[STATS_QUERY_PERCENTILES] = { 0.50, 0.90, 0.99 };
+
+// Exact distribution of one field: value -> games (open addressing)
+typedef struct {
+    int* values;
+    uint64_t* counts;           // 0 = free slot
+    size_t cap;                 // power of two
+    size_t used;
+} ValueHist;
+
+typedef struct {
+    int value;
+    uint64_t count;
+} ValueCount;
+
+typedef struct {
+    StatsQueryRow row;          // sums and extremes; percentiles filled in at the end
+    ValueHist scores;
+    ValueHist durations;
+} QueryGroup;
+
+// Groups of one worker (or the merged result), found by hashing the key
+typedef struct {
+    StatsGroupBy by;
+    QueryGroup* groups;
+    int count;
+    int cap;
+    int* index;                 // group number + 1, 0 = free slot
+    int index_cap;              // power of two
+    int last;                   // group of the previous game: runs of one key are common
+} GroupTable;
+
+// Shared by the workers; the only thing they write is the slice counter
+typedef struct {
+    const char* path;
+    const StatsQuery* q;
+    const StatsSlice* slices;
+    int count;
+    int next;                   // next unclaimed slice (atomic)
+} QueryQueue;
+
+// One per thread, allocated separately so tables never share a cache line
+typedef struct {
+    QueryQueue* queue;
+    GroupTable table;
+    long long records;
+    uint64_t bad_blocks;
+    int failed;                 // out of memory or unreadable log
+    int changed;                // a slice's day was rewritten since slicing
+} QueryWorker;
+
+static uint32_t hash_int(int64_t v) {
+    return (uint32_t)(((uint64_t)v * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+// FNV-1a over a zero-padded name
+static uint32_t hash_name(const char* name) {
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < NAME_LEN && name[i] != '\0'; i++) {
+        h = (h ^ (unsigned char)name[i]) * 16777619u;
+    }
+    return h;
+}
+
+static int hist_grow(ValueHist* h) {
+    size_t cap = h->cap > 0 ? h->cap * 2 : 64;
+    int* values = malloc(cap * sizeof(int));
+    uint64_t* counts = calloc(cap, sizeof(uint64_t));
+    if (values == NULL || counts == NULL) {
+        free(values);
+        free(counts);
+        return -1;
+    }
+    for (size_t i = 0; i < h->cap; i++) {
+        if (h->counts[i] == 0) continue;
+        size_t j = hash_int(h->values[i]) & (cap - 1);
+        while (counts[j] != 0) j = (j + 1) & (cap - 1);
+        values[j] = h->values[i];
+        counts[j] = h->counts[i];
+    }
+    free(h->values);
+    free(h->counts);
+    h->values = values;
+    h->counts = counts;
+    h->cap = cap;
+    return 0;
+}
+
+static int hist_add(ValueHist* h, int value, uint64_t games) {
+    if ((h->used + 1) * 2 > h->cap && hist_grow(h) == -1) return -1;
+    size_t j = hash_int(value) & (h->cap - 1);
+    while (h->counts[j] != 0 && h->values[j] != value) j = (j + 1) & (h->cap - 1);
+    if (h->counts[j] == 0) {
+        h->values[j] = value;
+        h->used++;
+    }
+    h->counts[j] += games;
+    return 0;
+}
+
+static int hist_merge(ValueHist* into, const ValueHist* from) {
+    for (size_t i = 0; i < from->cap; i++) {
+        if (from->counts[i] != 0 && hist_add(into, from->values[i], from->counts[i]) == -1) return -1;
+    }
+    return 0;
+}
+
+static int compare_values(const void* a, const void* b) {
+    const ValueCount* x = a;
+    const ValueCount* y = b;
+    return (x->value > y->value) - (x->value < y->value);
+}
+
+// Nearest-rank percentiles of 'games' games: sort the distinct values once
+static int hist_percentiles(const ValueHist* h, long long games, int out[STATS_QUERY_PERCENTILES]) {
+    ValueCount* sorted = malloc((h->used > 0 ? h->used : 1) * sizeof(ValueCount));
+    if (sorted == NULL) return -1;
+    size_t n = 0;
+    for (size_t i = 0; i < h->cap; i++) {
+        if (h->counts[i] == 0) continue;
+        sorted[n].value = h->values[i];
+        sorted[n++].count = h->counts[i];
+    }
+    qsort(sorted, n, sizeof(ValueCount), compare_values);
+    for (int q = 0; q < STATS_QUERY_PERCENTILES; q++) {
+        long long want = (long long)(percentiles[q] * games + 0.999999);
+        long long seen = 0;
+        size_t i = 0;
+        if (want < 1) want = 1;
+        while (i + 1 < n && seen + (long long)sorted[i].count < want) {
+            seen += (long long)sorted[i++].count;
+        }
+        out[q] = n > 0 ? sorted[i].value : 0;
+    }
+    free(sorted);
+    return 0;
+}
+
+static void table_free(GroupTable* t) {
+    for (int i = 0; i < t->count; i++) {
+        free(t->groups[i].scores.values);
+        free(t->groups[i].scores.counts);
+        free(t->groups[i].durations.values);
+        free(t->groups[i].durations.counts);
+    }
+    free(t->groups);
+    free(t->index);
+    memset(t, 0, sizeof(GroupTable));
+}
+
+static int same_group(const GroupTable* t, const QueryGroup* g, const char* player, int64_t key) {
+    if (t->by == STATS_GROUP_PLAYER) return strncmp(g->row.player, player, NAME_LEN) == 0;
+    return g->row.key == key;
+}
+
+static uint32_t hash_group(const GroupTable* t, const char* player, int64_t key) {
+    return t->by == STATS_GROUP_PLAYER ? hash_name(player) : hash_int(key);
+}
+
+static int index_grow(GroupTable* t) {
+    int cap = t->index_cap > 0 ? t->index_cap * 2 : 64;
+    int* index = calloc((size_t)cap, sizeof(int));
+    if (index == NULL) return -1;
+    for (int i = 0; i < t->count; i++) {
+        const QueryGroup* g = &t->groups[i];
+        uint32_t j = hash_group(t, g->row.player, g->row.key) & (uint32_t)(cap - 1);
+        while (index[j] != 0) j = (j + 1) & (uint32_t)(cap - 1);
+        index[j] = i + 1;
+    }
+    free(t->index);
+    t->index = index;
+    t->index_cap = cap;
+    return 0;
+}
+
+/**
+ * The group of a key, created empty if it is new
+ * Returns: the group, or NULL if memory ran out
+ */
+static QueryGroup* find_group(GroupTable* t, const char* player, int64_t key) {
+    if (t->last >= 0 && same_group(t, &t->groups[t->last], player, key)) return &t->groups[t->last];
+    if ((t->count + 1) * 2 > t->index_cap && index_grow(t) == -1) return NULL;
+    uint32_t j = hash_group(t, player, key) & (uint32_t)(t->index_cap - 1);
+    while (t->index[j] != 0) {
+        if (same_group(t, &t->groups[t->index[j] - 1], player, key)) {
+            t->last = t->index[j] - 1;
+            return &t->groups[t->last];
+        }
+        j = (j + 1) & (uint32_t)(t->index_cap - 1);
+    }
+    if (t->count == t->cap) {
+        int cap = t->cap > 0 ? t->cap * 2 : 16;
+        QueryGroup* grown = realloc(t->groups, (size_t)cap * sizeof(QueryGroup));
+        if (grown == NULL) return NULL;
+        t->groups = grown;
+        t->cap = cap;
+    }
+    QueryGroup* g = &t->groups[t->count];
+    memset(g, 0, sizeof(QueryGroup));
+    if (t->by == STATS_GROUP_PLAYER) memcpy(g->row.player, player, strnlen(player, NAME_LEN));
+    g->row.key = key;
+    g->row.score_min = INT_MAX;
+    g->row.score_max = INT_MIN;
+    g->row.duration_min = INT_MAX;
+    g->row.duration_max = INT_MIN;
+    t->index[j] = ++t->count;
+    t->last = t->count - 1;
+    return g;
+}
+
+// Add one record - a game, or a compacted summary of 'weight' games
+static int add_game(GroupTable* t, int32_t day, const GameStats* game, uint64_t weight, int summary) {
+    int64_t key = t->by == STATS_GROUP_DAY ? day : t->by == STATS_GROUP_SPEED ? game->speed_level : 0;
+    QueryGroup* g = find_group(t, game->player_name, key);
+    if (g == NULL) return -1;
+    StatsQueryRow* r = &g->row;
+    int duration = summary ? (int)(game->game_duration / (long long)weight) : game->game_duration;
+
+    r->games += (long long)weight;
+    r->score_sum += (long long)game->final_score * (long long)weight;
+    r->duration_sum += game->game_duration;     // a summary's is already the sum
+    r->caught += game->fish_caught;
+    r->missed += game->hooks_missed;
+    if (game->final_score < r->score_min) r->score_min = game->final_score;
+    if (game->final_score > r->score_max) r->score_max = game->final_score;
+    if (duration < r->duration_min) r->duration_min = duration;
+    if (duration > r->duration_max) r->duration_max = duration;
+    if (summary && weight > 1) r->duration_approx = 1;
+    if (hist_add(&g->scores, game->final_score, weight) == -1) return -1;
+    return hist_add(&g->durations, duration, weight);
+}
+
+static int merge_group(GroupTable* into, const QueryGroup* from) {
+    QueryGroup* g = find_group(into, from->row.player, from->row.key);
+    if (g == NULL) return -1;
+    StatsQueryRow* r = &g->row;
+    r->games += from->row.games;
+    r->score_sum += from->row.score_sum;
+    r->duration_sum += from->row.duration_sum;
+    r->caught += from->row.caught;
+    r->missed += from->row.missed;
+    if (from->row.score_min < r->score_min) r->score_min = from->row.score_min;
+    if (from->row.score_max > r->score_max) r->score_max = from->row.score_max;
+    if (from->row.duration_min < r->duration_min) r->duration_min = from->row.duration_min;
+    if (from->row.duration_max > r->duration_max) r->duration_max = from->row.duration_max;
+    r->duration_approx |= from->row.duration_approx;
+    if (hist_merge(&g->scores, &from->scores) == -1) return -1;
+    return hist_merge(&g->durations, &from->durations);
+}
+
+/**
+ * Worker thread: claims one slice at a time until none are left and
+ * aggregates its games into the worker's own table
+ */
+static void* query_worker(void* arg) {
+    QueryWorker* w = arg;
+    const StatsQuery* q = w->queue->q;
+    StatsCursor* c = malloc(sizeof(StatsCursor));
+
+    if (c == NULL || stats_cursor_open(c, w->queue->path, 0) == -1) {
+        free(c);
+        w->failed = 1;
+        return NULL;
+    }
+    stats_cursor_filter(c, q->from, q->to, q->player);
+    while (!w->failed) {
+        int i = __atomic_fetch_add(&w->queue->next, 1, __ATOMIC_RELAXED);
+        if (i >= w->queue->count) break;
+        const StatsSlice* slice = &w->queue->slices[i];
+        if (stats_cursor_slice(c, slice) == -1) {
+            w->changed = 1;
+            break;
+        }
+        const GameStats* game;
+        while ((game = stats_cursor_next(c)) != NULL) {
+            if (q->speed != 0 && game->speed_level != q->speed) continue;
+            w->records++;
+            if (add_game(&w->table, slice->day, game, c->weight, c->summary) == -1) {
+                w->failed = 1;
+                break;
+            }
+        }
+    }
+    w->bad_blocks = c->bad_blocks;
+    stats_cursor_close(c);
+    free(c);
+    return NULL;
+}
+
+static int compare_rows_by_player(const void* a, const void* b) {
+    return strncmp(((const StatsQueryRow*)a)->player, ((const StatsQueryRow*)b)->player, NAME_LEN);
+}
+
+static int compare_rows_by_key(const void* a, const void* b) {
+    const StatsQueryRow* x = a;
+    const StatsQueryRow* y = b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+/**
+ * Slice the log and aggregate the slices on a pool of threads
+ * Returns: 0 on success, 1 if a day was rewritten under the scan (try
+ * again), -1 on error
+ */
+static int query_once(const char* path, const StatsQuery* q, GroupTable* total, StatsQueryResult* out) {
+    StatsCursor* c = malloc(sizeof(StatsCursor));
+    if (c == NULL || stats_cursor_open(c, path, 0) == -1) {
+        free(c);
+        return -1;
+    }
+    stats_cursor_filter(c, q->from, q->to, q->player);
+
+    int threads = q->threads;
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if (threads > STATS_QUERY_MAX_THREADS) threads = STATS_QUERY_MAX_THREADS;
+    uint64_t bytes = 0;
+    for (int i = 0; i < c->store.count; i++) {
+        const StatsSegmentHeader* h = stats_store_segment(&c->store, i);
+        if (h != NULL) bytes += h->data_end - sizeof(StatsSegmentHeader);
+    }
+    bytes /= (uint64_t)threads * STATS_QUERY_SLICES_PER_THREAD;
+    if (bytes < STATS_QUERY_MIN_SLICE) bytes = STATS_QUERY_MIN_SLICE;
+    if (q->slice_bytes > 0) bytes = (uint64_t)q->slice_bytes;
+    StatsSlice* slices;
+    int count = stats_cursor_slices(c, bytes, &slices);
+    stats_cursor_close(c);
+    free(c);
+    if (count == -1) return -1;
+    if (threads > count) threads = count;
+
+    QueryQueue queue = { path, q, slices, count, 0 };
+    QueryWorker* workers[STATS_QUERY_MAX_THREADS];
+    pthread_t tids[STATS_QUERY_MAX_THREADS];
+    int started = 0;
+    int result = 0;
+    for (int i = 0; i < threads; i++) {
+        workers[i] = calloc(1, sizeof(QueryWorker));
+        if (workers[i] == NULL) {
+            result = -1;
+            break;
+        }
+        workers[i]->queue = &queue;
+        workers[i]->table.by = q->group;
+        workers[i]->table.last = -1;
+        if (pthread_create(&tids[i], NULL, query_worker, workers[i]) != 0) {
+            free(workers[i]);
+            result = -1;
+            break;
+        }
+        started++;
+    }
+    for (int i = 0; i < started; i++) {
+        QueryWorker* w = workers[i];
+        pthread_join(tids[i], NULL);
+        if (w->failed) result = -1;
+        if (w->changed && result == 0) result = 1;
+        for (int g = 0; g < w->table.count && result == 0; g++) {
+            if (merge_group(total, &w->table.groups[g]) == -1) result = -1;
+        }
+        out->records += w->records;
+        out->bad_blocks += w->bad_blocks;
+        table_free(&w->table);
+        free(w);
+    }
+    free(slices);
+    out->threads = started;
+    out->slices = count;
+    return result;
+}
+
+/**
+ * Run a query over the stats log at 'path'
+ * Every slice of every day the filter does not rule out is read once,
+ * by whichever worker claims it; readers take no lock.
+ * Returns: 0 on success, -1 on error (out->rows is empty)
+ */
+int stats_query_run(const char* path, const StatsQuery* q, StatsQueryResult* out) {
+    GroupTable total;
+    int result = 1;
+    long long t0 = sched_clock_ns();
+    memset(out, 0, sizeof(StatsQueryResult));
+    memset(&total, 0, sizeof(total));
+    for (int tries = 0; tries < QUERY_TRIES && result == 1; tries++) {
+        table_free(&total);
+        total.by = q->group;
+        total.last = -1;
+        memset(out, 0, sizeof(StatsQueryResult));
+        result = query_once(path, q, &total, out);
+    }
+    if (result == 0 && total.count > 0) {
+        out->rows = malloc((size_t)total.count * sizeof(StatsQueryRow));
+        if (out->rows == NULL) result = -1;
+    }
+    for (int i = 0; i < total.count && result == 0; i++) {
+        QueryGroup* g = &total.groups[i];
+        if (hist_percentiles(&g->scores, g->row.games, g->row.score_pct) == -1 ||
+            hist_percentiles(&g->durations, g->row.games, g->row.duration_pct) == -1) {
+            result = -1;
+        }
+        out->rows[out->count++] = g->row;
+    }
+    table_free(&total);
+    if (result != 0) {
+        stats_query_free(out);
+        return -1;
+    }
+    qsort(out->rows, (size_t)out->count, sizeof(StatsQueryRow),
+          q->group == STATS_GROUP_PLAYER ? compare_rows_by_player : compare_rows_by_key);
+    out->seconds = (sched_clock_ns() - t0) / 1e9;
+    return 0;
+}
+
+void stats_query_free(StatsQueryResult* res) {
+    free(res->rows);
+    res->rows = NULL;
+    res->count = 0;
+}
+
+/**
+ * Print a query result as a table: one row per group with the score
+ * and duration aggregates and the catch rate
+ */
+void stats_query_print(const StatsQuery* q, const StatsQueryResult* res) {
+    static const char* labels[] = { "all", "player", "day", "speed" };
+    int approx = 0;
+    printf("Games of %s by %s: %lld records, %d slice(s) on %d thread(s), %.3f s\n",
+           STATS_FILE, q->group == STATS_GROUP_NONE ? "nothing" : labels[q->group],
+           res->records, res->slices, res->threads, res->seconds);
+    printf("  %-20s %10s | %12s %7s %6s %6s %6s %6s %6s | %6s | %7s %6s %6s %6s %6s %6s\n",
+           labels[q->group], "games", "score sum", "avg", "min", "max", "p50", "p90", "p99",
+           "catch%", "avg s", "min", "max", "p50", "p90", "p99");
+    for (int i = 0; i < res->count; i++) {
+        const StatsQueryRow* r = &res->rows[i];
+        char key[32];
+        if (q->group == STATS_GROUP_PLAYER) {
+            snprintf(key, sizeof(key), "%.20s", r->player);
+        } else if (q->group == STATS_GROUP_DAY) {
+            snprintf(key, sizeof(key), "%04d-%02d-%02d",
+                     (int)(r->key / 10000), (int)(r->key / 100 % 100), (int)(r->key % 100));
+        } else if (q->group == STATS_GROUP_SPEED) {
+            snprintf(key, sizeof(key), "%d", (int)r->key);
+        } else {
+            snprintf(key, sizeof(key), "all");
+        }
+        long long shots = r->caught + r->missed;
+        printf("  %-20s %10lld | %12lld %7.1f %6d %6d %6d %6d %6d | %5.1f%% | %7.1f %6d %6d %6d %6d %6d%s\n",
+               key, r->games, r->score_sum, (double)r->score_sum / r->games, r->score_min, r->score_max,
+               r->score_pct[0], r->score_pct[1], r->score_pct[2],
+               shots > 0 ? 100.0 * r->caught / shots : 0.0,
+               (double)r->duration_sum / r->games, r->duration_min, r->duration_max,
+               r->duration_pct[0], r->duration_pct[1], r->duration_pct[2], r->duration_approx ? " ~" : "");
+        approx |= r->duration_approx;
+    }
+    if (res->count == 0) {
+        printf("  No games match\n");
+    }
+    if (approx) {
+        printf("~ includes compacted days: their games' durations are known only as an average\n");
+    }
+    if (res->bad_blocks > 0) {
+        printf("%llu damaged block(s) of %s skipped (with the rest of their slice)\n",
+               (unsigned long long)res->bad_blocks, STATS_FILE);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef STATS_QUERY_H
+#define STATS_QUERY_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define STATS_QUERY_MAX_THREADS 64
+#define STATS_QUERY_SLICES_PER_THREAD 4     // slices per worker, so a slow one can be caught up on
+#define STATS_QUERY_MIN_SLICE (1 << 20)     // bytes of blocks below which a slice is not cut further
+#define STATS_QUERY_PERCENTILES 3           // p50, p90, p99
+
+typedef enum {
+    STATS_GROUP_NONE,
+    STATS_GROUP_PLAYER,
+    STATS_GROUP_DAY,
+    STATS_GROUP_SPEED
+} StatsGroupBy;
+
+// Which games to aggregate and how to group them
+typedef struct {
+    time_t from, to;            // games that ended in [from, to]
+    const char* player;         // NULL = every player
+    int speed;                  // 0 = every speed level
+    StatsGroupBy group;
+    int threads;                // 0 = one per CPU
+    long slice_bytes;           // 0 = sized from the log and the thread count
+} StatsQuery;
+
+/**
+ * Aggregates of one group
+ * Percentiles are exact (nearest rank, like the score trees). A game of
+ * a compacted day is only known through its summary: its score is
+ * exact, its duration is the summary's average (duration_approx).
+ */
+typedef struct {
+    char player[20];            // STATS_GROUP_PLAYER
+    int64_t key;                // yyyymmdd or speed level for the other groupings
+    long long games;
+    long long score_sum;
+    int score_min, score_max;
+    int score_pct[STATS_QUERY_PERCENTILES];
+    long long duration_sum;
+    int duration_min, duration_max;
+    int duration_pct[STATS_QUERY_PERCENTILES];
+    int duration_approx;
+    long long caught;
+    long long missed;
+} StatsQueryRow;
+
+typedef struct {
+    StatsQueryRow* rows;        // ordered by player, day or speed
+    int count;
+    int threads;
+    int slices;
+    long long records;          // records read that matched (a summary is one)
+    uint64_t bad_blocks;
+    double seconds;
+} StatsQueryResult;
+
+// Function prototypes
+int stats_query_run(const char* path, const StatsQuery* q, StatsQueryResult* out);
+void stats_query_print(const StatsQuery* q, const StatsQueryResult* res);
+void stats_query_free(StatsQueryResult* res);
+
+#endif
@@ -0,0 +1,1302 @@
+#include "stats_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#define NAME_LEN 20     // GameStats.player_name
+#define LOCK_NEWEST_OFF sizeof(uint32_t)    // lock file: format, then the newest segment's day
+
+// yyyymmdd of a moment, local time
+int stats_day_of(time_t when) {
+    struct tm tm_info;
+    localtime_r(&when, &tm_info);
+    return (tm_info.tm_year + 1900) * 10000 + (tm_info.tm_mon + 1) * 100 + tm_info.tm_mday;
+}
+
+static void segment_name(char* out, size_t size, const char* path, int32_t day) {
+    snprintf(out, size, "%s.%08d", path, (int)day);
+}
+
+// Zero-padded copy of a name, so names compare with memcmp()
+static void make_key(char key[NAME_LEN], const char* name) {
+    memset(key, 0, NAME_LEN);
+    memcpy(key, name, strnlen(name, NAME_LEN));
+}
+
+#define V1_HEADER_SIZE offsetof(StatsSegmentHeader, base_time)    // before blocks
+
+// System calls used: pwrite()
+static int write_at(int fd, const void* data, size_t size, off_t offset) {
+    const unsigned char* p = data;
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, offset);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void* data, size_t size, off_t offset) {
+    unsigned char* p = data;
+    while (size > 0) {
+        ssize_t n = pread(fd, p, size, offset);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+        offset += n;
+    }
+    return 0;
+}
+
+static size_t record_size(const StatsSegmentHeader* h) {
+    return h->kind == STATS_SEGMENT_SUMMARY ? sizeof(StatsSummary) : sizeof(GameStats);
+}
+
+static const GameStats* record_game(const StatsSegmentHeader* h, const void* records, uint64_t i) {
+    if (h->kind == STATS_SEGMENT_SUMMARY) return &((const StatsSummary*)records)[i].game;
+    return &((const GameStats*)records)[i];
+}
+
+// Encode one game after the one at time *prev (at most STATS_RECORD_MAX
+// bytes with a summary's count)
+static unsigned char* put_game(unsigned char* p, const GameStats* g, int64_t* prev) {
+    size_t len = strnlen(g->player_name, NAME_LEN);
+    p = codec_put_svarint(p, (int64_t)g->timestamp - *prev);
+    *prev = g->timestamp;
+    *p++ = (unsigned char)len;
+    memcpy(p, g->player_name, len);
+    p += len;
+    p = codec_put_svarint(p, g->final_score);
+    p = codec_put_svarint(p, g->fish_caught);
+    p = codec_put_svarint(p, g->hooks_missed);
+    p = codec_put_svarint(p, g->speed_level);
+    p = codec_put_svarint(p, g->lives_remaining);
+    return codec_put_svarint(p, g->game_duration);
+}
+
+static const unsigned char* get_int(const unsigned char* p, const unsigned char* end, int* out) {
+    int64_t v = 0;
+    p = p != NULL ? codec_get_svarint(p, end, &v) : NULL;
+    *out = (int)v;
+    return p;
+}
+
+static const unsigned char* get_game(const unsigned char* p, const unsigned char* end, GameStats* g, int64_t* prev) {
+    int64_t delta;
+    memset(g, 0, sizeof(GameStats));
+    p = codec_get_svarint(p, end, &delta);
+    if (p == NULL || p >= end || *p > NAME_LEN || end - p - 1 < *p) return NULL;
+    *prev += delta;
+    g->timestamp = (time_t)*prev;
+    size_t len = *p++;
+    memcpy(g->player_name, p, len);
+    p += len;
+    p = get_int(p, end, &g->final_score);
+    p = get_int(p, end, &g->fish_caught);
+    p = get_int(p, end, &g->hooks_missed);
+    p = get_int(p, end, &g->speed_level);
+    p = get_int(p, end, &g->lives_remaining);
+    return get_int(p, end, &g->game_duration);
+}
+
+// Encode records [first, first + n) of a segment as one block
+// Returns: bytes of the block (at most STATS_BLOCK_BYTES)
+static size_t encode_block(unsigned char* block, const StatsSegmentHeader* h, const void* records,
+                           uint64_t first, uint32_t n) {
+    unsigned char* p = block + CODEC_BLOCK_HEAD;
+    int64_t prev = h->base_time;
+    for (uint64_t i = first; i < first + n; i++) {
+        if (h->kind == STATS_SEGMENT_SUMMARY) p = codec_put_varint(p, ((const StatsSummary*)records)[i].games);
+        p = put_game(p, record_game(h, records, i), &prev);
+    }
+    return codec_block_finish(block, (size_t)(p - block - CODEC_BLOCK_HEAD), n);
+}
+
+/**
+ * Check a block and decode all of its records
+ * Returns: bytes of the block, or -1 if it is damaged or holds more
+ * than 'max' records; *count is set to the records decoded
+ */
+static long decode_block(const unsigned char* block, size_t avail, const StatsSegmentHeader* h,
+                         void* records, uint64_t max, uint32_t* count) {
+    long size = codec_block_check(block, avail, count);
+    if (size == -1 || *count > max || *count > STATS_BLOCK_RECORDS) return -1;
+    const unsigned char* p = block + CODEC_BLOCK_HEAD;
+    const unsigned char* end = block + size - CODEC_BLOCK_TAIL;
+    int64_t prev = h->base_time;
+    for (uint32_t i = 0; i < *count && p != NULL; i++) {
+        if (h->kind == STATS_SEGMENT_SUMMARY) {
+            StatsSummary* sum = &((StatsSummary*)records)[i];
+            p = codec_get_varint(p, end, &sum->games);
+            if (p != NULL) p = get_game(p, end, &sum->game, &prev);
+        } else {
+            p = get_game(p, end, &((GameStats*)records)[i], &prev);
+        }
+    }
+    return p == end ? size : -1;
+}
+
+// Bytes the records of a segment take once encoded, to weigh compaction
+static uint64_t encoded_bytes(const StatsSegmentHeader* h, const void* records) {
+    unsigned char record[STATS_RECORD_MAX];
+    int64_t prev = h->base_time;
+    uint64_t blocks = (h->entries + STATS_BLOCK_RECORDS - 1) / STATS_BLOCK_RECORDS;
+    uint64_t bytes = blocks * (CODEC_BLOCK_HEAD + CODEC_BLOCK_TAIL);
+    for (uint64_t i = 0; i < h->entries; i++) {
+        unsigned char* p = record;
+        if (i % STATS_BLOCK_RECORDS == 0) prev = h->base_time;
+        if (h->kind == STATS_SEGMENT_SUMMARY) p = codec_put_varint(p, ((const StatsSummary*)records)[i].games);
+        bytes += (uint64_t)(put_game(p, record_game(h, records, i), &prev) - record);
+    }
+    return bytes;
+}
+
+/**
+ * Read and check the header of an open segment
+ * A version 1 segment (fixed-size records right after a shorter header)
+ * is described as if it had blocks: only read_segment() can read it.
+ * System calls used: pread(), fstat()
+ */
+static int read_header(int fd, int32_t day, StatsSegmentHeader* h) {
+    struct stat st;
+    memset(h, 0, sizeof(StatsSegmentHeader));
+    if (fstat(fd, &st) == -1 || (uint64_t)st.st_size < V1_HEADER_SIZE) return -1;
+    size_t want = (uint64_t)st.st_size < sizeof(StatsSegmentHeader) ? V1_HEADER_SIZE : sizeof(StatsSegmentHeader);
+    if (read_all(fd, h, want, 0) == -1 || h->magic != STATS_STORE_MAGIC || h->day != day ||
+        (h->kind != STATS_SEGMENT_RAW && h->kind != STATS_SEGMENT_SUMMARY) ||
+        (!h->sealed && h->kind != STATS_SEGMENT_RAW)) {
+        return -1;
+    }
+    if (h->version == 1) {
+        h->base_time = 0;
+        if (!h->sealed) {
+            h->entries = ((uint64_t)st.st_size - V1_HEADER_SIZE) / sizeof(GameStats);
+            h->games = h->entries;
+            h->players_count = 0;
+        }
+        h->data_end = V1_HEADER_SIZE + h->entries * record_size(h);
+        if (h->data_end > (uint64_t)st.st_size ||
+            (h->sealed && (h->data_end > h->players_off ||
+                           h->players_off + h->players_count * sizeof(StatsPlayerCount) > (uint64_t)st.st_size))) {
+            return -1;
+        }
+        return 0;
+    }
+    if (h->version != STATS_STORE_VERSION || want != sizeof(StatsSegmentHeader) ||
+        h->data_end < sizeof(StatsSegmentHeader) || h->data_end > (uint64_t)st.st_size) {
+        return -1;
+    }
+    if (!h->sealed) {
+        h->players_count = 0;
+    } else if (h->players_off < h->data_end ||
+               h->players_off + h->players_count * sizeof(StatsPlayerCount) > (uint64_t)st.st_size) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Write a whole segment to a temporary file and rename it into place
+ * The records are encoded in blocks of STATS_BLOCK_RECORDS. Readers see
+ * either the old segment or the new one, never a mix.
+ * System calls used: open(), pwrite(), fsync(), close(), rename()
+ */
+static int write_segment(const char* path, StatsSegmentHeader* h, const void* records,
+                         const StatsPlayerCount* players) {
+    char final_path[300];
+    char tmp_path[320];
+    segment_name(final_path, sizeof(final_path), path, h->day);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d.tmp", final_path, (int)getpid());
+
+    h->magic = STATS_STORE_MAGIC;
+    h->version = STATS_STORE_VERSION;
+    for (uint64_t i = 0; i < h->entries; i++) {
+        int64_t when = record_game(h, records, i)->timestamp;
+        if (i == 0) h->base_time = when;
+        if (i == 0 || when < h->min_time) h->min_time = when;
+        if (i == 0 || when > h->max_time) h->max_time = when;
+    }
+    unsigned char* block = malloc(STATS_BLOCK_BYTES);
+    int fd = block != NULL ? open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+    if (fd == -1) {
+        free(block);
+        return -1;
+    }
+    int result = 0;
+    uint64_t off = sizeof(StatsSegmentHeader);
+    for (uint64_t first = 0; first < h->entries && result == 0; first += STATS_BLOCK_RECORDS) {
+        uint64_t n = h->entries - first < STATS_BLOCK_RECORDS ? h->entries - first : STATS_BLOCK_RECORDS;
+        size_t size = encode_block(block, h, records, first, (uint32_t)n);
+        result = write_at(fd, block, size, (off_t)off);
+        off += size;
+    }
+    free(block);
+    h->data_end = off;
+    h->players_off = h->sealed ? off : 0;
+    if (result == -1 ||
+        (h->sealed && write_at(fd, players, h->players_count * sizeof(StatsPlayerCount), (off_t)off) == -1) ||
+        write_at(fd, h, sizeof(StatsSegmentHeader), 0) == -1 || fsync(fd) == -1) {
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    close(fd);
+    if (rename(tmp_path, final_path) == -1) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+static int compare_players(const void* a, const void* b) {
+    return memcmp(((const StatsPlayerCount*)a)->name, ((const StatsPlayerCount*)b)->name, NAME_LEN);
+}
+
+// Fill in the game count and per-player counts of a segment's records
+// Returns: the sorted player counts (malloc'd), or NULL on error
+static StatsPlayerCount* seal_header(StatsSegmentHeader* h, const void* records) {
+    StatsPlayerCount* players = malloc((h->entries > 0 ? h->entries : 1) * sizeof(StatsPlayerCount));
+    if (players == NULL) return NULL;
+    h->games = 0;
+    for (uint64_t i = 0; i < h->entries; i++) {
+        uint64_t weight = h->kind == STATS_SEGMENT_SUMMARY ? ((const StatsSummary*)records)[i].games : 1;
+        make_key(players[i].name, record_game(h, records, i)->player_name);
+        players[i].games = (uint32_t)weight;
+        h->games += weight;
+    }
+    qsort(players, h->entries, sizeof(StatsPlayerCount), compare_players);
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < h->entries; i++) {
+        if (count > 0 && memcmp(players[count - 1].name, players[i].name, NAME_LEN) == 0) {
+            players[count - 1].games += players[i].games;
+        } else {
+            players[count++] = players[i];
+        }
+    }
+    h->players_count = count;
+    h->sealed = 1;
+    return players;
+}
+
+// Decode every block of a segment into 'records' (room for h->entries)
+// System calls used: pread()
+static int read_blocks(int fd, const StatsSegmentHeader* h, void* records) {
+    size_t bytes = h->data_end - sizeof(StatsSegmentHeader);
+    unsigned char* data = malloc(bytes > 0 ? bytes : 1);
+    if (data == NULL || read_all(fd, data, bytes, sizeof(StatsSegmentHeader)) == -1) {
+        free(data);
+        return -1;
+    }
+    uint64_t decoded = 0;
+    size_t off = 0;
+    while (off < bytes) {
+        uint32_t n;
+        long size = decode_block(data + off, bytes - off, h, (char*)records + decoded * record_size(h),
+                                 h->entries - decoded, &n);
+        if (size == -1) break;
+        decoded += n;
+        off += (size_t)size;
+    }
+    free(data);
+    return off == bytes && decoded == h->entries ? 0 : -1;
+}
+
+/**
+ * Records of a segment (malloc'd), decoded; the header is read fresh
+ * Returns NULL on error, or if any block is damaged
+ * System calls used: open(), pread(), fstat(), close()
+ */
+static void* read_segment(const char* path, int32_t day, StatsSegmentHeader* h) {
+    char name[300];
+    segment_name(name, sizeof(name), path, day);
+    int fd = open(name, O_RDONLY);
+    if (fd == -1) return NULL;
+    void* records = NULL;
+    if (read_header(fd, day, h) == 0) {
+        records = malloc(h->entries > 0 ? h->entries * record_size(h) : 1);
+        int result = records == NULL ? -1 :
+                     h->version == 1 ? read_all(fd, records, h->data_end - V1_HEADER_SIZE, V1_HEADER_SIZE) :
+                     read_blocks(fd, h, records);
+        if (result == -1) {
+            free(records);
+            records = NULL;
+        }
+    }
+    close(fd);
+    return records;
+}
+
+// Rewrite a segment in full blocks with its player counts (lock held)
+static int seal_segment(const char* path, int32_t day) {
+    StatsSegmentHeader h;
+    void* records = read_segment(path, day, &h);
+    if (records == NULL) return -1;
+    StatsPlayerCount* players = seal_header(&h, records);
+    int result = players != NULL ? write_segment(path, &h, records, players) : -1;
+    free(players);
+    free(records);
+    return result;
+}
+
+// Start an empty segment (lock held)
+static int create_segment(const char* path, int32_t day, uint64_t first_game) {
+    StatsSegmentHeader h;
+    memset(&h, 0, sizeof(h));
+    h.kind = STATS_SEGMENT_RAW;
+    h.day = day;
+    h.first_game = first_game;
+    return write_segment(path, &h, NULL, NULL);
+}
+
+static int compare_days(const void* a, const void* b) {
+    int32_t x = ((const StatsSegment*)a)->day;
+    int32_t y = ((const StatsSegment*)b)->day;
+    return (x > y) - (x < y);
+}
+
+/**
+ * List the segments of a log, oldest first (headers are read later)
+ * System calls used: opendir(), readdir(), closedir()
+ */
+static int list_segments(StatsStore* s, const char* path) {
+    char dir[256];
+    const char* base = strrchr(path, '/');
+    memset(s, 0, sizeof(StatsStore));
+    snprintf(s->path, sizeof(s->path), "%s", path);
+    if (base == NULL) {
+        snprintf(dir, sizeof(dir), ".");
+        base = path;
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(base - path), path);
+        base++;
+        if (dir[0] == '\0') snprintf(dir, sizeof(dir), "/");
+    }
+    size_t base_len = strlen(base);
+
+    DIR* d = opendir(dir);
+    if (d == NULL) return -1;
+    int capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        const char* name = entry->d_name;
+        if (strncmp(name, base, base_len) != 0 || name[base_len] != '.' || strlen(name + base_len + 1) != 8) {
+            continue;
+        }
+        int day = 0;
+        int digits = 0;
+        for (const char* p = name + base_len + 1; *p >= '0' && *p <= '9'; p++, digits++) {
+            day = day * 10 + (*p - '0');
+        }
+        if (digits != 8) continue;
+        if (s->count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            StatsSegment* grown = realloc(s->segs, (size_t)capacity * sizeof(StatsSegment));
+            if (grown == NULL) {
+                closedir(d);
+                stats_store_close(s);
+                return -1;
+            }
+            s->segs = grown;
+        }
+        memset(&s->segs[s->count], 0, sizeof(StatsSegment));
+        s->segs[s->count++].day = day;
+    }
+    closedir(d);
+    qsort(s->segs, (size_t)s->count, sizeof(StatsSegment), compare_days);
+    return 0;
+}
+
+/**
+ * Split a log from before segments into them (lock held)
+ * Games stay in the same order and keep their numbers, so the score
+ * trees and player index built from the old log remain valid. A game
+ * from an earlier day than the segment being filled (a clock change)
+ * joins that segment, as it would when appended.
+ * System calls used: stat(), open(), read(), close(), unlink()
+ */
+static int migrate_legacy(const char* path) {
+    struct stat st;
+    StatsStore s;
+    if (stat(path, &st) == -1 || !S_ISREG(st.st_mode)) return 0;
+    if (list_segments(&s, path) == -1) return -1;
+    int have_segments = s.count > 0;
+    stats_store_close(&s);
+    if (have_segments) return 0;        // already split; the old file is left alone
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return -1;
+    uint64_t n = (uint64_t)st.st_size / sizeof(GameStats);
+    GameStats* games = malloc(n > 0 ? n * sizeof(GameStats) : 1);
+    if (games == NULL || read_all(fd, games, n * sizeof(GameStats), 0) == -1) {
+        free(games);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    int result = 0;
+    for (uint64_t i = 0; i < n && result == 0; ) {
+        StatsSegmentHeader h;
+        memset(&h, 0, sizeof(h));
+        h.kind = STATS_SEGMENT_RAW;
+        h.day = stats_day_of(games[i].timestamp);
+        h.first_game = i;
+        uint64_t j = i + 1;
+        while (j < n && stats_day_of(games[j].timestamp) <= h.day) j++;
+        h.entries = j - i;
+        if (j < n) {        // the newest day stays open for appends
+            StatsPlayerCount* players = seal_header(&h, games + i);
+            result = players != NULL ? write_segment(path, &h, games + i, players) : -1;
+            free(players);
+        } else {
+            h.games = h.entries;
+            result = write_segment(path, &h, games + i, NULL);
+        }
+        i = j;
+    }
+    free(games);
+    if (result == 0) unlink(path);
+    return result;
+}
+
+/**
+ * Re-encode the version 1 segments of a log in blocks (lock held)
+ * Every game keeps its number and segment, so the score trees and the
+ * player index stay valid.
+ */
+static int upgrade_segments(const char* path) {
+    StatsStore s;
+    int result = 0;
+    if (list_segments(&s, path) == -1) return -1;
+    for (int i = 0; i < s.count && result == 0; i++) {
+        const StatsSegmentHeader* old = stats_store_segment(&s, i);
+        if (old == NULL || old->version == STATS_STORE_VERSION) continue;
+        StatsSegmentHeader h;
+        void* records = read_segment(path, s.segs[i].day, &h);
+        if (records == NULL) {
+            result = -1;
+            break;
+        }
+        StatsPlayerCount* players = h.sealed ? seal_header(&h, records) : NULL;
+        result = h.sealed && players == NULL ? -1 : write_segment(path, &h, records, players);
+        free(players);
+        free(records);
+    }
+    stats_store_close(&s);
+    return result;
+}
+
+/**
+ * Take the lock that orders appends, sealing and compaction
+ * The first time a build of this format takes it, a log from before
+ * segments is split into them and version 1 segments are re-encoded;
+ * the lock file then records the version.
+ * Returns: the lock's descriptor, or -1 on error
+ * System calls used: open(), flock(), pread(), pwrite()
+ */
+int stats_store_lock(const char* path) {
+    char lock_path[300];
+    uint32_t format = 0;
+    snprintf(lock_path, sizeof(lock_path), "%s%s", path, STATS_STORE_LOCK_SUFFIX);
+    int fd = open(lock_path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) return -1;
+    while (flock(fd, LOCK_EX) == -1) {
+        if (errno != EINTR) {
+            close(fd);
+            return -1;
+        }
+    }
+    if (read_all(fd, &format, sizeof(format), 0) == -1 || format != STATS_STORE_VERSION) {
+        int32_t unknown = 0;    // the next append lists the segments and records the newest
+        format = STATS_STORE_VERSION;
+        if (migrate_legacy(path) == -1 || upgrade_segments(path) == -1 ||
+            write_at(fd, &unknown, sizeof(unknown), LOCK_NEWEST_OFF) == -1 ||
+            write_at(fd, &format, sizeof(format), 0) == -1) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+// Has the lock file recorded this format (no migration left to do)?
+// System calls used: open(), pread(), close()
+static int store_current(const char* path) {
+    char lock_path[300];
+    uint32_t format = 0;
+    snprintf(lock_path, sizeof(lock_path), "%s%s", path, STATS_STORE_LOCK_SUFFIX);
+    int fd = open(lock_path, O_RDONLY);
+    if (fd == -1) return 0;
+    int current = read_all(fd, &format, sizeof(format), 0) == 0 && format == STATS_STORE_VERSION;
+    close(fd);
+    return current;
+}
+
+// Day of the newest segment as the lock file records it, or 0 if unknown
+// System calls used: open(), pread(), close()
+static int32_t read_newest_day(const char* path) {
+    char lock_path[300];
+    int32_t day = 0;
+    snprintf(lock_path, sizeof(lock_path), "%s%s", path, STATS_STORE_LOCK_SUFFIX);
+    int fd = open(lock_path, O_RDONLY);
+    if (fd == -1) return 0;
+    if (read_all(fd, &day, sizeof(day), LOCK_NEWEST_OFF) == -1) day = 0;
+    close(fd);
+    return day;
+}
+
+// Record the newest segment's day in the lock file (lock held)
+// System calls used: open(), pwrite(), close()
+static void write_newest_day(const char* path, int32_t day) {
+    char lock_path[300];
+    snprintf(lock_path, sizeof(lock_path), "%s%s", path, STATS_STORE_LOCK_SUFFIX);
+    int fd = open(lock_path, O_WRONLY);
+    if (fd == -1) return;
+    write_at(fd, &day, sizeof(day), LOCK_NEWEST_OFF);
+    close(fd);
+}
+
+// Closing the descriptor releases the lock
+void stats_store_unlock(int lock_fd) {
+    if (lock_fd != -1) close(lock_fd);
+}
+
+// List a log's segments for reading (no lock needed)
+int stats_store_open(StatsStore* s, const char* path) {
+    struct stat st;
+    if (list_segments(s, path) == -1) return -1;
+    if ((s->count > 0 || stat(path, &st) == 0) && !store_current(path)) {  // not migrated yet
+        stats_store_close(s);
+        int lock_fd = stats_store_lock(path);
+        if (lock_fd == -1) return -1;
+        stats_store_unlock(lock_fd);
+        return list_segments(s, path);
+    }
+    return 0;
+}
+
+void stats_store_close(StatsStore* s) {
+    free(s->segs);
+    s->segs = NULL;
+    s->count = 0;
+}
+
+// Header of segment i, read on first use
+// System calls used: open(), pread(), fstat(), close()
+const StatsSegmentHeader* stats_store_segment(StatsStore* s, int i) {
+    StatsSegment* seg = &s->segs[i];
+    if (!seg->loaded) {
+        char name[300];
+        segment_name(name, sizeof(name), s->path, seg->day);
+        int fd = open(name, O_RDONLY);
+        if (fd == -1) return NULL;
+        int ok = read_header(fd, seg->day, &seg->head) == 0;
+        close(fd);
+        if (!ok) return NULL;
+        seg->loaded = 1;
+    }
+    return &seg->head;
+}
+
+// Games in the whole log
+uint64_t stats_store_games(StatsStore* s) {
+    if (s->count == 0) return 0;
+    const StatsSegmentHeader* h = stats_store_segment(s, s->count - 1);
+    return h != NULL ? h->first_game + h->games : 0;
+}
+
+uint64_t stats_log_games(const char* path) {
+    StatsStore s;
+    if (stats_store_open(&s, path) == -1) return 0;
+    uint64_t games = stats_store_games(&s);
+    stats_store_close(&s);
+    return games;
+}
+
+/**
+ * Games in the log, from the header of the newest segment the lock file
+ * names: no directory listing, so sidecars can tell cheaply whether
+ * anything was logged since they last caught up
+ * Returns: 0 with *games set, -1 if the lock file does not know the
+ * newest segment yet (not migrated, or no append since) or it is gone
+ * System calls used: open(), pread(), fstat(), close()
+ */
+int stats_log_position(const char* path, uint64_t* games) {
+    char name[300];
+    StatsSegmentHeader h;
+    if (!store_current(path)) return -1;
+    int32_t day = read_newest_day(path);
+    if (day == 0) return -1;
+    segment_name(name, sizeof(name), path, day);
+    int fd = open(name, O_RDONLY);
+    if (fd == -1) return -1;
+    int result = read_header(fd, day, &h);
+    close(fd);
+    if (result == -1) return -1;
+    *games = h.first_game + h.games;
+    return 0;
+}
+
+// Pick the segment a game of time 'when' goes to, sealing the newest one
+// and starting the next when 'when' is on a later day (lock held)
+// Lists the whole directory: stats_store_append() only comes here when
+// the newest segment recorded in the lock file does not take the game
+// Returns: 1 if a new day was started, 0 if not, -1 on error; *day is set
+static int open_day(const char* path, time_t when, int32_t* day) {
+    StatsStore s;
+    int started = 0;
+    int result = 0;
+    *day = stats_day_of(when);
+    if (list_segments(&s, path) == -1) return -1;
+
+    if (s.count == 0) {
+        result = create_segment(path, *day, 0);
+    } else {
+        const StatsSegmentHeader* last = stats_store_segment(&s, s.count - 1);
+        if (last == NULL) {
+            result = -1;
+        } else if (last->day < *day) {
+            // a segment that cannot be read back whole (a damaged block)
+            // stays unsealed; it is still read up to the damage
+            if (!last->sealed) seal_segment(path, last->day);
+            result = create_segment(path, *day, last->first_game + last->games);
+            started = 1;
+        } else if (last->sealed) {
+            // sealed, but no newer day was started (that failed): open it again
+            StatsSegmentHeader h;
+            void* records = read_segment(path, last->day, &h);
+            h.sealed = 0;
+            result = records != NULL && h.kind == STATS_SEGMENT_RAW ? write_segment(path, &h, records, NULL) : -1;
+            free(records);
+            *day = last->day;
+        } else {
+            *day = last->day;
+        }
+    }
+    stats_store_close(&s);
+    return result == -1 ? -1 : started;
+}
+
+/**
+ * Write games to the open segment of 'day' in blocks of up to
+ * STATS_BLOCK_RECORDS with one pwrite(), then count them in the header
+ * Returns: 0 on success, -1 on a write error, -2 if the segment is
+ * missing or not open for appending (sealed, damaged or old format)
+ * System calls used: open(), pread(), pwrite(), fstat(), close()
+ */
+static int append_run(const char* path, int32_t day, const GameStats* games, int count) {
+    char name[300];
+    StatsSegmentHeader h;
+    segment_name(name, sizeof(name), path, day);
+    int fd = open(name, O_RDWR);
+    if (fd == -1) return -2;
+    if (read_header(fd, day, &h) == -1 || h.version != STATS_STORE_VERSION || h.sealed) {
+        close(fd);
+        return -2;
+    }
+    int blocks = (count + STATS_BLOCK_RECORDS - 1) / STATS_BLOCK_RECORDS;
+    unsigned char* data = malloc((size_t)count * STATS_RECORD_MAX + (size_t)blocks * (CODEC_BLOCK_HEAD + CODEC_BLOCK_TAIL));
+    if (data == NULL) {
+        close(fd);
+        return -1;
+    }
+    if (h.entries == 0) {
+        h.base_time = games[0].timestamp;
+        h.min_time = games[0].timestamp;
+        h.max_time = games[0].timestamp;
+    }
+    size_t bytes = 0;
+    for (int first = 0; first < count; first += STATS_BLOCK_RECORDS) {
+        int n = count - first < STATS_BLOCK_RECORDS ? count - first : STATS_BLOCK_RECORDS;
+        bytes += encode_block(data + bytes, &h, games, (uint64_t)first, (uint32_t)n);
+    }
+    int result = write_at(fd, data, bytes, (off_t)h.data_end);
+    free(data);
+    if (result == 0) {
+        for (int i = 0; i < count; i++) {
+            if (games[i].timestamp < h.min_time) h.min_time = games[i].timestamp;
+            if (games[i].timestamp > h.max_time) h.max_time = games[i].timestamp;
+        }
+        h.entries += (uint64_t)count;
+        h.games += (uint64_t)count;
+        h.data_end += bytes;
+        result = write_at(fd, &h, sizeof(h), 0);
+    }
+    close(fd);
+    return result;
+}
+
+/**
+ * Append games to the log, in order (call with stats_store_lock() held)
+ * A game from a later day than the newest segment seals that segment
+ * and starts a new one; an earlier one joins the newest segment. Each
+ * run of games for one segment is written as whole blocks at data_end,
+ * and only then does the header count them, so a write cut short is
+ * never seen.
+ * The newest segment's day is kept in the lock file, so a game of that
+ * day or before goes straight to it by name; the directory is listed
+ * only to start a day, or when that segment is gone or sealed.
+ * Returns: number of games appended (fewer than 'count' on error);
+ * *new_day is set if a new day was started
+ */
+int stats_store_append(const char* path, const GameStats* games, int count, int* new_day) {
+    int done = 0;
+    int32_t newest = read_newest_day(path);
+    *new_day = 0;
+    while (done < count) {
+        int32_t day = stats_day_of(games[done].timestamp);
+        int result = -2;
+        int end = done + 1;
+        if (newest != 0 && day <= newest) {
+            day = newest;
+            while (end < count && stats_day_of(games[end].timestamp) <= day) end++;
+            result = append_run(path, day, games + done, end - done);
+        }
+        if (result == -2) {
+            int started = open_day(path, games[done].timestamp, &day);
+            if (started == -1) break;
+            if (started) *new_day = 1;
+            write_newest_day(path, day);
+            newest = day;
+            end = done + 1;
+            while (end < count && stats_day_of(games[end].timestamp) <= day) end++;
+            result = append_run(path, day, games + done, end - done);
+        }
+        if (result != 0) break;
+        done = end;
+    }
+    return done;
+}
+
+/**
+ * Flush the newest segment's appended blocks to disk
+ * Sealed segments were synced when they were written. The newest one is
+ * found through the lock file; the directory is listed only if that
+ * does not know it yet.
+ * System calls used: opendir(), readdir(), open(), fdatasync(), close()
+ */
+int stats_store_sync(const char* path) {
+    StatsStore s;
+    char name[300];
+    int32_t day = read_newest_day(path);
+    if (day == 0) {
+        if (list_segments(&s, path) == -1) return -1;
+        day = s.count > 0 ? s.segs[s.count - 1].day : 0;
+        stats_store_close(&s);
+        if (day == 0) return 0;
+    }
+    segment_name(name, sizeof(name), path, day);
+    int fd = open(name, O_RDWR);
+    int result = fd == -1 || fdatasync(fd) == -1 ? -1 : 0;
+    if (fd != -1) close(fd);
+    return result;
+}
+
+static int compare_games(const void* a, const void* b) {
+    const GameStats* x = a;
+    const GameStats* y = b;
+    int c = strncmp(x->player_name, y->player_name, NAME_LEN);
+    if (c != 0) return c;
+    if (x->speed_level != y->speed_level) return x->speed_level < y->speed_level ? -1 : 1;
+    if (x->final_score != y->final_score) return x->final_score < y->final_score ? -1 : 1;
+    return (x->timestamp > y->timestamp) - (x->timestamp < y->timestamp);
+}
+
+// Replace a sealed day's games by one summary per (player, speed, score)
+// Returns: 1 if compacted, 0 if kept as it was, -1 on error
+static int compact_segment(const char* path, int32_t day) {
+    StatsSegmentHeader h;
+    GameStats* games = read_segment(path, day, &h);
+    if (games == NULL) return -1;
+    size_t bytes = (h.entries > 0 ? h.entries : 1) * sizeof(GameStats);
+    GameStats* sorted = malloc(bytes);
+    StatsSummary* sums = malloc((h.entries > 0 ? h.entries : 1) * sizeof(StatsSummary));
+    if (sorted == NULL || sums == NULL) {
+        free(sorted);
+        free(sums);
+        free(games);
+        return -1;
+    }
+    memcpy(sorted, games, h.entries * sizeof(GameStats));
+    qsort(sorted, h.entries, sizeof(GameStats), compare_games);
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < h.entries; i++) {
+        StatsSummary* last = count > 0 ? &sums[count - 1] : NULL;
+        if (last != NULL && strncmp(last->game.player_name, sorted[i].player_name, NAME_LEN) == 0 &&
+            last->game.speed_level == sorted[i].speed_level && last->game.final_score == sorted[i].final_score) {
+            last->games++;
+            last->game.fish_caught += sorted[i].fish_caught;
+            last->game.hooks_missed += sorted[i].hooks_missed;
+            last->game.lives_remaining += sorted[i].lives_remaining;
+            last->game.game_duration += sorted[i].game_duration;
+        } else {
+            sums[count].games = 1;
+            sums[count++].game = sorted[i];     // the earliest of the group, as sorted
+        }
+    }
+    free(sorted);
+
+    StatsSegmentHeader summary = h;
+    summary.kind = STATS_SEGMENT_SUMMARY;
+    summary.entries = count;
+    summary.base_time = count > 0 ? sums[0].game.timestamp : 0;
+    int compacted = encoded_bytes(&summary, sums) < h.data_end - sizeof(StatsSegmentHeader);
+    StatsPlayerCount* players;
+    if (compacted) {
+        h.kind = STATS_SEGMENT_SUMMARY;
+        h.entries = count;
+        players = seal_header(&h, sums);
+    } else {
+        // too few repeats to gain anything: mark the day so it is not
+        // looked at again
+        h.kept_raw = 1;
+        players = seal_header(&h, games);
+    }
+    int result = players == NULL ? -1 :
+                 write_segment(path, &h, compacted ? (void*)sums : (void*)games, players);
+    free(players);
+    free(sums);
+    free(games);
+    return result == -1 ? -1 : compacted;
+}
+
+/**
+ * Compact the sealed segments older than 'keep_days' days (lock held)
+ * The newest segment is never compacted. Update the score trees and
+ * player index first: they cannot count a compacted day game by game.
+ * Returns: number of segments compacted, or -1 on error
+ */
+int stats_store_compact(const char* path, int keep_days) {
+    StatsStore s;
+    int32_t cutoff = stats_day_of(time(NULL) - (time_t)keep_days * 86400);
+    int compacted = 0;
+    if (list_segments(&s, path) == -1) return -1;
+    for (int i = 0; i + 1 < s.count; i++) {
+        const StatsSegmentHeader* h = stats_store_segment(&s, i);
+        if (h == NULL || !h->sealed || h->kind != STATS_SEGMENT_RAW || h->kept_raw || h->day >= cutoff) continue;
+        int result = compact_segment(path, h->day);
+        if (result == -1) {
+            compacted = -1;
+            break;
+        }
+        compacted += result;
+    }
+    stats_store_close(&s);
+    return compacted;
+}
+
+/**
+ * Open a cursor over a stats log
+ * A missing log is an empty one.
+ * Returns: 0 on success, -1 on error
+ */
+int stats_cursor_open(StatsCursor* c, const char* path, int reverse) {
+    memset(c, 0, offsetof(StatsCursor, chunk));
+    c->fd = -1;
+    c->seg = -1;
+    c->reverse = reverse;
+    c->from = INT64_MIN;
+    c->to = INT64_MAX;
+    if (stats_store_open(&c->store, path) == -1) return -1;
+    c->count = stats_store_games(&c->store);
+    c->pos = reverse ? c->count : 0;
+    return 0;
+}
+
+// Only return games that ended in [from, to] and, if 'player' is not
+// NULL, that player's; segments that cannot hold any are skipped unread
+void stats_cursor_filter(StatsCursor* c, time_t from, time_t to, const char* player) {
+    c->from = from;
+    c->to = to;
+    c->has_player = player != NULL;
+    if (player != NULL) make_key(c->player, player);
+}
+
+// Does a sealed segment hold games of the cursor's player?
+// Binary search of its player counts
+// System calls used: open(), pread(), close()
+static int segment_has_player(const StatsCursor* c, const StatsSegmentHeader* h) {
+    char name[300];
+    StatsPlayerCount probe;
+    segment_name(name, sizeof(name), c->store.path, h->day);
+    int fd = open(name, O_RDONLY);
+    if (fd == -1) return 1;         // let the read report it
+    uint64_t lo = 0;
+    uint64_t hi = h->players_count;
+    int found = 0;
+    while (lo < hi && !found) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (read_all(fd, &probe, sizeof(probe), (off_t)(h->players_off + mid * sizeof(probe))) == -1) {
+            found = 1;
+            break;
+        }
+        int cmp = memcmp(probe.name, c->player, NAME_LEN);
+        if (cmp == 0) found = 1;
+        else if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    close(fd);
+    return found;
+}
+
+// Can segment i be skipped whole?
+static int prune_segment(StatsCursor* c, int i) {
+    const StatsSegmentHeader* h = stats_store_segment(&c->store, i);
+    if (h == NULL || h->entries == 0) return 0;
+    if (h->max_time < c->from || h->min_time > c->to) return 1;
+    return h->sealed && c->has_player && !segment_has_player(c, h);
+}
+
+static void leave_segment(StatsCursor* c) {
+    if (c->fd != -1) close(c->fd);
+    c->fd = -1;
+    c->chunk_count = 0;
+    c->chunk_pos = 0;
+}
+
+// Start reading segment i from its start (forward) or end (reverse)
+// System calls used: open(), pread(), fstat()
+static int enter_segment(StatsCursor* c, int i) {
+    char name[300];
+    leave_segment(c);
+    c->seg = i;
+    segment_name(name, sizeof(name), c->store.path, c->store.segs[i].day);
+    c->fd = open(name, O_RDONLY);
+    if (c->fd == -1 || read_header(c->fd, c->store.segs[i].day, &c->head) == -1 ||
+        c->head.version != STATS_STORE_VERSION) {
+        leave_segment(c);
+        return -1;
+    }
+    c->limit = c->head.entries;
+    if (c->head.kind == STATS_SEGMENT_RAW && c->head.first_game + c->head.entries > c->count) {
+        // games appended since the cursor was opened
+        c->limit = c->count > c->head.first_game ? c->count - c->head.first_game : 0;
+        c->head.games = c->limit;
+    }
+    c->chunk_start = c->reverse ? c->head.entries : 0;
+    c->block_off = c->reverse ? c->head.data_end : sizeof(StatsSegmentHeader);
+    c->pos = c->reverse ? c->head.first_game + c->head.games : c->head.first_game;
+    return 0;
+}
+
+// Largest segment whose first game is at most 'index'
+static int find_segment(StatsCursor* c, uint64_t index) {
+    int lo = 0;
+    int hi = c->store.count - 1;
+    int found = -1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        const StatsSegmentHeader* h = stats_store_segment(&c->store, mid);
+        if (h == NULL) return -1;
+        if (h->first_game <= index) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
+}
+
+/**
+ * Read and decode the block that starts at 'off' (forward) or ends at
+ * 'off' (reverse) into the chunk, using at most one pread()
+ * Returns: records in the block, or -1 if it is damaged; *start and
+ * *end are set to where the block lies
+ */
+static int load_block(StatsCursor* c, uint64_t off, int backward, uint64_t* start, uint64_t* end) {
+    uint64_t lo = sizeof(StatsSegmentHeader);
+    uint64_t hi = c->head.data_end;
+    size_t avail = backward ? (off - lo < STATS_BLOCK_BYTES ? off - lo : STATS_BLOCK_BYTES)
+                            : (hi - off < STATS_BLOCK_BYTES ? hi - off : STATS_BLOCK_BYTES);
+    uint64_t read_from = backward ? off - avail : off;
+    if (off < lo || off > hi || read_all(c->fd, c->block, avail, (off_t)read_from) == -1) return -1;
+    long skip = backward ? codec_block_start(c->block, avail) : 0;
+    if (skip == -1) return -1;
+    uint32_t n;
+    long size = decode_block(c->block + skip, avail - (size_t)skip, &c->head, &c->chunk, STATS_BLOCK_RECORDS, &n);
+    if (size == -1 || (backward && (size_t)(skip + size) != avail)) return -1;
+    *start = read_from + (uint64_t)skip;
+    *end = *start + (uint64_t)size;
+    return (int)n;
+}
+
+/**
+ * Move to the next block of the open segment in the cursor's direction
+ * Returns: 1 if one was decoded, 0 at the end of the segment, -1 if it
+ * is damaged
+ */
+static int next_block(StatsCursor* c) {
+    uint64_t start, end;
+    if (c->reverse) {
+        if (c->chunk_start == 0) return 0;
+        int n = load_block(c, c->block_off, 1, &start, &end);
+        if (n == -1 || (uint64_t)n > c->chunk_start) return -1;
+        c->chunk_start -= (uint64_t)n;
+        c->block_off = start;
+        c->chunk_count = n;
+        // records past the limit were appended after the cursor was opened
+        c->chunk_pos = c->chunk_start + (uint64_t)n <= c->limit ? n :
+                       c->limit > c->chunk_start ? (int)(c->limit - c->chunk_start) : 0;
+        return 1;
+    }
+    c->chunk_start += (uint64_t)c->chunk_count;
+    c->chunk_count = 0;
+    c->chunk_pos = 0;
+    if (c->chunk_start >= c->limit || (c->sliced && c->block_off >= c->slice_end)) return 0;
+    int n = load_block(c, c->block_off, 0, &start, &end);
+    if (n == -1) return -1;
+    c->block_off = end;
+    c->chunk_count = c->chunk_start + (uint64_t)n <= c->limit ? n : (int)(c->limit - c->chunk_start);
+    return 1;
+}
+
+/**
+ * Find the block holding record 'r' of the open segment by its block
+ * heads (or, past the middle, trailing sizes from the end), reading a
+ * window of STATS_BLOCK_BYTES at a time
+ * Returns: the block's offset, or 0 if not found; *first is set to the
+ * number of its first record
+ * System calls used: pread()
+ */
+static uint64_t find_block(StatsCursor* c, uint64_t r, uint64_t* first) {
+    const uint64_t lo = sizeof(StatsSegmentHeader);
+    CodecBlockHead head;
+    if (r >= c->head.entries / 2) {
+        uint64_t end = c->head.data_end;
+        uint64_t rec = c->head.entries;
+        while (end > lo) {
+            size_t avail = end - lo < STATS_BLOCK_BYTES ? end - lo : STATS_BLOCK_BYTES;
+            if (read_all(c->fd, c->block, avail, (off_t)(end - avail)) == -1) return 0;
+            size_t q = avail;
+            long start;
+            while ((start = codec_block_start(c->block, q)) != -1) {
+                memcpy(&head, c->block + start, sizeof(head));
+                if (head.magic != CODEC_BLOCK_MAGIC || head.count > rec) return 0;
+                rec -= head.count;
+                if (r >= rec) {
+                    *first = rec;
+                    return end - avail + (uint64_t)start;
+                }
+                q = (size_t)start;
+            }
+            if (q == avail) return 0;       // not even one block fits: damaged
+            end -= avail - q;
+        }
+        return 0;
+    }
+    uint64_t off = lo;
+    uint64_t rec = 0;
+    while (off < c->head.data_end) {
+        size_t avail = c->head.data_end - off < STATS_BLOCK_BYTES ? c->head.data_end - off : STATS_BLOCK_BYTES;
+        if (avail < CODEC_BLOCK_HEAD || read_all(c->fd, c->block, avail, (off_t)off) == -1) return 0;
+        size_t p = 0;
+        while (p + CODEC_BLOCK_HEAD <= avail) {
+            memcpy(&head, c->block + p, sizeof(head));
+            if (head.magic != CODEC_BLOCK_MAGIC) return 0;
+            if (r < rec + head.count) {
+                *first = rec;
+                return off + p;
+            }
+            rec += head.count;
+            p += CODEC_BLOCK_HEAD + head.size + CODEC_BLOCK_TAIL;
+        }
+        off += p;
+    }
+    return 0;
+}
+
+// Give up on the rest of the open segment after a damaged block
+static void skip_segment(StatsCursor* c) {
+    c->bad_blocks++;
+    c->pos = c->reverse ? c->head.first_game : c->head.first_game + c->head.games;
+    leave_segment(c);
+}
+
+// Next game in the cursor's direction, or NULL at the end
+// The record stays valid until the next call; c->weight tells how many
+// games it stands for and c->summary whether it is a compacted summary
+const GameStats* stats_cursor_next(StatsCursor* c) {
+    for (;;) {
+        if (c->seg == -1 || c->fd == -1) {
+            if (c->sliced || (c->reverse ? c->pos == 0 : c->pos >= c->count)) return NULL;
+            int step = c->reverse ? -1 : 1;
+            int i = c->seg == -1 ? (c->reverse ? c->store.count - 1 : 0) : c->seg + step;
+            while (i >= 0 && i < c->store.count && prune_segment(c, i)) i += step;
+            if (i < 0 || i >= c->store.count || enter_segment(c, i) == -1) {
+                leave_segment(c);
+                c->pos = c->reverse ? 0 : c->count;
+                return NULL;
+            }
+            continue;
+        }
+        if (c->reverse ? c->chunk_pos == 0 : c->chunk_pos >= c->chunk_count) {
+            int loaded = next_block(c);
+            if (loaded == 0) leave_segment(c);
+            if (loaded == -1) skip_segment(c);
+            continue;
+        }
+
+        int e = c->reverse ? --c->chunk_pos : c->chunk_pos++;
+        const GameStats* game;
+        if (c->head.kind == STATS_SEGMENT_SUMMARY) {
+            game = &c->chunk.summaries[e].game;
+            c->weight = c->chunk.summaries[e].games;
+            c->summary = 1;
+        } else {
+            game = &c->chunk.games[e];
+            c->weight = 1;
+            c->summary = 0;
+        }
+        c->pos = c->reverse ? c->pos - c->weight : c->pos + c->weight;
+        if (game->timestamp < c->from || game->timestamp > c->to) continue;
+        if (c->has_player && strncmp(game->player_name, c->player, NAME_LEN) != 0) continue;
+        return game;
+    }
+}
+
+// Continue from game 'index' (forward), or from the one before it (reverse)
+// Inside a compacted day the cursor lands on the day's edge instead:
+// check c->pos
+void stats_cursor_seek(StatsCursor* c, uint64_t index) {
+    leave_segment(c);
+    c->seg = -1;
+    if (index > c->count) index = c->count;
+    c->pos = index;
+    if (c->reverse ? index == 0 : index >= c->count) return;    // at the end
+    int i = find_segment(c, c->reverse ? index - 1 : index);
+    if (i < 0 || enter_segment(c, i) == -1) {
+        leave_segment(c);
+        c->pos = c->reverse ? 0 : c->count;
+        return;
+    }
+    if (c->head.kind != STATS_SEGMENT_RAW) return;
+
+    uint64_t r = (c->reverse ? index - 1 : index) - c->head.first_game;
+    uint64_t first = 0;
+    uint64_t start, end;
+    uint64_t off = find_block(c, r, &first);
+    int n = off != 0 ? load_block(c, off, 0, &start, &end) : -1;
+    if (n == -1 || r >= first + (uint64_t)n) {
+        skip_segment(c);
+        return;
+    }
+    c->chunk_start = first;
+    c->chunk_count = first + (uint64_t)n <= c->limit ? n : (int)(c->limit - first);
+    c->chunk_pos = (int)(r - first) + (c->reverse ? 1 : 0);
+    c->block_off = c->reverse ? start : end;
+    c->pos = index;
+}
+
+/**
+ * Cut the segments the cursor's filter does not skip into slices of
+ * about 'bytes' of blocks each, for cursors on other threads to read
+ * Returns: number of slices (*out is malloc()ed), or -1 on error
+ */
+int stats_cursor_slices(StatsCursor* c, uint64_t bytes, StatsSlice** out) {
+    int count = 0;
+    int cap = 0;
+    *out = NULL;
+    if (bytes < STATS_BLOCK_BYTES) bytes = STATS_BLOCK_BYTES;
+    for (int i = 0; i < c->store.count; i++) {
+        const StatsSegmentHeader* h = stats_store_segment(&c->store, i);
+        if (h == NULL || h->entries == 0 || prune_segment(c, i)) continue;
+        for (uint64_t off = sizeof(StatsSegmentHeader); off < h->data_end; off += bytes) {
+            if (count == cap) {
+                cap = cap > 0 ? cap * 2 : 64;
+                StatsSlice* grown = realloc(*out, (size_t)cap * sizeof(StatsSlice));
+                if (grown == NULL) {
+                    free(*out);
+                    *out = NULL;
+                    return -1;
+                }
+                *out = grown;
+            }
+            StatsSlice* slice = &(*out)[count++];
+            slice->day = h->day;
+            slice->kind = h->kind;
+            slice->sealed = h->sealed;
+            slice->begin = off;
+            slice->end = h->data_end - off > bytes ? off + bytes : h->data_end;
+        }
+    }
+    return count;
+}
+
+/**
+ * Find the first block of the open segment that starts in [off, end):
+ * the first block magic from 'off' on that decodes with a good CRC-32
+ * Returns: its offset, or 'end' if there is none
+ * System calls used: pread()
+ */
+static uint64_t resync_block(StatsCursor* c, uint64_t off, uint64_t end) {
+    const uint32_t magic = CODEC_BLOCK_MAGIC;
+    while (off < end) {
+        size_t avail = c->head.data_end - off < STATS_BLOCK_BYTES ? c->head.data_end - off : STATS_BLOCK_BYTES;
+        if (avail < CODEC_BLOCK_HEAD || read_all(c->fd, c->block, avail, (off_t)off) == -1) return end;
+        size_t p = 0;
+        while (p + sizeof(magic) <= avail && off + p < end && memcmp(c->block + p, &magic, sizeof(magic)) != 0) {
+            p++;
+        }
+        if (off + p >= end) return end;
+        if (p + sizeof(magic) > avail) {
+            off += avail - (sizeof(magic) - 1);     // a magic may straddle the window
+            continue;
+        }
+        uint64_t start, stop;
+        if (load_block(c, off + p, 0, &start, &stop) != -1) return off + p;
+        off += p + 1;   // magic inside a payload (load_block() reused the window)
+    }
+    return end;
+}
+
+/**
+ * Make the cursor read only the blocks of one slice (forward), from a
+ * stats_cursor_slices() of a cursor with the same filter
+ * Returns: 0 on success, -1 if the segment is gone or was sealed or
+ * compacted since it was sliced
+ */
+int stats_cursor_slice(StatsCursor* c, const StatsSlice* slice) {
+    int lo = 0;
+    int hi = c->store.count - 1;
+    leave_segment(c);
+    c->reverse = 0;
+    c->sliced = 1;
+    c->slice_end = slice->end;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (c->store.segs[mid].day == slice->day) {
+            if (enter_segment(c, mid) == -1) return -1;
+            if (c->head.kind != slice->kind || c->head.sealed != slice->sealed ||
+                c->head.data_end < slice->end) {
+                leave_segment(c);
+                return -1;
+            }
+            c->block_off = slice->begin <= sizeof(StatsSegmentHeader) ? sizeof(StatsSegmentHeader) :
+                           resync_block(c, slice->begin, slice->end);
+            c->chunk_start = 0;
+            c->chunk_count = 0;
+            c->chunk_pos = 0;
+            return 0;
+        }
+        if (c->store.segs[mid].day < slice->day) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+void stats_cursor_close(StatsCursor* c) {
+    leave_segment(c);
+    stats_store_close(&c->store);
+}
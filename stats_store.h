@@ -0,0 +1,153 @@
+#ifndef STATS_STORE_H
+#define STATS_STORE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "statistics.h"
+#include "codec.h"
+
+#define STATS_STORE_MAGIC 0x47535453u       // "STSG" in the first four bytes
+#define STATS_STORE_VERSION 2               // 1: fixed-size records, no blocks
+#define STATS_SEGMENT_RAW 1                 // GameStats records, in arrival order
+#define STATS_SEGMENT_SUMMARY 2             // StatsSummary records (compacted day)
+#define STATS_STORE_LOCK_SUFFIX ".lock"
+#define STATS_STORE_KEEP_DAYS 30            // days kept game by game before compaction
+#define STATS_BLOCK_RECORDS 256             // most records in one block
+#define STATS_RECORD_MAX 72                 // longest encoded record
+#define STATS_BLOCK_BYTES (CODEC_BLOCK_HEAD + STATS_BLOCK_RECORDS * STATS_RECORD_MAX + CODEC_BLOCK_TAIL)
+
+/**
+ * The stats log, one segment file per day (local time) of game endings
+ *   game_stats.log.YYYYMMDD    segment: StatsSegmentHeader, codec blocks
+ *                              up to data_end, then (once sealed)
+ *                              StatsPlayerCount[]
+ *   game_stats.log.lock        flock() that orders appends and rewrites;
+ *                              holds the format version of the segments
+ *                              and the day of the newest one
+ * Games are numbered in arrival order across segments (first_game).
+ * A record is its time as a zigzag delta (from base_time for the first
+ * record of a block, else from the record before), the name as a length
+ * byte and its characters, then the counters as zigzag varints; a
+ * summary starts with its game count. An append adds its games as blocks
+ * at data_end and then moves data_end, so a write cut short is ignored.
+ * Only the newest segment is appended to; it is sealed when the next day
+ * starts, which fills in the time range and the sorted per-player counts,
+ * so range and player queries can skip whole segments. Sealed segments
+ * older than STATS_STORE_KEEP_DAYS are compacted into one summary per
+ * (player, speed, score), unless that would not be smaller. Sealing and
+ * compaction write a new file and rename() it over the old one, so
+ * readers never need the lock.
+ * A game_stats.log from before segments is split into them on first use,
+ * and version 1 segments are re-encoded.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t kind;              // STATS_SEGMENT_RAW or STATS_SEGMENT_SUMMARY
+    int32_t day;                // yyyymmdd
+    uint16_t sealed;            // 0 while appended to
+    uint16_t kept_raw;          // compaction would not have saved space: leave it raw
+    int64_t min_time;           // time range of the games
+    int64_t max_time;
+    uint64_t first_game;        // number of the first game in the whole log
+    uint64_t games;
+    uint64_t entries;           // records in the blocks
+    uint64_t players_off;       // byte offset of the player counts (sealed only)
+    uint64_t players_count;
+    int64_t base_time;          // first record's time, that the deltas start from
+    uint64_t data_end;          // byte offset after the last block
+} StatsSegmentHeader;
+
+typedef struct {
+    char name[20];              // zero padded, sorted by memcmp()
+    uint32_t games;
+} StatsPlayerCount;
+
+// Games of one player at one speed and score on a compacted day:
+// game.timestamp is the first of them, the counters are sums
+typedef struct {
+    uint64_t games;
+    GameStats game;
+} StatsSummary;
+
+// A segment as listed; the header is read when first needed
+typedef struct {
+    int32_t day;
+    int loaded;
+    StatsSegmentHeader head;
+} StatsSegment;
+
+typedef struct {
+    char path[256];             // the log's name (segments add .YYYYMMDD)
+    StatsSegment* segs;         // oldest first
+    int count;
+} StatsStore;
+
+// Part of a segment for a parallel scan: the blocks of day 'day' that
+// start in [begin, end), as the segment was (kind, sealed) when sliced
+typedef struct {
+    int32_t day;
+    uint16_t kind;
+    uint16_t sealed;
+    uint64_t begin;
+    uint64_t end;
+} StatsSlice;
+
+/**
+ * Streaming reader over the stats log, forward or newest first
+ * Memory is one decoded block however long the log is; games appended
+ * after the cursor was opened are not seen. A summary record stands for
+ * 'weight' games and is never split by a seek. A damaged block ends the
+ * reading of its segment (counted in bad_blocks).
+ */
+typedef struct {
+    StatsStore store;
+    int reverse;
+    uint64_t count;             // games in the log when opened
+    uint64_t pos;               // forward: next game; reverse: one past it
+    int seg;                    // segment being read, or -1
+    int fd;
+    StatsSegmentHeader head;    // of that segment, as read from its file
+    uint64_t limit;             // records of the segment the cursor may return
+    uint64_t block_off;         // forward: next block; reverse: end of the next block
+    uint64_t chunk_start;       // record number of chunk[0] in the segment
+    int chunk_count;
+    int chunk_pos;              // forward: next record; reverse: one past it
+    uint64_t weight;            // games the last record stands for
+    int summary;                // last record is a compacted summary
+    uint64_t bad_blocks;
+    int64_t from, to;           // only games in [from, to]
+    int has_player;
+    char player[20];            // only this player's games, if has_player
+    int sliced;                 // reading one StatsSlice, then the end
+    uint64_t slice_end;
+    union {
+        GameStats games[STATS_BLOCK_RECORDS];
+        StatsSummary summaries[STATS_BLOCK_RECORDS];
+    } chunk;
+    unsigned char block[STATS_BLOCK_BYTES];     // encoded block being read
+} StatsCursor;
+
+// Function prototypes
+int stats_store_open(StatsStore* s, const char* path);
+void stats_store_close(StatsStore* s);
+const StatsSegmentHeader* stats_store_segment(StatsStore* s, int i);
+uint64_t stats_store_games(StatsStore* s);
+uint64_t stats_log_games(const char* path);
+int stats_log_position(const char* path, uint64_t* games);
+int stats_store_lock(const char* path);
+void stats_store_unlock(int lock_fd);
+int stats_store_append(const char* path, const GameStats* games, int count, int* new_day);
+int stats_store_sync(const char* path);
+int stats_store_compact(const char* path, int keep_days);
+int stats_day_of(time_t when);
+
+int stats_cursor_open(StatsCursor* c, const char* path, int reverse);
+void stats_cursor_filter(StatsCursor* c, time_t from, time_t to, const char* player);
+const GameStats* stats_cursor_next(StatsCursor* c);
+void stats_cursor_seek(StatsCursor* c, uint64_t index);
+int stats_cursor_slices(StatsCursor* c, uint64_t bytes, StatsSlice** out);
+int stats_cursor_slice(StatsCursor* c, const StatsSlice* slice);
+void stats_cursor_close(StatsCursor* c);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+/**
+ * Checks for the test programs run by 'make check'
+ * A failed CHECK() prints where it is and what failed, counts the
+ * failure and lets the test go on; test_result() prints one summary
+ * line and gives main() its exit status.
+ */
+static int test_checks;
+static int test_failures;
+
+#define CHECK(cond) do { \
+    test_checks++; \
+    if (!(cond)) { \
+        test_failures++; \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+    } \
+} while (0)
+
+// Returns: 0 if every check passed, 1 if not
+static inline int test_result(const char* name) {
+    if (test_failures == 0) {
+        printf("%s: %d checks passed\n", name, test_checks);
+        return 0;
+    }
+    printf("%s: %d of %d checks FAILED\n", name, test_failures, test_checks);
+    return 1;
+}
+
+#endif
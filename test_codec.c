@@ -0,0 +1,136 @@
+#include "codec.h"
+#include "test.h"
+#include <stdint.h>
+#include <string.h>
+
+// Values at every varint length boundary, plus the extremes
+static const uint64_t unsigned_values[] = {
+    0, 1, 127, 128, 255, 300, 16383, 16384, 2097151, 2097152,
+    0xFFFFFFFFull, 0x100000000ull, 1ull << 56, (1ull << 63) - 1, 1ull << 63, UINT64_MAX
+};
+
+static const int64_t signed_values[] = {
+    0, -1, 1, -2, 2, -64, 63, -65, 64, 1000000, -1000000,
+    INT32_MIN, INT32_MAX, INT64_MIN + 1, INT64_MIN, INT64_MAX
+};
+
+static void test_varints(void) {
+    unsigned char buf[CODEC_VARINT_MAX];
+    int n = sizeof(unsigned_values) / sizeof(unsigned_values[0]);
+    for (int i = 0; i < n; i++) {
+        uint64_t v = unsigned_values[i];
+        unsigned char* end = codec_put_varint(buf, v);
+        size_t len = (size_t)(end - buf);
+        uint64_t back = 0;
+        CHECK(len >= 1 && len <= CODEC_VARINT_MAX);
+        CHECK(codec_get_varint(buf, end, &back) == end && back == v);
+        // One byte short is not a varint
+        CHECK(codec_get_varint(buf, end - 1, &back) == NULL);
+    }
+    CHECK(codec_put_varint(buf, 127) - buf == 1);
+    CHECK(codec_put_varint(buf, 128) - buf == 2);
+    CHECK(codec_put_varint(buf, UINT64_MAX) - buf == CODEC_VARINT_MAX);
+
+    n = sizeof(signed_values) / sizeof(signed_values[0]);
+    for (int i = 0; i < n; i++) {
+        int64_t v = signed_values[i];
+        unsigned char* end = codec_put_svarint(buf, v);
+        int64_t back = 0;
+        CHECK(codec_get_svarint(buf, end, &back) == end && back == v);
+    }
+    // Zigzag keeps small negative numbers short: 0, -1, 1, -2 ... -> 0, 1, 2, 3 ...
+    uint64_t u = 0;
+    codec_get_varint(buf, codec_put_svarint(buf, -1), &u);
+    CHECK(u == 1);
+    codec_get_varint(buf, codec_put_svarint(buf, -64), &u);
+    CHECK(u == 127);
+}
+
+static void test_crc(void) {
+    const char* text = "123456789";
+    CHECK(codec_crc32(text, 9) == 0xCBF43926u);     // the CRC-32 check value
+    CHECK(codec_crc32(text, 0) == 0);
+    for (int split = 0; split <= 9; split++) {
+        uint32_t crc = codec_crc32_extend(0, text, (size_t)split);
+        CHECK(codec_crc32_extend(crc, text + split, (size_t)(9 - split)) == 0xCBF43926u);
+    }
+}
+
+// A block of 'count' varints 0, 1000, 2000 ...; returns its size
+static size_t make_block(unsigned char* block, uint32_t count) {
+    unsigned char* p = block + CODEC_BLOCK_HEAD;
+    for (uint32_t i = 0; i < count; i++) {
+        p = codec_put_varint(p, (uint64_t)i * 1000);
+    }
+    return codec_block_finish(block, (size_t)(p - block - CODEC_BLOCK_HEAD), count);
+}
+
+// Check a block and decode its records the way the data files do: the
+// record count is outside the CRC, so it must also match the payload
+static int block_ok(const unsigned char* block, size_t avail) {
+    uint32_t count;
+    long size = codec_block_check(block, avail, &count);
+    if (size == -1) return 0;
+    const unsigned char* p = block + CODEC_BLOCK_HEAD;
+    const unsigned char* end = block + size - CODEC_BLOCK_TAIL;
+    uint64_t v;
+    for (uint32_t i = 0; i < count && p != NULL; i++) {
+        p = codec_get_varint(p, end, &v);
+    }
+    return p == end;
+}
+
+static void test_blocks(void) {
+    unsigned char data[4096];
+    unsigned char copy[4096];
+    uint32_t count = 0;
+
+    size_t first = make_block(data, 100);
+    size_t second = make_block(data + first, 7);
+    size_t total = first + second;
+
+    // Both blocks check and decode; the trailing size walks back to each start
+    CHECK(codec_block_check(data, total, &count) == (long)first && count == 100);
+    CHECK(block_ok(data, total) && block_ok(data + first, second));
+    CHECK(codec_block_check(data + first, second, &count) == (long)second && count == 7);
+    CHECK(codec_block_start(data, total) == (long)first);
+    CHECK(codec_block_start(data, first) == 0);
+    const unsigned char* p = data + CODEC_BLOCK_HEAD;
+    const unsigned char* end = data + first - CODEC_BLOCK_TAIL;
+    int decoded = 0;
+    uint64_t v;
+    while (p < end && (p = codec_get_varint(p, end, &v)) != NULL) {
+        CHECK(v == (uint64_t)decoded * 1000);
+        decoded++;
+    }
+    CHECK(decoded == 100);
+
+    // Any flipped byte, anywhere in the block, is rejected
+    int accepted = 0;
+    for (size_t i = 0; i < first; i++) {
+        memcpy(copy, data, total);
+        copy[i] ^= 0x20;
+        if (block_ok(copy, total)) accepted++;
+    }
+    CHECK(accepted == 0);
+
+    // So is a block cut short, or one that is not a block at all
+    for (size_t avail = 0; avail < first; avail += 7) {
+        CHECK(codec_block_check(data, avail, &count) == -1);
+    }
+    memset(copy, 0, sizeof(copy));
+    CHECK(codec_block_check(copy, sizeof(copy), &count) == -1);
+    CHECK(codec_block_start(data, CODEC_BLOCK_HEAD) == -1);
+
+    // An empty payload is still a block
+    size_t empty = codec_block_finish(copy, 0, 0);
+    CHECK(empty == CODEC_BLOCK_HEAD + CODEC_BLOCK_TAIL);
+    CHECK(codec_block_check(copy, empty, &count) == (long)empty && count == 0);
+}
+
+int main() {
+    test_varints();
+    test_crc();
+    test_blocks();
+    return test_result("test_codec");
+}
@@ -1,14 +1,306 @@
 #include "highscore.h"
+#include "leaderboard.h"
+#include "test.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
-int main() {
-    // Test adding scores
+#define JOURNAL HIGHSCORE_FILE HIGHSCORE_JOURNAL_SUFFIX
+#define LB_PATH "board.dat"         // leaderboard fed straight through leaderboard_add_run()
+#define LB_PLAYERS 8
+#define LB_MAX_GAMES 8000
+
+// Whole contents of a file (NULL and *size 0 if it does not exist)
+static unsigned char* read_file(const char* path, size_t* size) {
+    FILE* fp = fopen(path, "rb");
+    *size = 0;
+    if (fp == NULL) return NULL;
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    unsigned char* data = malloc(n > 0 ? (size_t)n : 1);
+    if (data != NULL && fread(data, 1, (size_t)n, fp) == (size_t)n) *size = (size_t)n;
+    fclose(fp);
+    return data;
+}
+
+static void write_file(const char* path, const unsigned char* data, size_t size) {
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL) return;
+    fwrite(data, 1, size, fp);
+    fclose(fp);
+}
+
+static long saved_games(void) {
+    Leaderboard lb;
+    if (leaderboard_open(&lb, HIGHSCORE_FILE) == -1) return -1;
+    long games = leaderboard_games(&lb, 0);
+    leaderboard_close(&lb);
+    return games;
+}
+
+// No game twice in a loaded table, best first
+static int table_sane(const HighScoreTable* t) {
+    for (int i = 0; i < t->count; i++) {
+        if (i > 0 && t->scores[i - 1].score < t->scores[i].score) return 0;
+        for (int j = 0; j < i; j++) {
+            if (t->scores[i].id == t->scores[j].id) return 0;
+        }
+    }
+    return 1;
+}
+
+static void test_table(void) {
+    HighScore scores[MAX_HIGHSCORES];
     add_highscore("Alice", 100, 2);
     add_highscore("Bob", 150, 1);
     add_highscore("Charlie", 80, 3);
-    
-    // Display results
-    display_highscores();
-    
-    return 0;
-}
\ No newline at end of file
+    int count = load_highscores(scores, MAX_HIGHSCORES);
+    CHECK(count == 3);
+    CHECK(strcmp(scores[0].name, "Bob") == 0 && scores[0].score == 150 && scores[0].speed_level == 1);
+    CHECK(strcmp(scores[1].name, "Alice") == 0 && scores[1].score == 100);
+    CHECK(strcmp(scores[2].name, "Charlie") == 0 && scores[2].score == 80);
+    CHECK(is_highscore(1));     // the table is not full yet
+
+    // Identical games are still separate games
+    for (int i = 0; i < 5; i++) add_highscore("Player", 0, 4);
+    count = load_highscores(scores, MAX_HIGHSCORES);
+    CHECK(count == 8);
+    CHECK(saved_games() == 8);
+
+    // A table that keeps more than MAX_HIGHSCORES games waiting saves them, not drops them
+    HighScoreTable t;
+    highscore_table_load(&t, HIGHSCORE_FILE);
+    int failed = 0;
+    for (int i = 0; i < 3 * MAX_HIGHSCORES; i++) {
+        if (highscore_table_insert(&t, "Batch", 10 + i, 3) == -2) failed++;
+    }
+    CHECK(failed == 0);
+    CHECK(highscore_table_save(&t) == 0);
+    CHECK(saved_games() == 8 + 3 * MAX_HIGHSCORES);
+    highscore_table_load(&t, HIGHSCORE_FILE);
+    CHECK(t.count == MAX_HIGHSCORES && table_sane(&t));
+    CHECK(t.scores[0].score == 150 && t.scores[3].score == 10 + 3 * MAX_HIGHSCORES - 1);
+    CHECK(!is_highscore(0));
+}
+
+/**
+ * A fold that crashes leaves the journal behind: after the leaderboard
+ * run and the snapshot were written (before the truncate), or after only
+ * the run. Loading and folding again must count each game once.
+ */
+static void test_crashed_fold(void) {
+    HighScoreTable t;
+    size_t journal_size, snapshot_size;
+    for (int i = 0; i < 6; i++) add_highscore("Crash", 500 + i, 5);
+    long before = saved_games();
+    highscore_table_load(&t, HIGHSCORE_FILE);
+    HighScore top = t.scores[0];
+    int count = t.count;
+
+    unsigned char* journal = read_file(JOURNAL, &journal_size);
+    unsigned char* snapshot = read_file(HIGHSCORE_FILE, &snapshot_size);
+    CHECK(journal != NULL && journal_size > 0);
+
+    // Crash before the truncate
+    CHECK(highscore_compact(HIGHSCORE_FILE) == 0);
+    write_file(JOURNAL, journal, journal_size);
+    CHECK(saved_games() == before);
+    highscore_table_load(&t, HIGHSCORE_FILE);
+    CHECK(t.count == count && table_sane(&t) && t.scores[0].id == top.id);
+    CHECK(highscore_compact(HIGHSCORE_FILE) == 0);
+    CHECK(saved_games() == before);
+
+    // Crash between the leaderboard run and the snapshot
+    write_file(JOURNAL, journal, journal_size);
+    write_file(HIGHSCORE_FILE, snapshot, snapshot_size);
+    highscore_table_load(&t, HIGHSCORE_FILE);
+    CHECK(t.count == count && table_sane(&t) && t.scores[0].id == top.id);
+    CHECK(saved_games() == before);
+    CHECK(highscore_compact(HIGHSCORE_FILE) == 0);
+    CHECK(saved_games() == before);
+    highscore_table_load(&t, HIGHSCORE_FILE);
+    CHECK(t.count == count && table_sane(&t));
+    free(journal);
+    free(snapshot);
+}
+
+// Ranking order of the leaderboard, written out again
+static int rank_order(const void* pa, const void* pb) {
+    const HighScore* a = pa;
+    const HighScore* b = pb;
+    if (a->score != b->score) return a->score > b->score ? -1 : 1;
+    if (a->date != b->date) return a->date < b->date ? -1 : 1;
+    int c = strncmp(a->name, b->name, MAX_NAME_LENGTH);
+    if (c != 0) return c;
+    if (a->speed_level != b->speed_level) return a->speed_level < b->speed_level ? -1 : 1;
+    return (a->id > b->id) - (a->id < b->id);
+}
+
+// Check every board of the leaderboard at LB_PATH against the sorted games in all[]
+static void check_leaderboard(const HighScore* all, int n) {
+    Leaderboard lb;
+    HighScore* sorted = malloc((size_t)n * sizeof(HighScore));
+    HighScore* board = malloc((size_t)n * sizeof(HighScore));
+    HighScore top[100];
+    CHECK(sorted != NULL && board != NULL && leaderboard_open(&lb, LB_PATH) == 0);
+    memcpy(sorted, all, (size_t)n * sizeof(HighScore));
+    qsort(sorted, n, sizeof(HighScore), rank_order);
+
+    for (int b = 0; b < LEADERBOARD_BOARDS; b++) {
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            if (b == 0 || sorted[i].speed_level == b) board[m++] = sorted[i];
+        }
+        CHECK(leaderboard_games(&lb, b) == m);
+
+        // Rank of a score: 1 + games that scored more
+        int wrong = 0;
+        for (int score = -1; score <= 1001; score += 13) {
+            long above = 0;
+            while (above < m && board[above].score > score) above++;
+            if (leaderboard_rank(&lb, b, score) != above + 1) wrong++;
+        }
+        CHECK(wrong == 0);
+
+        // Best games, in order, each once
+        int k = leaderboard_top(&lb, b, 0, top, 100);
+        CHECK(k == (m < 100 ? m : 100));
+        wrong = 0;
+        for (int i = 0; i < k; i++) {
+            if (top[i].id != board[i].id) wrong++;
+        }
+        CHECK(wrong == 0);
+
+        // Each player's best: the first of their games in ranking order
+        k = leaderboard_top(&lb, b, 1, top, 100);
+        int players = 0;
+        wrong = 0;
+        for (int i = 0; i < m; i++) {
+            int first = 1;
+            for (int j = 0; j < i && first; j++) {
+                first = strcmp(board[j].name, board[i].name) != 0;
+            }
+            if (!first) continue;
+            HighScore best;
+            if (players >= k || top[players].id != board[i].id ||
+                !leaderboard_player_best(&lb, b, board[i].name, &best) || best.id != board[i].id) {
+                wrong++;
+            }
+            players++;
+        }
+        CHECK(wrong == 0 && k == players);
+    }
+    CHECK(!leaderboard_player_best(&lb, 0, "nobody", top));
+    leaderboard_close(&lb);
+    free(sorted);
+    free(board);
+}
+
+static long run_games_of(const Leaderboard* lb, int r) {
+    return (long)lb->runs[r].head->boards[0].ranked_count;
+}
+
+// Batches of every size, so runs are written and merged at every depth
+static void test_leaderboard_merges(void) {
+    HighScore* all = malloc(LB_MAX_GAMES * sizeof(HighScore));
+    int n = 0;
+    int batches = 0;
+    CHECK(all != NULL);
+    srand(24);
+    while (n < LB_MAX_GAMES) {
+        int size = 1 + rand() % (batches % 5 == 4 ? 1500 : 60);
+        if (size > LB_MAX_GAMES - n) size = LB_MAX_GAMES - n;
+        for (int i = 0; i < size; i++) {
+            HighScore* s = &all[n + i];
+            memset(s, 0, sizeof(HighScore));
+            snprintf(s->name, MAX_NAME_LENGTH, "player%d", rand() % LB_PLAYERS);
+            s->score = rand() % 1000;
+            s->speed_level = 1 + rand() % 6;
+            s->date = 1700000000 + rand() % 200;       // many ties on score and date
+            s->id = highscore_new_id();
+        }
+        CHECK(leaderboard_add_run(LB_PATH, all + n, size) == 0);
+        n += size;
+        if (++batches % 7 == 0) check_leaderboard(all, n);
+
+        // Folding a batch again (a crash before the truncate) adds nothing
+        if (batches % 11 == 0) {
+            CHECK(leaderboard_add_run(LB_PATH, all + n - size, size) == 0);
+        }
+    }
+    check_leaderboard(all, n);
+
+    // Run sizes double from newest to oldest, so there are only a few runs
+    Leaderboard lb;
+    CHECK(leaderboard_open(&lb, LB_PATH) == 0);
+    CHECK(lb.run_count >= 1 && lb.run_count <= 14);
+    leaderboard_close(&lb);
+    free(all);
+}
+
+// Flip one byte of a file, counted from its start (or from its end if 'at' is negative)
+static void flip_byte(const char* path, long at) {
+    size_t size;
+    unsigned char* data = read_file(path, &size);
+    if (data == NULL || size == 0) return;
+    data[at < 0 ? (long)size + at : at] ^= 0x40;
+    write_file(path, data, size);
+    free(data);
+}
+
+/**
+ * A run with a damaged header, and one whose records fail their CRC when
+ * it is due to be merged, are moved aside: the fold still succeeds and
+ * only their games leave the leaderboard
+ */
+static void test_damaged_runs(void) {
+    Leaderboard lb;
+    char oldest[64], newest[64], bad[80];
+    CHECK(leaderboard_open(&lb, LB_PATH) == 0 && lb.run_count >= 2);
+    long games = leaderboard_games(&lb, 0);
+    long newest_games = run_games_of(&lb, lb.run_count - 1);
+    long lost = run_games_of(&lb, 0) + newest_games;
+    int runs = lb.run_count;
+    snprintf(oldest, sizeof(oldest), "%s.run%llu", LB_PATH, (unsigned long long)lb.runs[0].head->seq);
+    snprintf(newest, sizeof(newest), "%s.run%llu", LB_PATH,
+             (unsigned long long)lb.runs[lb.run_count - 1].head->seq);
+    leaderboard_close(&lb);
+
+    flip_byte(oldest, 8);       // the header's sequence number
+    flip_byte(newest, -1);      // the last record
+    CHECK(leaderboard_open(&lb, LB_PATH) == 0 && lb.run_count == runs - 1);     // skipped, not an error
+    leaderboard_close(&lb);
+
+    // A batch big enough to merge the newest run
+    int size = (int)newest_games;
+    HighScore* batch = calloc((size_t)size, sizeof(HighScore));
+    CHECK(batch != NULL);
+    for (int i = 0; i < size; i++) {
+        snprintf(batch[i].name, MAX_NAME_LENGTH, "late%d", i % 4);
+        batch[i].score = i;
+        batch[i].speed_level = 1 + i % 6;
+        batch[i].date = 1700001000;
+        batch[i].id = highscore_new_id();
+    }
+    CHECK(leaderboard_add_run(LB_PATH, batch, size) == 0);
+    snprintf(bad, sizeof(bad), "%s.bad", oldest);
+    CHECK(access(bad, F_OK) == 0 && access(oldest, F_OK) == -1);
+    snprintf(bad, sizeof(bad), "%s.bad", newest);
+    CHECK(access(bad, F_OK) == 0);
+
+    CHECK(leaderboard_open(&lb, LB_PATH) == 0);
+    CHECK(leaderboard_games(&lb, 0) == games - lost + size);
+    leaderboard_close(&lb);
+    CHECK(leaderboard_add_run(LB_PATH, batch, 10) == 0);    // and it stays healthy
+    free(batch);
+}
+
+int main() {
+    test_table();
+    test_crashed_fold();
+    test_leaderboard_merges();
+    test_damaged_runs();
+    return test_result("test_highscore");
+}
@@ -0,0 +1,132 @@
+#include "game.h"
+#include "fish_kernels.h"
+#include "bot.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_KERNELS 3
+#define PASS_MAX 100                // fish per direct pass check
+
+static const char* const kernel_names[MAX_KERNELS] = { "scalar", "sse2", "avx2" };
+static const FishKernels* kernels[MAX_KERNELS];
+static int kernel_count;
+
+// Every kernel set this CPU can run, scalar (the reference) first
+static void find_kernels(void) {
+    for (int i = 0; i < MAX_KERNELS; i++) {
+        if (fish_kernels_use(kernel_names[i]) == 0) {
+            kernels[kernel_count++] = fish_kernels_get();
+        } else {
+            printf("test_kernels: %s not supported here, skipped\n", kernel_names[i]);
+        }
+    }
+    fish_kernels_use("auto");
+}
+
+/**
+ * The same seed through every kernel set, in lockstep: the bot plays the
+ * scalar game and every game gets its key, and game_hash() must agree
+ * on every frame. A few games in a row, so respawns and resets count too.
+ */
+static void test_lockstep(int cols, int lines, int fish, int schooling, unsigned long long seed) {
+    GameState games[MAX_KERNELS];
+    int ready = 1;
+    for (int k = 0; k < kernel_count; k++) {
+        ready &= game_init(&games[k], cols, lines, fish, seed) == 0 &&
+                 game_set_schooling(&games[k], schooling) == 0;
+        games[k].kernels = kernels[k];
+    }
+    CHECK(ready);
+
+    long frames = 0;
+    int diverged = 0;
+    for (int round = 0; round < 3 && !diverged; round++) {
+        while (!games[0].game_over && !diverged) {
+            int key = bot_input(&games[0]);
+            if (frames % 97 == 0) key = 'h';    // some blind drops too, for misses
+            for (int k = 0; k < kernel_count; k++) {
+                game_step(&games[k], key);
+            }
+            frames++;
+            unsigned long long want = game_hash(&games[0]);
+            for (int k = 1; k < kernel_count && !diverged; k++) {
+                if (game_hash(&games[k]) != want) {
+                    fprintf(stderr, "test_kernels: %s diverges from scalar at frame %ld "
+                            "(%dx%d, %d fish, schooling %d, seed %llu)\n", kernels[k]->name,
+                            games[k].frame, cols, lines, fish, schooling, seed);
+                    diverged = 1;
+                }
+            }
+        }
+        for (int k = 0; k < kernel_count; k++) {
+            game_reset(&games[k], seed + 1 + round);
+        }
+    }
+    CHECK(!diverged);
+    CHECK(frames > 0);
+    for (int k = 0; k < kernel_count; k++) {
+        game_free(&games[k]);
+    }
+}
+
+/**
+ * The passes on their own, for every length up to PASS_MAX (so every
+ * vector tail), with fish on and past both edges and hooks around them
+ */
+static void test_passes(void) {
+    int pos[MAX_KERNELS][PASS_MAX], counter[MAX_KERNELS][PASS_MAX];
+    int dir[PASS_MAX], fps[PASS_MAX], row[PASS_MAX];
+    unsigned char alive[PASS_MAX];
+    int wrong = 0;
+    srand(7);
+    for (int n = 0; n <= PASS_MAX; n++) {
+        int cols = 20 + rand() % 100;
+        int right_edge = cols - FISH_WIDTH;
+        for (int i = 0; i < n; i++) {
+            pos[0][i] = rand() % 4 == 0 ? (rand() % 2 ? 0 : right_edge + rand() % 2) : rand() % cols;
+            counter[0][i] = rand() % 4;
+            dir[i] = rand() % 2 ? 1 : -1;
+            fps[i] = 1 + rand() % 3;
+            row[i] = rand() % 12;
+            alive[i] = rand() % 5 != 0;
+        }
+        for (int k = 1; k < kernel_count; k++) {
+            memcpy(pos[k], pos[0], sizeof(pos[0]));
+            memcpy(counter[k], counter[0], sizeof(counter[0]));
+        }
+        for (int step = 0; step < 8; step++) {
+            for (int k = 0; k < kernel_count; k++) {
+                kernels[k]->move(pos[k], dir, fps, counter[k], n, right_edge, right_edge);
+            }
+            for (int k = 1; k < kernel_count; k++) {
+                if (memcmp(pos[k], pos[0], n * sizeof(int)) != 0 ||
+                    memcmp(counter[k], counter[0], n * sizeof(int)) != 0) {
+                    wrong++;
+                }
+            }
+            for (int probe = 0; probe < 20; probe++) {
+                int hook_x = rand() % cols - 2;
+                int hook_y = rand() % 14 - 1;
+                int want = kernels[0]->find_hit(pos[0], row, alive, n, hook_x, hook_y);
+                for (int k = 1; k < kernel_count; k++) {
+                    if (kernels[k]->find_hit(pos[k], row, alive, n, hook_x, hook_y) != want) wrong++;
+                }
+            }
+        }
+    }
+    CHECK(wrong == 0);
+}
+
+int main() {
+    find_kernels();
+    CHECK(kernel_count >= 1 && strcmp(kernels[0]->name, "scalar") == 0);
+    test_passes();
+    test_lockstep(80, 24, DEFAULT_FISH, 0, 1);
+    test_lockstep(81, 30, 37, 0, 2);            // fish counts that leave vector tails
+    test_lockstep(133, 43, 1000, 0, 3);
+    test_lockstep(200, 60, 5003, 0, 4);
+    test_lockstep(120, 40, 300, 1, 5);          // schooling
+    return test_result("test_kernels");
+}
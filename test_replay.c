@@ -0,0 +1,236 @@
+#include "game.h"
+#include "replay.h"
+#include "bot.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REC_PATH "test.rec"
+#define MAX_FRAMES 20000
+
+/**
+ * Record one bot-played game, replay it straight through, then seek to
+ * frames in every order: each seek must land on the exact state the
+ * straight replay passed through (game_hash() before that frame's step)
+ */
+static void test_seek(int fish, int schooling, unsigned long long seed) {
+    static unsigned long long hashes[MAX_FRAMES + 1];
+    GameState game;
+    Recording rec;
+    Replay straight, rp;
+
+    CHECK(game_init(&game, 120, 40, fish, seed) == 0 && game_set_schooling(&game, schooling) == 0);
+    CHECK(recording_start(&rec, &game, REC_PATH) == 0);
+    while (!game.game_over && game.frame < MAX_FRAMES) {
+        int key = bot_input(&game);
+        recording_frame(&rec, &game);
+        recording_key(&rec, game.frame, key);
+        recording_mark(&rec, &game, game_step(&game, key));
+    }
+    CHECK(recording_save(&rec, game.frame) == 0);
+    recording_free(&rec);
+    long frames = game.frame;
+    unsigned long long played = game_hash(&game);
+    int score = game.score;
+    int caught = game.fish_caught_total;
+    game_free(&game);
+    CHECK(caught > 0);                  // the bot caught something worth seeking to
+
+    // Straight through, keeping the state before every frame
+    CHECK(replay_load(&straight, REC_PATH) == 0 && replay_new_game(&straight, &game) == 0);
+    while (!replay_finished(&straight, game.frame) && game.frame < MAX_FRAMES) {
+        hashes[game.frame] = game_hash(&game);
+        game_step(&game, replay_key(&straight, game.frame));
+    }
+    hashes[game.frame] = game_hash(&game);
+    CHECK(game.frame == frames && game_hash(&game) == played);
+    CHECK(game.score == score && game.fish_caught_total == caught);
+    game_free(&game);
+    replay_free(&straight);
+
+    // Seeks (a game and its Replay move together): the start, the end,
+    // keyframe edges, then random frames back and forth
+    GameState seeker;
+    CHECK(replay_load(&rp, REC_PATH) == 0 && replay_new_game(&rp, &seeker) == 0);
+    CHECK(rp.keyframe_count >= 2);
+    int wrong = 0;
+    srand((unsigned)seed);
+    for (int k = 0; k < 300; k++) {
+        long frame;
+        if (k < 2) frame = k == 0 ? 0 : frames;
+        else if (k < 2 + 2 * rp.keyframe_count) frame = rp.keyframes[(k - 2) / 2].frame - (k % 2);
+        else frame = rand() % (frames + 1);
+        if (frame < 0) frame = 0;
+        if (replay_seek(&rp, &seeker, frame) == -1 || seeker.frame != frame ||
+            game_hash(&seeker) != hashes[frame]) {
+            wrong++;
+            continue;
+        }
+        // ... and playing on from there keeps matching
+        for (int step = 0; step < 5 && seeker.frame < frames; step++) {
+            game_step(&seeker, replay_key(&rp, seeker.frame));
+            if (game_hash(&seeker) != hashes[seeker.frame]) wrong++;
+        }
+    }
+    CHECK(wrong == 0);
+    game_free(&seeker);
+
+    // Every catch and miss indexed in the recording is where the replay has one
+    CHECK(replay_new_game(&rp, &seeker) == 0);
+    CHECK(rp.mark_count > 0);
+    wrong = 0;
+    for (int m = 0; m < rp.mark_count; m++) {
+        if (replay_seek(&rp, &seeker, rp.marks[m].frame) == -1 || seeker.score != rp.marks[m].score) {
+            wrong++;
+        }
+    }
+    CHECK(wrong == 0);
+    game_free(&seeker);
+    replay_free(&rp);
+}
+
+/**
+ * game_step() applies the key before the fish and hook move: a drop and a
+ * boat move show on the frame they were given to. Recordings rely on it.
+ */
+static void test_input_timing(void) {
+    GameState game;
+    CHECK(game_init(&game, 120, 40, 0, 3) == 0);
+    int boat_x = game.boat_x;
+    game_step(&game, 'h');
+    CHECK(game.hook_lowering == 1 && game.hook_depth == 1);
+    game_step(&game, 'a');
+    CHECK(game.boat_x == boat_x - 1 && game.hook_depth == 2);
+    game_step(&game, GAME_INPUT_NONE);
+    CHECK(game.boat_x == boat_x - 1 && game.hook_depth == 3);
+    game_free(&game);
+}
+
+// Restore 'snap' (len bytes) into a copy of 'game'; 0 if it loaded
+static int restores(const GameState* game, const unsigned char* snap, size_t len) {
+    GameState copy;
+    if (game_init(&copy, game->cols, game->lines, game->fish.capacity, 1) == -1) return -1;
+    unsigned long long before = game_hash(&copy);
+    int r = game_restore(&copy, snap, len);
+    if (r == -1 && game_hash(&copy) != before) r = -2;     // a refused snapshot changed the game
+    game_free(&copy);
+    return r;
+}
+
+static void put_int(unsigned char* p, int v) {
+    memcpy(p, &v, sizeof(int));
+}
+
+/**
+ * Damaged or crafted snapshots are refused without touching the game.
+ * A snapshot is the fixed head (used, count, free_count, boat_x,
+ * hook_depth, hook_lowering, two flags, speed ...), then pos, row, dir,
+ * frames per step and counter for each slot, the alive bytes and the
+ * free list.
+ */
+static void test_bad_snapshots(void) {
+    GameState game;
+    CHECK(game_init(&game, 120, 40, 50, 11) == 0);
+    for (int i = 0; i < 200; i++) game_step(&game, bot_input(&game));
+    int n = game.fish.used;
+    size_t len = game_snapshot(&game, NULL, 0);
+    size_t head = len - (size_t)n * (5 * sizeof(int) + 1);
+    unsigned char* snap = malloc(len + 2 * sizeof(int));
+    unsigned char* bad = malloc(len + 2 * sizeof(int));
+    CHECK(snap != NULL && bad != NULL && game.fish.free_count == 0);
+    game_snapshot(&game, snap, len);
+    CHECK(restores(&game, snap, len) == 0);
+
+    // Scalars out of range: boat_x, hook_depth, hook_lowering, speed
+    int fields[][2] = { { 3, -1 }, { 3, 120 }, { 4, -1 }, { 4, 1000 }, { 5, 2 }, { 8, 0 }, { 8, MAX_SPEED + 1 } };
+    for (unsigned k = 0; k < sizeof(fields) / sizeof(fields[0]); k++) {
+        memcpy(bad, snap, len);
+        put_int(bad + fields[k][0] * sizeof(int), fields[k][1]);
+        CHECK(restores(&game, bad, len) == -1);
+    }
+    // A live count that does not match the alive bytes, a fish off the pond
+    memcpy(bad, snap, len);
+    put_int(bad + sizeof(int), n - 1);
+    CHECK(restores(&game, bad, len) == -1);
+    memcpy(bad, snap, len);
+    put_int(bad + head + (size_t)n * sizeof(int), -5);     // row of fish 0
+    CHECK(restores(&game, bad, len) == -1);
+
+    // Free lists with slots 0 and 1 dead: each dead slot listed once loads, nothing else does
+    unsigned char* alive = bad + head + (size_t)n * 5 * sizeof(int);
+    int lists[][3] = {      // length, slots
+        { 2, 0, 1 }, { 2, 1, 0 }, { 2, 0, 0 }, { 2, 0, 2 }, { 2, 0, n }, { 2, 0, -1 }, { 1, 0, 0 },
+    };
+    for (unsigned k = 0; k < sizeof(lists) / sizeof(lists[0]); k++) {
+        int listed = lists[k][0];
+        memcpy(bad, snap, len);
+        put_int(bad + sizeof(int), n - 2);                  // count
+        put_int(bad + 2 * sizeof(int), listed);             // free_count
+        alive[0] = alive[1] = 0;
+        for (int i = 0; i < listed; i++) {
+            put_int(bad + len + (size_t)i * sizeof(int), lists[k][1 + i]);
+        }
+        CHECK(restores(&game, bad, len + (size_t)listed * sizeof(int)) == (k < 2 ? 0 : -1));
+    }
+    free(snap);
+    free(bad);
+    game_free(&game);
+}
+
+// Overwrite 'len' bytes of the recording at 'offset'
+static void patch_file(const char* path, long offset, const void* data, size_t len) {
+    FILE* fp = fopen(path, "r+b");
+    if (fp == NULL) return;
+    fseek(fp, offset, SEEK_SET);
+    fwrite(data, 1, len, fp);
+    fclose(fp);
+}
+
+/**
+ * A flipped byte in a keyframe - here the score, which would still load -
+ * fails its CRC; a keyframe index pointing outside the snapshots is
+ * refused when the recording is opened
+ */
+static void test_damaged_recording(void) {
+    Replay rp;
+    GameState game;
+    CHECK(replay_load(&rp, REC_PATH) == 0 && rp.keyframe_count >= 2);
+    ReplayKeyframe first = rp.keyframes[0];
+    long index_offset = -1;
+    FILE* fp = fopen(REC_PATH, "rb");
+    ReplayTrailer t;
+    if (fp != NULL && fseek(fp, -(long)sizeof(t), SEEK_END) == 0 && fread(&t, sizeof(t), 1, fp) == 1) {
+        index_offset = (long)t.index_offset;
+    }
+    if (fp != NULL) fclose(fp);
+    CHECK(index_offset > 0);
+    replay_free(&rp);
+
+    unsigned char byte;
+    long score_at = (long)first.offset + 9 * sizeof(int32_t);
+    fp = fopen(REC_PATH, "rb");
+    CHECK(fp != NULL && fseek(fp, score_at, SEEK_SET) == 0 && fread(&byte, 1, 1, fp) == 1);
+    if (fp != NULL) fclose(fp);
+    byte ^= 0x01;
+    patch_file(REC_PATH, score_at, &byte, 1);
+    CHECK(replay_load(&rp, REC_PATH) == 0 && replay_new_game(&rp, &game) == 0);
+    CHECK(replay_seek(&rp, &game, (long)first.frame) == -1);
+    CHECK(replay_seek(&rp, &game, (long)first.frame - 1) == 0);     // no keyframe needed
+    game_free(&game);
+    replay_free(&rp);
+
+    ReplayKeyframe bad = first;
+    bad.size = (uint64_t)1 << 40;
+    patch_file(REC_PATH, index_offset, &bad, sizeof(bad));
+    CHECK(replay_load(&rp, REC_PATH) == -1);
+}
+
+int main() {
+    test_input_timing();
+    test_bad_snapshots();
+    test_seek(2000, 0, 42);     // plain fish: keyframes every ~131 frames
+    test_seek(300, 1, 7);       // schooling: flock state is in the snapshots too
+    test_damaged_recording();
+    return test_result("test_replay");
+}
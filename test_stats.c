@@ -1,22 +1,733 @@
 #include "statistics.h"
+#include "stats_store.h"
+#include "score_tree.h"
+#include "player_index.h"
+#include "stats_logger.h"
+#include "stats_query.h"
+#include "test.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define GAMES 40000                 // several query slices per day
+#define DAYS 5                      // recent days, raw (test_compaction() covers old ones)
+#define PLAYERS 12
+#define OLD_DAYS (STATS_STORE_KEEP_DAYS + 15)   // days of the compaction log, today last
+#define OLD_PER_DAY 200
+#define OLD_GAMES (OLD_DAYS * OLD_PER_DAY + 3)
+#define OLD_KINDS 24                // 3 players x 2 speeds x 4 scores
+#define PUSHERS 4
+#define PUSHES 5000                 // per thread: together more than the queue and a batch hold
+
+static GameStats logged[GAMES];     // every game, in the order it was logged
+
+static int same_stats(const GameStats* a, const GameStats* b) {
+    return a->timestamp == b->timestamp && strcmp(a->player_name, b->player_name) == 0 &&
+           a->final_score == b->final_score && a->fish_caught == b->fish_caught &&
+           a->hooks_missed == b->hooks_missed && a->speed_level == b->speed_level &&
+           a->lives_remaining == b->lives_remaining && a->game_duration == b->game_duration;
+}
+
+// Log GAMES games over DAYS days in batches of every size (blocks and days split them)
+static void log_games(void) {
+    time_t start = time(NULL) - DAYS * 86400;
+    int n = 0;
+    srand(16);
+    for (int i = 0; i < GAMES; i++) {
+        GameStats* g = &logged[i];
+        memset(g, 0, sizeof(GameStats));
+        g->timestamp = start + (time_t)i * (DAYS * 86400 / GAMES);
+        snprintf(g->player_name, sizeof(g->player_name), "player%02d", rand() % PLAYERS);
+        g->final_score = rand() % 3 == 0 ? rand() % 40 - 20 : rand() % 2500;
+        g->fish_caught = rand() % 60;
+        g->hooks_missed = rand() % 10;
+        g->speed_level = 1 + rand() % 6;
+        g->lives_remaining = rand() % 4;
+        g->game_duration = 10 + rand() % 50;
+    }
+    while (n < GAMES) {
+        int size = 1 + rand() % (n % 3 == 0 ? 700 : 20);
+        if (size > GAMES - n) size = GAMES - n;
+        CHECK(log_game_stats_batch(logged + n, size) == size);
+        n += size;
+    }
+    CHECK(stats_log_games(STATS_FILE) == GAMES);
+}
+
+// Forward and newest-first reads, and seeks, give the games as logged
+static void test_cursor(void) {
+    StatsCursor* c = malloc(sizeof(StatsCursor));
+    const GameStats* g;
+    CHECK(c != NULL);
+
+    CHECK(stats_cursor_open(c, STATS_FILE, 0) == 0 && c->count == GAMES);
+    int n = 0, wrong = 0;
+    while ((g = stats_cursor_next(c)) != NULL) {
+        if (n >= GAMES || !same_stats(g, &logged[n]) || c->weight != 1) wrong++;
+        n++;
+    }
+    CHECK(n == GAMES && wrong == 0 && c->bad_blocks == 0);
+    stats_cursor_close(c);
+
+    CHECK(stats_cursor_open(c, STATS_FILE, 1) == 0);
+    n = 0;
+    wrong = 0;
+    while ((g = stats_cursor_next(c)) != NULL) {
+        if (n >= GAMES || !same_stats(g, &logged[GAMES - 1 - n])) wrong++;
+        n++;
+    }
+    CHECK(n == GAMES && wrong == 0);
+    stats_cursor_close(c);
+
+    // Seek anywhere, then read a few games on, in both directions
+    for (int reverse = 0; reverse <= 1; reverse++) {
+        CHECK(stats_cursor_open(c, STATS_FILE, reverse) == 0);
+        wrong = 0;
+        for (int k = 0; k < 200; k++) {
+            int at = k < 4 ? (int[]){ 0, 1, GAMES - 1, GAMES }[k] : rand() % (GAMES + 1);
+            stats_cursor_seek(c, (uint64_t)at);
+            for (int step = 0; step < 3; step++) {
+                int want = reverse ? at - 1 - step : at + step;
+                g = stats_cursor_next(c);
+                if (want < 0 || want >= GAMES) {
+                    if (g != NULL) wrong++;
+                    break;
+                }
+                if (g == NULL || !same_stats(g, &logged[want])) wrong++;
+            }
+        }
+        CHECK(wrong == 0);
+        stats_cursor_close(c);
+    }
+
+    // A time range and a player: the same games as a linear filter
+    time_t from = logged[GAMES / 3].timestamp;
+    time_t to = logged[2 * GAMES / 3].timestamp;
+    CHECK(stats_cursor_open(c, STATS_FILE, 0) == 0);
+    stats_cursor_filter(c, from, to, "player03");
+    int i = 0;
+    wrong = 0;
+    while ((g = stats_cursor_next(c)) != NULL) {
+        while (i < GAMES && !(logged[i].timestamp >= from && logged[i].timestamp <= to &&
+                              strcmp(logged[i].player_name, "player03") == 0)) {
+            i++;
+        }
+        if (i == GAMES || !same_stats(g, &logged[i])) wrong++;
+        i++;
+    }
+    while (i < GAMES && !(logged[i].timestamp >= from && logged[i].timestamp <= to &&
+                          strcmp(logged[i].player_name, "player03") == 0)) {
+        i++;
+    }
+    CHECK(wrong == 0 && i >= GAMES);
+    stats_cursor_close(c);
+    free(c);
+}
+
+// Slices read one after the other cover the log exactly once, in order
+static void test_slices(void) {
+    StatsCursor* c = malloc(sizeof(StatsCursor));
+    StatsCursor* reader = malloc(sizeof(StatsCursor));
+    StatsSlice* slices = NULL;
+    const GameStats* g;
+    CHECK(c != NULL && reader != NULL);
+    CHECK(stats_cursor_open(c, STATS_FILE, 0) == 0 && stats_cursor_open(reader, STATS_FILE, 0) == 0);
+
+    int count = stats_cursor_slices(c, STATS_BLOCK_BYTES, &slices);
+    CHECK(count > DAYS);
+    int n = 0, wrong = 0;
+    for (int s = 0; s < count; s++) {
+        if (stats_cursor_slice(reader, &slices[s]) == -1) {
+            wrong++;
+            continue;
+        }
+        while ((g = stats_cursor_next(reader)) != NULL) {
+            if (n >= GAMES || !same_stats(g, &logged[n])) wrong++;
+            n++;
+        }
+    }
+    CHECK(n == GAMES && wrong == 0);
+    free(slices);
+    stats_cursor_close(reader);
+    stats_cursor_close(c);
+    free(reader);
+    free(c);
+}
+
+static int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Fenwick ranks and quantiles agree with a sorted array of the same scores
+static void test_score_tree(void) {
+    static int scores[GAMES];
+    static const double qs[] = { 0.0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 1.0 };
+    ScoreTree t;
+    CHECK(score_tree_open(&t, STATS_FILE) == 0);
+
+    for (int board = 0; board < SCORE_TREE_BOARDS; board++) {
+        int n = 0;
+        for (int i = 0; i < GAMES; i++) {
+            if (board == 0 || logged[i].speed_level == board) scores[n++] = logged[i].final_score;
+        }
+        qsort(scores, n, sizeof(int), compare_ints);
+        CHECK(score_tree_count(&t, board) == n);
+
+        int wrong = 0;
+        for (unsigned k = 0; k < sizeof(qs) / sizeof(qs[0]); k++) {
+            long long want = (long long)(qs[k] * n + 0.999999);
+            if (want < 1) want = 1;
+            if (score_tree_quantile(&t, board, qs[k]) != scores[want - 1]) wrong++;
+        }
+        for (int score = -30; score < 2600; score += 37) {
+            long long below = 0, above = 0;
+            for (int i = 0; i < n; i++) {
+                below += scores[i] < score;
+                above += scores[i] > score;
+            }
+            if (score_tree_below(&t, board, score) != below || score_tree_above(&t, board, score) != above) {
+                wrong++;
+            }
+        }
+        CHECK(wrong == 0);
+    }
+    score_tree_close(&t);
+
+    // Rebuilt from the log, the trees come out the same
+    ScoreTree again;
+    CHECK(score_tree_open(&again, STATS_FILE) == 0 && score_tree_lock(&again) == 0);
+    long long before = score_tree_count(&again, 3);
+    int median = score_tree_quantile(&again, 0, 0.5);
+    CHECK(score_tree_rebuild(&again, STATS_FILE) == 0);
+    CHECK(score_tree_count(&again, 3) == before && score_tree_quantile(&again, 0, 0.5) == median);
+    score_tree_unlock(&again);
+    score_tree_close(&again);
+}
+
+// Local yyyymmdd of a game, the day of the segment it lands in
+static int day_of(time_t t) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    return (tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday;
+}
+
+// Does logged game i fall into query q's filter and into the group of 'row'?
+static int in_row(const StatsQuery* q, const StatsQueryRow* row, int i) {
+    const GameStats* g = &logged[i];
+    if (g->timestamp < q->from || g->timestamp > q->to ||
+        (q->player != NULL && strcmp(g->player_name, q->player) != 0) ||
+        (q->speed != 0 && g->speed_level != q->speed)) {
+        return 0;
+    }
+    switch (q->group) {
+    case STATS_GROUP_PLAYER: return strcmp(g->player_name, row->player) == 0;
+    case STATS_GROUP_DAY: return day_of(g->timestamp) == row->key;
+    case STATS_GROUP_SPEED: return g->speed_level == row->key;
+    default: return 1;
+    }
+}
+
+// Nearest-rank percentile of n sorted values, the way the query takes it
+static int nearest_rank(const int* sorted, int n, double p) {
+    long long want = (long long)(p * n + 0.999999);
+    if (want < 1) want = 1;
+    return sorted[want - 1];
+}
+
+// Every row of query q against the same sums, extremes and percentiles taken over logged[]
+static int query_matches(const StatsQuery* q, const StatsQueryResult* res) {
+    static const double ps[STATS_QUERY_PERCENTILES] = { 0.50, 0.90, 0.99 };
+    static int scores[GAMES], durations[GAMES];
+    long long covered = 0;
+    for (int r = 0; r < res->count; r++) {
+        const StatsQueryRow* row = &res->rows[r];
+        long long score_sum = 0, duration_sum = 0, caught = 0, missed = 0;
+        int n = 0;
+        for (int i = 0; i < GAMES; i++) {
+            if (!in_row(q, row, i)) continue;
+            scores[n] = logged[i].final_score;
+            durations[n++] = logged[i].game_duration;
+            score_sum += logged[i].final_score;
+            duration_sum += logged[i].game_duration;
+            caught += logged[i].fish_caught;
+            missed += logged[i].hooks_missed;
+        }
+        if (n == 0 || row->games != n || row->score_sum != score_sum || row->duration_sum != duration_sum ||
+            row->caught != caught || row->missed != missed || row->duration_approx) {
+            return 0;
+        }
+        qsort(scores, n, sizeof(int), compare_ints);
+        qsort(durations, n, sizeof(int), compare_ints);
+        if (row->score_min != scores[0] || row->score_max != scores[n - 1] ||
+            row->duration_min != durations[0] || row->duration_max != durations[n - 1]) {
+            return 0;
+        }
+        for (int k = 0; k < STATS_QUERY_PERCENTILES; k++) {
+            if (row->score_pct[k] != nearest_rank(scores, n, ps[k]) ||
+                row->duration_pct[k] != nearest_rank(durations, n, ps[k])) {
+                return 0;
+            }
+        }
+        covered += n;
+    }
+    // ... and no matching game was left out of every row
+    StatsQueryRow any;
+    memset(&any, 0, sizeof(any));
+    StatsQuery all = *q;
+    all.group = STATS_GROUP_NONE;
+    long long want = 0;
+    for (int i = 0; i < GAMES; i++) want += in_row(&all, &any, i);
+    return covered == want;
+}
+
+static GameStats old_games[OLD_GAMES];   // the compaction log's games, raw
+
+// Noon (local time) 'days' days ago, so a day's games stay inside it
+static time_t noon_days_ago(int days) {
+    time_t t = time(NULL) - (time_t)days * 86400;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    tm.tm_hour = 12;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
+    return mktime(&tm);
+}
+
+// Which of the OLD_KINDS (player, speed, score) combinations a game is
+static int kind_of(const GameStats* g) {
+    return ((g->player_name[1] - '0') * 2 + (g->speed_level - 1)) * 4 + g->final_score / 10;
+}
+
+/**
+ * A log longer than STATS_STORE_KEEP_DAYS of few distinct (player,
+ * speed, score) games, one batch per day, so every new day compacts the
+ * old ones as the game does. One old day holds only three distinct
+ * games, where a summary would not be smaller: it is kept raw.
+ * Returns: games logged
+ */
+static int log_old_games(void) {
+    int n = 0;
+    srand(19);
+    for (int days = OLD_DAYS - 1; days >= 0; days--) {
+        time_t noon = noon_days_ago(days);
+        int count = days == OLD_DAYS - 5 ? 3 : OLD_PER_DAY;
+        int first = n;
+        for (int i = 0; i < count; i++) {
+            GameStats* g = &old_games[n++];
+            memset(g, 0, sizeof(GameStats));
+            g->timestamp = noon + i;
+            snprintf(g->player_name, sizeof(g->player_name), "p%d", count == 3 ? i : rand() % 3);
+            g->final_score = 10 * (count == 3 ? i : rand() % 4);
+            g->speed_level = 1 + (count == 3 ? 0 : rand() % 2);
+            g->fish_caught = rand() % 30;
+            g->hooks_missed = rand() % 4;
+            g->game_duration = 20 + rand() % 20;
+        }
+        CHECK(log_game_stats_batch(old_games + first, count) == count);
+    }
+    return n;
+}
+
+// The cursor's weights and sums, the player index and the score trees all still give the raw numbers
+static void check_compacted(int n) {
+    long long want_kinds[OLD_KINDS] = { 0 }, got_kinds[OLD_KINDS] = { 0 };
+    long long want_caught = 0, got_caught = 0, want_duration = 0, got_duration = 0;
+    for (int i = 0; i < n; i++) {
+        want_kinds[kind_of(&old_games[i])]++;
+        want_caught += old_games[i].fish_caught;
+        want_duration += old_games[i].game_duration;
+    }
+
+    StatsCursor* c = malloc(sizeof(StatsCursor));
+    const GameStats* g;
+    CHECK(c != NULL);
+    for (int reverse = 0; reverse <= 1; reverse++) {
+        CHECK(stats_cursor_open(c, STATS_FILE, reverse) == 0 && c->count == (uint64_t)n);
+        long long weights = 0;
+        int summaries = 0;
+        memset(got_kinds, 0, sizeof(got_kinds));
+        got_caught = got_duration = 0;
+        while ((g = stats_cursor_next(c)) != NULL) {
+            weights += (long long)c->weight;
+            summaries += c->summary;
+            got_kinds[kind_of(g)] += (long long)c->weight;
+            got_caught += g->fish_caught;           // a summary's counters are already sums
+            got_duration += g->game_duration;
+        }
+        CHECK(weights == n && summaries > 0 && c->bad_blocks == 0);
+        CHECK(memcmp(got_kinds, want_kinds, sizeof(want_kinds)) == 0);
+        CHECK(got_caught == want_caught && got_duration == want_duration);
+        stats_cursor_close(c);
+    }
+    free(c);
+
+    PlayerIndex ix;
+    PlayerTotals p;
+    CHECK(player_index_open(&ix, STATS_FILE) == 0);
+    int wrong = 0;
+    for (int k = 0; k < 3; k++) {
+        char name[8];
+        long long games = 0, total = 0, caught = 0, missed = 0, duration = 0;
+        int best = -1;
+        snprintf(name, sizeof(name), "p%d", k);
+        for (int i = 0; i < n; i++) {
+            const GameStats* o = &old_games[i];
+            if (strcmp(o->player_name, name) != 0) continue;
+            games++;
+            total += o->final_score;
+            caught += o->fish_caught;
+            missed += o->hooks_missed;
+            duration += o->game_duration;
+            if (o->final_score > best) best = o->final_score;
+        }
+        if (!player_index_find(&ix, name, &p) || p.games != games || p.total_score != total ||
+            p.best_score != best || p.caught != caught || p.missed != missed || p.duration != duration) {
+            wrong++;
+        }
+    }
+    CHECK(wrong == 0);
+    player_index_close(&ix);
+
+    static int scores[OLD_GAMES];
+    ScoreTree t;
+    CHECK(score_tree_open(&t, STATS_FILE) == 0);
+    wrong = 0;
+    for (int board = 0; board < SCORE_TREE_BOARDS; board++) {
+        int m = 0;
+        for (int i = 0; i < n; i++) {
+            if (board == 0 || old_games[i].speed_level == board) scores[m++] = old_games[i].final_score;
+        }
+        qsort(scores, m, sizeof(int), compare_ints);
+        if (score_tree_count(&t, board) != m) wrong++;
+        for (int q = 1; q <= 9 && m > 0; q++) {
+            long long want = (long long)(q / 10.0 * m + 0.999999);
+            if (score_tree_quantile(&t, board, q / 10.0) != scores[want - 1]) wrong++;
+        }
+    }
+    CHECK(wrong == 0);
+    score_tree_close(&t);
+}
+
+// Sum and length of the latest 'size' scores of history h[0..k)
+static long long window_of(const int* h, int k, int size, int* n) {
+    long long sum = 0;
+    *n = k < size ? k : size;
+    for (int i = k - *n; i < k; i++) sum += h[i];
+    return sum;
+}
+
+// A player's ring, windows and streaks against a recomputation over every score h[0..k)
+static int recent_matches(const PlayerTotals* p, const int* h, int k) {
+    int n;
+    if (p->recent_count != (uint32_t)(k < PLAYER_RECENT_GAMES ? k : PLAYER_RECENT_GAMES)) return 0;
+    for (int w = 0; w < PLAYER_WINDOWS; w++) {
+        long long sum = window_of(h, k, player_window_size(w), &n);
+        if (p->window_sum[w] != sum || player_window_average(p, w) != (n > 0 ? (double)sum / n : 0.0)) {
+            return 0;
+        }
+    }
+    int streak = 0, best = 0;
+    for (int i = 0; i < k; i++) {
+        long long sum = window_of(h, i, player_window_size(PLAYER_STREAK_WINDOW), &n);
+        if (i > 0 && h[i] > (double)sum / n) {
+            if (++streak > best) best = streak;
+        } else {
+            streak = 0;
+        }
+    }
+    return p->streak == streak && p->best_streak == best;
+}
+
+/**
+ * Moving windows and streaks, checked after every score: random scores,
+ * rising runs (streaks), and bursts of one score as a compacted summary
+ * adds them, well past a full ring
+ */
+static void test_recent_scores(void) {
+    static int history[4 * PLAYER_RECENT_GAMES];
+    PlayerTotals p;
+    memset(&p, 0, sizeof(p));
+    int k = 0, wrong = 0;
+    srand(23);
+    while (k < 4 * PLAYER_RECENT_GAMES - 20) {
+        int kind = rand() % 3;
+        int len = 1 + rand() % 12;
+        int base = rand() % 100 - 20;
+        for (int i = 0; i < len; i++) {
+            int score = kind == 0 ? rand() % 100 - 20 : kind == 1 ? base + 3 * i : base;
+            player_recent_add(&p, score);
+            history[k++] = score;
+            if (!recent_matches(&p, history, k)) wrong++;
+        }
+    }
+    CHECK(wrong == 0 && p.best_streak > 1);
+}
+
+// The index built over compacted days: each summary added its score once per game, in log order
+static void check_recent_compacted(void) {
+    static int history[3][OLD_GAMES];
+    int k[3] = { 0, 0, 0 };
+    StatsCursor* c = malloc(sizeof(StatsCursor));
+    const GameStats* g;
+    CHECK(c != NULL && stats_cursor_open(c, STATS_FILE, 0) == 0);
+    while ((g = stats_cursor_next(c)) != NULL) {
+        int player = g->player_name[1] - '0';
+        for (uint64_t i = 0; i < c->weight && i < PLAYER_RECENT_GAMES; i++) {
+            history[player][k[player]++] = g->final_score;
+        }
+    }
+    stats_cursor_close(c);
+    free(c);
+
+    PlayerIndex ix;
+    PlayerTotals p;
+    int wrong = 0;
+    CHECK(player_index_open(&ix, STATS_FILE) == 0);
+    for (int player = 0; player < 3; player++) {
+        char name[8];
+        snprintf(name, sizeof(name), "p%d", player);
+        if (!player_index_find(&ix, name, &p) || !recent_matches(&p, history[player], k[player])) wrong++;
+    }
+    CHECK(wrong == 0);
+    player_index_close(&ix);
+}
+
+/**
+ * Compaction in its own directory: days past STATS_STORE_KEEP_DAYS turn
+ * into summaries (or stay raw when that is not smaller), and the cursor,
+ * the player index and the score trees agree with the raw games, also
+ * after both sidecars are rebuilt across the compacted days
+ */
+static void test_compaction(void) {
+    CHECK(mkdir("compacted", 0755) == 0 && chdir("compacted") == 0);
+    int n = log_old_games();
+    CHECK(stats_log_games(STATS_FILE) == (uint64_t)n);
+
+    StatsStore s;
+    int summary_days = 0, kept_raw = 0;
+    CHECK(stats_store_open(&s, STATS_FILE) == 0 && s.count == OLD_DAYS);
+    for (int i = 0; i < s.count; i++) {
+        const StatsSegmentHeader* h = stats_store_segment(&s, i);
+        if (h == NULL) continue;
+        summary_days += h->kind == STATS_SEGMENT_SUMMARY;
+        kept_raw += h->kept_raw;
+    }
+    stats_store_close(&s);
+    CHECK(summary_days >= OLD_DAYS - STATS_STORE_KEEP_DAYS - 3 && kept_raw == 1);
+
+    check_compacted(n);
+    CHECK(rebuild_stats_indexes() == 0);
+    check_compacted(n);
+    check_recent_compacted();
+    CHECK(chdir("..") == 0);
+}
+
+/**
+ * Queries on 1 and 8 threads with slices small enough to start inside
+ * blocks (so workers resync to the next block), every grouping, with and
+ * without filters: the per-thread tables must merge to exact answers
+ */
+static void test_query(void) {
+    time_t from = logged[GAMES / 4].timestamp;
+    time_t to = logged[3 * GAMES / 4].timestamp;
+    StatsQuery filters[] = {
+        { (time_t)0, (time_t)1 << 40, NULL, 0, STATS_GROUP_NONE, 0, 0 },
+        { from, to, NULL, 3, STATS_GROUP_NONE, 0, 0 },
+        { from, to, "player07", 0, STATS_GROUP_NONE, 0, 0 },
+    };
+    for (unsigned f = 0; f < sizeof(filters) / sizeof(filters[0]); f++) {
+        for (int group = STATS_GROUP_NONE; group <= STATS_GROUP_SPEED; group++) {
+            for (int threads = 1; threads <= 8; threads += 7) {
+                StatsQuery q = filters[f];
+                StatsQueryResult res;
+                q.group = (StatsGroupBy)group;
+                q.threads = threads;
+                q.slice_bytes = STATS_BLOCK_BYTES;  // the smallest slice: most start mid-block
+                CHECK(stats_query_run(STATS_FILE, &q, &res) == 0);
+                CHECK(res.count > 0 && res.slices > (f == 0 ? 4 * DAYS : 1) && res.bad_blocks == 0);
+                CHECK(query_matches(&q, &res));
+                stats_query_free(&res);
+            }
+        }
+    }
+}
+
+// Per-player totals match a linear count
+static void test_player_index(void) {
+    PlayerIndex ix;
+    PlayerTotals p;
+    CHECK(player_index_open(&ix, STATS_FILE) == 0);
+    int wrong = 0;
+    for (int k = 0; k < PLAYERS; k++) {
+        char name[20];
+        long long games = 0, total = 0;
+        int best = -1000000;
+        snprintf(name, sizeof(name), "player%02d", k);
+        for (int i = 0; i < GAMES; i++) {
+            if (strcmp(logged[i].player_name, name) != 0) continue;
+            games++;
+            total += logged[i].final_score;
+            if (logged[i].final_score > best) best = logged[i].final_score;
+        }
+        if (!player_index_find(&ix, name, &p) || p.games != games || p.total_score != total ||
+            p.best_score != best) {
+            wrong++;
+        }
+    }
+    CHECK(wrong == 0);
+    CHECK(!player_index_find(&ix, "nobody", &p));
+    player_index_close(&ix);
+}
+
+// A game the logger tests can tell apart: its number is the score
+static void numbered_game(GameStats* g, const char* player, int number, time_t when) {
+    memset(g, 0, sizeof(GameStats));
+    g->timestamp = when;
+    snprintf(g->player_name, sizeof(g->player_name), "%s", player);
+    g->final_score = number;
+    g->speed_level = 1 + number % 6;
+    g->game_duration = 30;
+}
+
+static void* push_games(void* arg) {
+    int thread = (int)(long)arg;
+    GameStats g;
+    for (int i = 0; i < PUSHES; i++) {
+        numbered_game(&g, "logger", thread * PUSHES + i, time(NULL));
+        if (stats_logger_push(&g) == -1) break;
+    }
+    return NULL;
+}
+
+static long long logger_pushed(void) {
+    StatsLoggerCounters k;
+    stats_logger_counters(&k);
+    return k.pushed;
+}
+
+/**
+ * Every game of 'player' numbered [0, count) is in the log exactly once,
+ * and each pusher's games (PUSHES apart) in the order it pushed them
+ */
+static int logged_once(const char* player, int count) {
+    StatsCursor* c = malloc(sizeof(StatsCursor));
+    int* seen = calloc((size_t)count, sizeof(int));
+    int last[PUSHERS];
+    int ok = c != NULL && seen != NULL && stats_cursor_open(c, STATS_FILE, 0) == 0;
+    if (ok) {
+        const GameStats* g;
+        for (int t = 0; t < PUSHERS; t++) last[t] = -1;
+        stats_cursor_filter(c, 0, (time_t)1 << 40, player);
+        while ((g = stats_cursor_next(c)) != NULL) {
+            int n = g->final_score;
+            if (n < 0 || n >= count || seen[n]++ || n <= last[n / PUSHES % PUSHERS]) ok = 0;
+            else last[n / PUSHES % PUSHERS] = n;
+        }
+        for (int n = 0; n < count; n++) {
+            if (seen[n] != 1) ok = 0;
+        }
+        stats_cursor_close(c);
+    }
+    free(c);
+    free(seen);
+    return ok;
+}
+
+static void* release_later(void* arg) {
+    usleep(100000);
+    stats_store_unlock((int)(long)arg);
+    return NULL;
+}
+
+/**
+ * The background logger: pushers from several threads fill the queue
+ * while the writer is held up, a commit that fails is retried, and
+ * flush and stop lose nothing
+ */
+static void test_logger(void) {
+    pthread_t threads[PUSHERS];
+    StatsLoggerCounters k;
+    GameStats g;
+    uint64_t before = stats_log_games(STATS_FILE);
+    CHECK(stats_logger_start(0) == 0);
+
+    // Hold the store lock so the writer's first commit waits and the queue fills up
+    int lock_fd = stats_store_lock(STATS_FILE);
+    CHECK(lock_fd != -1);
+    for (int t = 0; t < PUSHERS; t++) {
+        pthread_create(&threads[t], NULL, push_games, (void*)(long)t);
+    }
+    for (int wait = 0; wait < 2000 && logger_pushed() < STATS_LOGGER_QUEUE; wait++) usleep(1000);
+    usleep(50000);
+    // At most a batch taken plus a full queue: the other pushers must be waiting
+    long long pushed = logger_pushed();
+    CHECK(pushed >= STATS_LOGGER_QUEUE && pushed <= STATS_LOGGER_QUEUE + STATS_LOGGER_BATCH);
+    stats_store_unlock(lock_fd);
+    for (int t = 0; t < PUSHERS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    CHECK(stats_logger_flush() == 0);
+    CHECK(stats_log_games(STATS_FILE) == before + PUSHERS * PUSHES);
+    CHECK(logged_once("logger", PUSHERS * PUSHES));
+    before += PUSHERS * PUSHES;
+
+    // A day whose segment cannot be created (a directory is in the way):
+    // the commit fails and is retried until the way is clear
+    char day_path[64];
+    time_t later = time(NULL) + 2 * 86400;
+    struct tm tm;
+    localtime_r(&later, &tm);
+    snprintf(day_path, sizeof(day_path), "%s.%04d%02d%02d", STATS_FILE,
+             tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+    CHECK(mkdir(day_path, 0755) == 0);
+    stats_logger_counters(&k);
+    long long commits = k.commits;
+    int refused = 0;
+    for (int i = 0; i < 100; i++) {
+        numbered_game(&g, "retry", i, later);
+        refused += stats_logger_push(&g) == -1;
+    }
+    usleep(3 * STATS_LOGGER_RETRY_MS * 1000);
+    stats_logger_counters(&k);
+    CHECK(k.commits >= commits + 2 && k.logged == PUSHERS * PUSHES);
+    CHECK(rmdir(day_path) == 0);
+    CHECK(stats_logger_flush() == 0);
+    CHECK(stats_log_games(STATS_FILE) == before + 100 && logged_once("retry", 100));
+    before += 100;
+
+    // Stop with games still queued behind a held lock: they are written first
+    pthread_t releaser;
+    lock_fd = stats_store_lock(STATS_FILE);
+    CHECK(lock_fd != -1);
+    for (int i = 0; i < 3000; i++) {
+        numbered_game(&g, "stopped", i, later);
+        refused += stats_logger_push(&g) == -1;
+    }
+    CHECK(refused == 0);
+    pthread_create(&releaser, NULL, release_later, (void*)(long)lock_fd);
+    stats_logger_stop();
+    pthread_join(releaser, NULL);
+    stats_logger_counters(&k);
+    CHECK(k.failed == 0 && k.logged == PUSHERS * PUSHES + 100 + 3000);
+    CHECK(stats_log_games(STATS_FILE) == before + 3000 && logged_once("stopped", 3000));
+    CHECK(stats_logger_push(&g) == -1);     // stopped: log_game_stats() writes directly again
+}
 
 int main() {
-    GameStats stats;
-    stats.timestamp = time(NULL);
-    strcpy(stats.player_name, "TestPlayer");
-    stats.final_score = 120;
-    stats.fish_caught = 15;
-    stats.hooks_missed = 2;
-    stats.speed_level = 2;
-    stats.lives_remaining = 1;
-    stats.game_duration = 30;
-    
-    log_game_stats(&stats);
-    display_game_history();
-    display_player_stats("TestPlayer");
-    
-    return 0;
-}
\ No newline at end of file
+    log_games();
+    test_cursor();
+    test_slices();
+    test_score_tree();
+    test_player_index();
+    test_recent_scores();
+    test_query();
+    test_compaction();
+    test_logger();
+    return test_result("test_stats");
+}